@@ -97,6 +97,12 @@ static IceTCommRequest MPIIrecv(IceTCommunicator self,
 static void MPIWaitone(IceTCommunicator self, IceTCommRequest *request);
 static int  MPIWaitany(IceTCommunicator self,
                        int count, IceTCommRequest *array_of_requests);
+static int  MPITestone(IceTCommunicator self, IceTCommRequest *request);
+static int  MPITestany(IceTCommunicator self,
+                       int count, IceTCommRequest *array_of_requests);
+static int  MPIWaitsome(IceTCommunicator self,
+                        int count, IceTCommRequest *array_of_requests,
+                        int *array_of_indices);
 static int MPIComm_size(IceTCommunicator self);
 static int MPIComm_rank(IceTCommunicator self);
 
@@ -222,6 +228,10 @@ IceTCommunicator icetCreateMPICommunicator(MPI_Comm mpi_comm)
     comm->Irecv = MPIIrecv;
     comm->Wait = MPIWaitone;
     comm->Waitany = MPIWaitany;
+    comm->version = ICET_COMMUNICATOR_VERSION;
+    comm->Test = MPITestone;
+    comm->Testany = MPITestany;
+    comm->Waitsome = MPIWaitsome;
     comm->Comm_size = MPIComm_size;
     comm->Comm_rank = MPIComm_rank;
 
@@ -560,6 +570,90 @@ static int  MPIWaitany(IceTCommunicator self,
     return idx;
 }
 
+static int  MPITestone(IceTCommunicator self, IceTCommRequest *icet_request)
+{
+    MPI_Request mpi_request;
+    int flag;
+
+    /* To remove warning */
+    (void)self;
+
+    if (*icet_request == ICET_COMM_REQUEST_NULL) return 1;
+
+    mpi_request = getMPIRequest(*icet_request);
+    MPI_Test(&mpi_request, &flag, MPI_STATUS_IGNORE);
+    setMPIRequest(*icet_request, mpi_request);
+
+    if (flag) {
+        destroy_request(*icet_request);
+        *icet_request = ICET_COMM_REQUEST_NULL;
+    }
+
+    return flag;
+}
+
+static int  MPITestany(IceTCommunicator self,
+                       int count, IceTCommRequest *array_of_requests)
+{
+    int idx;
+
+    /* This is called often while polling, so test the requests one at a
+       time rather than allocating an array for MPI_Testany on every call. */
+    for (idx = 0; idx < count; idx++) {
+        if (   (array_of_requests[idx] != ICET_COMM_REQUEST_NULL)
+            && MPITestone(self, &array_of_requests[idx]) ) {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+static int  MPIWaitsome(IceTCommunicator self,
+                        int count, IceTCommRequest *array_of_requests,
+                        int *array_of_indices)
+{
+    MPI_Request *mpi_requests;
+    int outcount;
+    int i;
+
+    /* To remove warning */
+    (void)self;
+
+    mpi_requests = malloc(sizeof(MPI_Request)*count);
+    if (mpi_requests == NULL) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not allocate array for MPI requests.");
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        mpi_requests[i] = getMPIRequest(array_of_requests[i]);
+    }
+
+    MPI_Waitsome(count,
+                 mpi_requests,
+                 &outcount,
+                 array_of_indices,
+                 MPI_STATUSES_IGNORE);
+
+    if (outcount == MPI_UNDEFINED) {
+        /* No active requests. */
+        outcount = 0;
+    }
+
+    for (i = 0; i < outcount; i++) {
+        int idx = array_of_indices[i];
+        setMPIRequest(array_of_requests[idx], mpi_requests[idx]);
+        destroy_request(array_of_requests[idx]);
+        array_of_requests[idx] = ICET_COMM_REQUEST_NULL;
+    }
+
+    free(mpi_requests);
+
+    return outcount;
+}
+
 static int MPIComm_size(IceTCommunicator self)
 {
     int size;
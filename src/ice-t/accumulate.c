@@ -0,0 +1,387 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#include <IceTDevAccumulate.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+#include <IceTDevTiming.h>
+
+#include <string.h>
+
+/* Layout of ICET_ACCUMULATION_LAYOUT.  The running sums only hold for the
+   same piece of the same tile with the same number of color channels. */
+#define ACCUMULATE_TILE                 0
+#define ACCUMULATE_OFFSET               1
+#define ACCUMULATE_NUM_PIXELS           2
+#define ACCUMULATE_NUM_CHANNELS         3
+#define ACCUMULATE_LAYOUT_SIZE          4
+
+void icetAccumulateInterval(IceTInt frames)
+{
+    if (frames < 0) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Accumulation interval must be nonnegative.");
+        return;
+    }
+
+    icetStateSetInteger(ICET_ACCUMULATE_INTERVAL, frames);
+}
+
+void icetAccumulateCollect(void)
+{
+    icetStateSetBoolean(ICET_ACCUMULATE_COLLECT_REQUEST, ICET_TRUE);
+}
+
+void icetAccumulateReset(void)
+{
+    icetStateSetInteger(ICET_ACCUMULATED_FRAMES, 0);
+}
+
+void icetAccumulateBeginFrame(void)
+{
+    IceTBoolean accumulating = icetIsEnabled(ICET_ACCUMULATE_FRAMES);
+
+    /* Sums left from before accumulation was last turned off are stale. */
+    if (accumulating && !icetUnsafeStateGetBoolean(ICET_ACCUMULATING)[0]) {
+        icetStateSetInteger(ICET_ACCUMULATED_FRAMES, 0);
+    }
+
+    icetStateSetBoolean(ICET_ACCUMULATING, accumulating);
+    if (!accumulating) { return; }
+
+    icetStateSetBoolean(ICET_ACCUMULATE_COLLECT_IMAGES,
+                        icetIsEnabled(ICET_COLLECT_IMAGES));
+    icetDisable(ICET_COLLECT_IMAGES);
+}
+
+static IceTInt accumulateNumChannels(IceTEnum color_format)
+{
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_RGBA_UBYTE: return 4;
+      case ICET_IMAGE_COLOR_RGBA_FLOAT: return 4;
+      case ICET_IMAGE_COLOR_RGB_FLOAT:  return 3;
+      default:                          return 0;
+    }
+}
+
+/* Starts the running sums over if they were reset or if the piece held by
+   any process moved.  All processes vote so that they keep counting the same
+   frames and agree on which frames to collect. */
+static void accumulateCheckLayout(const IceTInt *layout)
+{
+    IceTInt frames;
+    IceTInt moved;
+    IceTInt *votes;
+    IceTInt num_proc;
+    IceTInt proc;
+
+    moved = (   (icetStateGetNumEntries(ICET_ACCUMULATION_LAYOUT)
+                 != ACCUMULATE_LAYOUT_SIZE)
+             || (memcmp(layout,
+                        icetUnsafeStateGetInteger(ICET_ACCUMULATION_LAYOUT),
+                        ACCUMULATE_LAYOUT_SIZE*sizeof(IceTInt)) != 0) );
+
+    num_proc = icetCommSize();
+    votes = icetStateAllocateInteger(ICET_ACCUMULATE_VOTES, num_proc);
+    icetCommAllgather(&moved, 1, ICET_INT, votes);
+
+    icetGetIntegerv(ICET_ACCUMULATED_FRAMES, &frames);
+    for (proc = 0; proc < num_proc; proc++) {
+        if (votes[proc]) { frames = 0; }
+    }
+
+    if (frames == 0) {
+        IceTSizeType num_values
+            = layout[ACCUMULATE_NUM_PIXELS]*layout[ACCUMULATE_NUM_CHANNELS];
+        IceTFloat *sums;
+
+        icetRaiseDebug("Starting accumulation over.");
+        icetStateSetIntegerv(ICET_ACCUMULATION_LAYOUT,
+                             ACCUMULATE_LAYOUT_SIZE,
+                             layout);
+        sums = icetStateAllocateFloat(ICET_ACCUMULATION_SUMS, num_values);
+        if (num_values > 0) {
+            memset(sums, 0, num_values*sizeof(IceTFloat));
+        }
+        icetStateSetInteger(ICET_ACCUMULATED_FRAMES, 0);
+    }
+}
+
+/* Adds the colors of the piece to the running sums and replaces them with
+   the average over frames. */
+static void accumulateAddPiece(IceTImage image,
+                               const IceTInt *layout,
+                               IceTInt frames)
+{
+    IceTFloat *sums = (IceTFloat *)icetUnsafeStateGetFloat(
+                                                      ICET_ACCUMULATION_SUMS);
+    IceTInt num_channels = layout[ACCUMULATE_NUM_CHANNELS];
+    IceTSizeType num_values = layout[ACCUMULATE_NUM_PIXELS]*num_channels;
+    IceTSizeType first_value = layout[ACCUMULATE_OFFSET]*num_channels;
+    IceTFloat scale = 1.0f/(IceTFloat)frames;
+    IceTSizeType i;
+
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUByte *colors = icetImageGetColorub(image) + first_value;
+        for (i = 0; i < num_values; i++) {
+            sums[i] += (IceTFloat)colors[i]/255.0f;
+            colors[i] = (IceTUByte)(255.0f*sums[i]*scale + 0.5f);
+        }
+    } else {
+        IceTFloat *colors = icetImageGetColorf(image) + first_value;
+        for (i = 0; i < num_values; i++) {
+            sums[i] += colors[i];
+            colors[i] = sums[i]*scale;
+        }
+    }
+}
+
+static IceTBoolean accumulateCollectThisFrame(IceTInt frames)
+{
+    IceTBoolean requested;
+    IceTInt interval;
+
+    requested = icetUnsafeStateGetBoolean(ICET_ACCUMULATE_COLLECT_REQUEST)[0];
+    icetStateSetBoolean(ICET_ACCUMULATE_COLLECT_REQUEST, ICET_FALSE);
+
+    if (!icetUnsafeStateGetBoolean(ICET_ACCUMULATE_COLLECT_IMAGES)[0]) {
+        return ICET_FALSE;
+    }
+
+    icetGetIntegerv(ICET_ACCUMULATE_INTERVAL, &interval);
+    return (requested || ((interval > 0) && (frames%interval == 0)));
+}
+
+#define ACCUMULATE_PIECE_OFFSETS(buf, num_proc) (buf)
+#define ACCUMULATE_PIECE_SIZES(buf, num_proc)   ((buf) + (num_proc))
+#define ACCUMULATE_BYTE_OFFSETS(buf, num_proc)  ((buf) + 2*(num_proc))
+#define ACCUMULATE_BYTE_SIZES(buf, num_proc)    ((buf) + 3*(num_proc))
+
+/* Gathers one buffer (colors or depths) of the pieces of a tile to dest.  On
+   dest, pieces holds the offsets and sizes of the pieces of all processes in
+   pixels. */
+static void accumulateGatherBuffer(const IceTByte *piece_buffer,
+                                   IceTByte *tile_buffer,
+                                   IceTSizeType pixel_size,
+                                   IceTSizeType piece_offset,
+                                   IceTSizeType piece_size,
+                                   IceTSizeType *pieces,
+                                   IceTInt dest)
+{
+    IceTInt rank = icetCommRank();
+
+    if (rank == dest) {
+        IceTInt num_proc = icetCommSize();
+        IceTSizeType *byte_offsets = ACCUMULATE_BYTE_OFFSETS(pieces, num_proc);
+        IceTSizeType *byte_sizes = ACCUMULATE_BYTE_SIZES(pieces, num_proc);
+        IceTInt proc;
+
+        for (proc = 0; proc < num_proc; proc++) {
+            byte_offsets[proc]
+                = pixel_size*ACCUMULATE_PIECE_OFFSETS(pieces, num_proc)[proc];
+            byte_sizes[proc]
+                = pixel_size*ACCUMULATE_PIECE_SIZES(pieces, num_proc)[proc];
+        }
+        if (piece_size > 0) {
+            memcpy(tile_buffer + pixel_size*piece_offset,
+                   piece_buffer + pixel_size*piece_offset,
+                   pixel_size*piece_size);
+        }
+        icetCommGatherv(ICET_IN_PLACE_COLLECT,
+                        byte_sizes[rank],
+                        ICET_BYTE,
+                        tile_buffer,
+                        byte_sizes,
+                        byte_offsets,
+                        dest);
+    } else {
+        icetCommGatherv((piece_size > 0)
+                            ? piece_buffer + pixel_size*piece_offset : NULL,
+                        pixel_size*piece_size,
+                        ICET_BYTE,
+                        NULL,
+                        NULL,
+                        NULL,
+                        dest);
+    }
+}
+
+/* Gathers the averaged pieces of every tile to its display process in the
+   same way icetSingleImageCollect does and returns the tile displayed by the
+   local process. */
+static IceTImage accumulateCollect(IceTImage image, const IceTInt *layout)
+{
+    IceTInt num_tiles;
+    const IceTInt *tile_viewports;
+    const IceTInt *display_nodes;
+    IceTInt tile_displayed;
+    IceTEnum color_format;
+    IceTEnum depth_format;
+    IceTBoolean collect_depth;
+    IceTSizeType *pieces;
+    IceTImage result_image;
+    IceTInt rank;
+    IceTInt tile_idx;
+
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    tile_viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
+    display_nodes = icetUnsafeStateGetInteger(ICET_DISPLAY_NODES);
+    icetGetIntegerv(ICET_TILE_DISPLAYED, &tile_displayed);
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    rank = icetCommRank();
+
+    /* Same as icetImageAdjustForOutput. */
+    collect_depth = (   (depth_format != ICET_IMAGE_DEPTH_NONE)
+                     && (   !icetIsEnabled(ICET_COMPOSITE_ONE_BUFFER)
+                         || (color_format == ICET_IMAGE_COLOR_NONE) ) );
+
+    icetTimingCollectBegin();
+
+    result_image = icetImageNull();
+    for (tile_idx = 0; tile_idx < num_tiles; tile_idx++) {
+        IceTInt dest = display_nodes[tile_idx];
+        IceTSizeType piece_offset;
+        IceTSizeType piece_size;
+        IceTSizeType *piece_offsets;
+        IceTSizeType *piece_sizes;
+        IceTImage tile_image;
+        const IceTByte *piece_colors;
+        const IceTByte *piece_depths;
+        IceTByte *tile_colors;
+        IceTByte *tile_depths;
+        IceTSizeType color_size;
+        IceTSizeType depth_size;
+
+        if (layout[ACCUMULATE_TILE] == tile_idx) {
+            piece_offset = layout[ACCUMULATE_OFFSET];
+            piece_size = layout[ACCUMULATE_NUM_PIXELS];
+        } else {
+            piece_offset = 0;
+            piece_size = 0;
+        }
+
+        if (rank == dest) {
+            IceTInt num_proc = icetCommSize();
+            pieces = icetGetStateBuffer(ICET_ACCUMULATE_PIECE_BUF,
+                                        4*num_proc*sizeof(IceTSizeType));
+            piece_offsets = ACCUMULATE_PIECE_OFFSETS(pieces, num_proc);
+            piece_sizes = ACCUMULATE_PIECE_SIZES(pieces, num_proc);
+            tile_image = icetGetStateBufferImage(
+                                        ICET_ACCUMULATE_IMAGE_BUF,
+                                        tile_viewports[4*tile_idx + 2],
+                                        tile_viewports[4*tile_idx + 3]);
+            icetImageAdjustForOutput(tile_image);
+            /* Pixels no process holds are background. */
+            icetClearImageTrueBackground(tile_image);
+        } else {
+            pieces = NULL;
+            piece_offsets = NULL;
+            piece_sizes = NULL;
+            tile_image = icetImageNull();
+        }
+        icetCommGather(&piece_offset, 1, ICET_SIZE_TYPE, piece_offsets, dest);
+        icetCommGather(&piece_size, 1, ICET_SIZE_TYPE, piece_sizes, dest);
+
+        piece_colors = NULL;
+        piece_depths = NULL;
+        tile_colors = NULL;
+        tile_depths = NULL;
+        color_size = 0;
+        depth_size = 0;
+        if (piece_size > 0) {
+            if (color_format != ICET_IMAGE_COLOR_NONE) {
+                piece_colors = icetImageGetColorConstVoid(image, &color_size);
+            }
+            if (collect_depth) {
+                piece_depths = icetImageGetDepthConstVoid(image, &depth_size);
+            }
+        }
+        if (rank == dest) {
+            if (color_format != ICET_IMAGE_COLOR_NONE) {
+                tile_colors = icetImageGetColorVoid(tile_image, &color_size);
+            }
+            if (collect_depth) {
+                tile_depths = icetImageGetDepthVoid(tile_image, &depth_size);
+            }
+            result_image = tile_image;
+        }
+
+        if (color_format != ICET_IMAGE_COLOR_NONE) {
+            accumulateGatherBuffer(piece_colors, tile_colors, color_size,
+                                   piece_offset, piece_size, pieces, dest);
+        }
+        if (collect_depth) {
+            accumulateGatherBuffer(piece_depths, tile_depths, depth_size,
+                                   piece_offset, piece_size, pieces, dest);
+        }
+    }
+
+    icetTimingCollectEnd();
+
+    if (tile_displayed >= 0) {
+        icetStateSetInteger(ICET_VALID_PIXELS_TILE, tile_displayed);
+        icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
+        icetStateSetInteger(ICET_VALID_PIXELS_NUM,
+                            icetImageGetNumPixels(result_image));
+    } else {
+        icetStateSetInteger(ICET_VALID_PIXELS_TILE, -1);
+        icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
+        icetStateSetInteger(ICET_VALID_PIXELS_NUM, 0);
+    }
+
+    return result_image;
+}
+
+IceTImage icetAccumulateFinishFrame(IceTImage image)
+{
+    IceTInt layout[ACCUMULATE_LAYOUT_SIZE];
+    IceTEnum color_format;
+    IceTInt frames;
+
+    if (!icetUnsafeStateGetBoolean(ICET_ACCUMULATING)[0]) { return image; }
+
+    if (icetUnsafeStateGetBoolean(ICET_ACCUMULATE_COLLECT_IMAGES)[0]) {
+        icetEnable(ICET_COLLECT_IMAGES);
+    }
+
+    /* Nothing of a cancelled frame is kept. */
+    if (icetUnsafeStateGetBoolean(ICET_FRAME_CANCELLED)[0]) { return image; }
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &layout[ACCUMULATE_TILE]);
+    icetGetIntegerv(ICET_VALID_PIXELS_OFFSET, &layout[ACCUMULATE_OFFSET]);
+    icetGetIntegerv(ICET_VALID_PIXELS_NUM, &layout[ACCUMULATE_NUM_PIXELS]);
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    layout[ACCUMULATE_NUM_CHANNELS] = accumulateNumChannels(color_format);
+    if ((layout[ACCUMULATE_TILE] < 0) || icetImageIsNull(image)) {
+        layout[ACCUMULATE_TILE] = -1;
+        layout[ACCUMULATE_OFFSET] = 0;
+        layout[ACCUMULATE_NUM_PIXELS] = 0;
+    }
+
+    accumulateCheckLayout(layout);
+
+    icetGetIntegerv(ICET_ACCUMULATED_FRAMES, &frames);
+    frames++;
+    icetStateSetInteger(ICET_ACCUMULATED_FRAMES, frames);
+
+    if (   (layout[ACCUMULATE_NUM_PIXELS] > 0)
+        && (layout[ACCUMULATE_NUM_CHANNELS] > 0) ) {
+        accumulateAddPiece(image, layout, frames);
+    }
+
+    if (accumulateCollectThisFrame(frames)) {
+        return accumulateCollect(image, layout);
+    } else {
+        return image;
+    }
+}
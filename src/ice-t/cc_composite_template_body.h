@@ -52,6 +52,8 @@
     IceTSizeType _back_num_inactive;
     IceTSizeType _back_num_active;
     IceTSizeType _dest_num_active;
+    IceTSizeType _progress_interval;
+    IceTSizeType _progress_countdown;
 
     _num_pixels = icetSparseImageGetNumPixels(CCC_FRONT_COMPRESSED_IMAGE);
     if (_num_pixels != icetSparseImageGetNumPixels(CCC_BACK_COMPRESSED_IMAGE)) {
@@ -69,6 +71,11 @@
     _dest = ICET_IMAGE_DATA(CCC_DEST_COMPRESSED_IMAGE);
     _dest_runlengths = NULL;
 
+    /* Blending a big image can take a while.  If asked, periodically give
+       the communication library a chance to progress outstanding sends. */
+    _progress_interval = icetCommProgressInterval();
+    _progress_countdown = _progress_interval;
+
     _pixel = 0;
     _front_num_inactive = _front_num_active = 0;
     _back_num_inactive = _back_num_active = 0;
@@ -150,8 +157,21 @@
             _back_num_active -= _num_to_composite;
             _dest_num_active += _num_to_composite;
             _pixel += _num_to_composite;
-            for ( ; 0 < _num_to_composite; _num_to_composite--) {
-                CCC_COMPOSITE(_front, _back, _dest);
+            while (0 < _num_to_composite) {
+                IceTSizeType _num_in_chunk = _num_to_composite;
+                if (   (_progress_interval > 0)
+                    && (_num_in_chunk > _progress_countdown) ) {
+                    _num_in_chunk = _progress_countdown;
+                }
+                _num_to_composite -= _num_in_chunk;
+                _progress_countdown -= _num_in_chunk;
+                for ( ; 0 < _num_in_chunk; _num_in_chunk--) {
+                    CCC_COMPOSITE(_front, _back, _dest);
+                }
+                if ((_progress_interval > 0) && (_progress_countdown < 1)) {
+                    icetCommProgress();
+                    _progress_countdown = _progress_interval;
+                }
             }
         }
     }
@@ -218,6 +218,88 @@ void icetCommWaitall(int count, IceTCommRequest *array_of_requests)
     }
 }
 
+/* Communicators that do not set version may predate Test, Testany, and
+   Waitsome and hold anything in their place.  Without them the tests report
+   nothing finished and Waitsome waits on one request at a time. */
+#define COMM_HAS(comm, member)                                  \
+    (   ((comm)->version == ICET_COMMUNICATOR_VERSION)          \
+     && ((comm)->member != NULL) )
+
+static IceTBoolean commAnyActive(int count,
+                                 const IceTCommRequest *array_of_requests)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        if (array_of_requests[i] != ICET_COMM_REQUEST_NULL) {
+            return ICET_TRUE;
+        }
+    }
+    return ICET_FALSE;
+}
+
+IceTBoolean icetCommTest(IceTCommRequest *request)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    if (!COMM_HAS(comm, Test)) {
+        return (*request == ICET_COMM_REQUEST_NULL) ? ICET_TRUE : ICET_FALSE;
+    }
+    return comm->Test(comm, request) ? ICET_TRUE : ICET_FALSE;
+}
+
+int icetCommTestany(int count, IceTCommRequest *array_of_requests)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    if (!COMM_HAS(comm, Testany)) {
+        return -1;
+    }
+    return comm->Testany(comm, count, array_of_requests);
+}
+
+int icetCommWaitsome(int count,
+                     IceTCommRequest *array_of_requests,
+                     int *array_of_indices)
+{
+    IceTCommunicator comm = icetGetCommunicator();
+    if (!COMM_HAS(comm, Waitsome)) {
+        if (!commAnyActive(count, array_of_requests)) { return 0; }
+        array_of_indices[0] = icetCommWaitany(count, array_of_requests);
+        return 1;
+    }
+    return comm->Waitsome(comm, count, array_of_requests, array_of_indices);
+}
+
+void icetCommProgressRequests(int count, IceTCommRequest *array_of_requests)
+{
+    icetStateSetPointer(ICET_COMM_PROGRESS_REQUESTS, array_of_requests);
+    icetStateSetInteger(ICET_NUM_COMM_PROGRESS_REQUESTS, count);
+}
+
+IceTSizeType icetCommProgressInterval(void)
+{
+    IceTInt interval;
+    IceTInt num_requests;
+
+    icetGetIntegerv(ICET_COMM_PROGRESS_INTERVAL, &interval);
+    if (interval < 1) { return 0; }
+    icetGetIntegerv(ICET_NUM_COMM_PROGRESS_REQUESTS, &num_requests);
+    if (num_requests < 1) { return 0; }
+    return interval;
+}
+
+void icetCommProgress(void)
+{
+    IceTInt num_requests;
+    IceTVoid *requests;
+
+    icetGetIntegerv(ICET_NUM_COMM_PROGRESS_REQUESTS, &num_requests);
+    if (num_requests < 1) { return; }
+    icetGetPointerv(ICET_COMM_PROGRESS_REQUESTS, &requests);
+
+    /* Any test call lets the communication library make progress on all
+       outstanding operations, so testing the set once is enough. */
+    icetCommTestany(num_requests, (IceTCommRequest *)requests);
+}
+
 int icetCommSize()
 {
     IceTCommunicator comm = icetGetCommunicator();
@@ -248,8 +330,7 @@ int icetFindRankInGroup(const int *group,
 int icetFindMyRankInGroup(const int *group,
                           IceTSizeType group_size)
 {
-    IceTInt rank;
-
-    icetGetIntegerv(ICET_RANK, &rank);
-    return icetFindRankInGroup(group, group_size, rank);
+    /* Ask the communicator rather than ICET_RANK so that this stays correct
+       while a strategy runs on a reordered communicator. */
+    return icetFindRankInGroup(group, group_size, icetCommRank());
 }
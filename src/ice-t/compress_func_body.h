@@ -36,6 +36,13 @@
  *              pixels in memory.  If defined, then REGION_OFFSET_X,
  *              REGION_OFFSET_Y, REGION_WIDTH, and REGION_HEIGHT must also be
  *              defined.
+ *      WORKER_THREAD - If defined, the body may run on a thread other than the
+ *              one that called IceT.  It then takes the composite mode from
+ *              COMPOSITE_MODE and a pointer to the imageDenseInfo from
+ *              DENSE_INFO, which must also be defined, instead of the
+ *              state and records no timing or debug messages.  The caller
+ *              must make sure the formats and composite mode are valid, since
+ *              errors cannot be raised from such a thread.
  *
  * All of the above macros are undefined at the end of this file.
  */
@@ -65,13 +72,25 @@
     IceTEnum _color_format, _depth_format;
     IceTSizeType _pixel_count;
     IceTEnum _composite_mode;
+#ifndef WORKER_THREAD
+    imageDenseInfo _dense_info;
+#endif
+    const imageDenseInfo *_dense;
+    IceTBoolean _raw;
 #ifdef REGION
     IceTSizeType _input_width = icetImageGetWidth(INPUT_IMAGE);
     IceTSizeType _region_width = REGION_WIDTH;
     IceTSizeType _region_x_skip = _input_width - (REGION_WIDTH);
 #endif
 
+#ifdef WORKER_THREAD
+    _composite_mode = COMPOSITE_MODE;
+    _dense = DENSE_INFO;
+#else
     icetGetEnumv(ICET_COMPOSITE_MODE, &_composite_mode);
+    imageDenseInfoGet(&_dense_info);
+    _dense = &_dense_info;
+#endif
 
     _color_format = icetImageGetColorFormat(INPUT_IMAGE);
     _depth_format = icetImageGetDepthFormat(INPUT_IMAGE);
@@ -84,6 +103,17 @@
     _pixel_count = icetImageGetNumPixels(INPUT_IMAGE);
 #endif
 
+#ifdef REGION
+    _raw = imageIsDense(INPUT_IMAGE, _composite_mode, _dense, OFFSET,
+                        _region_width, _input_width, _pixel_count);
+#elif defined(OFFSET)
+    _raw = imageIsDense(INPUT_IMAGE, _composite_mode, _dense, OFFSET,
+                        _pixel_count, _pixel_count, _pixel_count);
+#else
+    _raw = imageIsDense(INPUT_IMAGE, _composite_mode, _dense, 0,
+                        _pixel_count, _pixel_count, _pixel_count);
+#endif
+
 #ifdef DEBUG
     if (   (icetSparseImageGetColorFormat(OUTPUT_SPARSE_IMAGE) != _color_format)
         || (icetSparseImageGetDepthFormat(OUTPUT_SPARSE_IMAGE) != _depth_format)
@@ -144,6 +174,18 @@
                                 _d_out = (IceTFloat *)dest;     \
                                 _d_out[0] = _depth[0];          \
                                 dest += sizeof(IceTFloat);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _c_out = (IceTUInt *)dest;      \
+                                _d_out = (IceTFloat *)(_c_out+1);\
+                                if (CT_ACTIVE()) {              \
+                                    _c_out[0] = _color[0];      \
+                                    _d_out[0] = _depth[0];      \
+                                } else {                        \
+                                    _c_out[0] = _dense->background_word;\
+                                    _d_out[0] = 1.0f;           \
+                                }                               \
+                                dest += sizeof(IceTUInt) + sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color++;  _depth++;                    \
                                 _region_count++;                        \
@@ -187,6 +229,23 @@
                                 _out[3] = _color[3];            \
                                 _out[4] = _depth[0];            \
                                 dest += 5*sizeof(IceTFloat);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _out = (IceTFloat *)dest;       \
+                                if (CT_ACTIVE()) {              \
+                                    _out[0] = _color[0];        \
+                                    _out[1] = _color[1];        \
+                                    _out[2] = _color[2];        \
+                                    _out[3] = _color[3];        \
+                                    _out[4] = _depth[0];        \
+                                } else {                        \
+                                    _out[0] = _dense->background_color[0];\
+                                    _out[1] = _dense->background_color[1];\
+                                    _out[2] = _dense->background_color[2];\
+                                    _out[3] = _dense->background_color[3];\
+                                    _out[4] = 1.0f;             \
+                                }                               \
+                                dest += 5*sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color += 4;  _depth++;                 \
                                 _region_count++;                        \
@@ -229,6 +288,21 @@
                                 _out[2] = _color[2];            \
                                 _out[3] = _depth[0];            \
                                 dest += 4*sizeof(IceTFloat);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _out = (IceTFloat *)dest;       \
+                                if (CT_ACTIVE()) {              \
+                                    _out[0] = _color[0];        \
+                                    _out[1] = _color[1];        \
+                                    _out[2] = _color[2];        \
+                                    _out[3] = _depth[0];        \
+                                } else {                        \
+                                    _out[0] = _dense->background_color[0];\
+                                    _out[1] = _dense->background_color[1];\
+                                    _out[2] = _dense->background_color[2];\
+                                    _out[3] = 1.0f;             \
+                                }                               \
+                                dest += 4*sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color += 3;  _depth++;                 \
                                 _region_count++;                        \
@@ -263,6 +337,11 @@
 #define CT_WRITE_PIXEL(dest)    _out = (IceTFloat *)dest;       \
                                 _out[0] = _depth[0];            \
                                 dest += 1*sizeof(IceTFloat);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _out = (IceTFloat *)dest;       \
+                                _out[0] = CT_ACTIVE() ? _depth[0] : 1.0f;\
+                                dest += 1*sizeof(IceTFloat);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _depth++;                               \
                                 _region_count++;                        \
@@ -322,6 +401,11 @@
 #define CT_WRITE_PIXEL(dest)    _out = (IceTUInt *)dest;        \
                                 _out[0] = _color[0];            \
                                 dest += sizeof(IceTUInt);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _out = (IceTUInt *)dest;        \
+                                _out[0] = CT_ACTIVE() ? _color[0] : 0;\
+                                dest += sizeof(IceTUInt);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color++;                               \
                                 _region_count++;                        \
@@ -363,6 +447,19 @@
                                 _out[2] = _color[2];            \
                                 _out[3] = _color[3];            \
                                 dest += 4*sizeof(IceTUInt);
+#define CT_RAW                  _raw
+#define CT_WRITE_RAW_PIXEL(dest)                                \
+                                _out = (IceTFloat *)dest;       \
+                                if (CT_ACTIVE()) {              \
+                                    _out[0] = _color[0];        \
+                                    _out[1] = _color[1];        \
+                                    _out[2] = _color[2];        \
+                                    _out[3] = _color[3];        \
+                                } else {                        \
+                                    _out[0] = _out[1] = 0.0f;   \
+                                    _out[2] = _out[3] = 0.0f;   \
+                                }                               \
+                                dest += 4*sizeof(IceTUInt);
 #ifdef REGION
 #define CT_INCREMENT_PIXEL()    _color += 4;                            \
                                 _region_count++;                        \
@@ -413,11 +510,13 @@
                        _composite_mode);
     }
 
+#ifndef WORKER_THREAD
     icetRaiseDebug("Compression: %f%%\n",
         100.0f - (  100.0f*icetSparseImageGetCompressedBufferSize(OUTPUT_SPARSE_IMAGE)
                   / icetImageBufferSizeType(_color_format, _depth_format,
                                             icetSparseImageGetWidth(OUTPUT_SPARSE_IMAGE),
                                             icetSparseImageGetHeight(OUTPUT_SPARSE_IMAGE)) ));
+#endif
 }
 
 #undef INPUT_IMAGE
@@ -448,3 +547,9 @@
 #ifdef PIXEL_COUNT
 #undef PIXEL_COUNT
 #endif
+
+#ifdef WORKER_THREAD
+#undef WORKER_THREAD
+#undef COMPOSITE_MODE
+#undef DENSE_INFO
+#endif
@@ -32,6 +32,15 @@
  *              around the file.  If defined, then CT_SPACE_BOTTOM,
  *              CT_SPACE_TOP, CT_SPACE_LEFT, CT_SPACE_RIGHT, CT_FULL_WIDTH,
  *              and CT_FULL_HEIGHT must all also be defined.
+ *      CT_RAW - If defined to a true value (or variable holding one), every
+ *              pixel (except the padding) is stored in one active run
+ *              without looking for inactive ones.  CT_WRITE_RAW_PIXEL(pointer)
+ *              must then also be defined.  It is like CT_WRITE_PIXEL except
+ *              that it writes inactive pixels as the values that
+ *              decompressing or compositing an inactive pixel gives.
+ *
+ * No timing is recorded when the WORKER_THREAD macro of compress_func_body.h
+ * is defined.
  *
  * All of the above macros are undefined at the end of this file.
  */
@@ -76,7 +85,9 @@
 #endif
     IceTSizeType _compressed_size;
 
+#ifndef WORKER_THREAD
     icetTimingCompressBegin();
+#endif
 
     _dest = ICET_IMAGE_DATA(CT_COMPRESSED_IMAGE);
 
@@ -92,7 +103,23 @@
             IceTSizeType _x = CT_SPACE_LEFT;
             IceTSizeType _lastx = CT_FULL_WIDTH-CT_SPACE_RIGHT;
             _count += CT_SPACE_LEFT;
-            while (ICET_TRUE) {
+#ifdef CT_RAW
+            if (CT_RAW) {
+                IceTVoid *_runlengths = _dest;
+                _dest += RUN_LENGTH_SIZE;
+                INACTIVE_RUN_LENGTH(_runlengths) = _count;
+#ifdef DEBUG
+                _totalcount += _count + (_lastx - _x);
+#endif
+                ACTIVE_RUN_LENGTH(_runlengths) = _lastx - _x;
+                for ( ; _x < _lastx; _x++) {
+                    CT_WRITE_RAW_PIXEL(_dest);
+                    CT_INCREMENT_PIXEL();
+                }
+                _count = 0;
+            }
+#endif /*CT_RAW*/
+            while (_x < _lastx) {
                 IceTVoid *_runlengths;
                 while ((_x < _lastx) && (!CT_ACTIVE())) {
                     _x++;
@@ -127,6 +154,22 @@
 #endif /* CT_PADDING */
 
         _p = 0;
+#ifdef CT_RAW
+        if (CT_RAW) {
+            IceTVoid *_runlengths = _dest;
+            _dest += RUN_LENGTH_SIZE;
+            INACTIVE_RUN_LENGTH(_runlengths) = _count;
+            ACTIVE_RUN_LENGTH(_runlengths) = _pixels;
+#ifdef DEBUG
+            _totalcount += _count + _pixels;
+#endif
+            for ( ; _p < _pixels; _p++) {
+                CT_WRITE_RAW_PIXEL(_dest);
+                CT_INCREMENT_PIXEL();
+            }
+            _count = 0;
+        }
+#endif /*CT_RAW*/
         while (_p < _pixels) {
             IceTVoid *_runlengths = _dest;
             _dest += RUN_LENGTH_SIZE;
@@ -183,7 +226,9 @@
     }
 #endif /*DEBUG*/
 
+#ifndef WORKER_THREAD
     icetTimingCompressEnd();
+#endif
 
     _compressed_size
         = (IceTSizeType)
@@ -206,6 +251,11 @@
 #undef CT_INCREMENT_PIXEL
 #undef COMPRESSED_SIZE
 
+#ifdef CT_RAW
+#undef CT_RAW
+#undef CT_WRITE_RAW_PIXEL
+#endif
+
 #ifdef CT_PADDING
 #undef CT_PADDING
 #undef CT_SPACE_BOTTOM
@@ -11,8 +11,10 @@
 
 #include <IceT.h>
 
+#include <IceTDevCommunication.h>
 #include <IceTDevDiagnostics.h>
 #include <IceTDevImage.h>
+#include <IceTDevThreads.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +25,11 @@ struct IceTContextStruct {
     IceTEnum magic_number;
     IceTState state;
     IceTCommunicator communicator;
+
+    /* Set by icetCancelFrame, which may be called from any thread, so it is
+       kept out of the state and guarded by its own lock. */
+    IceTThreadLock cancel_lock;
+    IceTBoolean cancel_requested;
 };
 
 static IceTContext icet_current_context = NULL;
@@ -46,6 +53,9 @@ IceTContext icetCreateContext(IceTCommunicator comm)
     icetSetContext(context);
     icetStateSetDefaults();
 
+    context->cancel_lock = icetThreadLockCreate();
+    context->cancel_requested = ICET_FALSE;
+
     return context;
 }
 
@@ -78,6 +88,20 @@ void icetDestroyContext(IceTContext context)
   /* Call destructors for other dependent units. */
     callDestructor(ICET_RENDER_LAYER_DESTRUCTOR);
 
+  /* Free the communicators that strategies built from this one. */
+    {
+        IceTVoid *value;
+        icetGetPointerv(ICET_IN_TRANSIT_COMMUNICATOR, &value);
+        if (value != NULL) {
+            IceTCommunicator in_transit_comm = (IceTCommunicator)value;
+            in_transit_comm->Destroy(in_transit_comm);
+        }
+    }
+
+  /* Stop the worker threads. */
+    icetThreadPoolDestroy();
+    icetThreadLockDestroy(context->cancel_lock);
+
   /* From here on out be careful.  We are invalidating the context. */
     context->magic_number = 0;
 
@@ -117,6 +141,65 @@ IceTCommunicator icetGetCommunicator()
     return icet_current_context->communicator;
 }
 
+IceTCommunicator icetSetCommunicator(IceTCommunicator comm)
+{
+    IceTCommunicator old_comm = icet_current_context->communicator;
+    icet_current_context->communicator = comm;
+    return old_comm;
+}
+
+void icetCancelFrame(void)
+{
+    IceTContext context = icet_current_context;
+
+    if (context == NULL) { return; }
+
+    icetThreadLockAcquire(context->cancel_lock);
+    context->cancel_requested = ICET_TRUE;
+    icetThreadLockRelease(context->cancel_lock);
+}
+
+void icetFrameCancelReset(void)
+{
+    icetThreadLockAcquire(icet_current_context->cancel_lock);
+    icet_current_context->cancel_requested = ICET_FALSE;
+    icetThreadLockRelease(icet_current_context->cancel_lock);
+
+    icetStateSetBoolean(ICET_FRAME_CANCELLED, ICET_FALSE);
+}
+
+IceTBoolean icetFrameCancelled(void)
+{
+    IceTBoolean requested;
+    IceTBoolean *votes;
+    IceTInt num_proc;
+    IceTInt proc;
+
+    if (icetUnsafeStateGetBoolean(ICET_FRAME_CANCELLED)[0]) {
+        /* Every process saw the same votes, so there is no need to ask
+           again. */
+        return ICET_TRUE;
+    }
+    if (!icetIsEnabled(ICET_FRAME_CANCELLATION)) { return ICET_FALSE; }
+
+    icetThreadLockAcquire(icet_current_context->cancel_lock);
+    requested = icet_current_context->cancel_requested;
+    icetThreadLockRelease(icet_current_context->cancel_lock);
+
+    num_proc = icetCommSize();
+    votes = icetStateAllocateBoolean(ICET_FRAME_CANCEL_VOTES, num_proc);
+    icetCommAllgather(&requested, 1, ICET_BYTE, votes);
+
+    for (proc = 0; proc < num_proc; proc++) {
+        if (votes[proc]) {
+            icetRaiseDebug("Frame cancelled by process %d.", (int)proc);
+            icetStateSetBoolean(ICET_FRAME_CANCELLED, ICET_TRUE);
+            return ICET_TRUE;
+        }
+    }
+    return ICET_FALSE;
+}
+
 void icetCopyState(IceTContext dest, const IceTContext src)
 {
     icetStateCopy(dest->state, src->state);
@@ -472,3 +472,7 @@
 #ifdef PIXEL_COUNT
 #undef PIXEL_COUNT
 #endif
+
+#ifdef CORRECT_BACKGROUND
+#undef CORRECT_BACKGROUND
+#endif
@@ -9,11 +9,14 @@
 
 #include <IceT.h>
 
+#include <IceTDevAccumulate.h>
 #include <IceTDevCommunication.h>
+#include <IceTDevContext.h>
 #include <IceTDevDiagnostics.h>
 #include <IceTDevImage.h>
 #include <IceTDevMatrix.h>
 #include <IceTDevProjections.h>
+#include <IceTDevQuality.h>
 #include <IceTDevState.h>
 #include <IceTDevStrategySelect.h>
 #include <IceTDevTiming.h>
@@ -133,6 +136,40 @@ void icetDataReplicationGroup(IceTInt size, const IceTInt *processes)
     icetStateSetIntegerv(ICET_DATA_REPLICATION_GROUP, size, processes);
 }
 
+void icetCompositorGroup(IceTInt size, const IceTInt *processes)
+{
+    IceTInt num_proc;
+    IceTInt i;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    if ((size < 0) || (size >= num_proc)) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Compositor group must leave at least one process"
+                       " to render.");
+        return;
+    }
+    for (i = 0; i < size; i++) {
+        IceTInt j;
+        if ((processes[i] < 0) || (processes[i] >= num_proc)) {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Invalid process %d in compositor group.",
+                           processes[i]);
+            return;
+        }
+        for (j = 0; j < i; j++) {
+            if (processes[j] == processes[i]) {
+                icetRaiseError(ICET_INVALID_VALUE,
+                               "Process %d given twice in compositor group.",
+                               processes[i]);
+                return;
+            }
+        }
+    }
+
+    icetStateSetIntegerv(ICET_COMPOSITOR_GROUP, size, processes);
+    icetStateSetInteger(ICET_COMPOSITOR_GROUP_SIZE, size);
+}
+
 void icetDataReplicationGroupColor(IceTInt color)
 {
     IceTInt *allcolors;
@@ -242,80 +279,15 @@ static void drawUseBackgroundColor(const IceTFloat *background_color)
     }
 }
 
-static void drawFindContainedViewport(IceTInt contained_viewport[4],
-                                      IceTDouble *znear, IceTDouble *zfar)
+static void drawProjectBoundingGroup(const IceTDouble *transformed_verts,
+                                     IceTInt num_verts,
+                                     const IceTInt global_viewport[4],
+                                     IceTInt contained_viewport[4],
+                                     IceTDouble *znear, IceTDouble *zfar)
 {
-    IceTDouble total_transform[16];
     IceTDouble left, right, bottom, top;
-    IceTDouble *transformed_verts;
-    IceTInt global_viewport[4];
-    IceTInt num_bounding_verts;
     int i;
 
-    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
-
-    {
-        IceTDouble projection_matrix[16];
-        IceTDouble modelview_matrix[16];
-        IceTDouble viewport_matrix[16];
-        IceTDouble tmp_matrix[16];
-
-        icetGetDoublev(ICET_PROJECTION_MATRIX, projection_matrix);
-        icetGetDoublev(ICET_MODELVIEW_MATRIX, modelview_matrix);
-
-        /* Strange projection matrix that transforms the x and y of normalized
-           screen coordinates into viewport coordinates that may be cast to
-           integers. */
-        viewport_matrix[ 0] = global_viewport[2];
-        viewport_matrix[ 1] = 0.0;
-        viewport_matrix[ 2] = 0.0;
-        viewport_matrix[ 3] = 0.0;
-
-        viewport_matrix[ 4] = 0.0;
-        viewport_matrix[ 5] = global_viewport[3];
-        viewport_matrix[ 6] = 0.0;
-        viewport_matrix[ 7] = 0.0;
-
-        viewport_matrix[ 8] = 0.0;
-        viewport_matrix[ 9] = 0.0;
-        viewport_matrix[10] = 2.0;
-        viewport_matrix[11] = 0.0;
-
-        viewport_matrix[12] = global_viewport[2] + global_viewport[0]*2.0;
-        viewport_matrix[13] = global_viewport[3] + global_viewport[1]*2.0;
-        viewport_matrix[14] = 0.0;
-        viewport_matrix[15] = 2.0;
-
-        icetMatrixMultiply(tmp_matrix,
-                           (const IceTDouble *)projection_matrix,
-                           (const IceTDouble *)modelview_matrix);
-        icetMatrixMultiply(total_transform,
-                           (const IceTDouble *)viewport_matrix,
-                           (const IceTDouble *)tmp_matrix);
-    }
-
-    icetGetIntegerv(ICET_NUM_BOUNDING_VERTS, &num_bounding_verts);
-    transformed_verts = icetGetStateBuffer(
-                                       ICET_TRANSFORMED_BOUNDS,
-                                       sizeof(IceTDouble)*num_bounding_verts*4);
-
-    /* Transform each vertex to find where it lies in the global viewport and
-       normalized z.  Leave the results in homogeneous coordinates for now. */
-    {
-        const IceTDouble *bound_vert
-            = icetUnsafeStateGetDouble(ICET_GEOMETRY_BOUNDS);
-        for (i = 0; i < num_bounding_verts; i++) {
-            IceTDouble bound_vert_4vec[4];
-            bound_vert_4vec[0] = bound_vert[3*i+0];
-            bound_vert_4vec[1] = bound_vert[3*i+1];
-            bound_vert_4vec[2] = bound_vert[3*i+2];
-            bound_vert_4vec[3] = 1.0;
-            icetMatrixVectorMultiply(transformed_verts + 4*i,
-                                     (const IceTDouble *)total_transform,
-                                     (const IceTDouble *)bound_vert_4vec);
-        }
-    }
-
     /* Set absolute mins and maxes. */
     left   = global_viewport[0] + global_viewport[2];
     right  = global_viewport[0];
@@ -326,9 +298,9 @@ static void drawFindContainedViewport(IceTInt contained_viewport[4],
 
     /* Now iterate over all the transformed verts and adjust the absolute mins
        and maxs to include them all. */
-    for (i = 0; i < num_bounding_verts; i++)
+    for (i = 0; i < num_verts; i++)
     {
-        IceTDouble *vert = transformed_verts + 4*i;
+        const IceTDouble *vert = transformed_verts + 4*i;
 
         /* Check to see if the vertex is in front of the near cut plane.  This
            is true when z/w >= -1 or z + w >= 0.  The second form is better just
@@ -355,8 +327,8 @@ static void drawFindContainedViewport(IceTInt contained_viewport[4],
              segment between the two points and the near plane (in homogeneous
              coordinates) and use that as the projection. */
             int j;
-            for (j = 0; j < num_bounding_verts; j++) {
-                IceTDouble *vert2 = transformed_verts + 4*j;
+            for (j = 0; j < num_verts; j++) {
+                const IceTDouble *vert2 = transformed_verts + 4*j;
                 double t;
                 IceTDouble x, y, invw;
                 if (vert2[2] + vert2[3] < 0.0) {
@@ -407,7 +379,162 @@ static void drawFindContainedViewport(IceTInt contained_viewport[4],
     contained_viewport[3] = (IceTInt)(top - bottom);
 }
 
-static void drawDetermineContainedTiles(const IceTInt contained_viewport[4],
+static void drawFindContainedViewport(IceTInt contained_viewport[4],
+                                      IceTDouble *znear, IceTDouble *zfar,
+                                      IceTInt num_groups,
+                                      IceTInt *group_viewports)
+{
+    IceTDouble total_transform[16];
+    IceTDouble *transformed_verts;
+    IceTInt global_viewport[4];
+    IceTInt num_bounding_verts;
+    IceTInt verts_per_group;
+    IceTInt min_x, min_y, max_x, max_y;
+    IceTBoolean any_visible;
+    int i;
+
+    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+
+    {
+        IceTDouble projection_matrix[16];
+        IceTDouble modelview_matrix[16];
+        IceTDouble viewport_matrix[16];
+        IceTDouble tmp_matrix[16];
+
+        icetGetDoublev(ICET_PROJECTION_MATRIX, projection_matrix);
+        icetGetDoublev(ICET_MODELVIEW_MATRIX, modelview_matrix);
+
+        /* Strange projection matrix that transforms the x and y of normalized
+           screen coordinates into viewport coordinates that may be cast to
+           integers. */
+        viewport_matrix[ 0] = global_viewport[2];
+        viewport_matrix[ 1] = 0.0;
+        viewport_matrix[ 2] = 0.0;
+        viewport_matrix[ 3] = 0.0;
+
+        viewport_matrix[ 4] = 0.0;
+        viewport_matrix[ 5] = global_viewport[3];
+        viewport_matrix[ 6] = 0.0;
+        viewport_matrix[ 7] = 0.0;
+
+        viewport_matrix[ 8] = 0.0;
+        viewport_matrix[ 9] = 0.0;
+        viewport_matrix[10] = 2.0;
+        viewport_matrix[11] = 0.0;
+
+        viewport_matrix[12] = global_viewport[2] + global_viewport[0]*2.0;
+        viewport_matrix[13] = global_viewport[3] + global_viewport[1]*2.0;
+        viewport_matrix[14] = 0.0;
+        viewport_matrix[15] = 2.0;
+
+        icetMatrixMultiply(tmp_matrix,
+                           (const IceTDouble *)projection_matrix,
+                           (const IceTDouble *)modelview_matrix);
+        icetMatrixMultiply(total_transform,
+                           (const IceTDouble *)viewport_matrix,
+                           (const IceTDouble *)tmp_matrix);
+    }
+
+    icetGetIntegerv(ICET_NUM_BOUNDING_VERTS, &num_bounding_verts);
+    transformed_verts = icetGetStateBuffer(
+                                       ICET_TRANSFORMED_BOUNDS,
+                                       sizeof(IceTDouble)*num_bounding_verts*4);
+
+    /* Transform each vertex to find where it lies in the global viewport and
+       normalized z.  Leave the results in homogeneous coordinates for now. */
+    {
+        const IceTDouble *bound_vert
+            = icetUnsafeStateGetDouble(ICET_GEOMETRY_BOUNDS);
+        for (i = 0; i < num_bounding_verts; i++) {
+            IceTDouble bound_vert_4vec[4];
+            bound_vert_4vec[0] = bound_vert[3*i+0];
+            bound_vert_4vec[1] = bound_vert[3*i+1];
+            bound_vert_4vec[2] = bound_vert[3*i+2];
+            bound_vert_4vec[3] = 1.0;
+            icetMatrixVectorMultiply(transformed_verts + 4*i,
+                                     (const IceTDouble *)total_transform,
+                                     (const IceTDouble *)bound_vert_4vec);
+        }
+    }
+
+    if (num_groups < 2) {
+        drawProjectBoundingGroup(transformed_verts,
+                                 num_bounding_verts,
+                                 global_viewport,
+                                 contained_viewport,
+                                 znear,
+                                 zfar);
+        return;
+    }
+
+    /* Project each group of vertices on its own so that geometry split into
+       pieces (for example, one box per data block) gets a tight region for
+       each piece.  The contained viewport is the bounds of all the pieces. */
+    verts_per_group = num_bounding_verts/num_groups;
+    min_x = global_viewport[0] + global_viewport[2];
+    max_x = global_viewport[0];
+    min_y = global_viewport[1] + global_viewport[3];
+    max_y = global_viewport[1];
+    *znear = 1.0;
+    *zfar  = -1.0;
+    any_visible = ICET_FALSE;
+    for (i = 0; i < num_groups; i++) {
+        const IceTDouble *group_verts
+            = transformed_verts + 4*verts_per_group*i;
+        IceTInt *group_viewport = group_viewports + 4*i;
+        IceTDouble group_znear, group_zfar;
+        IceTBoolean beyond_far;
+        int j;
+
+        drawProjectBoundingGroup(group_verts,
+                                 verts_per_group,
+                                 global_viewport,
+                                 group_viewport,
+                                 &group_znear,
+                                 &group_zfar);
+
+        /* The projected depths are clamped to the view volume, so check
+           directly whether every vertex is past the far plane (z/w > 1). */
+        beyond_far = ICET_TRUE;
+        for (j = 0; j < verts_per_group; j++) {
+            if (group_verts[4*j+2] <= group_verts[4*j+3]) {
+                beyond_far = ICET_FALSE;
+                break;
+            }
+        }
+
+        if (   beyond_far
+            || (group_viewport[2] < 1) || (group_viewport[3] < 1) ) {
+          /* Group not visible.  Make sure it does not touch any tile. */
+            group_viewport[0] = group_viewport[1] = -1000000;
+            group_viewport[2] = group_viewport[3] = 0;
+            continue;
+        }
+
+        any_visible = ICET_TRUE;
+        if (min_x > group_viewport[0]) min_x = group_viewport[0];
+        if (min_y > group_viewport[1]) min_y = group_viewport[1];
+        if (max_x < group_viewport[0] + group_viewport[2])
+            max_x = group_viewport[0] + group_viewport[2];
+        if (max_y < group_viewport[1] + group_viewport[3])
+            max_y = group_viewport[1] + group_viewport[3];
+        if (*znear > group_znear) *znear = group_znear;
+        if (*zfar  < group_zfar)  *zfar  = group_zfar;
+    }
+
+    if (any_visible) {
+        contained_viewport[0] = min_x;
+        contained_viewport[1] = min_y;
+        contained_viewport[2] = max_x - min_x;
+        contained_viewport[3] = max_y - min_y;
+    } else {
+        contained_viewport[0] = contained_viewport[1] = -1000000;
+        contained_viewport[2] = contained_viewport[3] = 0;
+    }
+}
+
+static void drawDetermineContainedTiles(IceTInt num_contained_viewports,
+                                        const IceTInt *contained_viewports,
                                         IceTDouble znear, IceTDouble zfar,
                                         IceTInt *contained_list,
                                         IceTBoolean *contained_mask,
@@ -422,20 +549,24 @@ static void drawDetermineContainedTiles(const IceTInt contained_viewport[4],
 
     *num_contained_p = 0;
     memset(contained_mask, 0, sizeof(IceTBoolean)*num_tiles);
+    if ((znear > 1.0) || (zfar < -1.0)) { return; }
     for (i = 0; i < num_tiles; i++) {
-        if (   (znear  <= 1.0)
-            && (zfar   >= -1.0)
-            && (  contained_viewport[0]
-                < tile_viewports[i*4+0] + tile_viewports[i*4+2])
-            && (  contained_viewport[0] + contained_viewport[2]
-                > tile_viewports[i*4+0])
-            && (  contained_viewport[1]
-                < tile_viewports[i*4+1] + tile_viewports[i*4+3])
-            && (  contained_viewport[1] + contained_viewport[3]
-                > tile_viewports[i*4+1]) ) {
-            contained_list[*num_contained_p] = i;
-            contained_mask[i] = 1;
-            (*num_contained_p)++;
+        int j;
+        for (j = 0; j < num_contained_viewports; j++) {
+            const IceTInt *contained_viewport = contained_viewports + 4*j;
+            if (   (  contained_viewport[0]
+                    < tile_viewports[i*4+0] + tile_viewports[i*4+2])
+                && (  contained_viewport[0] + contained_viewport[2]
+                    > tile_viewports[i*4+0])
+                && (  contained_viewport[1]
+                    < tile_viewports[i*4+1] + tile_viewports[i*4+3])
+                && (  contained_viewport[1] + contained_viewport[3]
+                    > tile_viewports[i*4+1]) ) {
+                contained_list[*num_contained_p] = i;
+                contained_mask[i] = 1;
+                (*num_contained_p)++;
+                break;
+            }
         }
     }
 }
@@ -590,7 +721,8 @@ static void drawAdjustContainedForDataReplication(IceTInt *contained_viewport,
                 }
                 contained_viewport[split_axis] += group_piece*new_length;
             }
-            drawDetermineContainedTiles(contained_viewport,
+            drawDetermineContainedTiles(1,
+                                        contained_viewport,
                                         0.0,    /* Fake znear and zfar. */
                                         0.0,    /* Already checked in range. */
                                         contained_list,
@@ -604,14 +736,18 @@ static void drawAdjustContainedForDataReplication(IceTInt *contained_viewport,
 static void drawProjectBounds(void)
 {
     IceTInt num_bounding_verts;
+    IceTInt num_bounding_groups;
     IceTInt *contained_list;
     IceTBoolean *contained_mask;
     IceTInt contained_viewport[4];
+    IceTInt num_contained_viewports;
+    IceTInt *contained_viewports;
     IceTDouble znear, zfar;
     IceTInt num_tiles;
     IceTInt num_contained;
 
     icetGetIntegerv(ICET_NUM_BOUNDING_VERTS, &num_bounding_verts);
+    icetGetIntegerv(ICET_NUM_BOUNDING_GROUPS, &num_bounding_groups);
     icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
 
     contained_list = icetGetStateBuffer(ICET_CONTAINED_LIST_BUF,
@@ -619,6 +755,18 @@ static void drawProjectBounds(void)
     contained_mask = icetGetStateBuffer(ICET_CONTAINED_MASK_BUF,
                                         sizeof(IceTBoolean)*num_tiles);
 
+    /* When the bounds are given as several groups, keep a separate contained
+       viewport for each group.  Otherwise just use the one viewport. */
+    if ((num_bounding_verts > 0) && (num_bounding_groups > 1)) {
+        num_contained_viewports = num_bounding_groups;
+        contained_viewports
+            = icetStateAllocateInteger(ICET_CONTAINED_VIEWPORTS,
+                                       4*num_contained_viewports);
+    } else {
+        num_contained_viewports = 1;
+        contained_viewports = contained_viewport;
+    }
+
     if (num_bounding_verts < 1) {
         /* User never set bounding vertices. Assume image covers global
          * viewport. */
@@ -627,7 +775,11 @@ static void drawProjectBounds(void)
         zfar = 1.0;
     } else {
       /* Figure out how the geometry projects onto the display. */
-        drawFindContainedViewport(contained_viewport, &znear, &zfar);
+        drawFindContainedViewport(contained_viewport,
+                                  &znear,
+                                  &zfar,
+                                  num_contained_viewports,
+                                  contained_viewports);
     }
 
     if (   icetUnsafeStateGetBoolean(ICET_PRE_RENDERED)[0]
@@ -640,11 +792,20 @@ static void drawProjectBounds(void)
         icetIntersectViewports(rendered_viewport,
                                contained_viewport,
                                contained_viewport);
+        if (num_contained_viewports > 1) {
+            int i;
+            for (i = 0; i < num_contained_viewports; i++) {
+                icetIntersectViewports(rendered_viewport,
+                                       contained_viewports + 4*i,
+                                       contained_viewports + 4*i);
+            }
+        }
     }
 
     /* Now use this information to figure out which tiles need to be
        drawn. */
-    drawDetermineContainedTiles(contained_viewport,
+    drawDetermineContainedTiles(num_contained_viewports,
+                                contained_viewports,
                                 znear,
                                 zfar,
                                 contained_list,
@@ -660,10 +821,22 @@ static void drawProjectBounds(void)
                                           contained_mask,
                                           &num_contained);
 
+    /* Data replication divides up the contained viewport, which the separate
+       group viewports know nothing about.  Fall back to the single viewport
+       in that case. */
+    if (   (num_contained_viewports > 1)
+        && (*icetUnsafeStateGetInteger(ICET_DATA_REPLICATION_GROUP_SIZE) > 1) ) {
+        num_contained_viewports = 1;
+    }
+    if (num_contained_viewports == 1) {
+        icetStateSetIntegerv(ICET_CONTAINED_VIEWPORTS, 4, contained_viewport);
+    }
+
     icetRaiseDebug("new contained_viewport = %d %d %d %d",
                    (int)contained_viewport[0], (int)contained_viewport[1],
                    (int)contained_viewport[2], (int)contained_viewport[3]);
     icetStateSetIntegerv(ICET_CONTAINED_VIEWPORT, 4, contained_viewport);
+    icetStateSetInteger(ICET_NUM_CONTAINED_VIEWPORTS, num_contained_viewports);
     icetStateSetDoublev(ICET_NEAR_DEPTH, 1, &znear);
     icetStateSetDoublev(ICET_FAR_DEPTH, 1, &zfar);
     icetStateSetInteger(ICET_NUM_CONTAINED_TILES, num_contained);
@@ -729,6 +902,67 @@ static void drawCollectTileInformation(void)
     }
 }
 
+/* Called at the start of each frame, when the image returned for the previous
+ * frame is no longer valid.  Buffers that did not need at least half of their
+ * memory in the last ICET_BUFFER_RELEASE_FRAMES frames are freed so that one
+ * big frame does not keep its memory reserved forever.  If the buffers are
+ * over ICET_MEMORY_BUDGET, buffers not fully needed in the last frame go as
+ * well.  The start time of each frame is kept in a ring indexed by frame
+ * count, so the slot for this frame holds the start of the frame that is just
+ * leaving the window. */
+static void drawReleaseBuffers(IceTInt frame_count)
+{
+    IceTInt release_frames;
+    IceTInt memory_budget;
+    IceTInt num_slots;
+    IceTDouble *start_times;
+    IceTTimeStamp release_before;
+
+    icetGetIntegerv(ICET_BUFFER_RELEASE_FRAMES, &release_frames);
+    icetGetIntegerv(ICET_MEMORY_BUDGET, &memory_budget);
+
+    num_slots = (release_frames > 1) ? release_frames : 1;
+    if (icetStateGetNumEntries(ICET_FRAME_START_TIMES) != num_slots) {
+        IceTInt slot;
+        start_times = icetStateAllocateDouble(ICET_FRAME_START_TIMES,
+                                              num_slots);
+        for (slot = 0; slot < num_slots; slot++) {
+            start_times[slot] = 0.0;
+        }
+    } else {
+        start_times
+            = (IceTDouble *)icetUnsafeStateGetDouble(ICET_FRAME_START_TIMES);
+    }
+
+    release_before = 0;
+    if (release_frames > 0) {
+        release_before = (IceTTimeStamp)start_times[frame_count%num_slots];
+    }
+    if (   (memory_budget > 0)
+        && (  icetStateBufferBytes()
+            > (IceTUnsignedInt64)memory_budget*1024*1024) ) {
+        IceTTimeStamp last_start
+            = (IceTTimeStamp)start_times[(frame_count-1)%num_slots];
+        icetRaiseDebug("Buffers over memory budget.");
+        if (last_start > release_before) {
+            release_before = last_start;
+        }
+    }
+    if (release_before > 0) {
+        icetStateReleaseBuffers(release_before);
+    }
+
+    start_times[frame_count%num_slots] = (IceTDouble)icetGetTimeStamp();
+}
+
+static IceTImage drawCancelledImage(void)
+{
+    icetStateSetInteger(ICET_VALID_PIXELS_TILE, -1);
+    icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
+    icetStateSetInteger(ICET_VALID_PIXELS_NUM, 0);
+    return icetImageNull();
+}
+
 static IceTImage drawInvokeStrategy(void)
 {
     IceTImage image;
@@ -745,6 +979,9 @@ static IceTImage drawInvokeStrategy(void)
         return icetImageNull();
     }
 
+    /* Last chance to drop a stale frame before anything is rendered. */
+    if (icetFrameCancelled()) { return drawCancelledImage(); }
+
     icetRaiseDebug("Calling strategy");
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 1);
     icetGetEnumv(ICET_STRATEGY, &strategy);
@@ -752,6 +989,12 @@ static IceTImage drawInvokeStrategy(void)
 
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 0);
 
+    /* Strategies stop at their next stage boundary once the frame is
+       cancelled, so whatever they return is incomplete. */
+    if (icetUnsafeStateGetBoolean(ICET_FRAME_CANCELLED)[0]) {
+        return drawCancelledImage();
+    }
+
     /* Ensure that the returned image is the expected size. */
     icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
     icetGetIntegerv(ICET_TILE_DISPLAYED, &display_tile);
@@ -812,6 +1055,12 @@ static IceTImage drawDoFrame(const IceTDouble *projection_matrix,
     icetStateResetTiming();
     icetTimingDrawFrameBegin();
 
+    icetFrameCancelReset();
+
+    icetAccumulateBeginFrame();
+
+    icetQualityBeginFrame();
+
     drawUseMatrices(projection_matrix, modelview_matrix);
 
     drawUseBackgroundColor(background_color);
@@ -820,6 +1069,8 @@ static IceTImage drawDoFrame(const IceTDouble *projection_matrix,
     frame_count++;
     icetStateSetIntegerv(ICET_FRAME_COUNT, 1, &frame_count);
 
+    drawReleaseBuffers(frame_count);
+
     drawProjectBounds();
 
     drawCollectTileInformation();
@@ -845,6 +1096,10 @@ static IceTImage drawDoFrame(const IceTDouble *projection_matrix,
 
     image = drawInvokeStrategy();
 
+    image = icetAccumulateFinishFrame(image);
+
+    image = icetQualityFinishFrame(image);
+
     /* Calculate times. */
     icetGetDoublev(ICET_RENDER_TIME, &render_time);
     icetGetDoublev(ICET_BUFFER_READ_TIME, &buf_read_time);
@@ -858,6 +1113,8 @@ static IceTImage drawDoFrame(const IceTDouble *projection_matrix,
 
     icetStateSetDouble(ICET_BUFFER_WRITE_TIME, 0.0);
 
+    icetQualityUpdate();
+
     icetStateCheckMemory();
 
     return image;
@@ -870,6 +1127,7 @@ IceTImage icetDrawFrame(const IceTDouble *projection_matrix,
     icetRaiseDebug("In icetDrawFrame");
 
     icetStateSetBoolean(ICET_PRE_RENDERED, ICET_FALSE);
+    icetStateSetPointer(ICET_PRE_RENDERED_SPARSE, NULL);
 
     return drawDoFrame(projection_matrix, modelview_matrix, background_color);
 }
@@ -888,6 +1146,7 @@ IceTImage icetCompositeImage(const IceTVoid *color_buffer,
     icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
 
     icetStateSetBoolean(ICET_PRE_RENDERED, ICET_TRUE);
+    icetStateSetPointer(ICET_PRE_RENDERED_SPARSE, NULL);
     icetGetStatePointerImage(ICET_RENDER_BUFFER,
                              global_viewport[2],
                              global_viewport[3],
@@ -901,3 +1160,70 @@ IceTImage icetCompositeImage(const IceTVoid *color_buffer,
 
     return drawDoFrame(projection_matrix, modelview_matrix, background_color);
 }
+
+IceTImage icetCompositeSparseImage(const IceTSparseImage image,
+                                   const IceTDouble *projection_matrix,
+                                   const IceTDouble *modelview_matrix,
+                                   const IceTFloat *background_color)
+{
+    IceTInt global_viewport[4];
+    IceTEnum color_format, depth_format;
+
+    icetRaiseDebug("In icetCompositeSparseImage");
+
+    if (icetSparseImageIsNull(image)) {
+        icetRaiseError(ICET_INVALID_VALUE, "Null sparse image composited.");
+        return icetImageNull();
+    }
+
+    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    if (   (icetSparseImageGetWidth(image) != global_viewport[2])
+        || (icetSparseImageGetHeight(image) != global_viewport[3])
+        || (icetSparseImageGetColorFormat(image) != color_format)
+        || (icetSparseImageGetDepthFormat(image) != depth_format) ) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Sparse image does not match the global viewport and"
+                       " image formats.");
+        return icetImageNull();
+    }
+
+    /* The strategies take the pixels of each tile straight out of the sparse
+     * image, so there is no dense buffer to fill or to compress. */
+    icetStateSetBoolean(ICET_PRE_RENDERED, ICET_TRUE);
+    icetStateSetPointer(ICET_PRE_RENDERED_SPARSE, image.opaque_internals);
+    icetStateSetIntegerv(ICET_RENDERED_VIEWPORT, 0, NULL);
+
+    return drawDoFrame(projection_matrix, modelview_matrix, background_color);
+}
+
+IceTImage icetCompositeImageSpans(IceTSizeType num_spans,
+                                  const IceTInt *spans,
+                                  const IceTVoid *color_buffer,
+                                  const IceTVoid *depth_buffer,
+                                  const IceTDouble *projection_matrix,
+                                  const IceTDouble *modelview_matrix,
+                                  const IceTFloat *background_color)
+{
+    IceTInt global_viewport[4];
+    IceTSparseImage image;
+
+    icetRaiseDebug("In icetCompositeImageSpans");
+
+    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+
+    image = icetGetStateBufferSparseImageFromSpans(ICET_SPARSE_RENDER_BUF,
+                                                   global_viewport[2],
+                                                   global_viewport[3],
+                                                   num_spans,
+                                                   spans,
+                                                   color_buffer,
+                                                   depth_buffer);
+    if (icetSparseImageIsNull(image)) { return icetImageNull(); }
+
+    return icetCompositeSparseImage(image,
+                                    projection_matrix,
+                                    modelview_matrix,
+                                    background_color);
+}
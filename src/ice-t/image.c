@@ -7,22 +7,34 @@
  * This source code is released under the New BSD License.
  */
 
+/* Needed for fseeko when compiling with -ansi, and for a 64-bit off_t on
+   32-bit systems. */
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+
 #include <IceTDevImage.h>
 
 #include <IceT.h>
 
+#include <IceTDevCommunication.h>
 #include <IceTDevProjections.h>
 #include <IceTDevState.h>
 #include <IceTDevDiagnostics.h>
 #include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+#include <IceTDevThreads.h>
 #include <IceTDevTiming.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define ICET_IMAGE_MAGIC_NUM            (IceTEnum)0x004D5000
 #define ICET_IMAGE_POINTERS_MAGIC_NUM   (IceTEnum)0x004D5100
 #define ICET_SPARSE_IMAGE_MAGIC_NUM     (IceTEnum)0x004D6000
+#define ICET_SPARSE_IMAGE_PREDICTED_DEPTH_MAGIC_NUM (IceTEnum)0x004D6100
+#define ICET_SPARSE_IMAGE_BITMAP_MAGIC_NUM (IceTEnum)0x004D6200
+#define ICET_SPARSE_IMAGE_VARINT_MAGIC_NUM (IceTEnum)0x004D6300
 
 #define ICET_IMAGE_MAGIC_NUM_INDEX              0
 #define ICET_IMAGE_COLOR_FORMAT_INDEX           1
@@ -193,17 +205,24 @@ static void icetSparseImageSplitChoosePartitions(
                                            IceTSizeType first_offset,
                                            IceTSizeType *offsets);
 
+/* A render whose finished blocks are compressed while the drawing callback
+   is still running.  See icetDrawBlockFinished. */
+typedef struct renderStreamStruct *renderStream;
+
 /* This function is used to get the image for a tile. It will either render
    the tile on demand (with renderTile) or get the image from a pre-rendered
    image (with prerenderedTile). The screen_viewport is set to the region of
    valid pixels in the returned image. The tile_viewport gives the region
    where the pixels reside in the tile. (The width and height of the two
    viewports will be the same.) Pixels outside of these viewports are
-   undefined. */
+   undefined.  If stream_p is not NULL, the render may be streamed, in which
+   case *stream_p is set to the stream to finish with renderStreamFinish.
+   Otherwise *stream_p is set to NULL. */
 static IceTImage generateTile(int tile,
                               IceTInt *screen_viewport,
                               IceTInt *target_viewport,
-                              IceTImage tile_buffer);
+                              IceTImage tile_buffer,
+                              renderStream *stream_p);
 
 /* Renders the geometry for a tile and returns an image of the rendered data.
    If IceT determines that it is most efficient to render the data directly to
@@ -221,7 +240,22 @@ static IceTImage generateTile(int tile,
 static IceTImage renderTile(int tile,
                             IceTInt *screen_viewport,
                             IceTInt *target_viewport,
-                            IceTImage tile_buffer);
+                            IceTImage tile_buffer,
+                            renderStream *stream_p);
+
+/* Sets up a stream for a render into render_buffer when ICET_STREAM_DRAW_BLOCKS
+   is on and the image formats can be compressed on other threads.  Returns
+   NULL otherwise. */
+static renderStream renderStreamBegin(IceTImage render_buffer,
+                                      IceTSizeType tile_width,
+                                      IceTSizeType tile_height,
+                                      const IceTInt *screen_viewport,
+                                      const IceTInt *target_viewport);
+
+/* Compresses the bands the renderer did not finish and joins all bands into
+   compressed_image. */
+static void renderStreamFinish(renderStream stream,
+                               IceTSparseImage compressed_image);
 
 /* Returns the pre-rendered image, the region of valid pixels in the tile in
    screen_viewport, and the region where the pixels reside in the tile in
@@ -230,8 +264,35 @@ static IceTImage prerenderedTile(int tile,
                                  IceTInt *screen_viewport,
                                  IceTInt *target_viewport);
 
-/* Gets an image buffer attached to this context. */
-static IceTImage getRenderBuffer(void);
+/* Computes the screen_viewport and target_viewport of prerenderedTile. */
+static void prerenderedTileViewports(int tile,
+                                     IceTInt *screen_viewport,
+                                     IceTInt *target_viewport);
+
+/* Returns the sparse image given to icetCompositeSparseImage or
+   icetCompositeImageSpans for this frame.  Returns a null image when drawing
+   with a callback or when the pre-rendered image is dense. */
+static IceTSparseImage prerenderedSparseImage(void);
+
+/* Adds count inactive pixels to the end of a sparse image being built. */
+static void sparseImageAppendInactive(IceTVoid **out_data_p,
+                                      IceTVoid **out_run_length_p,
+                                      IceTSizeType count);
+
+/* Copies the pixels of the pre-rendered sparse image that fall in the given
+   tile into compressed_image.  Only run lengths are walked, so inactive pixels
+   cost nothing. */
+static void prerenderedSparseTile(int tile, IceTSparseImage compressed_image);
+
+/* Finds the region of the given tile (in global coordinates) that the local
+   geometry covers.  When bounds were projected as multiple groups, this is the
+   bounds of the group regions clipped to the tile, which can be much tighter
+   than clipping the full contained viewport. */
+static void getTileContainedViewport(int tile,
+                                     IceTInt *tile_contained_viewport);
+
+/* Gets an image buffer of the given size attached to this context. */
+static IceTImage getRenderBuffer(IceTInt width, IceTInt height);
 
 static IceTSizeType colorPixelSize(IceTEnum color_format)
 {
@@ -327,6 +388,11 @@ IceTSizeType icetSparseImageBufferSizeType(IceTEnum color_format,
     if (pixel_size < RUN_LENGTH_SIZE) {
         size += (RUN_LENGTH_SIZE - pixel_size)*((width*height+1)/2);
     }
+
+    /* Variable-length run lengths can take up to VARINT_MAX_SIZE bytes each,
+       but images are only encoded with them (or with a bitmap) when that is
+       smaller, so the bound above holds for images packaged for send as
+       well. */
     return size;
 }
 
@@ -343,6 +409,23 @@ IceTImage icetGetStateBufferImage(IceTEnum pname,
     return icetImageAssignBuffer(buffer, width, height);
 }
 
+IceTImage icetGetDisplayImage(IceTEnum pname,
+                              IceTSizeType width,
+                              IceTSizeType height)
+{
+    IceTVoid *buffer;
+    IceTInt buffer_size;
+
+    icetGetPointerv(ICET_DISPLAY_IMAGE_BUFFER, &buffer);
+    icetGetIntegerv(ICET_DISPLAY_IMAGE_BUFFER_SIZE, &buffer_size);
+    if (   (buffer == NULL)
+        || (buffer_size < icetImageBufferSize(width, height)) ) {
+        return icetGetStateBufferImage(pname, width, height);
+    }
+
+    return icetImageAssignBuffer(buffer, width, height);
+}
+
 IceTImage icetRetrieveStateImage(IceTEnum pname)
 {
     return icetImageUnpackageFromReceive(
@@ -551,6 +634,111 @@ IceTSparseImage icetSparseImageAssignBuffer(IceTVoid *buffer,
     return image;
 }
 
+IceTSparseImage icetGetStateBufferSparseImageFromSpans(
+                                                IceTEnum pname,
+                                                IceTSizeType width,
+                                                IceTSizeType height,
+                                                IceTSizeType num_spans,
+                                                const IceTInt *spans,
+                                                const IceTVoid *color_buffer,
+                                                const IceTVoid *depth_buffer)
+{
+    IceTSparseImage image;
+    IceTEnum color_format, depth_format;
+    IceTSizeType color_pixel_size, depth_pixel_size;
+    IceTSizeType num_active;
+    IceTSizeType span_end;
+    IceTSizeType span;
+    const IceTByte *color_in = color_buffer;
+    const IceTByte *depth_in = depth_buffer;
+    IceTByte *out_data;
+
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    color_pixel_size = colorPixelSize(color_format);
+    depth_pixel_size = depthPixelSize(depth_format);
+
+    if (   ((color_pixel_size > 0) && (color_buffer == NULL))
+        || ((depth_pixel_size > 0) && (depth_buffer == NULL)) ) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Span pixel data missing for the current image format.");
+        return icetSparseImageNull();
+    }
+
+    /* Check the spans before touching any memory. */
+    num_active = 0;
+    span_end = 0;
+    for (span = 0; span < num_spans; span++) {
+        IceTSizeType start = spans[2*span];
+        IceTSizeType length = spans[2*span+1];
+        if (   (start < span_end)
+            || (length < 0)
+            || (start + length > width*height) ) {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Span %d (%d, %d) is out of order or outside the"
+                           " image.",
+                           (int)span, (int)start, (int)length);
+            return icetSparseImageNull();
+        }
+        num_active += length;
+        span_end = start + length;
+    }
+
+    /* Each span needs one run length, and one more ends the image. */
+    image = icetSparseImageAssignBuffer(
+                 icetGetStateBuffer(pname,
+                                    ICET_IMAGE_DATA_START_INDEX*sizeof(IceTInt)
+                                    + (num_spans + 1)*RUN_LENGTH_SIZE
+                                    + num_active*(  color_pixel_size
+                                                  + depth_pixel_size)),
+                 width,
+                 height);
+
+    out_data = ICET_IMAGE_DATA(image);
+    span_end = 0;
+    for (span = 0; span < num_spans; span++) {
+        IceTSizeType start = spans[2*span];
+        IceTSizeType length = spans[2*span+1];
+        IceTSizeType pixel;
+
+        if (length < 1) { continue; }
+
+        INACTIVE_RUN_LENGTH(out_data) = (IceTRunLengthType)(start - span_end);
+        ACTIVE_RUN_LENGTH(out_data) = (IceTRunLengthType)length;
+        out_data += RUN_LENGTH_SIZE;
+
+        /* Sparse pixels interleave color and depth. */
+        if (depth_pixel_size == 0) {
+            memcpy(out_data, color_in, length*color_pixel_size);
+            out_data += length*color_pixel_size;
+            color_in += length*color_pixel_size;
+        } else if (color_pixel_size == 0) {
+            memcpy(out_data, depth_in, length*depth_pixel_size);
+            out_data += length*depth_pixel_size;
+            depth_in += length*depth_pixel_size;
+        } else {
+            for (pixel = 0; pixel < length; pixel++) {
+                memcpy(out_data, color_in, color_pixel_size);
+                out_data += color_pixel_size;
+                color_in += color_pixel_size;
+                memcpy(out_data, depth_in, depth_pixel_size);
+                out_data += depth_pixel_size;
+                depth_in += depth_pixel_size;
+            }
+        }
+
+        span_end = start + length;
+    }
+
+    INACTIVE_RUN_LENGTH(out_data) = (IceTRunLengthType)(width*height - span_end);
+    ACTIVE_RUN_LENGTH(out_data) = 0;
+    out_data += RUN_LENGTH_SIZE;
+
+    icetSparseImageSetActualSize(image, out_data);
+
+    return image;
+}
+
 IceTSparseImage icetSparseImageNull(void)
 {
     IceTSparseImage image;
@@ -929,6 +1117,116 @@ IceTFloat *icetImageGetDepthf(IceTImage image)
     return icetImageGetDepthVoid(image, NULL);
 }
 
+typedef struct imageCopyColorTaskStruct {
+    IceTEnum in_color_format;
+    IceTEnum out_color_format;
+    IceTSizeType in_pixel_size;
+    const IceTVoid *in_buffer;
+    IceTVoid *out_buffer;
+} imageCopyColorTaskData;
+
+/* Converts pixels [begin,end) from in_buffer to out_buffer.  The formats are
+   checked before starting the task. */
+static void imageCopyColorTask(IceTSizeType begin,
+                               IceTSizeType end,
+                               IceTVoid *task_data)
+{
+    const imageCopyColorTaskData *data
+        = (const imageCopyColorTaskData *)task_data;
+    IceTEnum in_color_format = data->in_color_format;
+    IceTEnum out_color_format = data->out_color_format;
+    IceTSizeType i;
+
+    if (in_color_format == out_color_format) {
+        IceTSizeType pixel_size = data->in_pixel_size;
+        memcpy((IceTByte *)data->out_buffer + begin*pixel_size,
+               (const IceTByte *)data->in_buffer + begin*pixel_size,
+               (end - begin)*pixel_size);
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
+        const IceTFloat *in = (const IceTFloat *)data->in_buffer + 4*begin;
+        IceTUByte *out = (IceTUByte *)data->out_buffer + 4*begin;
+        IceTSizeType num_values = 4*(end - begin);
+        for (i = 0; i < num_values; i++) {
+            out[i] = (IceTUByte)(255*in[i]);
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
+        const IceTFloat *in = (const IceTFloat *)data->in_buffer + 3*begin;
+        IceTUByte *out = (IceTUByte *)data->out_buffer + 4*begin;
+        for (i = begin; i < end; i++) {
+            out[0] = (IceTUByte)(255*in[0]);
+            out[1] = (IceTUByte)(255*in[1]);
+            out[2] = (IceTUByte)(255*in[2]);
+            out[3] = (IceTUByte)255;
+            in += 3;
+            out += 4;
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
+        const IceTUByte *in = (const IceTUByte *)data->in_buffer + 4*begin;
+        IceTFloat *out = (IceTFloat *)data->out_buffer + 4*begin;
+        IceTSizeType num_values = 4*(end - begin);
+        for (i = 0; i < num_values; i++) {
+            out[i] = (IceTFloat)in[i]/255.0f;
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+               && (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
+        const IceTUByte *in = (const IceTUByte *)data->in_buffer + 4*begin;
+        IceTFloat *out = (IceTFloat *)data->out_buffer + 3*begin;
+        for (i = begin; i < end; i++) {
+            out[0] = (IceTFloat)in[0]/255.0f;
+            out[1] = (IceTFloat)in[1]/255.0f;
+            out[2] = (IceTFloat)in[2]/255.0f;
+            in += 4;
+            out += 3;
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
+        const IceTFloat *in = (const IceTFloat *)data->in_buffer + 4*begin;
+        IceTFloat *out = (IceTFloat *)data->out_buffer + 3*begin;
+        for (i = begin; i < end; i++) {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+            in += 4;
+            out += 3;
+        }
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT)
+               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
+        const IceTFloat *in = (const IceTFloat *)data->in_buffer + 3*begin;
+        IceTFloat *out = (IceTFloat *)data->out_buffer + 4*begin;
+        for (i = begin; i < end; i++) {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+            out[3] = 1.0f;
+            in += 3;
+            out += 4;
+        }
+    }
+}
+
+/* Runs imageCopyColorTask over the whole image on the worker threads. */
+static void imageCopyColor(const IceTImage image,
+                           IceTVoid *color_buffer,
+                           IceTEnum out_color_format)
+{
+    IceTEnum in_color_format = icetImageGetColorFormat(image);
+    imageCopyColorTaskData data;
+
+    data.in_color_format = in_color_format;
+    data.out_color_format = out_color_format;
+    data.in_buffer = icetImageGetColorConstVoid(image, &data.in_pixel_size);
+    data.out_buffer = color_buffer;
+
+    icetThreadParallelFor(icetImageGetNumPixels(image),
+                          MAX(data.in_pixel_size,
+                              colorPixelSize(out_color_format)),
+                          imageCopyColorTask,
+                          &data);
+}
+
 void icetImageCopyColorub(const IceTImage image,
                           IceTUByte *color_buffer,
                           IceTEnum out_color_format)
@@ -947,37 +1245,10 @@ void icetImageCopyColorub(const IceTImage image,
         return;
     }
 
-    if (in_color_format == out_color_format) {
-        const IceTUByte *in_buffer = icetImageGetColorcub(image);
-        IceTSizeType color_format_bytes = (  icetImageGetNumPixels(image)
-                                           * colorPixelSize(in_color_format) );
-        memcpy(color_buffer, in_buffer, color_format_bytes);
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
-               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
-        const IceTFloat *in_buffer = icetImageGetColorcf(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTFloat *in;
-        IceTUByte *out;
-        for (i = 0, in = in_buffer, out = color_buffer; i < 4*num_pixels;
-             i++, in++, out++) {
-            out[0] = (IceTUByte)(255*in[0]);
-        }
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT)
-               && (out_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) ) {
-        const IceTFloat *in_buffer = icetImageGetColorcf(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTFloat *in = in_buffer;
-        IceTUByte *out = color_buffer;
-        for (i = 0; i < num_pixels; i++) {
-            out[0] = (IceTUByte)(255*in[0]);
-            out[1] = (IceTUByte)(255*in[1]);
-            out[2] = (IceTUByte)(255*in[2]);
-            out[3] = (IceTUByte)255;
-            in += 3;
-            out += 4;
-        }
+    if (   (in_color_format == out_color_format)
+        || (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+        || (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
+        imageCopyColor(image, color_buffer, out_color_format);
     } else {
         icetRaiseError(ICET_SANITY_CHECK_FAIL,
                        "Encountered unexpected color format combination "
@@ -1005,65 +1276,11 @@ void icetImageCopyColorf(const IceTImage image,
         return;
     }
 
-    if (in_color_format == out_color_format) {
-        const IceTFloat *in_buffer = icetImageGetColorcf(image);
-        IceTSizeType color_format_bytes = (  icetImageGetNumPixels(image)
-                                           * colorPixelSize(in_color_format) );
-        memcpy(color_buffer, in_buffer, color_format_bytes);
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
-               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
-        const IceTUByte *in_buffer = icetImageGetColorcub(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTUByte *in;
-        IceTFloat *out;
-        for (i = 0, in = in_buffer, out = color_buffer; i < 4*num_pixels;
-             i++, in++, out++) {
-            out[0] = (IceTFloat)in[0]/255.0f;
-        }
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
-               && (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
-        const IceTUByte *in_buffer = icetImageGetColorcub(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTUByte *in = in_buffer;
-        IceTFloat *out = color_buffer;
-        for (i = 0; i < num_pixels; i++) {
-            out[0] = (IceTFloat)in[0]/255.0f;
-            out[1] = (IceTFloat)in[1]/255.0f;
-            out[2] = (IceTFloat)in[2]/255.0f;
-            in += 4;
-            out += 3;
-        }
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
-               && (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
-        const IceTFloat *in_buffer = icetImageGetColorcf(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTFloat *in = in_buffer;
-        IceTFloat *out = color_buffer;
-        for (i = 0; i < num_pixels; i++) {
-            out[0] = (IceTFloat)in[0];
-            out[1] = (IceTFloat)in[1];
-            out[2] = (IceTFloat)in[2];
-            in += 4;
-            out += 3;
-        }
-    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT)
-               && (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) ) {
-        const IceTFloat *in_buffer = icetImageGetColorcf(image);
-        IceTSizeType num_pixels = icetImageGetNumPixels(image);
-        IceTSizeType i;
-        const IceTFloat *in = in_buffer;
-        IceTFloat *out = color_buffer;
-        for (i = 0; i < num_pixels; i++) {
-            out[0] = (IceTFloat)in[0];
-            out[1] = (IceTFloat)in[1];
-            out[2] = (IceTFloat)in[2];
-            out[3] = 1.0f;
-            in += 3;
-            out += 4;
-        }
+    if (   (in_color_format == out_color_format)
+        || (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+        || (in_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+        || (in_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
+        imageCopyColor(image, color_buffer, out_color_format);
     } else {
         icetRaiseError(ICET_SANITY_CHECK_FAIL,
                        "Unexpected format combination "
@@ -1100,6 +1317,208 @@ void icetImageCopyDepthf(const IceTImage image,
     }
 }
 
+static FILE *imageOpenFile(const char *filename, const char *mode)
+{
+    FILE *fd;
+#ifndef _WIN32
+    fd = fopen(filename, mode);
+#else /*_WIN32*/
+    if (fopen_s(&fd, filename, mode) != 0) { fd = NULL; }
+#endif /*_WIN32*/
+    if (fd == NULL) {
+        icetRaiseError(ICET_INVALID_VALUE, "Could not open %s.", filename);
+    }
+    return fd;
+}
+
+/* Seeks to an absolute position.  fseek takes a long, which cannot reach
+   past 2 GB on many systems. */
+static int imageSeekFile(FILE *fd, IceTInt64 position)
+{
+#ifndef _WIN32
+    return fseeko(fd, (off_t)position, SEEK_SET);
+#else /*_WIN32*/
+    return _fseeki64(fd, position, SEEK_SET);
+#endif /*_WIN32*/
+}
+
+/* Converts a float color component to a byte, clamping it to [0,1] first. */
+static IceTUByte imageFloatToUByte(IceTFloat value)
+{
+    if (value <= 0.0f) { return 0; }
+    if (value >= 1.0f) { return 255; }
+    return (IceTUByte)(255*value);
+}
+
+/* Raises an error and returns ICET_FALSE if writing to a file failed. */
+static IceTBoolean imageCheckWrite(IceTBoolean success, const char *filename)
+{
+    if (!success) {
+        icetRaiseError(ICET_INVALID_OPERATION,
+                       "Could not write to %s.", filename);
+    }
+    return success;
+}
+
+/* Writes the pixels [offset, offset+num_pixels) of image into a PPM file that
+   already has its header and full size.  The pixels never cross a row, so
+   they land in one contiguous run of the file.  Returns ICET_FALSE if the
+   file could not be written. */
+static IceTBoolean imageWritePPMRun(const IceTImage image,
+                             IceTSizeType offset,
+                             IceTSizeType num_pixels,
+                             IceTSizeType header_size,
+                             FILE *fd)
+{
+#define ICET_WRITE_PPM_CHUNK 1024
+    IceTUByte rgb[3*ICET_WRITE_PPM_CHUNK];
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTSizeType x = offset%width;
+    IceTSizeType y = offset/width;
+
+    /* PPM rows go from top to bottom whereas image rows go bottom to top. */
+    if (imageSeekFile(fd,
+                      header_size + 3*((IceTInt64)(height-y-1)*width + x))
+        != 0) {
+        return ICET_FALSE;
+    }
+
+    while (num_pixels > 0) {
+        IceTSizeType chunk = num_pixels;
+        IceTSizeType i;
+        if (chunk > ICET_WRITE_PPM_CHUNK) { chunk = ICET_WRITE_PPM_CHUNK; }
+
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            const IceTUByte *in = icetImageGetColorcub(image) + 4*offset;
+            for (i = 0; i < chunk; i++) {
+                rgb[3*i+0] = in[4*i+0];
+                rgb[3*i+1] = in[4*i+1];
+                rgb[3*i+2] = in[4*i+2];
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            const IceTFloat *in = icetImageGetColorcf(image) + 4*offset;
+            for (i = 0; i < chunk; i++) {
+                rgb[3*i+0] = imageFloatToUByte(in[4*i+0]);
+                rgb[3*i+1] = imageFloatToUByte(in[4*i+1]);
+                rgb[3*i+2] = imageFloatToUByte(in[4*i+2]);
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+            const IceTFloat *in = icetImageGetColorcf(image) + 3*offset;
+            for (i = 0; i < chunk; i++) {
+                rgb[3*i+0] = imageFloatToUByte(in[3*i+0]);
+                rgb[3*i+1] = imageFloatToUByte(in[3*i+1]);
+                rgb[3*i+2] = imageFloatToUByte(in[3*i+2]);
+            }
+        } else {
+            icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                           "Encountered invalid color format 0x%X.",
+                           color_format);
+            return ICET_TRUE;
+        }
+
+        if (fwrite(rgb, 1, 3*chunk, fd) != (size_t)(3*chunk)) {
+            return ICET_FALSE;
+        }
+        offset += chunk;
+        num_pixels -= chunk;
+    }
+#undef ICET_WRITE_PPM_CHUNK
+
+    return ICET_TRUE;
+}
+
+void icetImageWritePPM(const IceTImage image,
+                       IceTInt tile,
+                       const char *filename)
+{
+    const IceTInt *tile_viewport;
+    IceTInt display_node;
+    IceTSizeType width;
+    IceTSizeType height;
+    char header[64];
+    IceTSizeType header_size;
+    IceTInt num_tiles;
+    IceTInt valid_tile;
+
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    if ((tile < 0) || (tile >= num_tiles)) {
+        icetRaiseError(ICET_INVALID_VALUE, "Invalid tile %d.", tile);
+        return;
+    }
+
+    tile_viewport = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*tile;
+    display_node = icetUnsafeStateGetInteger(ICET_DISPLAY_NODES)[tile];
+    width = tile_viewport[2];
+    height = tile_viewport[3];
+    header_size = icetSnprintf(header, 64, "P6\n%d %d\n255\n",
+                               (int)width, (int)height);
+
+    /* The display node creates the file at its full size before anyone
+       writes into it. */
+    if (icetCommRank() == display_node) {
+        FILE *fd = imageOpenFile(filename, "wb");
+        if (fd != NULL) {
+            IceTUByte zero = 0;
+            IceTBoolean success
+                = (   (fwrite(header, 1, header_size, fd)
+                       == (size_t)header_size)
+                   && (imageSeekFile(fd,
+                                     header_size
+                                     + 3*(IceTInt64)width*height - 1)
+                       == 0)
+                   && (fwrite(&zero, 1, 1, fd) == 1) );
+            success = (fclose(fd) == 0) && success;
+            imageCheckWrite(success, filename);
+        }
+    }
+    icetCommBarrier();
+
+    /* Each process writes the pixels it holds for the tile, which is either
+       the whole image on the display node after collection or its own
+       partition when ICET_COLLECT_IMAGES is off. */
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+    if ((valid_tile == tile) && !icetImageIsNull(image)) {
+        IceTInt offset;
+        IceTInt num_pixels;
+        FILE *fd;
+
+        if (   (icetImageGetWidth(image) != width)
+            || (icetImageGetHeight(image) != height) ) {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Image does not match the size of tile %d.",
+                           tile);
+        } else if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_NONE) {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Image has no color data to write.");
+        } else {
+            icetGetIntegerv(ICET_VALID_PIXELS_OFFSET, &offset);
+            icetGetIntegerv(ICET_VALID_PIXELS_NUM, &num_pixels);
+            fd = imageOpenFile(filename, "r+b");
+            if (fd != NULL) {
+                IceTBoolean success = ICET_TRUE;
+                while (success && (num_pixels > 0)) {
+                    IceTSizeType run = width - offset%width;
+                    if (run > num_pixels) { run = num_pixels; }
+                    success = imageWritePPMRun(image,
+                                               offset,
+                                               run,
+                                               header_size,
+                                               fd);
+                    offset += run;
+                    num_pixels -= run;
+                }
+                success = (fclose(fd) == 0) && success;
+                imageCheckWrite(success, filename);
+            }
+        }
+    }
+
+    /* Make sure the file is complete when anyone returns. */
+    icetCommBarrier();
+}
+
 IceTBoolean icetImageEqual(const IceTImage image1, const IceTImage image2)
 {
     return image1.opaque_internals == image2.opaque_internals;
@@ -1154,6 +1573,50 @@ void icetImageCopyPixels(const IceTImage in_image, IceTSizeType in_offset,
     }
 }
 
+typedef struct imageCopyRegionTaskStruct {
+    const IceTByte *color_src;
+    IceTByte *color_dest;
+    IceTSizeType color_row_bytes;
+    IceTSizeType color_src_stride;
+    IceTSizeType color_dest_stride;
+    const IceTByte *depth_src;
+    IceTByte *depth_dest;
+    IceTSizeType depth_row_bytes;
+    IceTSizeType depth_src_stride;
+    IceTSizeType depth_dest_stride;
+} imageCopyRegionTaskData;
+
+/* Copies rows [begin,end) of the region.  The source and destination
+   pointers point to the first pixel of the region (or are NULL). */
+static void imageCopyRegionTask(IceTSizeType begin,
+                                IceTSizeType end,
+                                IceTVoid *task_data)
+{
+    const imageCopyRegionTaskData *data
+        = (const imageCopyRegionTaskData *)task_data;
+    IceTSizeType y;
+
+    if (data->color_src != NULL) {
+        const IceTByte *src = data->color_src + begin*data->color_src_stride;
+        IceTByte *dest = data->color_dest + begin*data->color_dest_stride;
+        for (y = begin; y < end; y++) {
+            memcpy(dest, src, data->color_row_bytes);
+            src  += data->color_src_stride;
+            dest += data->color_dest_stride;
+        }
+    }
+
+    if (data->depth_src != NULL) {
+        const IceTByte *src = data->depth_src + begin*data->depth_src_stride;
+        IceTByte *dest = data->depth_dest + begin*data->depth_dest_stride;
+        for (y = begin; y < end; y++) {
+            memcpy(dest, src, data->depth_row_bytes);
+            src  += data->depth_src_stride;
+            dest += data->depth_dest_stride;
+        }
+    }
+}
+
 void icetImageCopyRegion(const IceTImage in_image,
                          const IceTInt *in_viewport,
                          IceTImage out_image,
@@ -1161,6 +1624,7 @@ void icetImageCopyRegion(const IceTImage in_image,
 {
     IceTEnum color_format = icetImageGetColorFormat(in_image);
     IceTEnum depth_format = icetImageGetDepthFormat(in_image);
+    imageCopyRegionTaskData data;
 
     if (    (color_format != icetImageGetColorFormat(out_image))
          || (depth_format != icetImageGetDepthFormat(out_image)) ) {
@@ -1182,7 +1646,6 @@ void icetImageCopyRegion(const IceTImage in_image,
         /* Use IceTByte for byte-based pointer arithmetic. */
         const IceTByte *src = icetImageGetColorConstVoid(in_image, &pixel_size);
         IceTByte *dest = icetImageGetColorVoid(out_image, &pixel_size);
-        IceTSizeType y;
 
       /* Advance pointers up to vertical offset. */
         src  += in_viewport[1]*icetImageGetWidth(in_image)*pixel_size;
@@ -1192,11 +1655,15 @@ void icetImageCopyRegion(const IceTImage in_image,
         src  += in_viewport[0]*pixel_size;
         dest += out_viewport[0]*pixel_size;
 
-        for (y = 0; y < in_viewport[3]; y++) {
-            memcpy(dest, src, in_viewport[2]*pixel_size);
-            src  += icetImageGetWidth(in_image)*pixel_size;
-            dest += icetImageGetWidth(out_image)*pixel_size;
-        }
+        data.color_src = src;
+        data.color_dest = dest;
+        data.color_row_bytes = in_viewport[2]*pixel_size;
+        data.color_src_stride = icetImageGetWidth(in_image)*pixel_size;
+        data.color_dest_stride = icetImageGetWidth(out_image)*pixel_size;
+    } else {
+        data.color_src = NULL;
+        data.color_dest = NULL;
+        data.color_row_bytes = 0;
     }
 
     if (depth_format != ICET_IMAGE_DEPTH_NONE) {
@@ -1204,7 +1671,6 @@ void icetImageCopyRegion(const IceTImage in_image,
         /* Use IceTByte for byte-based pointer arithmetic. */
         const IceTByte *src = icetImageGetDepthConstVoid(in_image, &pixel_size);
         IceTByte *dest = icetImageGetDepthVoid(out_image, &pixel_size);
-        IceTSizeType y;
 
       /* Advance pointers up to vertical offset. */
         src  += in_viewport[1]*icetImageGetWidth(in_image)*pixel_size;
@@ -1214,164 +1680,258 @@ void icetImageCopyRegion(const IceTImage in_image,
         src  += in_viewport[0]*pixel_size;
         dest += out_viewport[0]*pixel_size;
 
-        for (y = 0; y < in_viewport[3]; y++) {
-            memcpy(dest, src, in_viewport[2]*pixel_size);
-            src  += icetImageGetWidth(in_image)*pixel_size;
-            dest += icetImageGetWidth(out_image)*pixel_size;
-        }
+        data.depth_src = src;
+        data.depth_dest = dest;
+        data.depth_row_bytes = in_viewport[2]*pixel_size;
+        data.depth_src_stride = icetImageGetWidth(in_image)*pixel_size;
+        data.depth_dest_stride = icetImageGetWidth(out_image)*pixel_size;
+    } else {
+        data.depth_src = NULL;
+        data.depth_dest = NULL;
+        data.depth_row_bytes = 0;
     }
+
+    icetThreadParallelFor(in_viewport[3],
+                          data.color_row_bytes + data.depth_row_bytes,
+                          imageCopyRegionTask,
+                          &data);
 }
 
-void icetImageClearAroundRegion(IceTImage image, const IceTInt *region)
+typedef struct imageScalePixelsTaskStruct {
+    const IceTByte *color_src;
+    IceTByte *color_dest;
+    IceTSizeType color_src_size;
+    IceTSizeType color_dest_size;
+    IceTBoolean color_to_float;
+    IceTSizeType color_dest_components;
+    const IceTFloat *depth_src;
+    IceTFloat *depth_dest;
+    IceTSizeType in_width;
+    IceTSizeType in_height;
+    IceTSizeType out_width;
+    IceTSizeType out_height;
+} imageScalePixelsTaskData;
+
+/* Fills rows [begin,end) of the output with the nearest input pixels. */
+static void imageScalePixelsTask(IceTSizeType begin,
+                                 IceTSizeType end,
+                                 IceTVoid *task_data)
 {
-    IceTSizeType width = icetImageGetWidth(image);
-    IceTSizeType height = icetImageGetHeight(image);
-    IceTEnum color_format = icetImageGetColorFormat(image);
-    IceTEnum depth_format = icetImageGetDepthFormat(image);
-    IceTSizeType x, y;
-
-    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-        IceTUInt *color_buffer = icetImageGetColorui(image);
-        IceTUInt background_color;
-
-        icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,(IceTInt*)&background_color);
-
-      /* Clear out bottom. */
-        for (y = 0; y < region[1]; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[y*width + x] = background_color;
-            }
-        }
-      /* Clear out left and right. */
-        if ((region[0] > 0) || (region[0]+region[2] < width)) {
-            for (y = region[1]; y < region[1]+region[3]; y++) {
-                for (x = 0; x < region[0]; x++) {
-                    color_buffer[y*width + x] = background_color;
-                }
-                for (x = region[0]+region[2]; x < width; x++) {
-                    color_buffer[y*width + x] = background_color;
-                }
-            }
-        }
-      /* Clear out top. */
-        for (y = region[1]+region[3]; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[y*width + x] = background_color;
-            }
-        }
-    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-        IceTFloat *color_buffer = icetImageGetColorf(image);
-        IceTFloat background_color[4];
-
-        icetGetFloatv(ICET_BACKGROUND_COLOR, background_color);
-
-      /* Clear out bottom. */
-        for (y = 0; y < region[1]; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[4*(y*width + x) + 0] = background_color[0];
-                color_buffer[4*(y*width + x) + 1] = background_color[1];
-                color_buffer[4*(y*width + x) + 2] = background_color[2];
-                color_buffer[4*(y*width + x) + 3] = background_color[3];
-            }
-        }
-      /* Clear out left and right. */
-        if ((region[0] > 0) || (region[0]+region[2] < width)) {
-            for (y = region[1]; y < region[1]+region[3]; y++) {
-                for (x = 0; x < region[0]; x++) {
-                    color_buffer[4*(y*width + x) + 0] = background_color[0];
-                    color_buffer[4*(y*width + x) + 1] = background_color[1];
-                    color_buffer[4*(y*width + x) + 2] = background_color[2];
-                    color_buffer[4*(y*width + x) + 3] = background_color[3];
-                }
-                for (x = region[0]+region[2]; x < width; x++) {
-                    color_buffer[4*(y*width + x) + 0] = background_color[0];
-                    color_buffer[4*(y*width + x) + 1] = background_color[1];
-                    color_buffer[4*(y*width + x) + 2] = background_color[2];
-                    color_buffer[4*(y*width + x) + 3] = background_color[3];
+    const imageScalePixelsTaskData *data
+        = (const imageScalePixelsTaskData *)task_data;
+    IceTSizeType y;
+
+    for (y = begin; y < end; y++) {
+        IceTSizeType in_row = (y*data->in_height)/data->out_height;
+        IceTSizeType x;
+        for (x = 0; x < data->out_width; x++) {
+            IceTSizeType in_pixel
+                = in_row*data->in_width + (x*data->in_width)/data->out_width;
+            IceTSizeType out_pixel = y*data->out_width + x;
+            if (data->color_to_float) {
+                const IceTUByte *src
+                    = (const IceTUByte *)data->color_src + 4*in_pixel;
+                IceTFloat *dest = (IceTFloat *)data->color_dest
+                    + data->color_dest_components*out_pixel;
+                IceTSizeType c;
+                for (c = 0; c < data->color_dest_components; c++) {
+                    dest[c] = src[c]/255.0f;
                 }
+            } else if (data->color_src != NULL) {
+                memcpy(data->color_dest + data->color_dest_size*out_pixel,
+                       data->color_src + data->color_src_size*in_pixel,
+                       data->color_src_size);
             }
-        }
-      /* Clear out top. */
-        for (y = region[1]+region[3]; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[4*(y*width + x) + 0] = background_color[0];
-                color_buffer[4*(y*width + x) + 1] = background_color[1];
-                color_buffer[4*(y*width + x) + 2] = background_color[2];
-                color_buffer[4*(y*width + x) + 3] = background_color[3];
+            if (data->depth_src != NULL) {
+                data->depth_dest[out_pixel] = data->depth_src[in_pixel];
             }
         }
-    } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
-        IceTFloat *color_buffer = icetImageGetColorf(image);
-        IceTFloat background_color[4];
+    }
+}
 
-        icetGetFloatv(ICET_BACKGROUND_COLOR, background_color);
+void icetImageScalePixels(const IceTImage in_image, IceTImage out_image)
+{
+    IceTEnum in_color_format = icetImageGetColorFormat(in_image);
+    IceTEnum out_color_format = icetImageGetColorFormat(out_image);
+    IceTEnum in_depth_format = icetImageGetDepthFormat(in_image);
+    IceTEnum out_depth_format = icetImageGetDepthFormat(out_image);
+    imageScalePixelsTaskData data;
 
-      /* Clear out bottom. */
-        for (y = 0; y < region[1]; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[3*(y*width + x) + 0] = background_color[0];
-                color_buffer[3*(y*width + x) + 1] = background_color[1];
-                color_buffer[3*(y*width + x) + 2] = background_color[2];
-            }
-        }
-      /* Clear out left and right. */
-        if ((region[0] > 0) || (region[0]+region[2] < width)) {
-            for (y = region[1]; y < region[1]+region[3]; y++) {
-                for (x = 0; x < region[0]; x++) {
-                    color_buffer[3*(y*width + x) + 0] = background_color[0];
-                    color_buffer[3*(y*width + x) + 1] = background_color[1];
-                    color_buffer[3*(y*width + x) + 2] = background_color[2];
-                }
-                for (x = region[0]+region[2]; x < width; x++) {
-                    color_buffer[3*(y*width + x) + 0] = background_color[0];
-                    color_buffer[3*(y*width + x) + 1] = background_color[1];
-                    color_buffer[3*(y*width + x) + 2] = background_color[2];
-                }
-            }
-        }
-      /* Clear out top. */
-        for (y = region[1]+region[3]; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                color_buffer[3*(y*width + x) + 0] = background_color[0];
-                color_buffer[3*(y*width + x) + 1] = background_color[1];
-                color_buffer[3*(y*width + x) + 2] = background_color[2];
-            }
-        }
-    } else if (color_format != ICET_IMAGE_COLOR_NONE) {
-        icetRaiseError(ICET_SANITY_CHECK_FAIL,
-                       "Invalid color format 0x%X.", color_format);
+    data.color_to_float = ICET_FALSE;
+    if (in_color_format == out_color_format) {
+        /* Plain copy of each pixel. */
+    } else if (   (in_color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+               && (   (out_color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+                   || (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) ) {
+        data.color_to_float = ICET_TRUE;
+    } else {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "icetImageScalePixels cannot convert color format"
+                       " 0x%X to 0x%X.", in_color_format, out_color_format);
+        return;
+    }
+    if (in_depth_format != out_depth_format) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "icetImageScalePixels only supports images with the"
+                       " same depth format.");
+        return;
     }
 
-    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
-        IceTFloat *depth_buffer = icetImageGetDepthf(image);
+    data.in_width = icetImageGetWidth(in_image);
+    data.in_height = icetImageGetHeight(in_image);
+    data.out_width = icetImageGetWidth(out_image);
+    data.out_height = icetImageGetHeight(out_image);
+
+    if (out_color_format != ICET_IMAGE_COLOR_NONE) {
+        data.color_src = icetImageGetColorConstVoid(in_image,
+                                                    &data.color_src_size);
+        data.color_dest = icetImageGetColorVoid(out_image,
+                                                &data.color_dest_size);
+        data.color_dest_components
+            = (out_color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ? 3 : 4;
+    } else {
+        data.color_src = NULL;
+        data.color_dest = NULL;
+        data.color_src_size = 0;
+        data.color_dest_size = 0;
+        data.color_dest_components = 0;
+    }
 
-      /* Clear out bottom. */
-        for (y = 0; y < region[1]; y++) {
-            for (x = 0; x < width; x++) {
-                depth_buffer[y*width + x] = 1.0f;
-            }
-        }
-      /* Clear out left and right. */
-        if ((region[0] > 0) || (region[0]+region[2] < width)) {
-            for (y = region[1]; y < region[1]+region[3]; y++) {
-                for (x = 0; x < region[0]; x++) {
-                    depth_buffer[y*width + x] = 1.0f;
-                }
-                for (x = region[0]+region[2]; x < width; x++) {
-                    depth_buffer[y*width + x] = 1.0f;
-                }
-            }
+    if (out_depth_format != ICET_IMAGE_DEPTH_NONE) {
+        data.depth_src = icetImageGetDepthcf(in_image);
+        data.depth_dest = icetImageGetDepthf(out_image);
+    } else {
+        data.depth_src = NULL;
+        data.depth_dest = NULL;
+    }
+
+    icetThreadParallelFor(data.out_height,
+                          data.out_width*(  data.color_dest_size
+                                          + ((data.depth_src != NULL)
+                                             ? sizeof(IceTFloat) : 0) ),
+                          imageScalePixelsTask,
+                          &data);
+}
+
+typedef struct imageClearAroundRegionTaskStruct {
+    IceTSizeType width;
+    IceTInt region[4];
+    IceTEnum color_format;
+    IceTVoid *color_buffer;
+    IceTUInt background_color_word;
+    IceTFloat background_color[4];
+    IceTFloat *depth_buffer;
+} imageClearAroundRegionTaskData;
+
+static void imageClearSpan(const imageClearAroundRegionTaskData *data,
+                           IceTSizeType y,
+                           IceTSizeType x_begin,
+                           IceTSizeType x_end)
+{
+    IceTSizeType start = y*data->width;
+    IceTSizeType x;
+
+    if (data->color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUInt *color = (IceTUInt *)data->color_buffer + start;
+        IceTUInt background_color = data->background_color_word;
+        for (x = x_begin; x < x_end; x++) {
+            color[x] = background_color;
         }
-      /* Clear out top. */
-        for (y = region[1]+region[3]; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                depth_buffer[y*width + x] = 1.0f;
-            }
+    } else if (data->color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        IceTFloat *color = (IceTFloat *)data->color_buffer + 4*start;
+        const IceTFloat *background_color = data->background_color;
+        for (x = x_begin; x < x_end; x++) {
+            color[4*x + 0] = background_color[0];
+            color[4*x + 1] = background_color[1];
+            color[4*x + 2] = background_color[2];
+            color[4*x + 3] = background_color[3];
+        }
+    } else if (data->color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+        IceTFloat *color = (IceTFloat *)data->color_buffer + 3*start;
+        const IceTFloat *background_color = data->background_color;
+        for (x = x_begin; x < x_end; x++) {
+            color[3*x + 0] = background_color[0];
+            color[3*x + 1] = background_color[1];
+            color[3*x + 2] = background_color[2];
+        }
+    }
+
+    if (data->depth_buffer != NULL) {
+        IceTFloat *depth = data->depth_buffer + start;
+        for (x = x_begin; x < x_end; x++) {
+            depth[x] = 1.0f;
         }
+    }
+}
+
+/* Clears rows [begin,end) everywhere outside of the region. */
+static void imageClearAroundRegionTask(IceTSizeType begin,
+                                       IceTSizeType end,
+                                       IceTVoid *task_data)
+{
+    const imageClearAroundRegionTaskData *data
+        = (const imageClearAroundRegionTaskData *)task_data;
+    const IceTInt *region = data->region;
+    IceTSizeType y;
+
+    for (y = begin; y < end; y++) {
+        if ((y < region[1]) || (y >= region[1]+region[3])) {
+          /* Clear out bottom or top. */
+            imageClearSpan(data, y, 0, data->width);
+        } else {
+          /* Clear out left and right. */
+            imageClearSpan(data, y, 0, region[0]);
+            imageClearSpan(data, y, region[0]+region[2], data->width);
+        }
+    }
+}
+
+void icetImageClearAroundRegion(IceTImage image, const IceTInt *region)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType row_bytes;
+    imageClearAroundRegionTaskData data;
+
+    data.width = icetImageGetWidth(image);
+    data.region[0] = region[0];
+    data.region[1] = region[1];
+    data.region[2] = region[2];
+    data.region[3] = region[3];
+    data.color_format = ICET_IMAGE_COLOR_NONE;
+    data.color_buffer = NULL;
+    data.depth_buffer = NULL;
+    row_bytes = 0;
+
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        data.color_format = color_format;
+        data.color_buffer = icetImageGetColorui(image);
+        icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,
+                        (IceTInt*)&data.background_color_word);
+        row_bytes += 4*data.width;
+    } else if (   (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+               || (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) ) {
+        data.color_format = color_format;
+        data.color_buffer = icetImageGetColorf(image);
+        icetGetFloatv(ICET_BACKGROUND_COLOR, data.background_color);
+        row_bytes += colorPixelSize(color_format)*data.width;
+    } else if (color_format != ICET_IMAGE_COLOR_NONE) {
+        icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                       "Invalid color format 0x%X.", color_format);
+    }
+
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        data.depth_buffer = icetImageGetDepthf(image);
+        row_bytes += sizeof(IceTFloat)*data.width;
     } else if (depth_format != ICET_IMAGE_DEPTH_NONE) {
         icetRaiseError(ICET_SANITY_CHECK_FAIL,
                        "Invalid depth format 0x%X.", depth_format);
     }
+
+    icetThreadParallelFor(icetImageGetHeight(image),
+                          row_bytes,
+                          imageClearAroundRegionTask,
+                          &data);
 }
 
 void icetImagePackageForSend(IceTImage image,
@@ -1472,10 +2032,726 @@ IceTImage icetImageUnpackageFromReceive(IceTVoid *buffer)
     return image;
 }
 
+/* Codes for the depth values of an active run in an image encoded with
+   icetSparseImageEncodeDepth.  The code is kept in the top bits of the active
+   run length.  Raw runs are stored as usual.  Otherwise the colors of the run
+   come first, then the first depth as a raw float and then the residuals of
+   the remaining depths against a linear prediction from the two depths before
+   them, padded to a multiple of 4 bytes. */
+#define DEPTH_CODE_SHIFT        30
+#define DEPTH_CODE_MASK         ((IceTRunLengthType)0x3 << DEPTH_CODE_SHIFT)
+#define DEPTH_CODE_RAW          0
+#define DEPTH_CODE_8BIT         1
+#define DEPTH_CODE_16BIT        2
+
+/* Depths are predicted on their bit patterns, which for the nonnegative
+   floats in a depth buffer are ordered the same way as the values.  All the
+   arithmetic is unsigned, so it wraps and decodes exactly. */
+static IceTUnsignedInt32 depthCodeGet(const IceTByte *pixels,
+                                      IceTSizeType index,
+                                      IceTSizeType pixel_size,
+                                      IceTSizeType depth_offset)
+{
+    IceTUnsignedInt32 value;
+    memcpy(&value, pixels + index*pixel_size + depth_offset, sizeof(value));
+    return value;
+}
+
+static IceTUnsignedInt32 depthCodePredict(IceTUnsignedInt32 before_last,
+                                          IceTUnsignedInt32 last,
+                                          IceTSizeType index)
+{
+    if (index < 2) {
+        return last;
+    } else {
+        return 2*last - before_last;
+    }
+}
+
+static IceTSizeType depthCodeResidualsSize(IceTUnsignedInt32 code,
+                                           IceTSizeType num_pixels)
+{
+    IceTSizeType size = (num_pixels - 1)*(IceTSizeType)code;
+    return (IceTSizeType)sizeof(IceTUnsignedInt32) + ((size + 3) & ~3);
+}
+
+/* Picks the smallest code that holds every residual of the run. */
+static IceTUnsignedInt32 depthCodeChoose(const IceTByte *pixels,
+                                         IceTSizeType num_pixels,
+                                         IceTSizeType pixel_size,
+                                         IceTSizeType depth_offset)
+{
+    IceTUnsignedInt32 before_last = 0;
+    IceTUnsignedInt32 last;
+    IceTUnsignedInt32 code = DEPTH_CODE_8BIT;
+    IceTSizeType i;
+
+    if (num_pixels < 2) { return DEPTH_CODE_RAW; }
+
+    last = depthCodeGet(pixels, 0, pixel_size, depth_offset);
+    for (i = 1; i < num_pixels; i++) {
+        IceTUnsignedInt32 value
+            = depthCodeGet(pixels, i, pixel_size, depth_offset);
+        IceTUnsignedInt32 residual
+            = value - depthCodePredict(before_last, last, i);
+        if (residual + 0x8000u > 0xFFFFu) {
+            return DEPTH_CODE_RAW;
+        }
+        if (residual + 0x80u > 0xFFu) {
+            code = DEPTH_CODE_16BIT;
+        }
+        before_last = last;
+        last = value;
+    }
+
+    if (  depthCodeResidualsSize(code, num_pixels)
+        < num_pixels*(IceTSizeType)sizeof(IceTUnsignedInt32) ) {
+        return code;
+    } else {
+        return DEPTH_CODE_RAW;
+    }
+}
+
+void icetSparseImageEncodeDepth(IceTSparseImage image)
+{
+    IceTSizeType color_pixel_size;
+    IceTSizeType pixel_size;
+    const IceTByte *in_data;
+    const IceTByte *in_end;
+    IceTByte *out_start;
+    IceTByte *out_data;
+
+    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+
+    if (   icetSparseImageIsNull(image)
+        || !icetIsEnabled(ICET_PREDICT_DEPTH)
+        || (icetSparseImageGetDepthFormat(image) != ICET_IMAGE_DEPTH_FLOAT)
+        || (icetSparseImageGetNumPixels(image)
+            >= ((IceTSizeType)1 << DEPTH_CODE_SHIFT)) ) {
+        return;
+    }
+
+    icetTimingCompressBegin();
+
+    color_pixel_size = colorPixelSize(icetSparseImageGetColorFormat(image));
+    pixel_size = color_pixel_size + depthPixelSize(ICET_IMAGE_DEPTH_FLOAT);
+
+    in_data = ICET_IMAGE_DATA(image);
+    in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+
+    /* The encoded runs are never bigger than the originals, so build them on
+       the side and copy them back over the image. */
+    out_start = icetGetStateBuffer(ICET_DEPTH_CODE_BUF, in_end - in_data);
+    out_data = out_start;
+
+    while (in_data < in_end) {
+        IceTSizeType num_active = ACTIVE_RUN_LENGTH(in_data);
+        IceTUnsignedInt32 code;
+
+        INACTIVE_RUN_LENGTH(out_data) = INACTIVE_RUN_LENGTH(in_data);
+        in_data += RUN_LENGTH_SIZE;
+
+        code = depthCodeChoose(in_data,
+                               num_active,
+                               pixel_size,
+                               color_pixel_size);
+        ACTIVE_RUN_LENGTH(out_data)
+            = (IceTRunLengthType)num_active | (code << DEPTH_CODE_SHIFT);
+        out_data += RUN_LENGTH_SIZE;
+
+        if (code == DEPTH_CODE_RAW) {
+            memcpy(out_data, in_data, num_active*pixel_size);
+            out_data += num_active*pixel_size;
+        } else {
+            IceTUnsignedInt32 before_last = 0;
+            IceTUnsignedInt32 last;
+            IceTUByte *residuals;
+            IceTSizeType i;
+
+            for (i = 0; i < num_active; i++) {
+                memcpy(out_data,
+                       in_data + i*pixel_size,
+                       color_pixel_size);
+                out_data += color_pixel_size;
+            }
+
+            last = depthCodeGet(in_data, 0, pixel_size, color_pixel_size);
+            memcpy(out_data, &last, sizeof(last));
+            residuals = (IceTUByte *)out_data + sizeof(last);
+            for (i = 1; i < num_active; i++) {
+                IceTUnsignedInt32 value
+                    = depthCodeGet(in_data, i, pixel_size, color_pixel_size);
+                IceTUnsignedInt32 residual
+                    = value - depthCodePredict(before_last, last, i);
+                residuals[0] = (IceTUByte)(residual & 0xFF);
+                if (code == DEPTH_CODE_16BIT) {
+                    residuals[1] = (IceTUByte)((residual >> 8) & 0xFF);
+                }
+                residuals += code;
+                before_last = last;
+                last = value;
+            }
+            out_data += depthCodeResidualsSize(code, num_active);
+        }
+
+        in_data += num_active*pixel_size;
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_PREDICTED_DEPTH_MAGIC_NUM;
+
+    icetTimingCompressEnd();
+}
+
+/* Undoes icetSparseImageEncodeDepth on a received image.  The buffer is
+   assumed to be big enough to hold the full image as is already the case for
+   any receive buffer. */
+static void icetSparseImageDecodeDepth(IceTSparseImage image)
+{
+    IceTSizeType color_pixel_size;
+    IceTSizeType pixel_size;
+    const IceTByte *in_data;
+    const IceTByte *in_end;
+    IceTByte *out_start;
+    IceTByte *out_data;
+
+    icetTimingCompressBegin();
+
+    color_pixel_size = colorPixelSize(icetSparseImageGetColorFormat(image));
+    pixel_size = color_pixel_size + depthPixelSize(ICET_IMAGE_DEPTH_FLOAT);
+
+    in_data = ICET_IMAGE_DATA(image);
+    in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+
+    out_start = icetGetStateBuffer(
+                        ICET_DEPTH_CODE_BUF,
+                        icetSparseImageBufferSizeType(
+                                   icetSparseImageGetColorFormat(image),
+                                   ICET_IMAGE_DEPTH_FLOAT,
+                                   icetSparseImageGetWidth(image),
+                                   icetSparseImageGetHeight(image)));
+    out_data = out_start;
+
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_MAGIC_NUM;
+
+    while (in_data < in_end) {
+        IceTRunLengthType active = ACTIVE_RUN_LENGTH(in_data);
+        IceTUnsignedInt32 code = (active & DEPTH_CODE_MASK) >> DEPTH_CODE_SHIFT;
+        IceTSizeType num_active = (IceTSizeType)(active & ~DEPTH_CODE_MASK);
+
+        INACTIVE_RUN_LENGTH(out_data) = INACTIVE_RUN_LENGTH(in_data);
+        ACTIVE_RUN_LENGTH(out_data) = (IceTRunLengthType)num_active;
+        in_data += RUN_LENGTH_SIZE;
+        out_data += RUN_LENGTH_SIZE;
+
+        if (code == DEPTH_CODE_RAW) {
+            memcpy(out_data, in_data, num_active*pixel_size);
+            in_data += num_active*pixel_size;
+        } else if ((code == DEPTH_CODE_8BIT) || (code == DEPTH_CODE_16BIT)) {
+            const IceTUByte *residuals
+                = (const IceTUByte *)in_data + num_active*color_pixel_size;
+            IceTUnsignedInt32 before_last = 0;
+            IceTUnsignedInt32 last;
+            IceTSizeType i;
+
+            memcpy(&last, residuals, sizeof(last));
+            residuals += sizeof(last);
+            for (i = 0; i < num_active; i++) {
+                IceTByte *out_pixel = out_data + i*pixel_size;
+                IceTUnsignedInt32 value;
+
+                memcpy(out_pixel, in_data + i*color_pixel_size,
+                       color_pixel_size);
+                if (i == 0) {
+                    value = last;
+                } else {
+                    IceTUnsignedInt32 residual;
+                    if (code == DEPTH_CODE_8BIT) {
+                        residual = residuals[0];
+                        residual = (residual ^ 0x80u) - 0x80u;
+                    } else {
+                        residual = (  (IceTUnsignedInt32)residuals[0]
+                                    | ((IceTUnsignedInt32)residuals[1] << 8) );
+                        residual = (residual ^ 0x8000u) - 0x8000u;
+                    }
+                    residuals += code;
+                    value = depthCodePredict(before_last, last, i) + residual;
+                    before_last = last;
+                    last = value;
+                }
+                memcpy(out_pixel + color_pixel_size, &value, sizeof(value));
+            }
+            in_data += (  num_active*color_pixel_size
+                        + depthCodeResidualsSize(code, num_active) );
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Invalid image buffer: unknown depth code.");
+            break;
+        }
+        out_data += num_active*pixel_size;
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+
+    icetTimingCompressEnd();
+}
+
+/* An image encoded with icetSparseImageEncodeBitmap has, in place of the run
+   lengths, one bit per pixel that is set for active pixels.  The bits are
+   packed into 32-bit words starting with the lowest bit.  The data of the
+   active pixels follows, packed together in order.  With many short runs this
+   is smaller because the two run lengths per run are bigger than the bits for
+   the pixels of the run. */
+#define BITMAP_WORD_BITS        32
+#define BITMAP_FULL_WORD        ((IceTUnsignedInt32)0xFFFFFFFF)
+
+static IceTSizeType bitmapWordsSize(IceTSizeType num_pixels)
+{
+    return (  (num_pixels + BITMAP_WORD_BITS - 1)/BITMAP_WORD_BITS
+            * (IceTSizeType)sizeof(IceTUnsignedInt32) );
+}
+
+/* An image encoded with icetSparseImageEncodeVarint has each run length
+   written 7 bits to a byte, lowest bits first, with the top bit set on all but
+   the last byte.  The pixel data follows each pair of run lengths without
+   padding.  Most runs are shorter than 128 pixels, which takes a byte instead
+   of 4. */
+#define VARINT_MAX_SIZE         5
+
+static IceTSizeType varintSize(IceTUnsignedInt32 value)
+{
+    IceTSizeType size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static IceTUByte *varintWrite(IceTUByte *out, IceTUnsignedInt32 value)
+{
+    while (value >= 0x80) {
+        *(out++) = (IceTUByte)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *(out++) = (IceTUByte)value;
+    return out;
+}
+
+/* Returns the byte after the value or NULL if the value does not end before
+   in_end. */
+static const IceTUByte *varintRead(const IceTUByte *in,
+                                   const IceTUByte *in_end,
+                                   IceTUnsignedInt32 *value_p)
+{
+    IceTUnsignedInt32 value = 0;
+    IceTSizeType shift = 0;
+
+    while (in < in_end) {
+        IceTUByte byte = *(in++);
+        value |= (IceTUnsignedInt32)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value_p = value;
+            return in;
+        }
+        shift += 7;
+        if (shift >= 7*VARINT_MAX_SIZE) { break; }
+    }
+    return NULL;
+}
+
+/* Returns the number of bytes the run lengths of a sparse image are sent
+   with, which depends on ICET_VARINT_RUN_LENGTHS, and the number of runs in
+   num_runs_p. */
+static IceTSizeType sparseImageRunLengthsSendSize(const IceTSparseImage image,
+                                                  IceTSizeType pixel_size,
+                                                  IceTSizeType *num_runs_p)
+{
+    IceTBoolean varint = icetIsEnabled(ICET_VARINT_RUN_LENGTHS);
+    const IceTByte *in_data = ICET_IMAGE_DATA(image);
+    const IceTByte *in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    IceTSizeType num_runs = 0;
+    IceTSizeType size = 0;
+
+    while (in_data < in_end) {
+        if (varint) {
+            size += (  varintSize(INACTIVE_RUN_LENGTH(in_data))
+                     + varintSize(ACTIVE_RUN_LENGTH(in_data)) );
+        } else {
+            size += RUN_LENGTH_SIZE;
+        }
+        in_data += RUN_LENGTH_SIZE + ACTIVE_RUN_LENGTH(in_data)*pixel_size;
+        num_runs++;
+    }
+
+    *num_runs_p = num_runs;
+    return size;
+}
+
+void icetSparseImageEncodeBitmap(IceTSparseImage image)
+{
+    IceTSizeType pixel_size;
+    IceTSizeType bitmap_size;
+    IceTSizeType run_lengths_size;
+    IceTSizeType num_runs;
+    IceTSizeType pixel;
+    const IceTByte *in_data;
+    const IceTByte *in_end;
+    IceTUnsignedInt32 *bitmap;
+    IceTByte *out_start;
+    IceTByte *out_data;
+
+    if (   icetSparseImageIsNull(image)
+        || !icetIsEnabled(ICET_BITMAP_SPARSE_IMAGES)
+        || (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+            != ICET_SPARSE_IMAGE_MAGIC_NUM) ) {
+        return;
+    }
+
+    pixel_size = (  colorPixelSize(icetSparseImageGetColorFormat(image))
+                  + depthPixelSize(icetSparseImageGetDepthFormat(image)) );
+
+    /* The pixel data is the same either way, so only the run lengths need to
+       be compared with the bitmap. */
+    run_lengths_size = sparseImageRunLengthsSendSize(image,
+                                                     pixel_size,
+                                                     &num_runs);
+    bitmap_size = bitmapWordsSize(icetSparseImageGetNumPixels(image));
+    if (bitmap_size >= run_lengths_size) {
+        return;
+    }
+
+    icetTimingCompressBegin();
+
+    in_data = ICET_IMAGE_DATA(image);
+    in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    out_start = icetGetStateBuffer(
+                     ICET_RUN_CODE_BUF,
+                     (in_end - in_data) - num_runs*RUN_LENGTH_SIZE + bitmap_size);
+    bitmap = (IceTUnsignedInt32 *)out_start;
+    memset(bitmap, 0, bitmap_size);
+    out_data = out_start + bitmap_size;
+
+    pixel = 0;
+    while (in_data < in_end) {
+        IceTSizeType num_active = ACTIVE_RUN_LENGTH(in_data);
+        IceTSizeType run_end;
+
+        pixel += INACTIVE_RUN_LENGTH(in_data);
+        in_data += RUN_LENGTH_SIZE;
+
+        for (run_end = pixel + num_active; pixel < run_end; pixel++) {
+            bitmap[pixel/BITMAP_WORD_BITS]
+                |= (IceTUnsignedInt32)1 << (pixel%BITMAP_WORD_BITS);
+        }
+        memcpy(out_data, in_data, num_active*pixel_size);
+        out_data += num_active*pixel_size;
+        in_data += num_active*pixel_size;
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_BITMAP_MAGIC_NUM;
+
+    icetTimingCompressEnd();
+}
+
+/* Writes a run length followed by the data of its active pixels, which are
+   taken from in_pixels_p.  Returns false if there is not enough data. */
+static IceTBoolean bitmapDecodeRun(IceTByte **out_data_p,
+                                   const IceTByte **in_pixels_p,
+                                   const IceTByte *in_end,
+                                   IceTSizeType num_inactive,
+                                   IceTSizeType num_active,
+                                   IceTSizeType pixel_size)
+{
+    IceTSizeType data_size = num_active*pixel_size;
+
+    if (*in_pixels_p + data_size > in_end) {
+        return ICET_FALSE;
+    }
+
+    INACTIVE_RUN_LENGTH(*out_data_p) = (IceTRunLengthType)num_inactive;
+    ACTIVE_RUN_LENGTH(*out_data_p) = (IceTRunLengthType)num_active;
+    *out_data_p += RUN_LENGTH_SIZE;
+    memcpy(*out_data_p, *in_pixels_p, data_size);
+    *out_data_p += data_size;
+    *in_pixels_p += data_size;
+
+    return ICET_TRUE;
+}
+
+/* Undoes icetSparseImageEncodeBitmap on a received image.  As with
+   icetSparseImageDecodeDepth, the buffer is assumed to be big enough to hold
+   the image with run lengths. */
+static void icetSparseImageDecodeBitmap(IceTSparseImage image)
+{
+    IceTSizeType pixel_size;
+    IceTSizeType num_pixels;
+    IceTSizeType num_inactive;
+    IceTSizeType num_active;
+    IceTSizeType pixel;
+    const IceTUnsignedInt32 *bitmap;
+    const IceTByte *in_pixels;
+    const IceTByte *in_end;
+    IceTByte *out_start;
+    IceTByte *out_data;
+    IceTBoolean valid = ICET_TRUE;
+
+    icetTimingCompressBegin();
+
+    pixel_size = (  colorPixelSize(icetSparseImageGetColorFormat(image))
+                  + depthPixelSize(icetSparseImageGetDepthFormat(image)) );
+    num_pixels = icetSparseImageGetNumPixels(image);
+
+    bitmap = ICET_IMAGE_DATA(image);
+    in_pixels = (const IceTByte *)ICET_IMAGE_DATA(image)
+        + bitmapWordsSize(num_pixels);
+    in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+
+    out_start = icetGetStateBuffer(
+                        ICET_RUN_CODE_BUF,
+                        icetSparseImageBufferSizeType(
+                                   icetSparseImageGetColorFormat(image),
+                                   icetSparseImageGetDepthFormat(image),
+                                   icetSparseImageGetWidth(image),
+                                   icetSparseImageGetHeight(image)));
+    out_data = out_start;
+
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_MAGIC_NUM;
+
+    /* A run is written when an inactive pixel follows an active one.  Whole
+       words that are empty or full are counted without looking at the bits. */
+    num_inactive = 0;
+    num_active = 0;
+    for (pixel = 0; valid && (pixel < num_pixels); pixel += BITMAP_WORD_BITS) {
+        IceTUnsignedInt32 word = bitmap[pixel/BITMAP_WORD_BITS];
+        IceTSizeType num_bits = MIN(BITMAP_WORD_BITS, num_pixels - pixel);
+        IceTSizeType bit;
+
+        if (word == BITMAP_FULL_WORD) {
+            num_active += num_bits;
+            continue;
+        }
+        if ((word == 0) && (num_active == 0)) {
+            num_inactive += num_bits;
+            continue;
+        }
+
+        for (bit = 0; bit < num_bits; bit++) {
+            if (word & ((IceTUnsignedInt32)1 << bit)) {
+                num_active++;
+            } else {
+                if (num_active > 0) {
+                    valid = bitmapDecodeRun(&out_data, &in_pixels, in_end,
+                                            num_inactive, num_active,
+                                            pixel_size);
+                    if (!valid) { break; }
+                    num_inactive = 0;
+                    num_active = 0;
+                }
+                num_inactive++;
+            }
+        }
+    }
+    if (valid && ((num_inactive > 0) || (num_active > 0))) {
+        valid = bitmapDecodeRun(&out_data, &in_pixels, in_end,
+                                num_inactive, num_active, pixel_size);
+    }
+    if (!valid || (in_pixels != in_end)) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Invalid image buffer: bitmap does not match the"
+                       " pixel data.");
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+
+    icetTimingCompressEnd();
+}
+
+void icetSparseImageEncodeVarint(IceTSparseImage image)
+{
+    IceTSizeType pixel_size;
+    IceTSizeType run_lengths_size;
+    IceTSizeType num_runs;
+    const IceTByte *in_data;
+    const IceTByte *in_end;
+    IceTUByte *out_start;
+    IceTUByte *out_data;
+
+    if (   icetSparseImageIsNull(image)
+        || !icetIsEnabled(ICET_VARINT_RUN_LENGTHS)
+        || (   ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+            != ICET_SPARSE_IMAGE_MAGIC_NUM) ) {
+        return;
+    }
+
+    pixel_size = (  colorPixelSize(icetSparseImageGetColorFormat(image))
+                  + depthPixelSize(icetSparseImageGetDepthFormat(image)) );
+
+    run_lengths_size = sparseImageRunLengthsSendSize(image,
+                                                     pixel_size,
+                                                     &num_runs);
+    if (run_lengths_size >= num_runs*RUN_LENGTH_SIZE) {
+        return;
+    }
+
+    icetTimingCompressBegin();
+
+    in_data = ICET_IMAGE_DATA(image);
+    in_end = (const IceTByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+    out_start = icetGetStateBuffer(
+                     ICET_RUN_CODE_BUF,
+                     (in_end - in_data) - num_runs*RUN_LENGTH_SIZE
+                     + run_lengths_size);
+    out_data = out_start;
+
+    while (in_data < in_end) {
+        IceTSizeType num_active = ACTIVE_RUN_LENGTH(in_data);
+
+        out_data = varintWrite(out_data, INACTIVE_RUN_LENGTH(in_data));
+        out_data = varintWrite(out_data, ACTIVE_RUN_LENGTH(in_data));
+        in_data += RUN_LENGTH_SIZE;
+
+        memcpy(out_data, in_data, num_active*pixel_size);
+        out_data += num_active*pixel_size;
+        in_data += num_active*pixel_size;
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_VARINT_MAGIC_NUM;
+
+    icetTimingCompressEnd();
+}
+
+/* Undoes icetSparseImageEncodeVarint on a received image.  As with
+   icetSparseImageDecodeDepth, the buffer is assumed to be big enough to hold
+   the image with run lengths. */
+static void icetSparseImageDecodeVarint(IceTSparseImage image)
+{
+    IceTSizeType pixel_size;
+    IceTSizeType num_pixels;
+    IceTSizeType pixels_left;
+    const IceTUByte *in_data;
+    const IceTUByte *in_end;
+    IceTByte *out_start;
+    IceTByte *out_data;
+
+    icetTimingCompressBegin();
+
+    pixel_size = (  colorPixelSize(icetSparseImageGetColorFormat(image))
+                  + depthPixelSize(icetSparseImageGetDepthFormat(image)) );
+    num_pixels = icetSparseImageGetNumPixels(image);
+
+    in_data = ICET_IMAGE_DATA(image);
+    in_end = (const IceTUByte *)image.opaque_internals
+        + ICET_IMAGE_HEADER(image)[ICET_IMAGE_ACTUAL_BUFFER_SIZE_INDEX];
+
+    out_start = icetGetStateBuffer(
+                        ICET_RUN_CODE_BUF,
+                        icetSparseImageBufferSizeType(
+                                   icetSparseImageGetColorFormat(image),
+                                   icetSparseImageGetDepthFormat(image),
+                                   icetSparseImageGetWidth(image),
+                                   icetSparseImageGetHeight(image)));
+    out_data = out_start;
+
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_MAGIC_NUM;
+
+    pixels_left = num_pixels;
+    while (in_data < in_end) {
+        IceTUnsignedInt32 num_inactive;
+        IceTUnsignedInt32 num_active;
+
+        /* Short runs have one byte lengths, so check for those first. */
+        if ((in_end - in_data >= 2) && !((in_data[0] | in_data[1]) & 0x80)) {
+            num_inactive = in_data[0];
+            num_active = in_data[1];
+            in_data += 2;
+        } else {
+            in_data = varintRead(in_data, in_end, &num_inactive);
+            if (in_data != NULL) {
+                in_data = varintRead(in_data, in_end, &num_active);
+            }
+        }
+
+        if (   (in_data == NULL)
+            || ((IceTSizeType)num_inactive > pixels_left)
+            || (  (IceTSizeType)num_active
+                > pixels_left - (IceTSizeType)num_inactive)
+            || ((IceTSizeType)num_active*pixel_size > in_end - in_data) ) {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Invalid image buffer: bad variable-length run"
+                           " length.");
+            break;
+        }
+        pixels_left -= (IceTSizeType)(num_inactive + num_active);
+
+        INACTIVE_RUN_LENGTH(out_data) = num_inactive;
+        ACTIVE_RUN_LENGTH(out_data) = num_active;
+        out_data += RUN_LENGTH_SIZE;
+        memcpy(out_data, in_data, num_active*pixel_size);
+        out_data += num_active*pixel_size;
+        in_data += num_active*pixel_size;
+    }
+
+    memcpy(ICET_IMAGE_DATA(image), out_start, out_data - out_start);
+    icetSparseImageSetActualSize(
+                         image,
+                         (IceTByte *)ICET_IMAGE_DATA(image)
+                         + (out_data - out_start));
+
+    icetTimingCompressEnd();
+}
+
+/* Returns true if image has been encoded for send with one of
+   icetSparseImageEncodeDepth, icetSparseImageEncodeBitmap, or
+   icetSparseImageEncodeVarint. */
+static IceTBoolean sparseImageIsEncoded(const IceTSparseImage image)
+{
+    IceTEnum magic_num = ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX];
+    return (   (magic_num == ICET_SPARSE_IMAGE_PREDICTED_DEPTH_MAGIC_NUM)
+            || (magic_num == ICET_SPARSE_IMAGE_BITMAP_MAGIC_NUM)
+            || (magic_num == ICET_SPARSE_IMAGE_VARINT_MAGIC_NUM) );
+}
+
 void icetSparseImagePackageForSend(IceTSparseImage image,
                                    IceTVoid **buffer, IceTSizeType *size)
 {
-    ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    if (icetSparseImageIsNull(image) || !sparseImageIsEncoded(image)) {
+        ICET_TEST_SPARSE_IMAGE_HEADER(image);
+    }
 
     if (icetSparseImageIsNull(image)) {
         /* Should we return a Null pointer and 0 size without error?
@@ -1494,18 +2770,23 @@ void icetSparseImagePackageForSend(IceTSparseImage image,
 IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
 {
     IceTSparseImage image;
-    IceTEnum color_format, depth_format;
+    IceTEnum magic_num, color_format, depth_format;
 
     image.opaque_internals = buffer;
 
   /* Check the image for validity. */
-    if (    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
-         != ICET_SPARSE_IMAGE_MAGIC_NUM ) {
+    magic_num = ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX];
+    if (    (magic_num != ICET_SPARSE_IMAGE_MAGIC_NUM)
+         && !sparseImageIsEncoded(image) ) {
         icetRaiseError(ICET_INVALID_VALUE,
                        "Invalid image buffer: no magic number.");
         image.opaque_internals = NULL;
         return image;
     }
+    /* The rest of the header is the same for encoded images, which are
+       decoded below, so mark it as a plain sparse image for the accessors. */
+    ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAGIC_NUM_INDEX]
+        = ICET_SPARSE_IMAGE_MAGIC_NUM;
 
     color_format = icetSparseImageGetColorFormat(image);
     if (    (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
@@ -1528,6 +2809,13 @@ IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
         image.opaque_internals = NULL;
         return image;
     }
+    if (    (magic_num == ICET_SPARSE_IMAGE_PREDICTED_DEPTH_MAGIC_NUM)
+         && (depth_format != ICET_IMAGE_DEPTH_FLOAT) ) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Invalid image buffer: predicted depth without depth.");
+        image.opaque_internals = NULL;
+        return image;
+    }
 
     if (   icetSparseImageBufferSizeType(color_format, depth_format,
                                          icetSparseImageGetWidth(image),
@@ -1543,6 +2831,14 @@ IceTSparseImage icetSparseImageUnpackageFromReceive(IceTVoid *buffer)
     ICET_IMAGE_HEADER(image)[ICET_IMAGE_MAX_NUM_PIXELS_INDEX]
         = (IceTInt)icetSparseImageGetNumPixels(image);
 
+    if (magic_num == ICET_SPARSE_IMAGE_PREDICTED_DEPTH_MAGIC_NUM) {
+        icetSparseImageDecodeDepth(image);
+    } else if (magic_num == ICET_SPARSE_IMAGE_BITMAP_MAGIC_NUM) {
+        icetSparseImageDecodeBitmap(image);
+    } else if (magic_num == ICET_SPARSE_IMAGE_VARINT_MAGIC_NUM) {
+        icetSparseImageDecodeVarint(image);
+    }
+
   /* The image is valid (as far as we can tell). */
     return image;
 }
@@ -1938,32 +3234,175 @@ void icetSparseImageSplit(const IceTSparseImage in_image,
     icetTimingCompressEnd();
 }
 
-void icetSparseImageInterlace(const IceTSparseImage in_image,
-                              IceTInt eventual_num_partitions,
-                              IceTEnum scratch_state_buffer,
-                              IceTSparseImage out_image)
-{
-    IceTSizeType num_pixels = icetSparseImageGetNumPixels(in_image);
-    IceTEnum color_format = icetSparseImageGetColorFormat(in_image);
-    IceTEnum depth_format = icetSparseImageGetDepthFormat(in_image);
-    IceTSizeType lower_partition_size = num_pixels/eventual_num_partitions;
-    IceTSizeType remaining_pixels = num_pixels%eventual_num_partitions;
-    IceTSizeType pixel_size;
-    IceTInt original_partition_idx;
-    IceTInt interlaced_partition_idx;
-    const IceTVoid **in_data_array;
-    IceTSizeType *inactive_before_array;
-    IceTSizeType *active_till_next_runl_array;
+/* Where a partition of an interlaced image comes from and goes to.  See
+   icetSparseImageInterlace. */
+typedef struct sparseImageInterlacePartitionStruct {
+    /* Position of the partition in the input image. */
     const IceTVoid *in_data;
-    IceTVoid *out_data;
     IceTSizeType inactive_before;
     IceTSizeType active_till_next_runl;
-    IceTVoid *last_run_length;
+    IceTSizeType num_pixels;
 
-    /* Special case, nothing to do. */
-    if (eventual_num_partitions < 2) {
-        icetSparseImageCopyPixels(in_image, 0, num_pixels, out_image);
-        return;
+    /* The run lengths the partition produces when copied on its own,
+       starting with a fresh run length. */
+    IceTSizeType num_run_lengths;
+    IceTSizeType first_inactive;
+    IceTSizeType last_active;
+    IceTSizeType num_active;
+
+    /* Where the partition is written.  If merge_first_run_length is true,
+       the first run length continues the last run length of the partition
+       before it.  It is then collected in first_run_length and added in after
+       all the partitions are copied. */
+    IceTBoolean merge_first_run_length;
+    IceTRunLengthType first_run_length[2];
+    IceTByte *out_data;
+    IceTByte *out_end;
+    IceTVoid *last_run_length;
+} sparseImageInterlacePartition;
+
+/* Like icetSparseImageScanPixels without an output, but also records in
+   partition the run lengths that copying the pixels would produce. */
+static void icetSparseImageMeasurePixels(
+                                    const IceTVoid **in_data_p,
+                                    IceTSizeType *inactive_before_p,
+                                    IceTSizeType *active_till_next_runl_p,
+                                    IceTSizeType pixels_to_skip,
+                                    IceTSizeType pixel_size,
+                                    sparseImageInterlacePartition *partition)
+{
+    const IceTByte *in_data = *in_data_p;
+    IceTSizeType inactive_before = *inactive_before_p;
+    IceTSizeType active_till_next_runl = *active_till_next_runl_p;
+    IceTSizeType pixels_left = pixels_to_skip;
+    IceTSizeType out_inactive = 0;
+    IceTSizeType out_active = 0;
+
+    partition->num_run_lengths = 1;
+    partition->first_inactive = 0;
+    partition->num_active = 0;
+
+    while (pixels_left > 0) {
+        IceTSizeType count;
+        if ((inactive_before == 0) && (active_till_next_runl == 0)) {
+            inactive_before = INACTIVE_RUN_LENGTH(in_data);
+            active_till_next_runl = ACTIVE_RUN_LENGTH(in_data);
+            in_data += RUN_LENGTH_SIZE;
+        }
+
+        count = MIN(inactive_before, pixels_left);
+        if (count > 0) {
+            if (out_active > 0) {
+                if (partition->num_run_lengths == 1) {
+                    partition->first_inactive = out_inactive;
+                }
+                partition->num_run_lengths++;
+                out_inactive = 0;
+                out_active = 0;
+            }
+            out_inactive += count;
+            inactive_before -= count;
+            pixels_left -= count;
+        }
+
+        count = MIN(active_till_next_runl, pixels_left);
+        if (count > 0) {
+            out_active += count;
+            partition->num_active += count;
+            in_data += count*pixel_size;
+            active_till_next_runl -= count;
+            pixels_left -= count;
+        }
+    }
+
+    if (partition->num_run_lengths == 1) {
+        partition->first_inactive = out_inactive;
+    }
+    partition->last_active = out_active;
+
+    *in_data_p = in_data;
+    *inactive_before_p = inactive_before;
+    *active_till_next_runl_p = active_till_next_runl;
+}
+
+typedef struct sparseImageInterlaceTaskStruct {
+    sparseImageInterlacePartition *partitions;
+    IceTSizeType pixel_size;
+} sparseImageInterlaceTaskData;
+
+/* Copies partitions [begin,end) to the places picked for them. */
+static void icetSparseImageInterlaceTask(IceTSizeType begin,
+                                         IceTSizeType end,
+                                         IceTVoid *task_data)
+{
+    const sparseImageInterlaceTaskData *data
+        = (const sparseImageInterlaceTaskData *)task_data;
+    IceTSizeType partition_idx;
+
+    for (partition_idx = begin; partition_idx < end; partition_idx++) {
+        sparseImageInterlacePartition *partition
+            = data->partitions + partition_idx;
+        const IceTVoid *in_data = partition->in_data;
+        IceTSizeType inactive_before = partition->inactive_before;
+        IceTSizeType active_till_next_runl = partition->active_till_next_runl;
+        IceTVoid *out_data = partition->out_data;
+        IceTVoid *last_run_length;
+
+        if (partition->num_pixels < 1) { continue; }
+
+        if (partition->merge_first_run_length) {
+            last_run_length = partition->first_run_length;
+        } else {
+            last_run_length = out_data;
+            out_data = (IceTByte*)out_data + RUN_LENGTH_SIZE;
+        }
+        INACTIVE_RUN_LENGTH(last_run_length) = 0;
+        ACTIVE_RUN_LENGTH(last_run_length) = 0;
+
+        icetSparseImageScanPixels(&in_data,
+                                  &inactive_before,
+                                  &active_till_next_runl,
+                                  NULL,
+                                  partition->num_pixels,
+                                  data->pixel_size,
+                                  &out_data,
+                                  &last_run_length);
+
+        if (last_run_length == (IceTVoid *)partition->first_run_length) {
+            partition->last_run_length = NULL;
+        } else {
+            partition->last_run_length = last_run_length;
+        }
+        partition->out_end = out_data;
+    }
+}
+
+void icetSparseImageInterlace(const IceTSparseImage in_image,
+                              IceTInt eventual_num_partitions,
+                              IceTEnum scratch_state_buffer,
+                              IceTSparseImage out_image)
+{
+    IceTSizeType num_pixels = icetSparseImageGetNumPixels(in_image);
+    IceTEnum color_format = icetSparseImageGetColorFormat(in_image);
+    IceTEnum depth_format = icetSparseImageGetDepthFormat(in_image);
+    IceTSizeType lower_partition_size = num_pixels/eventual_num_partitions;
+    IceTSizeType remaining_pixels = num_pixels%eventual_num_partitions;
+    IceTSizeType pixel_size;
+    IceTInt original_partition_idx;
+    IceTInt interlaced_partition_idx;
+    sparseImageInterlacePartition *partitions;
+    sparseImageInterlaceTaskData task_data;
+    const IceTVoid *in_data;
+    IceTByte *out_data;
+    IceTSizeType inactive_before;
+    IceTSizeType active_till_next_runl;
+    IceTVoid *last_run_length;
+    IceTSizeType last_active;
+
+    /* Special case, nothing to do. */
+    if (eventual_num_partitions < 2) {
+        icetSparseImageCopyPixels(in_image, 0, num_pixels, out_image);
+        return;
     }
 
     if (   (color_format != icetSparseImageGetColorFormat(out_image))
@@ -1977,28 +3416,19 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
 
     pixel_size = colorPixelSize(color_format) + depthPixelSize(depth_format);
 
-    {
-        IceTByte *buffer = icetGetStateBuffer(
-                              scratch_state_buffer,
-                                eventual_num_partitions*sizeof(IceTVoid*)
-                              + 2*eventual_num_partitions*sizeof(IceTSizeType));
-        in_data_array = (const IceTVoid **)buffer;
-        inactive_before_array
-            = (IceTSizeType *)(  buffer
-                               + eventual_num_partitions*sizeof(IceTVoid*));
-        active_till_next_runl_array
-            = inactive_before_array + eventual_num_partitions;
-    }
+    partitions = icetGetStateBuffer(
+                 scratch_state_buffer,
+                 eventual_num_partitions*sizeof(sparseImageInterlacePartition));
 
     /* Run through the input data and figure out where each interlaced
-       partition needs to read from. */
+       partition needs to read from and how much it will write. */
     in_data = ICET_IMAGE_DATA(in_image);
     inactive_before = 0;
     active_till_next_runl = 0;
     for (original_partition_idx = 0;
          original_partition_idx < eventual_num_partitions;
          original_partition_idx++) {
-        IceTSizeType pixels_to_skip;
+        sparseImageInterlacePartition *partition;
 
         BIT_REVERSE(interlaced_partition_idx,
                     original_partition_idx,
@@ -2006,27 +3436,23 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
         if (eventual_num_partitions <= interlaced_partition_idx) {
             interlaced_partition_idx = original_partition_idx;
         }
+        partition = partitions + interlaced_partition_idx;
 
-        pixels_to_skip = lower_partition_size;
+        partition->num_pixels = lower_partition_size;
         if (interlaced_partition_idx < remaining_pixels) {
-            pixels_to_skip += 1;
+            partition->num_pixels += 1;
         }
 
-        in_data_array[interlaced_partition_idx] = in_data;
-        inactive_before_array[interlaced_partition_idx] = inactive_before;
-        active_till_next_runl_array[interlaced_partition_idx]
-            = active_till_next_runl;
+        partition->in_data = in_data;
+        partition->inactive_before = inactive_before;
+        partition->active_till_next_runl = active_till_next_runl;
 
-        if (original_partition_idx < eventual_num_partitions-1) {
-            icetSparseImageScanPixels((const IceTVoid**)&in_data,
-                                      &inactive_before,
-                                      &active_till_next_runl,
-                                      NULL,
-                                      pixels_to_skip,
-                                      pixel_size,
-                                      NULL,
-                                      NULL);
-        }
+        icetSparseImageMeasurePixels((const IceTVoid**)&in_data,
+                                     &inactive_before,
+                                     &active_till_next_runl,
+                                     partition->num_pixels,
+                                     pixel_size,
+                                     partition);
     }
 
     /* Set up output image. */
@@ -2036,32 +3462,76 @@ void icetSparseImageInterlace(const IceTSparseImage in_image,
     out_data = ICET_IMAGE_DATA(out_image);
     INACTIVE_RUN_LENGTH(out_data) = 0;
     ACTIVE_RUN_LENGTH(out_data) = 0;
-    last_run_length = out_data;
-    out_data = (IceTByte*)out_data + RUN_LENGTH_SIZE;
+    out_data += RUN_LENGTH_SIZE;
 
+    /* Pick where each partition goes in the interlaced image.  A partition's
+       first run length merges with the last one written before it exactly
+       when copying them one after another would merge them. */
+    last_active = 0;
     for (interlaced_partition_idx = 0;
          interlaced_partition_idx < eventual_num_partitions;
          interlaced_partition_idx++) {
-        IceTSizeType pixels_left;
+        sparseImageInterlacePartition *partition
+            = partitions + interlaced_partition_idx;
+        IceTSizeType num_new_run_lengths;
+
+        partition->out_data = out_data;
+        partition->out_end = out_data;
+        if (partition->num_pixels < 1) { continue; }
+
+        partition->merge_first_run_length
+            = ((last_active == 0) || (partition->first_inactive == 0));
+        num_new_run_lengths = partition->num_run_lengths;
+        if (partition->merge_first_run_length) {
+            num_new_run_lengths--;
+        }
+        out_data += (  num_new_run_lengths*RUN_LENGTH_SIZE
+                     + partition->num_active*pixel_size );
 
-        pixels_left = lower_partition_size;
-        if (interlaced_partition_idx < remaining_pixels) {
-            pixels_left += 1;
+        if (   partition->merge_first_run_length
+            && (partition->num_run_lengths == 1) ) {
+            last_active += partition->last_active;
+        } else {
+            last_active = partition->last_active;
         }
+    }
 
-        in_data = in_data_array[interlaced_partition_idx];
-        inactive_before = inactive_before_array[interlaced_partition_idx];
-        active_till_next_runl
-            = active_till_next_runl_array[interlaced_partition_idx];
+    /* Copy the partitions, which no longer depend on each other. */
+    task_data.partitions = partitions;
+    task_data.pixel_size = pixel_size;
+    icetThreadParallelFor(
+              eventual_num_partitions,
+              (out_data - (IceTByte*)ICET_IMAGE_DATA(out_image))
+                  /eventual_num_partitions,
+              icetSparseImageInterlaceTask,
+              &task_data);
+
+    /* Fold in the run lengths that continue the previous partition. */
+    last_run_length = ICET_IMAGE_DATA(out_image);
+    for (interlaced_partition_idx = 0;
+         interlaced_partition_idx < eventual_num_partitions;
+         interlaced_partition_idx++) {
+        sparseImageInterlacePartition *partition
+            = partitions + interlaced_partition_idx;
 
-        icetSparseImageScanPixels((const IceTVoid **)&in_data,
-                                  &inactive_before,
-                                  &active_till_next_runl,
-                                  NULL,
-                                  pixels_left,
-                                  pixel_size,
-                                  (IceTVoid **)&out_data,
-                                  &last_run_length);
+        if (partition->num_pixels < 1) { continue; }
+
+        if (   (interlaced_partition_idx < eventual_num_partitions-1)
+            && (partition->out_end
+                != partitions[interlaced_partition_idx+1].out_data) ) {
+            icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                           "Interlaced partition has unexpected size.");
+        }
+
+        if (partition->merge_first_run_length) {
+            INACTIVE_RUN_LENGTH(last_run_length)
+                += INACTIVE_RUN_LENGTH(partition->first_run_length);
+            ACTIVE_RUN_LENGTH(last_run_length)
+                += ACTIVE_RUN_LENGTH(partition->first_run_length);
+        }
+        if (partition->last_run_length != NULL) {
+            last_run_length = partition->last_run_length;
+        }
     }
 
     icetSparseImageSetActualSize(out_image, out_data);
@@ -2123,6 +3593,44 @@ IceTSizeType icetGetInterlaceOffset(IceTInt partition_index,
     return 0;
 }
 
+void icetGetInterlaceOffsets(IceTInt eventual_num_partitions,
+                             IceTSizeType original_image_size,
+                             IceTSizeType *offsets)
+{
+    IceTSizeType lower_partition_size;
+    IceTSizeType remaining_pixels;
+    IceTSizeType offset;
+    IceTInt original_partition_idx;
+
+    icetTimingInterlaceBegin();
+
+    lower_partition_size = original_image_size/eventual_num_partitions;
+    remaining_pixels = original_image_size%eventual_num_partitions;
+
+    offset = 0;
+    for (original_partition_idx = 0;
+         original_partition_idx < eventual_num_partitions;
+         original_partition_idx++) {
+        IceTInt interlaced_partition_idx;
+
+        BIT_REVERSE(interlaced_partition_idx,
+                    original_partition_idx,
+                    eventual_num_partitions);
+        if (eventual_num_partitions <= interlaced_partition_idx) {
+            interlaced_partition_idx = original_partition_idx;
+        }
+
+        offsets[interlaced_partition_idx] = offset;
+
+        offset += lower_partition_size;
+        if (interlaced_partition_idx < remaining_pixels) {
+            offset += 1;
+        }
+    }
+
+    icetTimingInterlaceEnd();
+}
+
 void icetClearImage(IceTImage image)
 {
     IceTInt region[4] = {0, 0, 0, 0};
@@ -2203,8 +3711,18 @@ void icetGetTileImage(IceTInt tile, IceTImage image)
     height = viewports[4*tile+3];
     icetImageSetDimensions(image, width, height);
 
+    if (!icetSparseImageIsNull(prerenderedSparseImage())) {
+        /* Strategies that want a full tile get the sparse pixels expanded. */
+        IceTSparseImage tile_image
+            = icetGetStateBufferSparseImage(ICET_SPARSE_TILE_BUF,
+                                            width, height);
+        prerenderedSparseTile(tile, tile_image);
+        icetDecompressImage(tile_image, image);
+        return;
+    }
+
     rendered_image =
-            generateTile(tile, screen_viewport, target_viewport, image);
+            generateTile(tile, screen_viewport, target_viewport, image, NULL);
 
     icetTimingBufferReadBegin();
 
@@ -2228,6 +3746,100 @@ void icetGetTileImage(IceTInt tile, IceTImage image)
     icetTimingBufferReadEnd();
 }
 
+/* What compress needs to decide whether to store an image as one raw run of
+   active pixels.  Kept apart from the state so that worker threads can
+   compress. */
+typedef struct imageDenseInfoStruct {
+    IceTInt percent;
+    IceTUInt background_word;
+    IceTFloat background_color[4];
+} imageDenseInfo;
+
+/* Number of pixels sampled to estimate the fraction of active pixels. */
+#define DENSE_IMAGE_SAMPLES     1024
+
+static void imageDenseInfoGet(imageDenseInfo *info)
+{
+    icetGetIntegerv(ICET_DENSE_IMAGE_PERCENT, &info->percent);
+    if (icetIsEnabled(ICET_PREDICT_DEPTH)) {
+        /* Depths are predicted within runs of active pixels.  A stored hole
+           in the middle of a run would spoil the prediction of all of it. */
+        info->percent = 0;
+    }
+    icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD,
+                    (IceTInt *)&info->background_word);
+    icetGetFloatv(ICET_BACKGROUND_COLOR, info->background_color);
+}
+
+/* Returns true if the pixels to be compressed should be stored as one active
+   run.  The pixels are pixel_count pixels in rows of row_width that are
+   row_stride apart, starting offset pixels into image.  Inactive pixels are
+   then stored with the values that decompressing them gives, so this is only
+   possible in blending mode when the background is transparent black, which
+   blends with anything without changing it. */
+static IceTBoolean imageIsDense(const IceTImage image,
+                                IceTEnum composite_mode,
+                                const imageDenseInfo *info,
+                                IceTSizeType offset,
+                                IceTSizeType row_width,
+                                IceTSizeType row_stride,
+                                IceTSizeType pixel_count)
+{
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    const IceTFloat *depth = NULL;
+    const IceTUByte *color_ub = NULL;
+    const IceTFloat *color_f = NULL;
+    IceTSizeType stride;
+    IceTSizeType num_samples;
+    IceTSizeType num_active;
+    IceTSizeType i;
+
+    if ((info->percent < 1) || (pixel_count < 1)) { return ICET_FALSE; }
+
+    if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+        if (icetImageGetDepthFormat(image) != ICET_IMAGE_DEPTH_FLOAT) {
+            return ICET_FALSE;
+        }
+        depth = icetImageGetDepthcf(image);
+    } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
+        if (   (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE)
+            && (info->background_word == 0) ) {
+            color_ub = icetImageGetColorcub(image);
+        } else if (   (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+                   && (info->background_color[0] == 0.0f)
+                   && (info->background_color[1] == 0.0f)
+                   && (info->background_color[2] == 0.0f)
+                   && (info->background_color[3] == 0.0f) ) {
+            color_f = icetImageGetColorcf(image);
+        } else {
+            return ICET_FALSE;
+        }
+    } else {
+        return ICET_FALSE;
+    }
+
+    stride = pixel_count/DENSE_IMAGE_SAMPLES + 1;
+    num_samples = 0;
+    num_active = 0;
+    for (i = stride/2; i < pixel_count; i += stride) {
+        IceTSizeType pixel = (  offset
+                              + (i/row_width)*row_stride
+                              + i%row_width );
+        IceTBoolean active;
+        if (depth != NULL) {
+            active = (depth[pixel] < 1.0);
+        } else if (color_ub != NULL) {
+            active = (color_ub[4*pixel+3] != 0x00);
+        } else {
+            active = (color_f[4*pixel+3] != 0.0);
+        }
+        num_samples++;
+        if (active) { num_active++; }
+    }
+
+    return (100*num_active >= info->percent*num_samples);
+}
+
 void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
 {
     IceTInt screen_viewport[4], target_viewport[4];
@@ -2235,14 +3847,26 @@ void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
     const IceTInt *viewports;
     IceTSizeType width, height;
     IceTSizeType space_left, space_right, space_bottom, space_top;
+    renderStream stream;
 
     viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
     width = viewports[4*tile+2];
     height = viewports[4*tile+3];
     icetSparseImageSetDimensions(compressed_image, width, height);
 
+    if (!icetSparseImageIsNull(prerenderedSparseImage())) {
+        prerenderedSparseTile(tile, compressed_image);
+        return;
+    }
+
     raw_image = generateTile(tile, screen_viewport, target_viewport,
-                             icetImageNull());
+                             icetImageNull(), &stream);
+
+    if (stream != NULL) {
+        /* Most of the tile was compressed while it was rendered. */
+        renderStreamFinish(stream, compressed_image);
+        return;
+    }
 
     if ((target_viewport[2] < 1) || (target_viewport[3] < 1)) {
         /* Tile empty.  Just clear result. */
@@ -2274,6 +3898,210 @@ void icetGetCompressedTileImage(IceTInt tile, IceTSparseImage compressed_image)
 #include "compress_func_body.h"
 }
 
+typedef struct imageBlockPixelsTaskStruct {
+    const IceTByte *in_buffer;
+    IceTByte *out_buffer;
+    IceTSizeType pixel_size;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType block_size;
+    IceTBoolean to_blocked;
+} imageBlockPixelsTaskData;
+
+/* Moves the pixels of rows of blocks [begin,end) between scanline order and
+   block order.  In block order, the image is cut into block_size by
+   block_size blocks (smaller at the top and right edges).  The blocks are
+   laid out one after another, left to right and bottom to top, and the pixels
+   in each block are in scanline order within the block. */
+static void imageBlockPixelsTask(IceTSizeType begin,
+                                 IceTSizeType end,
+                                 IceTVoid *task_data)
+{
+    const imageBlockPixelsTaskData *data
+        = (const imageBlockPixelsTaskData *)task_data;
+    IceTSizeType pixel_size = data->pixel_size;
+    IceTSizeType width = data->width;
+    IceTSizeType block_size = data->block_size;
+    IceTSizeType block_row;
+
+    for (block_row = begin; block_row < end; block_row++) {
+        IceTSizeType y_start = block_row*block_size;
+        IceTSizeType block_height = MIN(block_size, data->height - y_start);
+        IceTSizeType x_start;
+
+        for (x_start = 0; x_start < width; x_start += block_size) {
+            IceTSizeType block_width = MIN(block_size, width - x_start);
+            IceTSizeType block_offset = y_start*width + x_start*block_height;
+            IceTSizeType y;
+
+            for (y = 0; y < block_height; y++) {
+                IceTSizeType scanline_index = (y_start + y)*width + x_start;
+                IceTSizeType block_index = block_offset + y*block_width;
+                if (data->to_blocked) {
+                    memcpy(data->out_buffer + block_index*pixel_size,
+                           data->in_buffer + scanline_index*pixel_size,
+                           block_width*pixel_size);
+                } else {
+                    memcpy(data->out_buffer + scanline_index*pixel_size,
+                           data->in_buffer + block_index*pixel_size,
+                           block_width*pixel_size);
+                }
+            }
+        }
+    }
+}
+
+static void imageBlockPixelsBuffer(const IceTVoid *in_buffer,
+                                   IceTVoid *out_buffer,
+                                   IceTSizeType pixel_size,
+                                   IceTSizeType width,
+                                   IceTSizeType height,
+                                   IceTSizeType block_size,
+                                   IceTBoolean to_blocked)
+{
+    imageBlockPixelsTaskData data;
+    data.in_buffer = in_buffer;
+    data.out_buffer = out_buffer;
+    data.pixel_size = pixel_size;
+    data.width = width;
+    data.height = height;
+    data.block_size = block_size;
+    data.to_blocked = to_blocked;
+    icetThreadParallelFor((height + block_size - 1)/block_size,
+                          block_size*width*pixel_size,
+                          imageBlockPixelsTask,
+                          &data);
+}
+
+static void imageBlockPixels(const IceTImage in_image,
+                             IceTImage out_image,
+                             IceTSizeType block_size)
+{
+    IceTSizeType width = icetImageGetWidth(in_image);
+    IceTSizeType height = icetImageGetHeight(in_image);
+    IceTSizeType pixel_size;
+
+    if (icetImageGetColorFormat(in_image) != ICET_IMAGE_COLOR_NONE) {
+        const IceTVoid *in_buffer
+            = icetImageGetColorConstVoid(in_image, &pixel_size);
+        imageBlockPixelsBuffer(in_buffer,
+                               icetImageGetColorVoid(out_image, NULL),
+                               pixel_size,
+                               width,
+                               height,
+                               block_size,
+                               ICET_TRUE);
+    }
+    if (icetImageGetDepthFormat(in_image) != ICET_IMAGE_DEPTH_NONE) {
+        const IceTVoid *in_buffer
+            = icetImageGetDepthConstVoid(in_image, &pixel_size);
+        imageBlockPixelsBuffer(in_buffer,
+                               icetImageGetDepthVoid(out_image, NULL),
+                               pixel_size,
+                               width,
+                               height,
+                               block_size,
+                               ICET_TRUE);
+    }
+}
+
+void icetGetBlockedCompressedTileImage(IceTInt tile,
+                                       IceTSizeType block_size,
+                                       IceTSparseImage compressed_image)
+{
+    IceTInt screen_viewport[4], target_viewport[4];
+    IceTImage raw_image;
+    IceTImage tile_image;
+    IceTImage blocked_image;
+    const IceTInt *viewports;
+    IceTSizeType width, height;
+
+    if (block_size < 1) {
+        icetGetCompressedTileImage(tile, compressed_image);
+        return;
+    }
+
+    viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
+    width = viewports[4*tile+2];
+    height = viewports[4*tile+3];
+
+    if (!icetSparseImageIsNull(prerenderedSparseImage())) {
+        tile_image
+            = icetGetStateBufferImage(ICET_PIXEL_BLOCK_BUF_0, width, height);
+        icetGetTileImage(tile, tile_image);
+        icetTimingBufferReadBegin();
+    } else {
+        raw_image = generateTile(tile, screen_viewport, target_viewport,
+                                 icetImageNull(), NULL);
+
+        if ((target_viewport[2] < 1) || (target_viewport[3] < 1)) {
+            /* Tile empty.  Just clear result. */
+            icetSparseImageSetDimensions(compressed_image, width, height);
+            icetClearSparseImage(compressed_image);
+            return;
+        }
+
+        /* Place the rendered pixels in a full tile before moving them into
+           blocks.  Unlike icetGetCompressedTileImage, the padding cannot be
+           written as whole runs because it is scattered over the blocks. */
+        icetTimingBufferReadBegin();
+        tile_image
+            = icetGetStateBufferImage(ICET_PIXEL_BLOCK_BUF_0, width, height);
+        icetImageCopyRegion(raw_image, screen_viewport,
+                            tile_image, target_viewport);
+        icetImageClearAroundRegion(tile_image, target_viewport);
+    }
+
+    blocked_image
+        = icetGetStateBufferImage(ICET_PIXEL_BLOCK_BUF_1, width, height);
+    imageBlockPixels(tile_image, blocked_image, block_size);
+    icetTimingBufferReadEnd();
+
+    icetCompressImage(blocked_image, compressed_image);
+}
+
+void icetImageUnblockPixels(IceTImage image, IceTSizeType block_size)
+{
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTSizeType pixel_size;
+    IceTVoid *blocked_buffer;
+
+    if ((block_size < 1) || icetImageIsNull(image)) { return; }
+
+    icetTimingCollectBegin();
+
+    /* Each buffer is copied aside and then moved back in scanline order. */
+    if (icetImageGetColorFormat(image) != ICET_IMAGE_COLOR_NONE) {
+        IceTVoid *color_buffer = icetImageGetColorVoid(image, &pixel_size);
+        blocked_buffer = icetGetStateBuffer(ICET_PIXEL_BLOCK_BUF_0,
+                                            width*height*pixel_size);
+        memcpy(blocked_buffer, color_buffer, width*height*pixel_size);
+        imageBlockPixelsBuffer(blocked_buffer,
+                               color_buffer,
+                               pixel_size,
+                               width,
+                               height,
+                               block_size,
+                               ICET_FALSE);
+    }
+    if (icetImageGetDepthFormat(image) != ICET_IMAGE_DEPTH_NONE) {
+        IceTVoid *depth_buffer = icetImageGetDepthVoid(image, &pixel_size);
+        blocked_buffer = icetGetStateBuffer(ICET_PIXEL_BLOCK_BUF_0,
+                                            width*height*pixel_size);
+        memcpy(blocked_buffer, depth_buffer, width*height*pixel_size);
+        imageBlockPixelsBuffer(blocked_buffer,
+                               depth_buffer,
+                               pixel_size,
+                               width,
+                               height,
+                               block_size,
+                               ICET_FALSE);
+    }
+
+    icetTimingCollectEnd();
+}
+
 void icetCompressImage(const IceTImage image,
                        IceTSparseImage compressed_image)
 {
@@ -2364,14 +4192,122 @@ void icetDecompressSubImageCorrectBackground(
 #include "decompress_func_body.h"
 }
 
-
+
+typedef struct imageCompositeTaskStruct {
+    IceTEnum composite_mode;
+    IceTEnum color_format;
+    int src_on_top;
+    const IceTVoid *src_color;
+    IceTVoid *dest_color;
+    const IceTFloat *src_depth;
+    IceTFloat *dest_depth;
+} imageCompositeTaskData;
+
+/* Composites pixels [begin,end).  The formats and composite mode are checked
+   before starting the task. */
+static void imageCompositeTask(IceTSizeType begin,
+                               IceTSizeType end,
+                               IceTVoid *task_data)
+{
+    const imageCompositeTaskData *data
+        = (const imageCompositeTaskData *)task_data;
+    IceTEnum color_format = data->color_format;
+    IceTSizeType i;
+
+    if (data->composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+        const IceTFloat *srcDepthBuffer = data->src_depth;
+        IceTFloat *destDepthBuffer = data->dest_depth;
+
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            const IceTUInt *srcColorBuffer = data->src_color;
+            IceTUInt *destColorBuffer = data->dest_color;
+            for (i = begin; i < end; i++) {
+                if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    destDepthBuffer[i] = srcDepthBuffer[i];
+                    destColorBuffer[i] = srcColorBuffer[i];
+                }
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            const IceTFloat *srcColorBuffer = data->src_color;
+            IceTFloat *destColorBuffer = data->dest_color;
+            for (i = begin; i < end; i++) {
+                if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    destDepthBuffer[i] = srcDepthBuffer[i];
+                    destColorBuffer[4*i+0] = srcColorBuffer[4*i+0];
+                    destColorBuffer[4*i+1] = srcColorBuffer[4*i+1];
+                    destColorBuffer[4*i+2] = srcColorBuffer[4*i+2];
+                    destColorBuffer[4*i+3] = srcColorBuffer[4*i+3];
+                }
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+            const IceTFloat *srcColorBuffer = data->src_color;
+            IceTFloat *destColorBuffer = data->dest_color;
+            for (i = begin; i < end; i++) {
+                if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    destDepthBuffer[i] = srcDepthBuffer[i];
+                    destColorBuffer[3*i+0] = srcColorBuffer[3*i+0];
+                    destColorBuffer[3*i+1] = srcColorBuffer[3*i+1];
+                    destColorBuffer[3*i+2] = srcColorBuffer[3*i+2];
+                }
+            }
+        } else /* color_format == ICET_IMAGE_COLOR_NONE */ {
+            for (i = begin; i < end; i++) {
+                if (srcDepthBuffer[i] < destDepthBuffer[i]) {
+                    destDepthBuffer[i] = srcDepthBuffer[i];
+                }
+            }
+        }
+    } else /* composite_mode == ICET_COMPOSITE_MODE_BLEND */ {
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            const IceTUByte *srcColorBuffer = data->src_color;
+            IceTUByte *destColorBuffer = data->dest_color;
+            if (data->src_on_top) {
+                for (i = begin; i < end; i++) {
+                    ICET_OVER_UBYTE(srcColorBuffer + i*4,
+                                    destColorBuffer + i*4);
+                }
+            } else {
+                for (i = begin; i < end; i++) {
+                    ICET_UNDER_UBYTE(srcColorBuffer + i*4,
+                                     destColorBuffer + i*4);
+                }
+            }
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            const IceTFloat *srcColorBuffer = data->src_color;
+            IceTFloat *destColorBuffer = data->dest_color;
+            if (data->src_on_top) {
+                for (i = begin; i < end; i++) {
+                    ICET_OVER_FLOAT(srcColorBuffer + i*4,
+                                    destColorBuffer + i*4);
+                }
+            } else {
+                for (i = begin; i < end; i++) {
+                    ICET_UNDER_FLOAT(srcColorBuffer + i*4,
+                                     destColorBuffer + i*4);
+                }
+            }
+        } else /* color_format == ICET_IMAGE_COLOR_RGB_FLOAT */ {
+            const IceTFloat *srcColorBuffer = data->src_color;
+            IceTFloat *destColorBuffer = data->dest_color;
+            if (data->src_on_top) {
+                for (i = begin; i < end; i++) {
+                    destColorBuffer[3*i+0] = srcColorBuffer[3*i+0];
+                    destColorBuffer[3*i+1] = srcColorBuffer[3*i+1];
+                    destColorBuffer[3*i+2] = srcColorBuffer[3*i+2];
+                }
+            }
+        }
+    }
+}
+
 void icetComposite(IceTImage destBuffer, const IceTImage srcBuffer,
                    int srcOnTop)
 {
     IceTSizeType pixels;
-    IceTSizeType i;
     IceTEnum composite_mode;
     IceTEnum color_format, depth_format;
+    imageCompositeTaskData data;
+    IceTSizeType pixel_bytes;
 
     pixels = icetImageGetNumPixels(destBuffer);
     if (pixels != icetImageGetNumPixels(srcBuffer)) {
@@ -2393,64 +4329,27 @@ void icetComposite(IceTImage destBuffer, const IceTImage srcBuffer,
 
     icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
 
-    icetTimingBlendBegin();
+    if (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+        && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_RGB_FLOAT)
+        && (color_format != ICET_IMAGE_COLOR_NONE) ) {
+        icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                       "Encountered invalid color format 0x%X.",
+                       color_format);
+        return;
+    }
 
     if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
-        if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
-            const IceTFloat *srcDepthBuffer = icetImageGetDepthf(srcBuffer);
-            IceTFloat *destDepthBuffer = icetImageGetDepthf(destBuffer);
-
-            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-                const IceTUInt *srcColorBuffer=icetImageGetColorui(srcBuffer);
-                IceTUInt *destColorBuffer = icetImageGetColorui(destBuffer);
-                for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
-                        destDepthBuffer[i] = srcDepthBuffer[i];
-                        destColorBuffer[i] = srcColorBuffer[i];
-                    }
-                }
-            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-                const IceTFloat *srcColorBuffer = icetImageGetColorf(srcBuffer);
-                IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
-                for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
-                        destDepthBuffer[i] = srcDepthBuffer[i];
-                        destColorBuffer[4*i+0] = srcColorBuffer[4*i+0];
-                        destColorBuffer[4*i+1] = srcColorBuffer[4*i+1];
-                        destColorBuffer[4*i+2] = srcColorBuffer[4*i+2];
-                        destColorBuffer[4*i+3] = srcColorBuffer[4*i+3];
-                    }
-                }
-            } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
-                const IceTFloat *srcColorBuffer = icetImageGetColorf(srcBuffer);
-                IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
-                for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
-                        destDepthBuffer[i] = srcDepthBuffer[i];
-                        destColorBuffer[3*i+0] = srcColorBuffer[3*i+0];
-                        destColorBuffer[3*i+1] = srcColorBuffer[3*i+1];
-                        destColorBuffer[3*i+2] = srcColorBuffer[3*i+2];
-                    }
-                }
-            } else if (color_format == ICET_IMAGE_COLOR_NONE) {
-                for (i = 0; i < pixels; i++) {
-                    if (srcDepthBuffer[i] < destDepthBuffer[i]) {
-                        destDepthBuffer[i] = srcDepthBuffer[i];
-                    }
-                }
-            } else {
-                icetRaiseError(ICET_SANITY_CHECK_FAIL,
-                               "Encountered invalid color format 0x%X.",
-                               color_format);
-            }
-        } else if (depth_format == ICET_IMAGE_DEPTH_NONE) {
+        if (depth_format == ICET_IMAGE_DEPTH_NONE) {
             icetRaiseError(ICET_INVALID_OPERATION,
                            "Cannot use Z buffer compositing operation with no"
                            " Z buffer.");
-        } else {
+            return;
+        } else if (depth_format != ICET_IMAGE_DEPTH_FLOAT) {
             icetRaiseError(ICET_SANITY_CHECK_FAIL,
                            "Encountered invalid depth format 0x%X.",
                            depth_format);
+            return;
         }
     } else if (composite_mode == ICET_COMPOSITE_MODE_BLEND) {
         if (depth_format != ICET_IMAGE_DEPTH_NONE) {
@@ -2458,59 +4357,48 @@ void icetComposite(IceTImage destBuffer, const IceTImage srcBuffer,
                              "Z buffer ignored during blend composite"
                              " operation.  Output z buffer meaningless.");
         }
-        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-            const IceTUByte *srcColorBuffer = icetImageGetColorcub(srcBuffer);
-            IceTUByte *destColorBuffer = icetImageGetColorub(destBuffer);
-            if (srcOnTop) {
-                for (i = 0; i < pixels; i++) {
-                    ICET_OVER_UBYTE(srcColorBuffer + i*4,
-                                    destColorBuffer + i*4);
-                }
-            } else {
-                for (i = 0; i < pixels; i++) {
-                    ICET_UNDER_UBYTE(srcColorBuffer + i*4,
-                                     destColorBuffer + i*4);
-                }
-            }
-        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-            const IceTFloat *srcColorBuffer = icetImageGetColorcf(srcBuffer);
-            IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
-            if (srcOnTop) {
-                for (i = 0; i < pixels; i++) {
-                    ICET_OVER_FLOAT(srcColorBuffer + i*4,
-                                    destColorBuffer + i*4);
-                }
-            } else {
-                for (i = 0; i < pixels; i++) {
-                    ICET_UNDER_FLOAT(srcColorBuffer + i*4,
-                                     destColorBuffer + i*4);
-                }
-            }
-        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
-            const IceTFloat *srcColorBuffer = icetImageGetColorf(srcBuffer);
-            IceTFloat *destColorBuffer = icetImageGetColorf(destBuffer);
+        if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
             icetRaiseWarning(ICET_INVALID_VALUE,
                              "No alpha channel for blending. "
                              "On top image used.");
-            if (srcOnTop) {
-                for (i = 0; i < pixels; i++) {
-                    destColorBuffer[3*i+0] = srcColorBuffer[3*i+0];
-                    destColorBuffer[3*i+1] = srcColorBuffer[3*i+1];
-                    destColorBuffer[3*i+2] = srcColorBuffer[3*i+2];
-                }
-            }
         } else if (color_format == ICET_IMAGE_COLOR_NONE) {
             icetRaiseWarning(ICET_INVALID_OPERATION,
                              "Compositing image with no data.");
-        } else {
-            icetRaiseError(ICET_SANITY_CHECK_FAIL,
-                           "Encountered invalid color format.");
+            return;
         }
     } else {
         icetRaiseError(ICET_SANITY_CHECK_FAIL,
                        "Encountered invalid composite mode.");
+        return;
+    }
+
+    data.composite_mode = composite_mode;
+    data.color_format = color_format;
+    data.src_on_top = srcOnTop;
+    pixel_bytes = 0;
+    if (color_format != ICET_IMAGE_COLOR_NONE) {
+        IceTSizeType color_pixel_size;
+        data.src_color = icetImageGetColorConstVoid(srcBuffer,
+                                                    &color_pixel_size);
+        data.dest_color = icetImageGetColorVoid(destBuffer, NULL);
+        pixel_bytes += 2*color_pixel_size;
+    } else {
+        data.src_color = NULL;
+        data.dest_color = NULL;
+    }
+    if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+        data.src_depth = icetImageGetDepthcf(srcBuffer);
+        data.dest_depth = icetImageGetDepthf(destBuffer);
+        pixel_bytes += 2*sizeof(IceTFloat);
+    } else {
+        data.src_depth = NULL;
+        data.dest_depth = NULL;
     }
 
+    icetTimingBlendBegin();
+
+    icetThreadParallelFor(pixels, pixel_bytes, imageCompositeTask, &data);
+
     icetTimingBlendEnd();
 }
 
@@ -2580,11 +4468,44 @@ void icetCompressedCompressedComposite(const IceTSparseImage front_buffer,
     icetTimingBlendEnd();
 }
 
+typedef struct imageCorrectBackgroundTaskStruct {
+    IceTEnum color_format;
+    IceTVoid *color_buffer;
+    IceTUByte background_color_ub[4];
+    IceTFloat background_color_f[4];
+} imageCorrectBackgroundTaskData;
+
+static void imageCorrectBackgroundTask(IceTSizeType begin,
+                                       IceTSizeType end,
+                                       IceTVoid *task_data)
+{
+    const imageCorrectBackgroundTaskData *data
+        = (const imageCorrectBackgroundTaskData *)task_data;
+    IceTSizeType p;
+
+    if (data->color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUByte *color = (IceTUByte *)data->color_buffer + 4*begin;
+        const IceTUByte *bc = data->background_color_ub;
+        for (p = begin; p < end; p++) {
+            ICET_UNDER_UBYTE(bc, color);
+            color += 4;
+        }
+    } else /* color_format == ICET_IMAGE_COLOR_RGBA_FLOAT */ {
+        IceTFloat *color = (IceTFloat *)data->color_buffer + 4*begin;
+        const IceTFloat *background_color = data->background_color_f;
+        for (p = begin; p < end; p++) {
+            ICET_UNDER_FLOAT(background_color, color);
+            color += 4;
+        }
+    }
+}
+
 void icetImageCorrectBackground(IceTImage image)
 {
     IceTBoolean need_correction;
     IceTSizeType num_pixels;
     IceTEnum color_format;
+    imageCorrectBackgroundTaskData data;
 
     icetGetBooleanv(ICET_NEED_BACKGROUND_CORRECTION, &need_correction);
     if (!need_correction) { return; }
@@ -2594,31 +4515,23 @@ void icetImageCorrectBackground(IceTImage image)
 
     icetTimingBlendBegin();
 
+    data.color_format = color_format;
     if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
-        IceTUByte *color = icetImageGetColorub(image);
         IceTInt background_color_word;
-        IceTUByte *bc;
-        IceTSizeType p;
 
         icetGetIntegerv(ICET_TRUE_BACKGROUND_COLOR_WORD,
                         &background_color_word);
-        bc = (IceTUByte *)(&background_color_word);
+        memcpy(data.background_color_ub, &background_color_word, 4);
+        data.color_buffer = icetImageGetColorub(image);
 
-        for (p = 0; p < num_pixels; p++) {
-            ICET_UNDER_UBYTE(bc, color);
-            color += 4;
-        }
+        icetThreadParallelFor(num_pixels, 4,
+                              imageCorrectBackgroundTask, &data);
     } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
-        IceTFloat *color = icetImageGetColorf(image);
-        IceTFloat background_color[4];
-        IceTSizeType p;
+        icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, data.background_color_f);
+        data.color_buffer = icetImageGetColorf(image);
 
-        icetGetFloatv(ICET_TRUE_BACKGROUND_COLOR, background_color);
-
-        for (p = 0; p < num_pixels; p++) {
-            ICET_UNDER_FLOAT(background_color, color);
-            color += 4;
-        }
+        icetThreadParallelFor(num_pixels, 4*sizeof(IceTFloat),
+                              imageCorrectBackgroundTask, &data);
     } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
       /* Nothing to fix. */
     } else {
@@ -2656,27 +4569,34 @@ void icetClearImageTrueBackground(IceTImage image)
 static IceTImage generateTile(int tile,
                               IceTInt *screen_viewport,
                               IceTInt *target_viewport,
-                              IceTImage tile_buffer)
+                              IceTImage tile_buffer,
+                              renderStream *stream_p)
 {
     IceTBoolean use_prerender;
+    if (stream_p != NULL) { *stream_p = NULL; }
     icetGetBooleanv(ICET_PRE_RENDERED, &use_prerender);
     if (use_prerender) {
         return prerenderedTile(tile, screen_viewport, target_viewport);
     } else {
-        return renderTile(tile, screen_viewport, target_viewport, tile_buffer);
+        return renderTile(tile, screen_viewport, target_viewport, tile_buffer,
+                          stream_p);
     }
 }
 
 static IceTImage renderTile(int tile,
                             IceTInt *screen_viewport,
                             IceTInt *target_viewport,
-                            IceTImage tile_buffer)
+                            IceTImage tile_buffer,
+                            renderStream *stream_p)
 {
     const IceTInt *contained_viewport;
     const IceTInt *tile_viewport;
     const IceTBoolean *contained_mask;
+    IceTInt tile_contained_viewport[4];
     IceTInt physical_width, physical_height;
+    IceTInt render_width, render_height;
     IceTBoolean use_floating_viewport;
+    IceTBoolean use_single_pass;
     IceTDrawCallbackType drawfunc;
     IceTVoid *value;
     IceTInt readback_viewport[4];
@@ -2690,9 +4610,13 @@ static IceTImage renderTile(int tile,
     tile_viewport = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*tile;
     contained_mask = icetUnsafeStateGetBoolean(ICET_CONTAINED_TILES_MASK);
     use_floating_viewport = icetIsEnabled(ICET_FLOATING_VIEWPORT);
+    use_single_pass = icetIsEnabled(ICET_SINGLE_RENDER_PASS);
+    getTileContainedViewport(tile, tile_contained_viewport);
 
     icetGetIntegerv(ICET_PHYSICAL_RENDER_WIDTH, &physical_width);
     icetGetIntegerv(ICET_PHYSICAL_RENDER_HEIGHT, &physical_height);
+    render_width = physical_width;
+    render_height = physical_height;
 
     icetRaiseDebug("contained viewport: %d %d %d %d",
                    (int)contained_viewport[0], (int)contained_viewport[1],
@@ -2700,14 +4624,17 @@ static IceTImage renderTile(int tile,
     icetRaiseDebug("tile viewport: %d %d %d %d",
                    (int)tile_viewport[0], (int)tile_viewport[1],
                    (int)tile_viewport[2], (int)tile_viewport[3]);
+    icetRaiseDebug("contained region of tile: %d %d %d %d",
+                   (int)tile_contained_viewport[0],
+                   (int)tile_contained_viewport[1],
+                   (int)tile_contained_viewport[2],
+                   (int)tile_contained_viewport[3]);
 
     render_buffer = tile_buffer;
 
     if (   !contained_mask[tile]
-        || (contained_viewport[0] + contained_viewport[2] < tile_viewport[0])
-        || (contained_viewport[1] + contained_viewport[3] < tile_viewport[1])
-        || (contained_viewport[0] > tile_viewport[0] + tile_viewport[2])
-        || (contained_viewport[1] > tile_viewport[1] + tile_viewport[3]) ) {
+        || (tile_contained_viewport[2] < 1)
+        || (tile_contained_viewport[3] < 1) ) {
       /* Case 0: geometry completely outside tile. */
         icetRaiseDebug("Case 0: geometry completely outside tile.");
         readback_viewport[0] = screen_viewport[0] = target_viewport[0] = 0;
@@ -2734,55 +4661,33 @@ static IceTImage renderTile(int tile,
         icetProjectTile(tile, projection_matrix);
         icetStateSetIntegerv(ICET_RENDERED_VIEWPORT, 4, tile_viewport);
         screen_viewport[0] = target_viewport[0]
-            = contained_viewport[0] - tile_viewport[0];
+            = tile_contained_viewport[0] - tile_viewport[0];
         screen_viewport[1] = target_viewport[1]
-            = contained_viewport[1] - tile_viewport[1];
-        screen_viewport[2] = target_viewport[2] = contained_viewport[2];
-        screen_viewport[3] = target_viewport[3] = contained_viewport[3];
+            = tile_contained_viewport[1] - tile_viewport[1];
+        screen_viewport[2] = target_viewport[2] = tile_contained_viewport[2];
+        screen_viewport[3] = target_viewport[3] = tile_contained_viewport[3];
 
         readback_viewport[0] = screen_viewport[0];
         readback_viewport[1] = screen_viewport[1];
         readback_viewport[2] = screen_viewport[2];
         readback_viewport[3] = screen_viewport[3];
 #endif
-    } else if (   !use_floating_viewport
-               || (contained_viewport[2] > physical_width)
-               || (contained_viewport[3] > physical_height) ) {
+    } else if (   !use_single_pass
+               && (   !use_floating_viewport
+                   || (contained_viewport[2] > physical_width)
+                   || (contained_viewport[3] > physical_height) ) ) {
       /* Case 2: Can't use floating viewport due to use selection or image
          does not fit. */
         icetRaiseDebug("Case 2: Can't use floating viewport.");
 
         icetProjectTile(tile, projection_matrix);
         icetStateSetIntegerv(ICET_RENDERED_VIEWPORT, 4, tile_viewport);
-        if (contained_viewport[0] <= tile_viewport[0]) {
-            screen_viewport[0] = target_viewport[0] = 0;
-            screen_viewport[2] = target_viewport[2]
-                = MIN(tile_viewport[2],
-                      contained_viewport[0] + contained_viewport[2]
-                      - tile_viewport[0]);
-        } else {
-            screen_viewport[0] = target_viewport[0]
-                = contained_viewport[0] - tile_viewport[0];
-            screen_viewport[2] = target_viewport[2]
-                = MIN(contained_viewport[2],
-                      tile_viewport[0] + tile_viewport[2]
-                      - contained_viewport[0]);
-        }
-
-        if (contained_viewport[1] <= tile_viewport[1]) {
-            screen_viewport[1] = target_viewport[1] = 0;
-            screen_viewport[3] = target_viewport[3]
-                = MIN(tile_viewport[3],
-                      contained_viewport[1] + contained_viewport[3]
-                      - tile_viewport[1]);
-        } else {
-            screen_viewport[1] = target_viewport[1]
-                = contained_viewport[1] - tile_viewport[1];
-            screen_viewport[3] = target_viewport[3]
-                = MIN(contained_viewport[3],
-                      tile_viewport[1] + tile_viewport[3]
-                      - contained_viewport[1]);
-        }
+        screen_viewport[0] = target_viewport[0]
+            = tile_contained_viewport[0] - tile_viewport[0];
+        screen_viewport[1] = target_viewport[1]
+            = tile_contained_viewport[1] - tile_viewport[1];
+        screen_viewport[2] = target_viewport[2] = tile_contained_viewport[2];
+        screen_viewport[3] = target_viewport[3] = tile_contained_viewport[3];
 
         readback_viewport[0] = screen_viewport[0];
         readback_viewport[1] = screen_viewport[1];
@@ -2795,12 +4700,19 @@ static IceTImage renderTile(int tile,
         IceTInt rendered_viewport[4];
         icetRaiseDebug("Case 3: Using floating viewport.");
 
+      /* A single render pass covers all the contained tiles even when they
+         do not fit in the physical render size. */
+        if (use_single_pass) {
+            render_width = MAX(physical_width, contained_viewport[2]);
+            render_height = MAX(physical_height, contained_viewport[3]);
+        }
+
       /* This is the viewport in the global tiled display that we will be
          rendering. */
         rendered_viewport[0] = contained_viewport[0];
         rendered_viewport[1] = contained_viewport[1];
-        rendered_viewport[2] = physical_width;
-        rendered_viewport[3] = physical_height;
+        rendered_viewport[2] = render_width;
+        rendered_viewport[3] = render_height;
 
       /* This is the area that has valid pixels.  The screen_viewport will be a
          subset of this. */
@@ -2809,36 +4721,21 @@ static IceTImage renderTile(int tile,
         readback_viewport[2] = contained_viewport[2];
         readback_viewport[3] = contained_viewport[3];
 
-        if (contained_viewport[0] < tile_viewport[0]) {
-            screen_viewport[0] = tile_viewport[0] - contained_viewport[0];
-            screen_viewport[2] = MIN(contained_viewport[2] - screen_viewport[0],
-                                     tile_viewport[2]);
-            target_viewport[0] = 0;
-            target_viewport[2] = screen_viewport[2];
-        } else {
-            target_viewport[0] = contained_viewport[0] - tile_viewport[0];
-            target_viewport[2] = MIN(tile_viewport[2] - target_viewport[0],
-                                     contained_viewport[2]);
-            screen_viewport[0] = 0;
-            screen_viewport[2] = target_viewport[2];
-        }
-        if (contained_viewport[1] < tile_viewport[1]) {
-            screen_viewport[1] = tile_viewport[1] - contained_viewport[1];
-            screen_viewport[3] = MIN(contained_viewport[3] - screen_viewport[1],
-                                     tile_viewport[3]);
-            target_viewport[1] = 0;
-            target_viewport[3] = screen_viewport[3];
-        } else {
-            target_viewport[1] = contained_viewport[1] - tile_viewport[1];
-            target_viewport[3] = MIN(tile_viewport[3] - target_viewport[1],
-                                     contained_viewport[3]);
-            screen_viewport[1] = 0;
-            screen_viewport[3] = target_viewport[3];
-        }
+      /* The part of the tile we need is at the same place in the rendered
+         floating viewport. */
+        screen_viewport[0] = tile_contained_viewport[0] - contained_viewport[0];
+        screen_viewport[1] = tile_contained_viewport[1] - contained_viewport[1];
+        screen_viewport[2] = tile_contained_viewport[2];
+        screen_viewport[3] = tile_contained_viewport[3];
+
+        target_viewport[0] = tile_contained_viewport[0] - tile_viewport[0];
+        target_viewport[1] = tile_contained_viewport[1] - tile_viewport[1];
+        target_viewport[2] = tile_contained_viewport[2];
+        target_viewport[3] = tile_contained_viewport[3];
 
       /* Floating viewport must be stored in our own buffer so subsequent tiles
          can be read from it. */
-        render_buffer = getRenderBuffer();
+        render_buffer = getRenderBuffer(render_width, render_height);
 
       /* Check to see if we already rendered the floating viewport.  The whole
          point of the floating viewport is to do one actual render and reuse the
@@ -2876,15 +4773,25 @@ static IceTImage renderTile(int tile,
 
   /* Make sure that the current render_buffer is sized appropriately for the
      physical viewport.  If not, use our own buffer. */
-    if (    (icetImageGetWidth(render_buffer) != physical_width)
-         || (icetImageGetHeight(render_buffer) != physical_height) ) {
-        render_buffer = getRenderBuffer();
+    if (    (icetImageGetWidth(render_buffer) != render_width)
+         || (icetImageGetHeight(render_buffer) != render_height) ) {
+        render_buffer = getRenderBuffer(render_width, render_height);
     }
 
   /* Now we can actually start to render an image. */
     icetGetDoublev(ICET_MODELVIEW_MATRIX, modelview_matrix);
     icetGetFloatv(ICET_BACKGROUND_COLOR, background_color);
 
+  /* Let the renderer hand over finished blocks if it can. */
+    if ((stream_p != NULL) && (target_viewport[2] > 0)) {
+        *stream_p = renderStreamBegin(render_buffer,
+                                      tile_viewport[2],
+                                      tile_viewport[3],
+                                      screen_viewport,
+                                      target_viewport);
+        icetStateSetPointer(ICET_RENDER_STREAM, *stream_p);
+    }
+
   /* Draw the geometry. */
     icetGetPointerv(ICET_DRAW_FUNCTION, &value);
     drawfunc = (IceTDrawCallbackType)value;
@@ -2894,23 +4801,305 @@ static IceTImage renderTile(int tile,
                 readback_viewport, render_buffer);
     icetTimingRenderEnd();
 
+    if (stream_p != NULL) {
+        icetStateSetPointer(ICET_RENDER_STREAM, NULL);
+    }
+
     return render_buffer;
 }
 
+#define RENDER_STREAM_BAND_ROWS 16
+
+struct renderStreamStruct {
+    IceTThreadLock lock;
+    IceTImage render_buffer;
+    IceTEnum composite_mode;
+    imageDenseInfo dense_info;
+    IceTInt screen_viewport[4];
+    IceTInt target_viewport[4];
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTSizeType band_rows;
+    IceTSizeType num_bands;
+    IceTSizeType band_buffer_size;
+    /* Finished pixels in each row of screen_viewport.  Protected by lock. */
+    IceTSizeType *row_pixels;
+    /* Unfinished rows in each band.  Protected by lock. */
+    IceTSizeType *band_rows_left;
+    /* A sparse image for each band, band_buffer_size bytes apart. */
+    IceTByte *band_buffers;
+};
+
+static IceTSparseImage renderStreamBandImage(renderStream stream,
+                                             IceTSizeType band)
+{
+    IceTSparseImage band_image;
+    band_image.opaque_internals
+        = stream->band_buffers + band*stream->band_buffer_size;
+    return band_image;
+}
+
+static IceTSizeType renderStreamBandHeight(renderStream stream,
+                                           IceTSizeType band)
+{
+    IceTSizeType first_row = band*stream->band_rows;
+    return MIN(stream->band_rows, stream->screen_viewport[3] - first_row);
+}
+
+/* Compresses one band of rows of the render.  Runs on whatever thread
+   finished the band, so it must not touch the IceT state. */
+static void renderStreamCompressBand(renderStream stream, IceTSizeType band)
+{
+    IceTSparseImage band_image = renderStreamBandImage(stream, band);
+    IceTSizeType first_row = band*stream->band_rows;
+    IceTSizeType num_rows = renderStreamBandHeight(stream, band);
+
+#define INPUT_IMAGE             stream->render_buffer
+#define OUTPUT_SPARSE_IMAGE     band_image
+#define WORKER_THREAD
+#define COMPOSITE_MODE          stream->composite_mode
+#define DENSE_INFO              (&stream->dense_info)
+#define PADDING
+#define SPACE_BOTTOM            0
+#define SPACE_TOP               0
+#define SPACE_LEFT              stream->target_viewport[0]
+#define SPACE_RIGHT             (  stream->width                        \
+                                 - stream->target_viewport[0]           \
+                                 - stream->target_viewport[2])
+#define FULL_WIDTH              stream->width
+#define FULL_HEIGHT             num_rows
+#define REGION
+#define REGION_OFFSET_X         stream->screen_viewport[0]
+#define REGION_OFFSET_Y         (stream->screen_viewport[1] + first_row)
+#define REGION_WIDTH            stream->screen_viewport[2]
+#define REGION_HEIGHT           num_rows
+#include "compress_func_body.h"
+}
+
+static void renderStreamCompressTask(IceTSizeType begin,
+                                     IceTSizeType end,
+                                     IceTVoid *data)
+{
+    renderStream stream = (renderStream)data;
+    IceTSizeType band;
+
+    for (band = begin; band < end; band++) {
+        if (stream->band_rows_left[band] > 0) {
+            renderStreamCompressBand(stream, band);
+        }
+    }
+}
+
+static renderStream renderStreamBegin(IceTImage render_buffer,
+                                      IceTSizeType tile_width,
+                                      IceTSizeType tile_height,
+                                      const IceTInt *screen_viewport,
+                                      const IceTInt *target_viewport)
+{
+    IceTEnum color_format, depth_format;
+    IceTEnum composite_mode;
+    IceTSizeType row_bytes;
+    IceTSizeType band_rows, num_bands, band_buffer_size;
+    IceTSizeType arrays_size;
+    IceTByte *buffer;
+    renderStream stream;
+    IceTSizeType band;
+
+    if (!icetIsEnabled(ICET_STREAM_DRAW_BLOCKS)) { return NULL; }
+
+    /* Only stream the combinations that compress without raising errors or
+       warnings, since the bands are compressed on the renderer's threads. */
+    color_format = icetImageGetColorFormat(render_buffer);
+    depth_format = icetImageGetDepthFormat(render_buffer);
+    icetGetEnumv(ICET_COMPOSITE_MODE, &composite_mode);
+    if (composite_mode == ICET_COMPOSITE_MODE_Z_BUFFER) {
+        if (depth_format != ICET_IMAGE_DEPTH_FLOAT) { return NULL; }
+    } else {
+        if (   (depth_format != ICET_IMAGE_DEPTH_NONE)
+            || (   (color_format != ICET_IMAGE_COLOR_RGBA_UBYTE)
+                && (color_format != ICET_IMAGE_COLOR_RGBA_FLOAT) ) ) {
+            return NULL;
+        }
+    }
+
+    /* Bands are no bigger than a thread pool chunk and no taller than the
+       blocks of typical tile renderers so that they finish early. */
+    row_bytes = screen_viewport[2]*(  colorPixelSize(color_format)
+                                    + depthPixelSize(depth_format));
+    band_rows = ICET_THREAD_CHUNK_BYTES/row_bytes;
+    if (band_rows > RENDER_STREAM_BAND_ROWS) {
+        band_rows = RENDER_STREAM_BAND_ROWS;
+    }
+    if (band_rows < 1) { band_rows = 1; }
+    num_bands = (screen_viewport[3] + band_rows - 1)/band_rows;
+    band_buffer_size = icetSparseImageBufferSize(tile_width, band_rows);
+    band_buffer_size = 8*((band_buffer_size + 7)/8);
+    arrays_size = (screen_viewport[3] + num_bands)*sizeof(IceTSizeType);
+    arrays_size = 8*((arrays_size + 7)/8);
+
+    buffer = icetGetStateBuffer(ICET_RENDER_STREAM_BUF,
+                                8*((sizeof(struct renderStreamStruct)+7)/8)
+                                + arrays_size
+                                + num_bands*band_buffer_size);
+    stream = (renderStream)buffer;
+    buffer += 8*((sizeof(struct renderStreamStruct)+7)/8);
+
+    stream->lock = icetThreadLockCreate();
+    stream->render_buffer = render_buffer;
+    stream->composite_mode = composite_mode;
+    imageDenseInfoGet(&stream->dense_info);
+    memcpy(stream->screen_viewport, screen_viewport, 4*sizeof(IceTInt));
+    memcpy(stream->target_viewport, target_viewport, 4*sizeof(IceTInt));
+    stream->width = tile_width;
+    stream->height = tile_height;
+    stream->band_rows = band_rows;
+    stream->num_bands = num_bands;
+    stream->band_buffer_size = band_buffer_size;
+    stream->row_pixels = (IceTSizeType *)buffer;
+    stream->band_rows_left = stream->row_pixels + screen_viewport[3];
+    stream->band_buffers = buffer + arrays_size;
+
+    memset(stream->row_pixels, 0, screen_viewport[3]*sizeof(IceTSizeType));
+    for (band = 0; band < num_bands; band++) {
+        stream->band_rows_left[band] = renderStreamBandHeight(stream, band);
+        icetSparseImageAssignBuffer(
+                              stream->band_buffers + band*band_buffer_size,
+                              tile_width,
+                              stream->band_rows_left[band]);
+    }
+
+    return stream;
+}
+
+void icetDrawBlockFinished(const IceTInt *block_viewport)
+{
+    const IceTVoid **value;
+    renderStream stream;
+    const IceTInt *screen_viewport;
+    IceTSizeType x_begin, x_end, y_begin, y_end;
+    IceTSizeType band;
+
+    /* This may be called from any thread of the renderer while IceT waits in
+       the drawing callback, so the state is only read. */
+    value = icetUnsafeStateGetPointer(ICET_RENDER_STREAM);
+    stream = (renderStream)value[0];
+    if ((stream == NULL) || (block_viewport == NULL)) {
+        /* Not streaming.  The image is compressed after the callback. */
+        return;
+    }
+
+    /* Clip the block to the pixels that go into the tile. */
+    screen_viewport = stream->screen_viewport;
+    x_begin = MAX(block_viewport[0], screen_viewport[0]);
+    x_end = MIN(block_viewport[0] + block_viewport[2],
+                screen_viewport[0] + screen_viewport[2]);
+    y_begin = MAX(block_viewport[1], screen_viewport[1]) - screen_viewport[1];
+    y_end = MIN(block_viewport[1] + block_viewport[3],
+                screen_viewport[1] + screen_viewport[3]) - screen_viewport[1];
+    if ((x_end <= x_begin) || (y_end <= y_begin)) { return; }
+
+    for (band = y_begin/stream->band_rows;
+         band*stream->band_rows < y_end;
+         band++) {
+        IceTSizeType row_begin = MAX(y_begin, band*stream->band_rows);
+        IceTSizeType row_end = MIN(y_end, (band+1)*stream->band_rows);
+        IceTSizeType row;
+        IceTBoolean band_finished = ICET_FALSE;
+
+        icetThreadLockAcquire(stream->lock);
+        for (row = row_begin; row < row_end; row++) {
+            stream->row_pixels[row] += x_end - x_begin;
+            if (stream->row_pixels[row] == screen_viewport[2]) {
+                stream->band_rows_left[band]--;
+                band_finished = (stream->band_rows_left[band] == 0);
+            }
+        }
+        icetThreadLockRelease(stream->lock);
+
+        /* Exactly one call sees the last row of a band finish. */
+        if (band_finished) {
+            renderStreamCompressBand(stream, band);
+        }
+    }
+}
+
+static void renderStreamFinish(renderStream stream,
+                               IceTSparseImage compressed_image)
+{
+    IceTSizeType pixel_size;
+    IceTVoid *out_data;
+    IceTVoid *out_run_length;
+    IceTSizeType band;
+
+    icetTimingCompressBegin();
+
+    icetThreadLockDestroy(stream->lock);
+    stream->lock = NULL;
+
+    icetThreadParallelFor(stream->num_bands,
+                          stream->band_buffer_size,
+                          renderStreamCompressTask,
+                          stream);
+
+    pixel_size
+        = (  colorPixelSize(icetSparseImageGetColorFormat(compressed_image))
+           + depthPixelSize(icetSparseImageGetDepthFormat(compressed_image)));
+
+    out_run_length = ICET_IMAGE_DATA(compressed_image);
+    INACTIVE_RUN_LENGTH(out_run_length) = 0;
+    ACTIVE_RUN_LENGTH(out_run_length) = 0;
+    out_data = (IceTByte *)out_run_length + RUN_LENGTH_SIZE;
+
+    /* Rows below the region, then the bands, then the rows above. */
+    sparseImageAppendInactive(&out_data, &out_run_length,
+                              stream->target_viewport[1]*stream->width);
+    for (band = 0; band < stream->num_bands; band++) {
+        IceTSparseImage band_image = renderStreamBandImage(stream, band);
+        const IceTVoid *in_data = ICET_IMAGE_DATA(band_image);
+        IceTSizeType inactive_before = 0;
+        IceTSizeType active_till_next_runl = 0;
+
+        icetSparseImageScanPixels(&in_data,
+                                  &inactive_before,
+                                  &active_till_next_runl,
+                                  NULL,
+                                  icetSparseImageGetNumPixels(band_image),
+                                  pixel_size,
+                                  &out_data,
+                                  &out_run_length);
+    }
+    sparseImageAppendInactive(
+                &out_data, &out_run_length,
+                (  stream->height
+                 - stream->target_viewport[1]
+                 - stream->target_viewport[3])*stream->width);
+
+    icetSparseImageSetActualSize(compressed_image, out_data);
+
+    icetTimingCompressEnd();
+}
+
 static IceTImage prerenderedTile(int tile,
                                  IceTInt *screen_viewport,
                                  IceTInt *target_viewport)
 {
-    const IceTInt *contained_viewport;
+    prerenderedTileViewports(tile, screen_viewport, target_viewport);
+
+    return icetRetrieveStateImage(ICET_RENDER_BUFFER);
+}
+
+static void prerenderedTileViewports(int tile,
+                                     IceTInt *screen_viewport,
+                                     IceTInt *target_viewport)
+{
     const IceTInt *tile_viewport;
 
     icetRaiseDebug("Getting viewport for tile %d in prerendered image", tile);
-    contained_viewport = icetUnsafeStateGetInteger(ICET_CONTAINED_VIEWPORT);
     tile_viewport = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*tile;
 
     /* The screen viewport is the intersection of the tile viewport with the
      * contained viewport. */
-    icetIntersectViewports(tile_viewport, contained_viewport, screen_viewport);
+    getTileContainedViewport(tile, screen_viewport);
 
     /* The target viewport is the same width-height as the screen viewport.
      * It is offset by the same amount the screen viewport is offset from the
@@ -2919,11 +5108,180 @@ static IceTImage prerenderedTile(int tile,
     target_viewport[1] = screen_viewport[1] - tile_viewport[1];
     target_viewport[2] = screen_viewport[2];
     target_viewport[3] = screen_viewport[3];
+}
 
-    return icetRetrieveStateImage(ICET_RENDER_BUFFER);
+static IceTSparseImage prerenderedSparseImage(void)
+{
+    IceTSparseImage image;
+    IceTBoolean use_prerender;
+    IceTVoid *buffer;
+
+    image.opaque_internals = NULL;
+    icetGetBooleanv(ICET_PRE_RENDERED, &use_prerender);
+    if (!use_prerender) { return image; }
+
+    icetGetPointerv(ICET_PRE_RENDERED_SPARSE, &buffer);
+    image.opaque_internals = buffer;
+    return image;
+}
+
+/* Adds count inactive pixels to the end of a sparse image being built. */
+static void sparseImageAppendInactive(IceTVoid **out_data_p,
+                                      IceTVoid **out_run_length_p,
+                                      IceTSizeType count)
+{
+    if (count < 1) { return; }
+
+    if (ACTIVE_RUN_LENGTH(*out_run_length_p) > 0) {
+        IceTByte *out_data = *out_data_p;
+        *out_run_length_p = out_data;
+        INACTIVE_RUN_LENGTH(out_data) = 0;
+        ACTIVE_RUN_LENGTH(out_data) = 0;
+        *out_data_p = out_data + RUN_LENGTH_SIZE;
+    }
+    INACTIVE_RUN_LENGTH(*out_run_length_p) += count;
+}
+
+static void prerenderedSparseTile(int tile, IceTSparseImage compressed_image)
+{
+    IceTSparseImage in_image = prerenderedSparseImage();
+    IceTInt screen_viewport[4], target_viewport[4];
+    const IceTInt *tile_viewport;
+    IceTSizeType width, height;
+    IceTSizeType in_width;
+    IceTSizeType pixel_size;
+    const IceTVoid *in_data;
+    IceTSizeType inactive_before;
+    IceTSizeType active_till_next_runl;
+    IceTVoid *out_data;
+    IceTVoid *out_run_length;
+    IceTSizeType row;
+
+    tile_viewport = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*tile;
+    width = tile_viewport[2];
+    height = tile_viewport[3];
+    icetSparseImageSetDimensions(compressed_image, width, height);
+
+    prerenderedTileViewports(tile, screen_viewport, target_viewport);
+    if ((target_viewport[2] < 1) || (target_viewport[3] < 1)) {
+        icetClearSparseImage(compressed_image);
+        return;
+    }
+
+    icetTimingBufferReadBegin();
+
+    in_width = icetSparseImageGetWidth(in_image);
+    pixel_size
+        = (  colorPixelSize(icetSparseImageGetColorFormat(in_image))
+           + depthPixelSize(icetSparseImageGetDepthFormat(in_image)) );
+    in_data = ICET_IMAGE_DATA(in_image);
+    inactive_before = 0;
+    active_till_next_runl = 0;
+
+    out_run_length = ICET_IMAGE_DATA(compressed_image);
+    INACTIVE_RUN_LENGTH(out_run_length) = 0;
+    ACTIVE_RUN_LENGTH(out_run_length) = 0;
+    out_data = (IceTByte *)out_run_length + RUN_LENGTH_SIZE;
+
+    /* Rows below the region and the left of its first row. */
+    sparseImageAppendInactive(&out_data, &out_run_length,
+                              target_viewport[1]*width + target_viewport[0]);
+    icetSparseImageScanPixels(&in_data,
+                              &inactive_before,
+                              &active_till_next_runl,
+                              NULL,
+                              screen_viewport[1]*in_width + screen_viewport[0],
+                              pixel_size,
+                              NULL,
+                              NULL);
+
+    for (row = 0; row < screen_viewport[3]; row++) {
+        icetSparseImageScanPixels(&in_data,
+                                  &inactive_before,
+                                  &active_till_next_runl,
+                                  NULL,
+                                  screen_viewport[2],
+                                  pixel_size,
+                                  &out_data,
+                                  &out_run_length);
+        if (row + 1 < screen_viewport[3]) {
+            /* Right of this row and left of the next. */
+            sparseImageAppendInactive(&out_data, &out_run_length,
+                                      width - target_viewport[2]);
+            icetSparseImageScanPixels(&in_data,
+                                      &inactive_before,
+                                      &active_till_next_runl,
+                                      NULL,
+                                      in_width - screen_viewport[2],
+                                      pixel_size,
+                                      NULL,
+                                      NULL);
+        }
+    }
+
+    /* Right of the last row and the rows above the region. */
+    sparseImageAppendInactive(
+                &out_data, &out_run_length,
+                (width - target_viewport[0] - target_viewport[2])
+                + (height - target_viewport[1] - target_viewport[3])*width);
+
+    icetSparseImageSetActualSize(compressed_image, out_data);
+
+    icetTimingBufferReadEnd();
+}
+
+static void getTileContainedViewport(int tile,
+                                     IceTInt *tile_contained_viewport)
+{
+    const IceTInt *tile_viewport;
+    IceTInt num_contained_viewports;
+
+    tile_viewport = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*tile;
+    icetGetIntegerv(ICET_NUM_CONTAINED_VIEWPORTS, &num_contained_viewports);
+
+    if (num_contained_viewports < 2) {
+        icetIntersectViewports(
+                           tile_viewport,
+                           icetUnsafeStateGetInteger(ICET_CONTAINED_VIEWPORT),
+                           tile_contained_viewport);
+    } else {
+        const IceTInt *contained_viewports
+            = icetUnsafeStateGetInteger(ICET_CONTAINED_VIEWPORTS);
+        IceTInt min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+        IceTBoolean found = ICET_FALSE;
+        IceTInt i;
+
+        for (i = 0; i < num_contained_viewports; i++) {
+            IceTInt piece[4];
+            icetIntersectViewports(tile_viewport,
+                                   contained_viewports + 4*i,
+                                   piece);
+            if ((piece[2] < 1) || (piece[3] < 1)) { continue; }
+            if (!found) {
+                min_x = piece[0];  max_x = piece[0] + piece[2];
+                min_y = piece[1];  max_y = piece[1] + piece[3];
+                found = ICET_TRUE;
+            } else {
+                min_x = MIN(min_x, piece[0]);
+                min_y = MIN(min_y, piece[1]);
+                max_x = MAX(max_x, piece[0] + piece[2]);
+                max_y = MAX(max_y, piece[1] + piece[3]);
+            }
+        }
+
+        if (found) {
+            tile_contained_viewport[0] = min_x;
+            tile_contained_viewport[1] = min_y;
+            tile_contained_viewport[2] = max_x - min_x;
+            tile_contained_viewport[3] = max_y - min_y;
+        } else {
+            tile_contained_viewport[0] = tile_contained_viewport[1] = -1000000;
+            tile_contained_viewport[2] = tile_contained_viewport[3] = 0;
+        }
+    }
 }
 
-static IceTImage getRenderBuffer(void)
+static IceTImage getRenderBuffer(IceTInt width, IceTInt height)
 {
     /* Check to see if we are in the same frame as the last time we returned
        this buffer.  In that case, just restore the buffer because it still has
@@ -2932,12 +5290,7 @@ static IceTImage getRenderBuffer(void)
         > icetStateGetTime(ICET_IS_DRAWING_FRAME) ) {
         return icetRetrieveStateImage(ICET_RENDER_BUFFER);
     } else {
-        IceTInt dim[2];
-
-        icetGetIntegerv(ICET_PHYSICAL_RENDER_WIDTH, &dim[0]);
-        icetGetIntegerv(ICET_PHYSICAL_RENDER_HEIGHT, &dim[1]);
-
         /* Create a new image object. */
-        return icetGetStateBufferImage(ICET_RENDER_BUFFER, dim[0], dim[1]);
+        return icetGetStateBufferImage(ICET_RENDER_BUFFER, width, height);
     }
 }
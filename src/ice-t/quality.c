@@ -0,0 +1,503 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#include <IceTDevQuality.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+#include <IceTDevStrategySelect.h>
+
+/* Render scales the controller steps through, from full resolution down. */
+static const IceTDouble qualityScales[] = {
+    1.0, 0.875, 0.75, 0.625, 0.5, 0.375, 0.25
+};
+#define QUALITY_NUM_SCALES \
+    ((IceTInt)(sizeof(qualityScales)/sizeof(qualityScales[0])))
+
+/* Single image strategies the controller chooses from.  They all give the
+   same image, so the controller is free to pick the fastest. */
+static const IceTEnum qualityStrategies[] = {
+    ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+    ICET_SINGLE_IMAGE_STRATEGY_RADIXKR,
+    ICET_SINGLE_IMAGE_STRATEGY_BSWAP
+};
+#define QUALITY_NUM_STRATEGIES \
+    ((IceTInt)(sizeof(qualityStrategies)/sizeof(qualityStrategies[0])))
+
+/* Layout of ICET_QUALITY_HISTORY.  Rates are seconds per full resolution
+   frame (and per byte of pixel for compositing) and are negative until
+   measured. */
+#define QUALITY_LEVEL                   0
+#define QUALITY_RAISE_COUNT             1
+#define QUALITY_RENDER_RATE             2
+#define QUALITY_COMPOSITE_RATE          3
+#define QUALITY_STRATEGY_RATE_START     4
+#define QUALITY_HISTORY_SIZE (QUALITY_STRATEGY_RATE_START+QUALITY_NUM_STRATEGIES)
+
+/* Weight of the newest frame in the running averages of the rates. */
+#define QUALITY_SMOOTHING               0.5
+
+/* Quality is only raised a level once the better level is predicted to fit in
+   this fraction of the target for QUALITY_RAISE_FRAMES frames in a row.
+   Together with dropping quality as soon as the target is missed, this keeps
+   the controller from bouncing between two levels. */
+#define QUALITY_RAISE_FRACTION          0.75
+#define QUALITY_RAISE_FRAMES            3
+
+/* Another single image strategy must be this much faster than the current
+   one to replace it. */
+#define QUALITY_STRATEGY_MARGIN         0.9
+
+void icetTargetFrameTime(IceTDouble seconds)
+{
+    if (seconds < 0.0) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Target frame time must be nonnegative.");
+        return;
+    }
+
+    icetStateSetDouble(ICET_TARGET_FRAME_TIME, seconds);
+
+    /* Start over at full quality. */
+    icetStateSetDouble(ICET_RENDER_SCALE, 1.0);
+    icetStateSetBoolean(ICET_REDUCED_PRECISION, ICET_FALSE);
+    icetStateSetDoublev(ICET_QUALITY_HISTORY, 0, NULL);
+}
+
+static IceTBoolean qualityControllerOn(void)
+{
+    IceTDouble target;
+    icetGetDoublev(ICET_TARGET_FRAME_TIME, &target);
+    return (target > 0.0);
+}
+
+static IceTBoolean qualityIsFloatColor(IceTEnum color_format)
+{
+    return (   (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT)
+            || (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) );
+}
+
+static IceTDouble qualityPixelBytes(IceTEnum color_format,
+                                    IceTEnum depth_format)
+{
+    IceTDouble bytes = 0.0;
+
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_RGBA_UBYTE: bytes += 4;                 break;
+      case ICET_IMAGE_COLOR_RGBA_FLOAT: bytes += 4*sizeof(IceTFloat); break;
+      case ICET_IMAGE_COLOR_RGB_FLOAT:  bytes += 3*sizeof(IceTFloat); break;
+      default:                                                       break;
+    }
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        bytes += sizeof(IceTFloat);
+    }
+
+    return (bytes > 0.0) ? bytes : 1.0;
+}
+
+static IceTBoolean qualityUsesSingleImageStrategy(void)
+{
+    IceTEnum strategy;
+
+    icetGetEnumv(ICET_STRATEGY, &strategy);
+    return (   (strategy == ICET_STRATEGY_SEQUENTIAL)
+            || (strategy == ICET_STRATEGY_REDUCE)
+            || (strategy == ICET_STRATEGY_IN_TRANSIT) );
+}
+
+void icetQualityBeginFrame(void)
+{
+    IceTDouble render_scale;
+
+    icetStateSetIntegerv(ICET_FULL_TILE_VIEWPORTS, 0, NULL);
+    icetStateSetInteger(ICET_FULL_COLOR_FORMAT, ICET_IMAGE_COLOR_NONE);
+
+    if (!qualityControllerOn()) { return; }
+
+    /* Pre-rendered images come in at full size and in the application's
+       format, and uncollected pieces cannot be stretched back. */
+    if (   icetUnsafeStateGetBoolean(ICET_PRE_RENDERED)[0]
+        || !icetIsEnabled(ICET_COLLECT_IMAGES) ) {
+        return;
+    }
+
+    if (icetUnsafeStateGetBoolean(ICET_REDUCED_PRECISION)[0]) {
+        IceTEnum color_format;
+        icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+        if (qualityIsFloatColor(color_format)) {
+            icetStateSetInteger(ICET_FULL_COLOR_FORMAT, color_format);
+            icetStateSetInteger(ICET_COLOR_FORMAT,
+                                ICET_IMAGE_COLOR_RGBA_UBYTE);
+        }
+    }
+
+    icetGetDoublev(ICET_RENDER_SCALE, &render_scale);
+    if (render_scale < 1.0) {
+        IceTInt num_tiles;
+        IceTInt global_viewport[4];
+        IceTInt scaled_global_viewport[4];
+        const IceTInt *tile_viewports;
+        IceTInt *scaled_viewports;
+        IceTInt max_width, max_height;
+        IceTInt tile;
+
+        icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+        icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+        tile_viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
+
+        icetStateSetIntegerv(ICET_FULL_GLOBAL_VIEWPORT, 4, global_viewport);
+        icetStateSetIntegerv(ICET_FULL_TILE_VIEWPORTS, 4*num_tiles,
+                             tile_viewports);
+        tile_viewports = icetUnsafeStateGetInteger(ICET_FULL_TILE_VIEWPORTS);
+
+        /* Scale about the corner of the global viewport.  Edges are rounded
+           the same way for every tile, so tiles that share an edge still
+           do. */
+        scaled_viewports = icetStateAllocateInteger(ICET_TILE_VIEWPORTS,
+                                                    4*num_tiles);
+        max_width = max_height = 1;
+        for (tile = 0; tile < num_tiles; tile++) {
+            const IceTInt *full = tile_viewports + 4*tile;
+            IceTInt *scaled = scaled_viewports + 4*tile;
+            IceTInt x0 = (IceTInt)((full[0]-global_viewport[0])*render_scale);
+            IceTInt y0 = (IceTInt)((full[1]-global_viewport[1])*render_scale);
+            IceTInt x1 = (IceTInt)(  (full[0]+full[2]-global_viewport[0])
+                                   * render_scale );
+            IceTInt y1 = (IceTInt)(  (full[1]+full[3]-global_viewport[1])
+                                   * render_scale );
+            scaled[0] = global_viewport[0] + x0;
+            scaled[1] = global_viewport[1] + y0;
+            scaled[2] = (x1 > x0) ? x1 - x0 : 1;
+            scaled[3] = (y1 > y0) ? y1 - y0 : 1;
+            if (scaled[2] > max_width) { max_width = scaled[2]; }
+            if (scaled[3] > max_height) { max_height = scaled[3]; }
+        }
+
+        scaled_global_viewport[0] = global_viewport[0];
+        scaled_global_viewport[1] = global_viewport[1];
+        scaled_global_viewport[2] = (IceTInt)(global_viewport[2]*render_scale);
+        scaled_global_viewport[3] = (IceTInt)(global_viewport[3]*render_scale);
+        if (scaled_global_viewport[2] < 1) { scaled_global_viewport[2] = 1; }
+        if (scaled_global_viewport[3] < 1) { scaled_global_viewport[3] = 1; }
+        icetStateSetIntegerv(ICET_GLOBAL_VIEWPORT, 4, scaled_global_viewport);
+        icetStateSetInteger(ICET_TILE_MAX_WIDTH, max_width);
+        icetStateSetInteger(ICET_TILE_MAX_HEIGHT, max_height);
+
+        icetRaiseDebug("Drawing frame at %g scale.", render_scale);
+    }
+}
+
+IceTImage icetQualityFinishFrame(IceTImage image)
+{
+    IceTInt num_full_entries;
+    IceTEnum full_color_format;
+    IceTInt valid_tile;
+
+    num_full_entries = icetStateGetNumEntries(ICET_FULL_TILE_VIEWPORTS);
+    icetGetEnumv(ICET_FULL_COLOR_FORMAT, &full_color_format);
+    if ((num_full_entries < 1) && (full_color_format == ICET_IMAGE_COLOR_NONE)){
+        return image;
+    }
+
+    if (num_full_entries > 0) {
+        const IceTInt *full_viewports
+            = icetUnsafeStateGetInteger(ICET_FULL_TILE_VIEWPORTS);
+        IceTInt max_width, max_height;
+        IceTInt i;
+
+        max_width = max_height = 0;
+        for (i = 0; i < num_full_entries; i += 4) {
+            if (full_viewports[i+2] > max_width) {
+                max_width = full_viewports[i+2];
+            }
+            if (full_viewports[i+3] > max_height) {
+                max_height = full_viewports[i+3];
+            }
+        }
+        icetStateSetIntegerv(ICET_GLOBAL_VIEWPORT, 4,
+                             icetUnsafeStateGetInteger(
+                                                   ICET_FULL_GLOBAL_VIEWPORT));
+        icetStateSetIntegerv(ICET_TILE_VIEWPORTS, num_full_entries,
+                             full_viewports);
+        icetStateSetInteger(ICET_TILE_MAX_WIDTH, max_width);
+        icetStateSetInteger(ICET_TILE_MAX_HEIGHT, max_height);
+    }
+    if (full_color_format != ICET_IMAGE_COLOR_NONE) {
+        icetStateSetInteger(ICET_COLOR_FORMAT, full_color_format);
+    }
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+    if ((valid_tile < 0) || icetImageIsNull(image)) {
+        return image;
+    }
+
+    {
+        const IceTInt *tile_viewport
+            = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS) + 4*valid_tile;
+        IceTImage full_image
+            = icetGetStateBufferImage(ICET_FULL_SIZE_IMAGE_BUF,
+                                      tile_viewport[2],
+                                      tile_viewport[3]);
+        if (icetImageGetDepthFormat(image) == ICET_IMAGE_DEPTH_NONE) {
+            icetImageAdjustForOutput(full_image);
+        }
+        icetImageScalePixels(image, full_image);
+
+        icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
+        icetStateSetInteger(ICET_VALID_PIXELS_NUM,
+                            tile_viewport[2]*tile_viewport[3]);
+
+        return full_image;
+    }
+}
+
+/* Mixes a new measurement into a running average. */
+static void qualitySmooth(IceTDouble *average, IceTDouble sample)
+{
+    if (*average < 0.0) {
+        *average = sample;
+    } else {
+        *average = (  (1.0 - QUALITY_SMOOTHING)*(*average)
+                    + QUALITY_SMOOTHING*sample );
+    }
+}
+
+/* Quality levels go from full quality (0) to the cheapest.  When the color
+   precision may be lowered, that is the first step and every smaller scale
+   keeps it lowered. */
+static IceTInt qualityNumLevels(IceTBoolean adapt_precision)
+{
+    return QUALITY_NUM_SCALES + (adapt_precision ? 1 : 0);
+}
+
+static void qualityLevelSettings(IceTInt level,
+                                 IceTBoolean adapt_precision,
+                                 IceTDouble *scale,
+                                 IceTBoolean *reduced_precision)
+{
+    if (adapt_precision) {
+        *reduced_precision = (level > 0);
+        *scale = qualityScales[(level > 0) ? level - 1 : 0];
+    } else {
+        *reduced_precision = ICET_FALSE;
+        *scale = qualityScales[level];
+    }
+}
+
+static IceTDouble qualityPredict(IceTInt level,
+                                 IceTBoolean adapt_precision,
+                                 IceTDouble render_rate,
+                                 IceTDouble composite_rate,
+                                 IceTEnum color_format,
+                                 IceTEnum depth_format)
+{
+    IceTDouble scale;
+    IceTBoolean reduced_precision;
+    IceTDouble bytes;
+
+    qualityLevelSettings(level, adapt_precision, &scale, &reduced_precision);
+    bytes = qualityPixelBytes(reduced_precision ? ICET_IMAGE_COLOR_RGBA_UBYTE
+                                                : color_format,
+                              depth_format);
+    return scale*scale*(render_rate + composite_rate*bytes);
+}
+
+static IceTInt qualityStrategyIndex(IceTEnum strategy)
+{
+    IceTInt i;
+    for (i = 0; i < QUALITY_NUM_STRATEGIES; i++) {
+        if (qualityStrategies[i] == strategy) { return i; }
+    }
+    return -1;
+}
+
+void icetQualityUpdate(void)
+{
+    IceTDouble target;
+    IceTDouble local_times[2];
+    IceTDouble *all_times;
+    IceTDouble render_time, composite_time;
+    IceTInt num_proc;
+    IceTInt proc;
+    IceTDouble frame_scale;
+    IceTEnum color_format, depth_format;
+    IceTEnum frame_color_format;
+    IceTDouble *history;
+    IceTDouble composite_rate;
+    IceTBoolean adapt_precision;
+    IceTInt num_levels;
+    IceTInt level;
+    IceTInt fit_level;
+
+    icetGetDoublev(ICET_TARGET_FRAME_TIME, &target);
+    if (target <= 0.0) { return; }
+    if (icetUnsafeStateGetBoolean(ICET_FRAME_CANCELLED)[0]) { return; }
+
+    /* The slowest process sets the frame time, and every process must see
+       the same numbers to make the same choice. */
+    {
+        IceTDouble buffer_read_time;
+        icetGetDoublev(ICET_RENDER_TIME, &local_times[0]);
+        icetGetDoublev(ICET_BUFFER_READ_TIME, &buffer_read_time);
+        icetGetDoublev(ICET_COMPOSITE_TIME, &local_times[1]);
+        local_times[0] += buffer_read_time;
+    }
+    num_proc = icetCommSize();
+    all_times = icetStateAllocateDouble(ICET_QUALITY_FRAME_TIMES, 2*num_proc);
+    icetCommAllgather(local_times, 2, ICET_DOUBLE, all_times);
+    render_time = composite_time = 0.0;
+    for (proc = 0; proc < num_proc; proc++) {
+        if (all_times[2*proc+0] > render_time) {
+            render_time = all_times[2*proc+0];
+        }
+        if (all_times[2*proc+1] > composite_time) {
+            composite_time = all_times[2*proc+1];
+        }
+    }
+
+    /* Normalize to a full resolution frame with what this frame used. */
+    icetGetEnumv(ICET_COLOR_FORMAT, &color_format);
+    icetGetEnumv(ICET_DEPTH_FORMAT, &depth_format);
+    icetGetEnumv(ICET_FULL_COLOR_FORMAT, &frame_color_format);
+    if (frame_color_format != ICET_IMAGE_COLOR_NONE) {
+        frame_color_format = ICET_IMAGE_COLOR_RGBA_UBYTE;
+    } else {
+        frame_color_format = color_format;
+    }
+    if (icetStateGetNumEntries(ICET_FULL_TILE_VIEWPORTS) > 0) {
+        icetGetDoublev(ICET_RENDER_SCALE, &frame_scale);
+    } else {
+        frame_scale = 1.0;
+    }
+
+    if (icetStateGetNumEntries(ICET_QUALITY_HISTORY) != QUALITY_HISTORY_SIZE) {
+        IceTInt i;
+        history = icetStateAllocateDouble(ICET_QUALITY_HISTORY,
+                                          QUALITY_HISTORY_SIZE);
+        history[QUALITY_LEVEL] = 0.0;
+        history[QUALITY_RAISE_COUNT] = 0.0;
+        for (i = QUALITY_RENDER_RATE; i < QUALITY_HISTORY_SIZE; i++) {
+            history[i] = -1.0;
+        }
+    } else {
+        history = (IceTDouble *)icetUnsafeStateGetDouble(ICET_QUALITY_HISTORY);
+    }
+
+    qualitySmooth(&history[QUALITY_RENDER_RATE],
+                  render_time/(frame_scale*frame_scale));
+    {
+        IceTDouble sample
+            = composite_time/(  frame_scale*frame_scale
+                              * qualityPixelBytes(frame_color_format,
+                                                  depth_format) );
+        IceTInt slot = QUALITY_COMPOSITE_RATE;
+
+        if (qualityUsesSingleImageStrategy()) {
+            IceTEnum si_strategy;
+            IceTInt index;
+            icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &si_strategy);
+            index = qualityStrategyIndex(si_strategy);
+            if (index >= 0) { slot = QUALITY_STRATEGY_RATE_START + index; }
+        }
+        qualitySmooth(&history[slot], sample);
+        composite_rate = history[slot];
+    }
+
+    /* Pick the single image strategy: each is tried once, then the fastest is
+       kept unless the current one is close. */
+    if (qualityUsesSingleImageStrategy()) {
+        IceTEnum si_strategy;
+        IceTInt current;
+        IceTInt next;
+        IceTInt i;
+
+        icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &si_strategy);
+        current = qualityStrategyIndex(si_strategy);
+
+        next = -1;
+        for (i = 0; i < QUALITY_NUM_STRATEGIES; i++) {
+            if (history[QUALITY_STRATEGY_RATE_START + i] < 0.0) {
+                next = i;
+                break;
+            }
+        }
+        if (next < 0) {
+            IceTInt best = 0;
+            for (i = 1; i < QUALITY_NUM_STRATEGIES; i++) {
+                if (  history[QUALITY_STRATEGY_RATE_START + i]
+                    < history[QUALITY_STRATEGY_RATE_START + best] ) {
+                    best = i;
+                }
+            }
+            if (   (current < 0)
+                || (  history[QUALITY_STRATEGY_RATE_START + best]
+                    < (  QUALITY_STRATEGY_MARGIN
+                       * history[QUALITY_STRATEGY_RATE_START + current]) ) ) {
+                next = best;
+            } else {
+                next = current;
+            }
+            composite_rate = history[QUALITY_STRATEGY_RATE_START + next];
+        }
+        if (next != current) {
+            icetRaiseDebug("Switching to single image strategy %s.",
+                           icetSingleImageStrategyNameFromEnum(
+                                                      qualityStrategies[next]));
+            icetStateSetInteger(ICET_SINGLE_IMAGE_STRATEGY,
+                                qualityStrategies[next]);
+        }
+    }
+    if (composite_rate < 0.0) { composite_rate = 0.0; }
+
+    /* Pick the quality level. */
+    adapt_precision = (   icetIsEnabled(ICET_ADAPT_PRECISION)
+                       && qualityIsFloatColor(color_format) );
+    num_levels = qualityNumLevels(adapt_precision);
+    level = (IceTInt)history[QUALITY_LEVEL];
+    if (level >= num_levels) { level = num_levels - 1; }
+
+    for (fit_level = 0; fit_level < num_levels - 1; fit_level++) {
+        if (qualityPredict(fit_level, adapt_precision,
+                           history[QUALITY_RENDER_RATE], composite_rate,
+                           color_format, depth_format) <= target) {
+            break;
+        }
+    }
+
+    if (fit_level > level) {
+        /* Over budget: drop right away. */
+        level = fit_level;
+        history[QUALITY_RAISE_COUNT] = 0.0;
+    } else if (   (level > 0)
+               && (  qualityPredict(level - 1, adapt_precision,
+                                    history[QUALITY_RENDER_RATE],
+                                    composite_rate,
+                                    color_format, depth_format)
+                   <= QUALITY_RAISE_FRACTION*target) ) {
+        history[QUALITY_RAISE_COUNT] += 1.0;
+        if (history[QUALITY_RAISE_COUNT] >= QUALITY_RAISE_FRAMES) {
+            level--;
+            history[QUALITY_RAISE_COUNT] = 0.0;
+        }
+    } else {
+        history[QUALITY_RAISE_COUNT] = 0.0;
+    }
+    history[QUALITY_LEVEL] = (IceTDouble)level;
+
+    {
+        IceTDouble scale;
+        IceTBoolean reduced_precision;
+        qualityLevelSettings(level, adapt_precision,
+                             &scale, &reduced_precision);
+        icetStateSetDouble(ICET_RENDER_SCALE, scale);
+        icetStateSetBoolean(ICET_REDUCED_PRECISION, reduced_precision);
+    }
+}
@@ -31,6 +31,8 @@ struct IceTStateValue {
     IceTSizeType buffer_size;
     void *data;
     IceTTimeStamp mod_time;
+    /* Last time at least half of the buffer was asked for. */
+    IceTTimeStamp peak_time;
 };
 
 #ifdef ICET_STATE_CHECK_MEM
@@ -95,7 +97,17 @@ void icetStateCopy(IceTState dest, const IceTState src)
             || (pname == ICET_DATA_REPLICATION_GROUP)
             || (pname == ICET_DATA_REPLICATION_GROUP_SIZE)
             || (pname == ICET_COMPOSITE_ORDER)
-            || (pname == ICET_PROCESS_ORDERS) )
+            || (pname == ICET_PROCESS_ORDERS)
+            || (pname == ICET_COMPOSITOR_GROUP)
+            || (pname == ICET_COMPOSITOR_GROUP_SIZE) )
+        {
+            continue;
+        }
+
+        /* Each context owns these and frees them when it is destroyed, so
+           they must never be shared. */
+        if (   (pname == ICET_THREAD_POOL)
+            || (pname == ICET_IN_TRANSIT_COMMUNICATOR) )
         {
             continue;
         }
@@ -112,6 +124,7 @@ void icetStateCopy(IceTState dest, const IceTState src)
             stateFree(pname, dest);
         }
         dest[pname].mod_time = mod_time;
+        dest[pname].peak_time = mod_time;
     }
 }
 
@@ -143,6 +156,7 @@ void icetStateSetDefaults(void)
 
     icetStateSetDoublev(ICET_GEOMETRY_BOUNDS, 0, NULL);
     icetStateSetInteger(ICET_NUM_BOUNDING_VERTS, 0);
+    icetStateSetInteger(ICET_NUM_BOUNDING_GROUPS, 0);
     icetStateSetInteger(ICET_STRATEGY, ICET_STRATEGY_UNDEFINED);
     icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_AUTOMATIC);
     icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
@@ -157,6 +171,8 @@ void icetStateSetDefaults(void)
 
     icetStateSetInteger(ICET_DATA_REPLICATION_GROUP, comm_rank);
     icetStateSetInteger(ICET_DATA_REPLICATION_GROUP_SIZE, 1);
+    icetStateSetIntegerv(ICET_COMPOSITOR_GROUP, 0, NULL);
+    icetStateSetInteger(ICET_COMPOSITOR_GROUP_SIZE, 0);
     icetStateSetInteger(ICET_FRAME_COUNT, 0);
 
     if (icetGetEnv("ICET_MAGIC_K", env_buffer, ENV_BUFFER_LEN)) {
@@ -188,6 +204,126 @@ void icetStateSetDefaults(void)
         icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, ICET_MAX_IMAGE_SPLIT_DEFAULT);
     }
 
+    if (icetGetEnv("ICET_DIRECT_SEND_THRESHOLD", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt direct_send_threshold = atoi(env_buffer);
+        if (direct_send_threshold >= 0) {
+            icetStateSetInteger(ICET_DIRECT_SEND_THRESHOLD,
+                                direct_send_threshold);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_DIRECT_SEND_THRESHOLD"
+                           " must be set to a nonnegative integer.");
+            icetStateSetInteger(ICET_DIRECT_SEND_THRESHOLD,
+                                ICET_DIRECT_SEND_THRESHOLD_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_DIRECT_SEND_THRESHOLD,
+                            ICET_DIRECT_SEND_THRESHOLD_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_NUM_THREADS", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt num_threads = atoi(env_buffer);
+        if (num_threads > 0) {
+            icetStateSetInteger(ICET_NUM_THREADS, num_threads);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_NUM_THREADS must be"
+                           " set to a positive integer.");
+            icetStateSetInteger(ICET_NUM_THREADS, ICET_NUM_THREADS_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_NUM_THREADS, ICET_NUM_THREADS_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_PIXEL_BLOCK_SIZE", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt pixel_block_size = atoi(env_buffer);
+        if (pixel_block_size >= 0) {
+            icetStateSetInteger(ICET_PIXEL_BLOCK_SIZE, pixel_block_size);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_PIXEL_BLOCK_SIZE must be"
+                           " set to a nonnegative integer.");
+            icetStateSetInteger(ICET_PIXEL_BLOCK_SIZE,
+                                ICET_PIXEL_BLOCK_SIZE_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_PIXEL_BLOCK_SIZE,
+                            ICET_PIXEL_BLOCK_SIZE_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_BUFFER_RELEASE_FRAMES", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt release_frames = atoi(env_buffer);
+        if (release_frames >= 0) {
+            icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES, release_frames);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_BUFFER_RELEASE_FRAMES"
+                           " must be set to a nonnegative integer.");
+            icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES,
+                                ICET_BUFFER_RELEASE_FRAMES_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES,
+                            ICET_BUFFER_RELEASE_FRAMES_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_MEMORY_BUDGET", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt memory_budget = atoi(env_buffer);
+        if (memory_budget >= 0) {
+            icetStateSetInteger(ICET_MEMORY_BUDGET, memory_budget);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_MEMORY_BUDGET must be"
+                           " set to a nonnegative integer.");
+            icetStateSetInteger(ICET_MEMORY_BUDGET, ICET_MEMORY_BUDGET_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_MEMORY_BUDGET, ICET_MEMORY_BUDGET_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_DENSE_IMAGE_PERCENT", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt dense_image_percent = atoi(env_buffer);
+        if ((dense_image_percent >= 0) && (dense_image_percent <= 100)) {
+            icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, dense_image_percent);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_DENSE_IMAGE_PERCENT"
+                           " must be set to an integer from 0 to 100.");
+            icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT,
+                                ICET_DENSE_IMAGE_PERCENT_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT,
+                            ICET_DENSE_IMAGE_PERCENT_DEFAULT);
+    }
+
+    if (icetGetEnv("ICET_COMM_PROGRESS_INTERVAL", env_buffer, ENV_BUFFER_LEN)) {
+        IceTInt progress_interval = atoi(env_buffer);
+        if (progress_interval >= 0) {
+            icetStateSetInteger(ICET_COMM_PROGRESS_INTERVAL,
+                                progress_interval);
+        } else {
+            icetRaiseError(ICET_INVALID_VALUE,
+                           "Environment variable ICET_COMM_PROGRESS_INTERVAL"
+                           " must be set to a nonnegative integer.");
+            icetStateSetInteger(ICET_COMM_PROGRESS_INTERVAL,
+                                ICET_COMM_PROGRESS_INTERVAL_DEFAULT);
+        }
+    } else {
+        icetStateSetInteger(ICET_COMM_PROGRESS_INTERVAL,
+                            ICET_COMM_PROGRESS_INTERVAL_DEFAULT);
+    }
+
+    icetStateSetDouble(ICET_TARGET_FRAME_TIME, 0.0);
+    icetStateSetDouble(ICET_RENDER_SCALE, 1.0);
+    icetStateSetBoolean(ICET_REDUCED_PRECISION, ICET_FALSE);
+    icetStateSetDoublev(ICET_QUALITY_HISTORY, 0, NULL);
+    icetStateSetInteger(ICET_ACCUMULATE_INTERVAL, 0);
+    icetStateSetInteger(ICET_ACCUMULATED_FRAMES, 0);
+    icetStateSetBoolean(ICET_ACCUMULATE_COLLECT_REQUEST, ICET_FALSE);
+    icetStateSetPointer(ICET_DISPLAY_IMAGE_BUFFER, NULL);
+    icetStateSetInteger(ICET_DISPLAY_IMAGE_BUFFER_SIZE, 0);
+
     icetStateSetPointer(ICET_DRAW_FUNCTION, NULL);
     icetStateSetPointer(ICET_RENDER_LAYER_DESTRUCTOR, NULL);
 
@@ -198,6 +334,16 @@ void icetStateSetDefaults(void)
     icetEnable(ICET_INTERLACE_IMAGES);
     icetEnable(ICET_COLLECT_IMAGES);
     icetDisable(ICET_RENDER_EMPTY_IMAGES);
+    icetDisable(ICET_AUTO_DISPLAY_PLACEMENT);
+    icetDisable(ICET_FUSE_COLLECT);
+    icetDisable(ICET_PREDICT_DEPTH);
+    icetDisable(ICET_STREAM_DRAW_BLOCKS);
+    icetDisable(ICET_SINGLE_RENDER_PASS);
+    icetDisable(ICET_FRAME_CANCELLATION);
+    icetDisable(ICET_ADAPT_PRECISION);
+    icetEnable(ICET_BITMAP_SPARSE_IMAGES);
+    icetEnable(ICET_VARINT_RUN_LENGTHS);
+    icetDisable(ICET_ACCUMULATE_FRAMES);
 
     icetStateSetBoolean(ICET_IS_DRAWING_FRAME, 0);
 
@@ -205,6 +351,25 @@ void icetStateSetDefaults(void)
     icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
     icetStateSetInteger(ICET_VALID_PIXELS_NUM, 0);
 
+    icetStateSetPointer(ICET_COMM_PROGRESS_REQUESTS, NULL);
+    icetStateSetInteger(ICET_NUM_COMM_PROGRESS_REQUESTS, 0);
+
+    icetStateSetPointer(ICET_IN_TRANSIT_COMMUNICATOR, NULL);
+    icetStateSetPointer(ICET_THREAD_POOL, NULL);
+    icetStateSetDoublev(ICET_FRAME_START_TIMES, 0, NULL);
+    icetStateSetPointer(ICET_PRE_RENDERED_SPARSE, NULL);
+    icetStateSetPointer(ICET_RENDER_STREAM, NULL);
+    icetStateSetBoolean(ICET_FRAME_CANCELLED, ICET_FALSE);
+    icetStateSetIntegerv(ICET_FULL_TILE_VIEWPORTS, 0, NULL);
+    icetStateSetInteger(ICET_FULL_COLOR_FORMAT, ICET_IMAGE_COLOR_NONE);
+    icetStateSetIntegerv(ICET_RADIXK_SCHEDULE, 0, NULL);
+    icetStateSetIntegerv(ICET_RADIXKR_SCHEDULE, 0, NULL);
+    icetStateSetBoolean(ICET_ACCUMULATING, ICET_FALSE);
+    icetStateSetBoolean(ICET_ACCUMULATE_COLLECT_IMAGES, ICET_TRUE);
+    icetStateSetIntegerv(ICET_ACCUMULATION_LAYOUT, 0, NULL);
+    icetStateSetFloatv(ICET_ACCUMULATION_SUMS, 0, NULL);
+    icetStateSetIntegerv(ICET_ACCUMULATE_VOTES, 0, NULL);
+
     icetStateResetTiming();
 }
 
@@ -528,6 +693,10 @@ static IceTVoid *stateAllocate(IceTEnum pname,
         && (type == state[pname].type) ) {
         /* Current buffer already configured correctly. */
         state[pname].mod_time = icetGetTimeStamp();
+        if (2*STATE_DATA_ALLOCATE(type, num_entries)
+            >= state[pname].buffer_size) {
+            state[pname].peak_time = state[pname].mod_time;
+        }
     } else if ((num_entries > 0) || (state[pname].buffer_size > 0)) {
         IceTSizeType buffer_size = STATE_DATA_ALLOCATE(type, num_entries);
         if (buffer_size < state[pname].buffer_size) {
@@ -555,6 +724,9 @@ static IceTVoid *stateAllocate(IceTEnum pname,
         state[pname].type = type;
         state[pname].num_entries = num_entries;
         state[pname].mod_time = icetGetTimeStamp();
+        if (2*buffer_size >= state[pname].buffer_size) {
+            state[pname].peak_time = state[pname].mod_time;
+        }
 
 #ifdef ICET_STATE_CHECK_MEM
         /* Set padding data. */
@@ -577,6 +749,7 @@ static IceTVoid *stateAllocate(IceTEnum pname,
         state[pname].buffer_size = 0;
         state[pname].data = NULL;
         state[pname].mod_time = icetGetTimeStamp();
+        state[pname].peak_time = state[pname].mod_time;
     }
 
 #ifdef ICET_STATE_CHECK_MEM
@@ -600,6 +773,7 @@ static void stateFree(IceTEnum pname, IceTState state)
         state[pname].buffer_size = 0;
         state[pname].data = NULL;
         state[pname].mod_time = 0;
+        state[pname].peak_time = 0;
     }
 }
 
@@ -692,6 +866,51 @@ IceTVoid *icetGetStateBuffer(IceTEnum pname, IceTSizeType num_bytes)
     return stateAllocate(pname, num_bytes, ICET_VOID, icetGetState());
 }
 
+IceTUnsignedInt64 icetStateBufferBytes(void)
+{
+    IceTState state = icetGetState();
+    IceTUnsignedInt64 total = 0;
+    IceTEnum pname;
+
+    for (pname = ICET_STATE_BUFFER_START;
+         pname < ICET_STATE_BUFFER_END;
+         pname++) {
+        if (state[pname].type == ICET_VOID) {
+            total += (IceTUnsignedInt64)state[pname].buffer_size;
+        }
+    }
+    return total;
+}
+
+void icetStateReleaseBuffers(IceTTimeStamp peak_before)
+{
+    IceTState state = icetGetState();
+    IceTEnum pname;
+
+    for (pname = ICET_STATE_BUFFER_START;
+         pname < ICET_STATE_BUFFER_END;
+         pname++) {
+        if (   (state[pname].type == ICET_VOID)
+            && (state[pname].peak_time < peak_before) ) {
+            stateFree(pname, state);
+        }
+    }
+}
+
+void icetTrimBuffers(void)
+{
+    IceTBoolean isDrawing;
+
+    icetGetBooleanv(ICET_IS_DRAWING_FRAME, &isDrawing);
+    if (isDrawing) {
+        icetRaiseError(ICET_INVALID_OPERATION,
+                       "Cannot trim buffers while drawing a frame.");
+        return;
+    }
+
+    icetStateReleaseBuffers(icetGetTimeStamp());
+}
+
 IceTTimeStamp icetGetTimeStamp(void)
 {
     static IceTTimeStamp current_time = 0;
@@ -0,0 +1,306 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* Needed for pthreads when compiling with -ansi. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceTDevThreads.h>
+
+#include <IceTDevDiagnostics.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+
+#ifdef ICET_USE_PTHREADS
+
+#include <pthread.h>
+
+typedef struct IceTThreadPoolStruct {
+    IceTInt num_threads; /* Counts the thread that submits jobs. */
+    pthread_t *workers;
+    IceTInt num_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_posted;
+    pthread_cond_t job_finished;
+
+    /* The current job.  Everything below is protected by lock. */
+    IceTThreadTask task;
+    IceTVoid *data;
+    IceTSizeType num_items;
+    IceTSizeType chunk_items;
+    IceTSizeType next_item;
+    IceTInt job_number;
+    IceTInt busy_workers;
+    IceTBoolean shutdown;
+} *IceTThreadPool;
+
+/* Hands out chunks of the current job until there are none left.  Called with
+   the lock held, which is also held on return. */
+static void threadPoolRunChunks(IceTThreadPool pool)
+{
+    while (pool->next_item < pool->num_items) {
+        IceTSizeType begin = pool->next_item;
+        IceTSizeType end = begin + pool->chunk_items;
+        IceTThreadTask task = pool->task;
+        IceTVoid *data = pool->data;
+
+        if (end > pool->num_items) { end = pool->num_items; }
+        pool->next_item = end;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(begin, end, data);
+        pthread_mutex_lock(&pool->lock);
+    }
+}
+
+static void *threadPoolWorker(void *arg)
+{
+    IceTThreadPool pool = (IceTThreadPool)arg;
+    IceTInt last_job = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (ICET_TRUE) {
+        while (!pool->shutdown && (pool->job_number == last_job)) {
+            pthread_cond_wait(&pool->job_posted, &pool->lock);
+        }
+        if (pool->shutdown) { break; }
+        last_job = pool->job_number;
+
+        pool->busy_workers++;
+        threadPoolRunChunks(pool);
+        pool->busy_workers--;
+        if (pool->busy_workers == 0) {
+            pthread_cond_signal(&pool->job_finished);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void threadPoolFree(IceTThreadPool pool)
+{
+    IceTInt i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = ICET_TRUE;
+    pthread_cond_broadcast(&pool->job_posted);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->job_finished);
+    pthread_cond_destroy(&pool->job_posted);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+static IceTThreadPool threadPoolCreate(IceTInt num_threads)
+{
+    IceTThreadPool pool = malloc(sizeof(struct IceTThreadPoolStruct));
+    IceTInt i;
+
+    if (pool == NULL) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not allocate memory for thread pool.");
+        return NULL;
+    }
+
+    pool->num_threads = num_threads;
+    pool->workers = malloc((num_threads-1)*sizeof(pthread_t));
+    pool->num_workers = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_posted, NULL);
+    pthread_cond_init(&pool->job_finished, NULL);
+    pool->task = NULL;
+    pool->data = NULL;
+    pool->num_items = 0;
+    pool->chunk_items = 1;
+    pool->next_item = 0;
+    pool->job_number = 0;
+    pool->busy_workers = 0;
+    pool->shutdown = ICET_FALSE;
+
+    if (pool->workers == NULL) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not allocate memory for thread pool.");
+        threadPoolFree(pool);
+        return NULL;
+    }
+
+    for (i = 0; i < num_threads-1; i++) {
+        if (pthread_create(&pool->workers[i], NULL, threadPoolWorker, pool)
+            != 0) {
+            icetRaiseWarning(ICET_INVALID_OPERATION,
+                             "Could only start %d of %d threads.",
+                             (int)i+1, (int)num_threads);
+            break;
+        }
+        pool->num_workers++;
+    }
+
+    return pool;
+}
+
+/* Returns the pool of the current context, (re)building it if
+   ICET_NUM_THREADS changed. */
+static IceTThreadPool threadPoolGet(IceTInt num_threads)
+{
+    IceTVoid *value;
+    IceTThreadPool pool;
+
+    icetGetPointerv(ICET_THREAD_POOL, &value);
+    pool = (IceTThreadPool)value;
+    if ((pool != NULL) && (pool->num_threads != num_threads)) {
+        threadPoolFree(pool);
+        pool = NULL;
+        icetStateSetPointer(ICET_THREAD_POOL, NULL);
+    }
+    if (pool == NULL) {
+        pool = threadPoolCreate(num_threads);
+        icetStateSetPointer(ICET_THREAD_POOL, pool);
+    }
+    return pool;
+}
+
+static void threadPoolRun(IceTThreadPool pool,
+                          IceTSizeType num_items,
+                          IceTSizeType chunk_items,
+                          IceTThreadTask task,
+                          IceTVoid *data)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    pool->task = task;
+    pool->data = data;
+    pool->num_items = num_items;
+    pool->chunk_items = chunk_items;
+    pool->next_item = 0;
+    /* Only inequality matters, so wrapping around is harmless. */
+    pool->job_number = (pool->job_number + 1) & 0x3FFFFFFF;
+    pthread_cond_broadcast(&pool->job_posted);
+
+    threadPoolRunChunks(pool);
+
+    while (pool->busy_workers > 0) {
+        pthread_cond_wait(&pool->job_finished, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void icetThreadPoolDestroy(void)
+{
+    IceTVoid *value;
+
+    icetGetPointerv(ICET_THREAD_POOL, &value);
+    if (value != NULL) {
+        threadPoolFree((IceTThreadPool)value);
+        icetStateSetPointer(ICET_THREAD_POOL, NULL);
+    }
+}
+
+struct IceTThreadLockStruct {
+    pthread_mutex_t mutex;
+};
+
+IceTThreadLock icetThreadLockCreate(void)
+{
+    IceTThreadLock lock = malloc(sizeof(struct IceTThreadLockStruct));
+
+    if (lock == NULL) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not allocate memory for thread lock.");
+        return NULL;
+    }
+    pthread_mutex_init(&lock->mutex, NULL);
+    return lock;
+}
+
+void icetThreadLockDestroy(IceTThreadLock lock)
+{
+    if (lock == NULL) { return; }
+    pthread_mutex_destroy(&lock->mutex);
+    free(lock);
+}
+
+void icetThreadLockAcquire(IceTThreadLock lock)
+{
+    if (lock != NULL) { pthread_mutex_lock(&lock->mutex); }
+}
+
+void icetThreadLockRelease(IceTThreadLock lock)
+{
+    if (lock != NULL) { pthread_mutex_unlock(&lock->mutex); }
+}
+
+#else /* ICET_USE_PTHREADS */
+
+void icetThreadPoolDestroy(void)
+{
+    /* Nothing to do. */
+}
+
+IceTThreadLock icetThreadLockCreate(void)
+{
+    /* Without threads there is nothing to lock. */
+    return NULL;
+}
+
+void icetThreadLockDestroy(IceTThreadLock lock)
+{
+    (void)lock;
+}
+
+void icetThreadLockAcquire(IceTThreadLock lock)
+{
+    (void)lock;
+}
+
+void icetThreadLockRelease(IceTThreadLock lock)
+{
+    (void)lock;
+}
+
+#endif /* ICET_USE_PTHREADS */
+
+void icetThreadParallelFor(IceTSizeType num_items,
+                           IceTSizeType item_bytes,
+                           IceTThreadTask task,
+                           IceTVoid *data)
+{
+    IceTSizeType chunk_items;
+    IceTInt num_threads;
+
+    if (num_items < 1) { return; }
+
+    if (item_bytes < 1) { item_bytes = 1; }
+    chunk_items = ICET_THREAD_CHUNK_BYTES/item_bytes;
+    if (chunk_items < 1) { chunk_items = 1; }
+
+    icetGetIntegerv(ICET_NUM_THREADS, &num_threads);
+
+#ifdef ICET_USE_PTHREADS
+    if ((num_threads > 1) && (num_items > chunk_items)) {
+        IceTThreadPool pool = threadPoolGet(num_threads);
+        if (pool != NULL) {
+            threadPoolRun(pool, num_items, chunk_items, task, data);
+            return;
+        }
+    }
+#else
+    (void)num_threads;
+#endif
+
+    task(0, num_items, data);
+}
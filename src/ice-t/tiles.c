@@ -152,12 +152,11 @@ void icetPhysicalRenderSize(IceTInt width, IceTInt height)
     icetStateSetInteger(ICET_PHYSICAL_RENDER_HEIGHT, height);
 }
 
-void icetBoundingBoxd(IceTDouble x_min, IceTDouble x_max,
-                      IceTDouble y_min, IceTDouble y_max,
-                      IceTDouble z_min, IceTDouble z_max)
+static void boxVertices(IceTDouble x_min, IceTDouble x_max,
+                        IceTDouble y_min, IceTDouble y_max,
+                        IceTDouble z_min, IceTDouble z_max,
+                        IceTDouble *vertices)
 {
-    IceTDouble vertices[8*3];
-
     vertices[3*0+0] = x_min;  vertices[3*0+1] = y_min;  vertices[3*0+2] = z_min;
     vertices[3*1+0] = x_min;  vertices[3*1+1] = y_min;  vertices[3*1+2] = z_max;
     vertices[3*2+0] = x_min;  vertices[3*2+1] = y_max;  vertices[3*2+2] = z_min;
@@ -166,9 +165,19 @@ void icetBoundingBoxd(IceTDouble x_min, IceTDouble x_max,
     vertices[3*5+0] = x_max;  vertices[3*5+1] = y_min;  vertices[3*5+2] = z_max;
     vertices[3*6+0] = x_max;  vertices[3*6+1] = y_max;  vertices[3*6+2] = z_min;
     vertices[3*7+0] = x_max;  vertices[3*7+1] = y_max;  vertices[3*7+2] = z_max;
+}
+
+void icetBoundingBoxd(IceTDouble x_min, IceTDouble x_max,
+                      IceTDouble y_min, IceTDouble y_max,
+                      IceTDouble z_min, IceTDouble z_max)
+{
+    IceTDouble vertices[8*3];
+
+    boxVertices(x_min, x_max, y_min, y_max, z_min, z_max, vertices);
 
     icetStateSetDoublev(ICET_GEOMETRY_BOUNDS, 8*3, vertices);
     icetStateSetInteger(ICET_NUM_BOUNDING_VERTS, 8);
+    icetStateSetInteger(ICET_NUM_BOUNDING_GROUPS, 1);
 }
 
 void icetBoundingBoxf(IceTFloat x_min, IceTFloat x_max,
@@ -178,6 +187,53 @@ void icetBoundingBoxf(IceTFloat x_min, IceTFloat x_max,
     icetBoundingBoxd(x_min, x_max, y_min, y_max, z_min, z_max);
 }
 
+void icetBoundingBoxesd(IceTSizeType count, const IceTDouble *bounds)
+{
+    IceTDouble *vertices;
+    IceTSizeType i;
+
+    if (count < 1) {
+        /* No boxes. (Must be clearing them out.) */
+        icetBoundingVertices(0, ICET_VOID, 0, 0, NULL);
+        return;
+    }
+
+  /* Each box is projected separately when drawing, so store the vertices of
+     each box contiguously as its own group. */
+    vertices = icetStateAllocateDouble(ICET_GEOMETRY_BOUNDS, count*8*3);
+    for (i = 0; i < count; i++) {
+        const IceTDouble *box = bounds + 6*i;
+        boxVertices(box[0], box[1], box[2], box[3], box[4], box[5],
+                    vertices + 8*3*i);
+    }
+
+    icetStateSetInteger(ICET_NUM_BOUNDING_VERTS, 8*count);
+    icetStateSetInteger(ICET_NUM_BOUNDING_GROUPS, count);
+}
+
+void icetBoundingBoxesf(IceTSizeType count, const IceTFloat *bounds)
+{
+    IceTDouble *double_bounds;
+    IceTSizeType i;
+
+    if (count < 1) {
+        icetBoundingBoxesd(0, NULL);
+        return;
+    }
+
+    double_bounds = malloc(count*6*sizeof(IceTDouble));
+    if (double_bounds == NULL) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not allocate memory for bounding boxes.");
+        return;
+    }
+    for (i = 0; i < 6*count; i++) {
+        double_bounds[i] = bounds[i];
+    }
+    icetBoundingBoxesd(count, double_bounds);
+    free(double_bounds);
+}
+
 void icetBoundingVertices(IceTInt size, IceTEnum type, IceTSizeType stride,
                           IceTSizeType count, const IceTVoid *pointer)
 {
@@ -188,6 +244,7 @@ void icetBoundingVertices(IceTInt size, IceTEnum type, IceTSizeType stride,
         /* No vertices. (Must be clearing them out.) */
         icetStateSetDoublev(ICET_GEOMETRY_BOUNDS, 0, NULL);
         icetStateSetInteger(ICET_NUM_BOUNDING_VERTS, 0);
+        icetStateSetInteger(ICET_NUM_BOUNDING_GROUPS, 0);
         return;
     }
 
@@ -229,4 +286,5 @@ void icetBoundingVertices(IceTInt size, IceTEnum type, IceTSizeType stride,
     icetStateSetDoublev(ICET_GEOMETRY_BOUNDS, count*3, verts);
     free(verts);
     icetStateSetInteger(ICET_NUM_BOUNDING_VERTS, (IceTInt)count);
+    icetStateSetInteger(ICET_NUM_BOUNDING_GROUPS, 1);
 }
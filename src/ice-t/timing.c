@@ -44,6 +44,7 @@ void icetStateResetTiming(void)
     icetStateSetInteger(ICET_SUBFUNC_TIME_ID, 0);
 
     icetStateSetInteger(ICET_BYTES_SENT, 0);
+    icetStateSetInteger(ICET_DIRECT_SEND_ROUNDS, 0);
 }
 
 static void icetTimingBegin(IceTEnum start_pname,
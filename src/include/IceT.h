@@ -46,6 +46,10 @@ typedef struct IceTCommRequestStruct {
 } *IceTCommRequest;
 #define ICET_COMM_REQUEST_NULL ((IceTCommRequest)NULL)
 
+/* Value of the version member of IceTCommunicatorStruct for communicators
+   that provide Test, Testany, and Waitsome. */
+#define ICET_COMMUNICATOR_VERSION ((IceTEnum)0x1CE70203)
+
 struct IceTCommunicatorStruct {
     struct IceTCommunicatorStruct *
          (*Duplicate)(struct IceTCommunicatorStruct *self);
@@ -124,6 +128,19 @@ struct IceTCommunicatorStruct {
     int  (*Comm_size)(struct IceTCommunicatorStruct *self);
     int  (*Comm_rank)(struct IceTCommunicatorStruct *self);
     void *data;
+
+    /* Added in IceT 2.3, which changes the size of this struct, so
+       communicators compiled against an earlier IceT must be recompiled.
+       IceT only uses Test, Testany, and Waitsome when version is
+       ICET_COMMUNICATOR_VERSION, so a communicator that does not set the
+       new members still works.  Any of the three may also be NULL. */
+    IceTEnum version;
+    int  (*Test)(struct IceTCommunicatorStruct *self, IceTCommRequest *request);
+    int  (*Testany)(struct IceTCommunicatorStruct *self,
+                    int count, IceTCommRequest *array_of_requests);
+    int  (*Waitsome)(struct IceTCommunicatorStruct *self,
+                     int count, IceTCommRequest *array_of_requests,
+                     int *array_of_indices);
 };
 
 typedef struct IceTCommunicatorStruct *IceTCommunicator;
@@ -160,6 +177,10 @@ ICET_EXPORT void icetBoundingBoxd(IceTDouble x_min, IceTDouble x_max,
 ICET_EXPORT void icetBoundingBoxf(IceTFloat x_min, IceTFloat x_max,
                                   IceTFloat y_min, IceTFloat y_max,
                                   IceTFloat z_min, IceTFloat z_max);
+ICET_EXPORT void icetBoundingBoxesd(IceTSizeType count,
+                                    const IceTDouble *bounds);
+ICET_EXPORT void icetBoundingBoxesf(IceTSizeType count,
+                                    const IceTFloat *bounds);
 
 ICET_EXPORT void icetResetTiles(void);
 ICET_EXPORT int  icetAddTile(IceTInt x, IceTInt y,
@@ -205,12 +226,16 @@ ICET_EXPORT void icetImageCopyColorf(const IceTImage image,
 ICET_EXPORT void icetImageCopyDepthf(const IceTImage image,
                                      IceTFloat *depth_buffer,
                                      IceTEnum depth_format);
+ICET_EXPORT void icetImageWritePPM(const IceTImage image,
+                                   IceTInt tile,
+                                   const char *filename);
 
 #define ICET_STRATEGY_DIRECT            (IceTEnum)0x6001
 #define ICET_STRATEGY_SEQUENTIAL        (IceTEnum)0x6002
 #define ICET_STRATEGY_SPLIT             (IceTEnum)0x6003
 #define ICET_STRATEGY_REDUCE            (IceTEnum)0x6004
 #define ICET_STRATEGY_VTREE             (IceTEnum)0x6005
+#define ICET_STRATEGY_IN_TRANSIT        (IceTEnum)0x6006
 
 ICET_EXPORT void icetStrategy(IceTEnum strategy);
 
@@ -237,6 +262,8 @@ ICET_EXPORT void icetDataReplicationGroup(IceTInt size,
                                           const IceTInt *processes);
 ICET_EXPORT void icetDataReplicationGroupColor(IceTInt color);
 
+ICET_EXPORT void icetCompositorGroup(IceTInt size, const IceTInt *processes);
+
 typedef void (*IceTDrawCallbackType)(const IceTDouble *projection_matrix,
                                      const IceTDouble *modelview_matrix,
                                      const IceTFloat *background_color,
@@ -245,6 +272,8 @@ typedef void (*IceTDrawCallbackType)(const IceTDouble *projection_matrix,
 
 ICET_EXPORT void icetDrawCallback(IceTDrawCallbackType callback);
 
+ICET_EXPORT void icetDrawBlockFinished(const IceTInt *block_viewport);
+
 ICET_EXPORT IceTImage icetDrawFrame(const IceTDouble *projection_matrix,
                                     const IceTDouble *modelview_matrix,
                                     const IceTFloat *background_color);
@@ -256,6 +285,25 @@ ICET_EXPORT IceTImage icetCompositeImage(const IceTVoid *color_buffer,
                                          const IceTDouble *modelview_matrix,
                                          const IceTFloat *background_color);
 
+ICET_EXPORT IceTImage icetCompositeImageSpans(
+                                         IceTSizeType num_spans,
+                                         const IceTInt *spans,
+                                         const IceTVoid *color_buffer,
+                                         const IceTVoid *depth_buffer,
+                                         const IceTDouble *projection_matrix,
+                                         const IceTDouble *modelview_matrix,
+                                         const IceTFloat *background_color);
+
+ICET_EXPORT void icetTrimBuffers(void);
+
+ICET_EXPORT void icetCancelFrame(void);
+
+ICET_EXPORT void icetTargetFrameTime(IceTDouble seconds);
+
+ICET_EXPORT void icetAccumulateInterval(IceTInt frames);
+ICET_EXPORT void icetAccumulateCollect(void);
+ICET_EXPORT void icetAccumulateReset(void);
+
 #define ICET_DIAG_OFF           (IceTEnum)0x0000
 #define ICET_DIAG_ERRORS        (IceTEnum)0x0001
 #define ICET_DIAG_WARNINGS      (IceTEnum)0x0003
@@ -292,6 +340,7 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_NUM_BOUNDING_VERTS (ICET_STATE_ENGINE_START | (IceTEnum)0x0023)
 #define ICET_STRATEGY           (ICET_STATE_ENGINE_START | (IceTEnum)0x0024)
 #define ICET_SINGLE_IMAGE_STRATEGY (ICET_STATE_ENGINE_START | (IceTEnum)0x0025)
+#define ICET_NUM_BOUNDING_GROUPS (ICET_STATE_ENGINE_START | (IceTEnum)0x0026)
 #define ICET_COMPOSITE_MODE     (ICET_STATE_ENGINE_START | (IceTEnum)0x0028)
 #define ICET_COMPOSITE_ORDER    (ICET_STATE_ENGINE_START | (IceTEnum)0x0029)
 #define ICET_PROCESS_ORDERS     (ICET_STATE_ENGINE_START | (IceTEnum)0x002A)
@@ -299,9 +348,27 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_DATA_REPLICATION_GROUP (ICET_STATE_ENGINE_START | (IceTEnum)0x002C)
 #define ICET_DATA_REPLICATION_GROUP_SIZE (ICET_STATE_ENGINE_START | (IceTEnum)0x002D)
 #define ICET_FRAME_COUNT        (ICET_STATE_ENGINE_START | (IceTEnum)0x002E)
+#define ICET_COMPOSITOR_GROUP   (ICET_STATE_ENGINE_START | (IceTEnum)0x002F)
+#define ICET_COMPOSITOR_GROUP_SIZE (ICET_STATE_ENGINE_START | (IceTEnum)0x0030)
 
 #define ICET_MAGIC_K            (ICET_STATE_ENGINE_START | (IceTEnum)0x0040)
 #define ICET_MAX_IMAGE_SPLIT    (ICET_STATE_ENGINE_START | (IceTEnum)0x0041)
+#define ICET_COMM_PROGRESS_INTERVAL (ICET_STATE_ENGINE_START|(IceTEnum)0x0042)
+#define ICET_DIRECT_SEND_THRESHOLD (ICET_STATE_ENGINE_START|(IceTEnum)0x0043)
+#define ICET_NUM_THREADS        (ICET_STATE_ENGINE_START | (IceTEnum)0x0044)
+#define ICET_PIXEL_BLOCK_SIZE   (ICET_STATE_ENGINE_START | (IceTEnum)0x0045)
+#define ICET_BUFFER_RELEASE_FRAMES (ICET_STATE_ENGINE_START|(IceTEnum)0x0046)
+#define ICET_MEMORY_BUDGET      (ICET_STATE_ENGINE_START | (IceTEnum)0x0047)
+#define ICET_TARGET_FRAME_TIME  (ICET_STATE_ENGINE_START | (IceTEnum)0x0048)
+#define ICET_RENDER_SCALE       (ICET_STATE_ENGINE_START | (IceTEnum)0x0049)
+#define ICET_REDUCED_PRECISION  (ICET_STATE_ENGINE_START | (IceTEnum)0x004A)
+#define ICET_QUALITY_HISTORY    (ICET_STATE_ENGINE_START | (IceTEnum)0x004B)
+#define ICET_DENSE_IMAGE_PERCENT (ICET_STATE_ENGINE_START|(IceTEnum)0x004C)
+#define ICET_ACCUMULATE_INTERVAL (ICET_STATE_ENGINE_START|(IceTEnum)0x004D)
+#define ICET_ACCUMULATED_FRAMES (ICET_STATE_ENGINE_START | (IceTEnum)0x004E)
+#define ICET_ACCUMULATE_COLLECT_REQUEST (ICET_STATE_ENGINE_START|(IceTEnum)0x004F)
+#define ICET_DISPLAY_IMAGE_BUFFER (ICET_STATE_ENGINE_START|(IceTEnum)0x0050)
+#define ICET_DISPLAY_IMAGE_BUFFER_SIZE (ICET_STATE_ENGINE_START|(IceTEnum)0x0051)
 
 #define ICET_DRAW_FUNCTION      (ICET_STATE_ENGINE_START | (IceTEnum)0x0060)
 #define ICET_RENDER_LAYER_DESTRUCTOR (ICET_STATE_ENGINE_START|(IceTEnum)0x0061)
@@ -323,6 +390,8 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_NEED_BACKGROUND_CORRECTION (ICET_STATE_FRAME_START | (IceTEnum)0x000C)
 #define ICET_TRUE_BACKGROUND_COLOR (ICET_STATE_FRAME_START | (IceTEnum)0x000D)
 #define ICET_TRUE_BACKGROUND_COLOR_WORD (ICET_STATE_FRAME_START | (IceTEnum)0x000E)
+#define ICET_NUM_CONTAINED_VIEWPORTS (ICET_STATE_FRAME_START | (IceTEnum)0x000F)
+#define ICET_CONTAINED_VIEWPORTS (ICET_STATE_FRAME_START | (IceTEnum)0x0010)
 
 #define ICET_VALID_PIXELS_TILE  (ICET_STATE_FRAME_START | (IceTEnum)0x0018)
 #define ICET_VALID_PIXELS_OFFSET (ICET_STATE_FRAME_START | (IceTEnum)0x0019)
@@ -332,6 +401,26 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_RENDER_BUFFER      (ICET_STATE_FRAME_START | (IceTEnum)0x0021)
 #define ICET_PRE_RENDERED       (ICET_STATE_FRAME_START | (IceTEnum)0x0022)
 #define ICET_TILE_PROJECTIONS   (ICET_STATE_FRAME_START | (IceTEnum)0x0023)
+#define ICET_COMM_PROGRESS_REQUESTS (ICET_STATE_FRAME_START|(IceTEnum)0x0024)
+#define ICET_NUM_COMM_PROGRESS_REQUESTS (ICET_STATE_FRAME_START|(IceTEnum)0x0025)
+#define ICET_IN_TRANSIT_COMMUNICATOR (ICET_STATE_FRAME_START|(IceTEnum)0x0027)
+#define ICET_THREAD_POOL        (ICET_STATE_FRAME_START | (IceTEnum)0x0028)
+#define ICET_FRAME_START_TIMES  (ICET_STATE_FRAME_START | (IceTEnum)0x0029)
+#define ICET_PRE_RENDERED_SPARSE (ICET_STATE_FRAME_START|(IceTEnum)0x002A)
+#define ICET_RENDER_STREAM      (ICET_STATE_FRAME_START | (IceTEnum)0x002B)
+#define ICET_FRAME_CANCELLED    (ICET_STATE_FRAME_START | (IceTEnum)0x002C)
+#define ICET_FRAME_CANCEL_VOTES (ICET_STATE_FRAME_START | (IceTEnum)0x002D)
+#define ICET_FULL_TILE_VIEWPORTS (ICET_STATE_FRAME_START|(IceTEnum)0x002E)
+#define ICET_FULL_GLOBAL_VIEWPORT (ICET_STATE_FRAME_START|(IceTEnum)0x002F)
+#define ICET_FULL_COLOR_FORMAT  (ICET_STATE_FRAME_START | (IceTEnum)0x0030)
+#define ICET_QUALITY_FRAME_TIMES (ICET_STATE_FRAME_START|(IceTEnum)0x0031)
+#define ICET_RADIXK_SCHEDULE    (ICET_STATE_FRAME_START | (IceTEnum)0x0032)
+#define ICET_RADIXKR_SCHEDULE   (ICET_STATE_FRAME_START | (IceTEnum)0x0033)
+#define ICET_ACCUMULATING       (ICET_STATE_FRAME_START | (IceTEnum)0x0034)
+#define ICET_ACCUMULATE_COLLECT_IMAGES (ICET_STATE_FRAME_START|(IceTEnum)0x0035)
+#define ICET_ACCUMULATION_LAYOUT (ICET_STATE_FRAME_START|(IceTEnum)0x0036)
+#define ICET_ACCUMULATION_SUMS  (ICET_STATE_FRAME_START | (IceTEnum)0x0037)
+#define ICET_ACCUMULATE_VOTES   (ICET_STATE_FRAME_START | (IceTEnum)0x0038)
 
 #define ICET_STATE_TIMING_START (IceTEnum)0x000000C0
 
@@ -346,6 +435,7 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_COLLECT_TIME       (ICET_STATE_TIMING_START | (IceTEnum)0x0008)
 #define ICET_TOTAL_DRAW_TIME    (ICET_STATE_TIMING_START | (IceTEnum)0x0009)
 #define ICET_BYTES_SENT         (ICET_STATE_TIMING_START | (IceTEnum)0x000A)
+#define ICET_DIRECT_SEND_ROUNDS (ICET_STATE_TIMING_START | (IceTEnum)0x000B)
 
 #define ICET_DRAW_START_TIME    (ICET_STATE_TIMING_START | (IceTEnum)0x0010)
 #define ICET_DRAW_TIME_ID       (ICET_STATE_TIMING_START | (IceTEnum)0x0011)
@@ -366,6 +456,16 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_INTERLACE_IMAGES   (ICET_STATE_ENABLE_START | (IceTEnum)0x0005)
 #define ICET_COLLECT_IMAGES     (ICET_STATE_ENABLE_START | (IceTEnum)0x0006)
 #define ICET_RENDER_EMPTY_IMAGES (ICET_STATE_ENABLE_START | (IceTEnum)0x0007)
+#define ICET_AUTO_DISPLAY_PLACEMENT (ICET_STATE_ENABLE_START | (IceTEnum)0x0008)
+#define ICET_FUSE_COLLECT       (ICET_STATE_ENABLE_START | (IceTEnum)0x000A)
+#define ICET_PREDICT_DEPTH      (ICET_STATE_ENABLE_START | (IceTEnum)0x000B)
+#define ICET_STREAM_DRAW_BLOCKS (ICET_STATE_ENABLE_START | (IceTEnum)0x000C)
+#define ICET_SINGLE_RENDER_PASS (ICET_STATE_ENABLE_START | (IceTEnum)0x000D)
+#define ICET_FRAME_CANCELLATION (ICET_STATE_ENABLE_START | (IceTEnum)0x000E)
+#define ICET_ADAPT_PRECISION    (ICET_STATE_ENABLE_START | (IceTEnum)0x000F)
+#define ICET_BITMAP_SPARSE_IMAGES (ICET_STATE_ENABLE_START | (IceTEnum)0x0010)
+#define ICET_VARINT_RUN_LENGTHS (ICET_STATE_ENABLE_START | (IceTEnum)0x0011)
+#define ICET_ACCUMULATE_FRAMES  (ICET_STATE_ENABLE_START | (IceTEnum)0x0012)
 
 /* This set of enable state variables are reserved for the rendering layer. */
 #define ICET_RENDER_LAYER_ENABLE_START (ICET_STATE_ENABLE_START | (IceTEnum)0x0030)
@@ -387,6 +487,12 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_STRATEGY_COMMON_BUF_0 (ICET_CORE_BUFFER_START | (IceTEnum)0x0006)
 #define ICET_STRATEGY_COMMON_BUF_1 (ICET_CORE_BUFFER_START | (IceTEnum)0x0007)
 #define ICET_STRATEGY_COMMON_BUF_2 (ICET_CORE_BUFFER_START | (IceTEnum)0x0008)
+#define ICET_DEPTH_CODE_BUF     (ICET_CORE_BUFFER_START | (IceTEnum)0x000A)
+#define ICET_PIXEL_BLOCK_BUF_0  (ICET_CORE_BUFFER_START | (IceTEnum)0x000B)
+#define ICET_PIXEL_BLOCK_BUF_1  (ICET_CORE_BUFFER_START | (IceTEnum)0x000C)
+#define ICET_SPARSE_RENDER_BUF  (ICET_CORE_BUFFER_START | (IceTEnum)0x000D)
+#define ICET_SPARSE_TILE_BUF    (ICET_CORE_BUFFER_START | (IceTEnum)0x000E)
+#define ICET_RENDER_STREAM_BUF  (ICET_CORE_BUFFER_START | (IceTEnum)0x000F)
 
 #define ICET_RENDER_LAYER_BUFFER_START (ICET_STATE_BUFFER_START | (IceTEnum)0x0010)
 #define ICET_RENDER_LAYER_BUFFER_END   (ICET_STATE_BUFFER_START | (IceTEnum)0x0020)
@@ -434,6 +540,15 @@ ICET_EXPORT void icetDiagnostics(IceTBitField mask);
 #define ICET_COMMUNICATION_LAYER_START (ICET_STATE_BUFFER_START | (IceTEnum)0x0040)
 #define ICET_COMMUNICATION_LAYER_END  (ICET_STATE_BUFFER_START | (IceTEnum)0x0050)
 
+/* Core buffers that did not fit in the first block. */
+#define ICET_CORE_BUFFER_2_START (ICET_STATE_BUFFER_START | (IceTEnum)0x0050)
+#define ICET_CORE_BUFFER_2_END  (ICET_STATE_BUFFER_START | (IceTEnum)0x0060)
+
+#define ICET_FULL_SIZE_IMAGE_BUF (ICET_CORE_BUFFER_2_START | (IceTEnum)0x0000)
+#define ICET_RUN_CODE_BUF       (ICET_CORE_BUFFER_2_START | (IceTEnum)0x0001)
+#define ICET_ACCUMULATE_IMAGE_BUF (ICET_CORE_BUFFER_2_START|(IceTEnum)0x0002)
+#define ICET_ACCUMULATE_PIECE_BUF (ICET_CORE_BUFFER_2_START|(IceTEnum)0x0003)
+
 #define ICET_STATE_SIZE         (IceTEnum)0x00000200
 #define ICET_STATE_ENGINE_END   (ICET_STATE_ENGINE_START + ICET_STATE_SIZE)
 
@@ -0,0 +1,40 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTDevAccumulate_h
+#define __IceTDevAccumulate_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* If ICET_ACCUMULATE_FRAMES is enabled, temporarily disables
+   ICET_COLLECT_IMAGES so that the strategy leaves each process with its
+   composited partition.  Must be called before icetQualityBeginFrame so that
+   the quality controller leaves accumulated frames at full quality. */
+ICET_EXPORT void icetAccumulateBeginFrame(void);
+
+/* Restores ICET_COLLECT_IMAGES, adds the partition held in image to the
+   running sum of the local process, and replaces it with the average of all
+   frames accumulated so far.  If this frame is to be collected, returns the
+   averaged image gathered to the display process instead.  Does nothing
+   unless icetAccumulateBeginFrame started accumulating or if the frame was
+   cancelled. */
+ICET_EXPORT IceTImage icetAccumulateFinishFrame(IceTImage image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IceTDevAccumulate_h */
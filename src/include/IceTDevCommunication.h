@@ -78,9 +78,44 @@ ICET_EXPORT IceTCommRequest icetCommIrecv(void *buf,
 ICET_EXPORT void icetCommWait(IceTCommRequest *request);
 ICET_EXPORT int icetCommWaitany(int count, IceTCommRequest *array_of_requests);
 ICET_EXPORT void icetCommWaitall(int count, IceTCommRequest *array_of_requests);
+ICET_EXPORT IceTBoolean icetCommTest(IceTCommRequest *request);
+ICET_EXPORT int icetCommTestany(int count, IceTCommRequest *array_of_requests);
+ICET_EXPORT int icetCommWaitsome(int count,
+                                 IceTCommRequest *array_of_requests,
+                                 int *array_of_indices);
 ICET_EXPORT int icetCommSize();
 ICET_EXPORT int icetCommRank();
 
+/* Asynchronous progress.  Many MPI implementations only move data for
+ * posted nonblocking operations (such as the handshake for large sends)
+ * while inside an MPI call.  A strategy that is about to spend a long time
+ * compositing can register its outstanding send requests with
+ * icetCommProgressRequests.  Long compositing loops then call
+ * icetCommProgress about every ICET_COMM_PROGRESS_INTERVAL pixels, which
+ * tests the requests so the library gets a chance to make progress.
+ * Requests that finish are set to ICET_COMM_REQUEST_NULL in the registered
+ * array, so they can still be waited on as normal.  Call
+ * icetCommProgressRequests(0, NULL) before the array goes away.
+ * icetCommProgressInterval returns 0 if polling is off or nothing is
+ * registered. */
+ICET_EXPORT void icetCommProgressRequests(int count,
+                                          IceTCommRequest *array_of_requests);
+ICET_EXPORT IceTSizeType icetCommProgressInterval(void);
+ICET_EXPORT void icetCommProgress(void);
+
+/* The test and wait functions follow the conventions of their MPI
+ * counterparts except that completed requests are always set to
+ * ICET_COMM_REQUEST_NULL.  icetCommTest returns true if the request is
+ * finished (or was already null).  icetCommTestany returns the index of a
+ * finished request or -1 if none are finished yet.  icetCommWaitsome blocks
+ * until at least one request finishes, fills array_of_indices (which must
+ * have room for count entries) with the indices of all the finished
+ * requests, and returns how many there are.  It returns 0 if there are no
+ * active requests.  If the communicator does not provide Test or Testany
+ * (see ICET_COMMUNICATOR_VERSION), the test functions still never block but
+ * report no request as newly finished, and icetCommWaitsome finishes one request at a
+ * time with Waitany. */
+
 /* When used in place of sendbuf in one of the gathers, then this means that
  * the local process should skip sending to itself.  Instead, the correct
  * data is already in the destbuf.  For icetCommGather and icetCommGatherV,
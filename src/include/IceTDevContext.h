@@ -23,6 +23,23 @@ extern "C" {
 ICET_EXPORT IceTState icetGetState();
 ICET_EXPORT IceTCommunicator icetGetCommunicator();
 
+/* Replaces the communicator of the current context and returns the one it
+   had before.  The context does not take ownership of the new communicator,
+   so the caller must restore the original one before it is destroyed. */
+ICET_EXPORT IceTCommunicator icetSetCommunicator(IceTCommunicator comm);
+
+/* Forgets any icetCancelFrame request and clears ICET_FRAME_CANCELLED.
+   Called at the start of every frame. */
+ICET_EXPORT void icetFrameCancelReset(void);
+
+/* Returns true if any process has cancelled the current frame.  Unless
+   ICET_FRAME_CANCELLATION is disabled or the frame is already known to be
+   cancelled, this exchanges a byte with every process in the current
+   communicator, so all processes must call it at the same point of the frame
+   and all get the same answer.  A true answer is remembered in
+   ICET_FRAME_CANCELLED for the rest of the frame. */
+ICET_EXPORT IceTBoolean icetFrameCancelled(void);
+
 #ifdef __cplusplus
 }
 #endif
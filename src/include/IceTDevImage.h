@@ -26,6 +26,13 @@ extern "C" {
 ICET_EXPORT IceTImage icetGetStateBufferImage(IceTEnum pname,
                                               IceTSizeType width,
                                               IceTSizeType height);
+/* Strategies get the image they return from icetDrawFrame here.  If a frame
+   sink has set ICET_DISPLAY_IMAGE_BUFFER to memory large enough for the
+   image, the image is placed there so that the frame is composited straight
+   into the sink.  Otherwise this is the same as icetGetStateBufferImage. */
+ICET_EXPORT IceTImage icetGetDisplayImage(IceTEnum pname,
+                                          IceTSizeType width,
+                                          IceTSizeType height);
 ICET_EXPORT IceTImage icetRetrieveStateImage(IceTEnum pname);
 ICET_EXPORT IceTSizeType icetImageBufferSize(IceTSizeType width,
                                              IceTSizeType height);
@@ -73,6 +80,12 @@ ICET_EXPORT void icetImageCopyRegion(const IceTImage in_image,
                                      const IceTInt *in_viewport,
                                      IceTImage out_image,
                                      const IceTInt *out_viewport);
+/* Fills out_image with the pixels of in_image stretched (or shrunk) to the
+   size of out_image, taking the nearest pixel.  Both images must have the
+   same depth format.  The color formats must match, except that an
+   ICET_IMAGE_COLOR_RGBA_UBYTE image may be scaled into a float image. */
+ICET_EXPORT void icetImageScalePixels(const IceTImage in_image,
+                                      IceTImage out_image);
 ICET_EXPORT void icetImageClearAroundRegion(IceTImage image,
                                             const IceTInt *region);
 ICET_EXPORT void icetImagePackageForSend(IceTImage image,
@@ -94,6 +107,20 @@ ICET_EXPORT IceTSparseImage icetGetStateBufferSparseImage(IceTEnum pname,
 ICET_EXPORT IceTSparseImage icetSparseImageAssignBuffer(IceTVoid *buffer,
                                                         IceTSizeType width,
                                                         IceTSizeType height);
+/* Builds a sparse image of the current formats in the given state buffer
+   from a list of spans of active pixels.  spans holds num_spans pairs of the
+   index of the first pixel of the span (y*width + x) and its number of
+   pixels.  Spans must be in increasing order and must not overlap.
+   color_buffer and depth_buffer hold the packed pixels of all the spans, one
+   after another.  Returns a null image if the spans are invalid. */
+ICET_EXPORT IceTSparseImage icetGetStateBufferSparseImageFromSpans(
+                                                IceTEnum pname,
+                                                IceTSizeType width,
+                                                IceTSizeType height,
+                                                IceTSizeType num_spans,
+                                                const IceTInt *spans,
+                                                const IceTVoid *color_buffer,
+                                                const IceTVoid *depth_buffer);
 ICET_EXPORT IceTSparseImage icetSparseImageNull(void);
 ICET_EXPORT IceTBoolean icetSparseImageIsNull(const IceTSparseImage image);
 ICET_EXPORT IceTEnum icetSparseImageGetColorFormat(const IceTSparseImage image);
@@ -107,6 +134,21 @@ ICET_EXPORT void icetSparseImageSetDimensions(IceTSparseImage image,
                                               IceTSizeType height);
 ICET_EXPORT IceTSizeType icetSparseImageGetCompressedBufferSize(
                                                    const IceTSparseImage image);
+/* Rewrites the depth values of image with predictive coding if
+   ICET_PREDICT_DEPTH is enabled.  Afterward the image can only be packaged
+   for send.  icetSparseImageUnpackageFromReceive decodes it again. */
+ICET_EXPORT void icetSparseImageEncodeDepth(IceTSparseImage image);
+/* Replaces the run lengths of image with a bitmap of its active pixels if
+   ICET_BITMAP_SPARSE_IMAGES is enabled and the bitmap is smaller.  Images
+   already encoded with icetSparseImageEncodeDepth are left alone.  Afterward
+   the image can only be packaged for send.
+   icetSparseImageUnpackageFromReceive decodes it again. */
+ICET_EXPORT void icetSparseImageEncodeBitmap(IceTSparseImage image);
+/* Writes the run lengths of image as variable-length integers if
+   ICET_VARINT_RUN_LENGTHS is enabled and that is smaller.  Images already
+   encoded some other way are left alone.  Afterward the image can only be
+   packaged for send.  icetSparseImageUnpackageFromReceive decodes it again. */
+ICET_EXPORT void icetSparseImageEncodeVarint(IceTSparseImage image);
 ICET_EXPORT void icetSparseImagePackageForSend(IceTSparseImage image,
                                                IceTVoid **buffer,
                                                IceTSizeType *size);
@@ -141,6 +183,9 @@ ICET_EXPORT IceTSizeType icetGetInterlaceOffset(
                                               IceTInt partition_index,
                                               IceTInt eventual_num_partitions,
                                               IceTSizeType original_image_size);
+ICET_EXPORT void icetGetInterlaceOffsets(IceTInt eventual_num_partitions,
+                                         IceTSizeType original_image_size,
+                                         IceTSizeType *offsets);
 
 ICET_EXPORT void icetClearImage(IceTImage image);
 ICET_EXPORT void icetClearSparseImage(IceTSparseImage image);
@@ -150,6 +195,24 @@ ICET_EXPORT void icetGetTileImage(IceTInt tile, IceTImage image);
 ICET_EXPORT void icetGetCompressedTileImage(IceTInt tile,
                                             IceTSparseImage compressed_image);
 
+/* Like icetGetCompressedTileImage, but the pixels are ordered by square blocks
+   of block_size pixels on a side rather than by scanline.  Images composited
+   from these must be put back in order with icetImageUnblockPixels. */
+ICET_EXPORT void icetGetBlockedCompressedTileImage(
+                                            IceTInt tile,
+                                            IceTSizeType block_size,
+                                            IceTSparseImage compressed_image);
+ICET_EXPORT void icetImageUnblockPixels(IceTImage image,
+                                        IceTSizeType block_size);
+
+/* Like icetCompositeImage, but takes the local image as a sparse image with
+   the dimensions of ICET_GLOBAL_VIEWPORT and the current image formats. */
+ICET_EXPORT IceTImage icetCompositeSparseImage(
+                                         const IceTSparseImage image,
+                                         const IceTDouble *projection_matrix,
+                                         const IceTDouble *modelview_matrix,
+                                         const IceTFloat *background_color);
+
 ICET_EXPORT void icetCompressImage(const IceTImage image,
                                    IceTSparseImage compressed_image);
 
@@ -0,0 +1,43 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTDevQuality_h
+#define __IceTDevQuality_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* Applies the render scale and color precision that the controller picked
+   for this frame by temporarily shrinking the tiles and changing
+   ICET_COLOR_FORMAT.  Does nothing unless ICET_TARGET_FRAME_TIME is set and
+   the frame is rendered with the drawing callback and collected. */
+ICET_EXPORT void icetQualityBeginFrame(void);
+
+/* Restores the tiles and color format changed by icetQualityBeginFrame and
+   returns image stretched back to the full size of the displayed tile in the
+   application's color format. */
+ICET_EXPORT IceTImage icetQualityFinishFrame(IceTImage image);
+
+/* Feeds the timings of the frame just drawn to the controller and picks the
+   render scale, color precision, and single image strategy of the next
+   frame.  Exchanges the timings of all processes so that they all pick the
+   same.  Must be called after the frame timings are final. */
+ICET_EXPORT void icetQualityUpdate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IceTDevQuality_h */
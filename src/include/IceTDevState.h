@@ -78,6 +78,15 @@ ICET_EXPORT IceTVoid   **icetStateAllocatePointer(IceTEnum pname,
 ICET_EXPORT IceTVoid       *icetGetStateBuffer(IceTEnum pname,
                                                IceTSizeType num_bytes);
 
+/* Returns the number of bytes held by the buffers in the
+   ICET_STATE_BUFFER_START to ICET_STATE_BUFFER_END range. */
+ICET_EXPORT IceTUnsignedInt64 icetStateBufferBytes(void);
+
+/* Frees every buffer in the ICET_STATE_BUFFER_START to ICET_STATE_BUFFER_END
+   range that was last asked for at least half of its size before the given
+   time.  Pointers to the freed buffers become invalid. */
+ICET_EXPORT void icetStateReleaseBuffers(IceTTimeStamp peak_before);
+
 ICET_EXPORT IceTTimeStamp icetGetTimeStamp(void);
 
 void icetStateDump(void);
@@ -47,6 +47,18 @@ ICET_STRATEGY_EXPORT void icetInvokeSingleImageStrategy(
                                                   IceTSparseImage *result_image,
                                                   IceTSizeType *piece_offset);
 
+/* Composites and collects the image in one go for single image strategies
+   that can fuse their last round with the collection.  The image ends up in
+   result_image on process compose_group[image_dest].  Returns ICET_FALSE
+   without doing any communication if the strategy has no fused path. */
+ICET_STRATEGY_EXPORT IceTBoolean icetInvokeSingleImageStrategyCollect(
+                                                  IceTEnum strategy,
+                                                  const IceTInt *compose_group,
+                                                  IceTInt group_size,
+                                                  IceTInt image_dest,
+                                                  IceTSparseImage input_image,
+                                                  IceTImage result_image);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,60 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+#ifndef __IceTDevThreads_h
+#define __IceTDevThreads_h
+
+#include <IceT.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* A task processes items [begin, end).  Tasks run on worker threads, so they
+   must not call anything that touches the IceT state (including raising
+   errors).  Look up everything the task needs beforehand and pass it in
+   data. */
+typedef void (*IceTThreadTask)(IceTSizeType begin,
+                               IceTSizeType end,
+                               IceTVoid *data);
+
+/* Runs task over num_items items split into chunks of about
+   ICET_THREAD_CHUNK_BYTES (given the size of each item) on the worker pool
+   of the current context.  The pool has ICET_NUM_THREADS threads counting
+   the calling thread, which also processes chunks.  Returns when all items
+   are done.  Small jobs and single threaded contexts just call task
+   directly. */
+ICET_EXPORT void icetThreadParallelFor(IceTSizeType num_items,
+                                       IceTSizeType item_bytes,
+                                       IceTThreadTask task,
+                                       IceTVoid *data);
+
+/* Stops the worker threads of the current context.  Called when the context
+   is destroyed. */
+ICET_EXPORT void icetThreadPoolDestroy(void);
+
+/* A mutual exclusion lock for data shared with threads that IceT does not
+   own, such as the threads of a renderer.  Without thread support the lock
+   does nothing.  Create and destroy may raise errors, so call them on the
+   thread that called IceT. */
+typedef struct IceTThreadLockStruct *IceTThreadLock;
+ICET_EXPORT IceTThreadLock icetThreadLockCreate(void);
+ICET_EXPORT void icetThreadLockDestroy(IceTThreadLock lock);
+ICET_EXPORT void icetThreadLockAcquire(IceTThreadLock lock);
+ICET_EXPORT void icetThreadLockRelease(IceTThreadLock lock);
+
+#define ICET_THREAD_CHUNK_BYTES         (256*1024)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*__IceTDevThreads_h*/
@@ -0,0 +1,96 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* A frame sink that hands composited images to another process on the same
+ * node through a POSIX shared memory ring.  The IceT application creates the
+ * sink on its display process and writes each frame into it.  A consumer
+ * process (an encoder or a streaming server, say) links against the small
+ * IceTShmReader library and reads frames straight out of the ring.  The
+ * reader does not need an IceT context or MPI. */
+
+#ifndef __IceTShm_h
+#define __IceTShm_h
+
+#include <IceT.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/* Writer side, in the IceTShm library. */
+
+typedef struct IceTShmSinkStruct *IceTShmSink;
+
+/* Creates the shared memory object called name (which should start with a
+   slash) holding num_slots frames of at most max_width by max_height pixels
+   in the given color format.  Returns NULL and raises an error on failure,
+   including when an object with that name already exists. */
+ICET_SHM_EXPORT IceTShmSink icetShmSinkCreate(const char *name,
+                                              IceTInt num_slots,
+                                              IceTSizeType max_width,
+                                              IceTSizeType max_height,
+                                              IceTEnum color_format);
+
+/* Unmaps and unlinks the shared memory object.  Readers that still have it
+   open keep their mapping until they close it. */
+ICET_SHM_EXPORT void icetShmSinkDestroy(IceTShmSink sink);
+
+/* Hands the next slot of the ring to the current IceT context so that the
+   next icetDrawFrame composites the displayed image straight into shared
+   memory.  Call it on the display process before drawing and pass the
+   image to icetShmSinkWriteImage afterward. */
+ICET_SHM_EXPORT void icetShmSinkBeginFrame(IceTShmSink sink);
+
+/* Publishes image in the next slot of the ring and notifies the reader.  If
+   the image was composited into the slot after icetShmSinkBeginFrame,
+   nothing is copied.  Otherwise the color buffer is copied into the slot.
+   Returns the sequence number of the frame (starting at 1) or 0 if the
+   image could not be written. */
+ICET_SHM_EXPORT IceTUnsignedInt64 icetShmSinkWriteImage(IceTShmSink sink,
+                                                        const IceTImage image);
+
+/* Reader side, in the IceTShmReader library. */
+
+typedef struct IceTShmReaderStruct *IceTShmReader;
+
+typedef struct IceTShmFrameStruct {
+    IceTUnsignedInt64 sequence;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTEnum color_format;
+    const IceTVoid *pixels;
+} IceTShmFrame;
+
+/* Opens the ring created by icetShmSinkCreate.  Returns NULL on failure. */
+ICET_SHM_EXPORT IceTShmReader icetShmReaderOpen(const char *name);
+
+ICET_SHM_EXPORT void icetShmReaderClose(IceTShmReader reader);
+
+/* Fills frame with the newest frame that the reader has not seen yet.  If
+   there is none, waits for the next one when block is true and otherwise
+   returns ICET_FALSE.  Frames written while the reader was busy are
+   skipped.  The pixels point into shared memory and are not copied. */
+ICET_SHM_EXPORT IceTBoolean icetShmReaderNextFrame(IceTShmReader reader,
+                                                   IceTBoolean block,
+                                                   IceTShmFrame *frame);
+
+/* Returns ICET_TRUE if the slot holding frame has not been reused by the
+   writer.  Check this after consuming the pixels to detect that the ring
+   wrapped around while they were being read. */
+ICET_SHM_EXPORT IceTBoolean icetShmReaderFrameValid(IceTShmReader reader,
+                                                    const IceTShmFrame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IceTShm_h */
@@ -0,0 +1,75 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* Layout of the shared memory ring used by both the frame sink and the
+ * reader.  The object starts with an IceTShmRingHeader followed by
+ * num_slots slots, each slot_stride bytes apart.  A slot is an
+ * IceTShmSlotHeader followed by room for a full IceT image buffer, so that
+ * IceT can composite a frame straight into it.  The pixels start
+ * pixel_offset bytes into the slot.  Everything is aligned to cache lines so
+ * that the writer and reader do not share lines needlessly. */
+
+#ifndef __IceTShmLayout_h
+#define __IceTShmLayout_h
+
+#include <IceT.h>
+
+#include <semaphore.h>
+
+#define ICET_SHM_MAGIC          0x49635368
+#define ICET_SHM_VERSION        1
+
+typedef struct IceTShmRingHeaderStruct {
+    IceTUInt magic;
+    IceTUInt version;
+    IceTInt num_slots;
+    IceTEnum color_format;
+    IceTSizeType max_width;
+    IceTSizeType max_height;
+    IceTSizeType slot_stride;
+    /* Sequence number of the last complete frame, 0 before the first. */
+    volatile IceTUnsignedInt64 last_sequence;
+    /* Posted when a frame is written and no earlier post is still pending. */
+    sem_t frame_posted;
+} IceTShmRingHeader;
+
+typedef struct IceTShmSlotHeaderStruct {
+    /* Sequence number of the frame in the slot.  It is 0 while the writer
+       is filling the slot. */
+    volatile IceTUnsignedInt64 sequence;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTEnum color_format;
+    IceTSizeType pixel_offset;
+} IceTShmSlotHeader;
+
+#define ICET_SHM_ALIGN(size)    (((size) + 63) & ~((IceTSizeType)63))
+
+#define ICET_SHM_SLOT(ring, idx)                                        \
+    ((IceTShmSlotHeader *)(  (IceTByte *)(ring)                         \
+                           + ICET_SHM_ALIGN(sizeof(IceTShmRingHeader))  \
+                           + (idx)*(ring)->slot_stride))
+
+#define ICET_SHM_SLOT_DATA(slot)                                        \
+    ((IceTVoid *)((IceTByte *)(slot)                                    \
+                  + ICET_SHM_ALIGN(sizeof(IceTShmSlotHeader))))
+
+#define ICET_SHM_SLOT_PIXELS(slot)                                      \
+    ((IceTVoid *)((IceTByte *)(slot) + (slot)->pixel_offset))
+
+#define ICET_SHM_SLOT_INDEX(ring, sequence)                             \
+    ((IceTInt)(((sequence) - 1)%(IceTUnsignedInt64)(ring)->num_slots))
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ICET_SHM_MEMORY_BARRIER()       __sync_synchronize()
+#else
+#define ICET_SHM_MEMORY_BARRIER()
+#endif
+
+#endif /* __IceTShmLayout_h */
@@ -0,0 +1,129 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* The reader is meant to be linked into processes that have no IceT context,
+ * so nothing in here may call into IceTCore.  Errors are reported through
+ * return values only. */
+
+/* Needed for shm_open and mmap when compiling with -ansi. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceTShm.h>
+
+#include "shm_layout.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct IceTShmReaderStruct {
+    IceTShmRingHeader *ring;
+    size_t mapped_size;
+    IceTUnsignedInt64 last_read;
+};
+
+IceTShmReader icetShmReaderOpen(const char *name)
+{
+    IceTShmReader reader;
+    struct stat file_stat;
+    int fd;
+    void *memory;
+    IceTShmRingHeader *ring;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) { return NULL; }
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)file_stat.st_size < sizeof(IceTShmRingHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* The semaphore lives in the mapping, so it has to be writable. */
+    memory = mmap(NULL, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) { return NULL; }
+
+    ring = (IceTShmRingHeader *)memory;
+    ICET_SHM_MEMORY_BARRIER();
+    if ((ring->magic != ICET_SHM_MAGIC) || (ring->version != ICET_SHM_VERSION)){
+        munmap(memory, (size_t)file_stat.st_size);
+        return NULL;
+    }
+
+    reader = malloc(sizeof(struct IceTShmReaderStruct));
+    reader->ring = ring;
+    reader->mapped_size = (size_t)file_stat.st_size;
+    reader->last_read = 0;
+
+    return reader;
+}
+
+void icetShmReaderClose(IceTShmReader reader)
+{
+    if (reader == NULL) { return; }
+
+    munmap(reader->ring, reader->mapped_size);
+    free(reader);
+}
+
+IceTBoolean icetShmReaderNextFrame(IceTShmReader reader,
+                                   IceTBoolean block,
+                                   IceTShmFrame *frame)
+{
+    IceTShmRingHeader *ring = reader->ring;
+
+    while (1) {
+        IceTUnsignedInt64 sequence;
+        const IceTShmSlotHeader *slot;
+
+        ICET_SHM_MEMORY_BARRIER();
+        sequence = ring->last_sequence;
+
+        if (sequence > reader->last_read) {
+            slot = ICET_SHM_SLOT(ring, ICET_SHM_SLOT_INDEX(ring, sequence));
+            ICET_SHM_MEMORY_BARRIER();
+            if (slot->sequence == sequence) {
+                frame->sequence = sequence;
+                frame->width = slot->width;
+                frame->height = slot->height;
+                frame->color_format = slot->color_format;
+                frame->pixels = ICET_SHM_SLOT_PIXELS(slot);
+                reader->last_read = sequence;
+                return ICET_TRUE;
+            }
+            /* The writer already moved on to the slot.  Look again. */
+            continue;
+        }
+
+        if (!block) { return ICET_FALSE; }
+
+        /* Posts are not consumed one for one when frames are skipped, so a
+           wakeup just means to look at the sequence number again. */
+        if ((sem_wait(&ring->frame_posted) != 0) && (errno != EINTR)) {
+            return ICET_FALSE;
+        }
+    }
+}
+
+IceTBoolean icetShmReaderFrameValid(IceTShmReader reader,
+                                    const IceTShmFrame *frame)
+{
+    const IceTShmSlotHeader *slot
+        = ICET_SHM_SLOT(reader->ring,
+                        ICET_SHM_SLOT_INDEX(reader->ring, frame->sequence));
+    ICET_SHM_MEMORY_BARRIER();
+    return slot->sequence == frame->sequence;
+}
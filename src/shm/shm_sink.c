@@ -0,0 +1,264 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* Needed for shm_open, ftruncate, and mmap when compiling with -ansi. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceTShm.h>
+
+#include <IceTDevDiagnostics.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+#include "shm_layout.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct IceTShmSinkStruct {
+    char *name;
+    IceTShmRingHeader *ring;
+    size_t mapped_size;
+    IceTSizeType color_pixel_size;
+    IceTSizeType slot_data_size;
+    /* Slot handed to IceT by icetShmSinkBeginFrame, or NULL. */
+    IceTShmSlotHeader *begun_slot;
+};
+
+static IceTSizeType shmColorPixelSize(IceTEnum color_format)
+{
+    switch (color_format) {
+      case ICET_IMAGE_COLOR_RGBA_UBYTE: return 4;
+      case ICET_IMAGE_COLOR_RGBA_FLOAT: return 4*sizeof(IceTFloat);
+      case ICET_IMAGE_COLOR_RGB_FLOAT:  return 3*sizeof(IceTFloat);
+      default:
+          icetRaiseError(ICET_INVALID_ENUM,
+                         "Invalid color format 0x%X for shared memory sink.",
+                         color_format);
+          return 0;
+    }
+}
+
+IceTShmSink icetShmSinkCreate(const char *name,
+                              IceTInt num_slots,
+                              IceTSizeType max_width,
+                              IceTSizeType max_height,
+                              IceTEnum color_format)
+{
+    IceTShmSink sink;
+    IceTSizeType color_pixel_size;
+    IceTSizeType slot_data_size;
+    IceTSizeType slot_stride;
+    size_t mapped_size;
+    int fd;
+    void *memory;
+    IceTInt slot;
+
+    if ((num_slots < 1) || (max_width < 1) || (max_height < 1)) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Invalid shared memory sink size.");
+        return NULL;
+    }
+    color_pixel_size = shmColorPixelSize(color_format);
+    if (color_pixel_size == 0) { return NULL; }
+
+    /* Leave room for a whole IceT image with the largest depth buffer so that
+       frames can be composited in place whatever the depth format is. */
+    slot_data_size = icetImageBufferSizeType(color_format,
+                                             ICET_IMAGE_DEPTH_FLOAT,
+                                             max_width, max_height);
+    slot_stride = (  ICET_SHM_ALIGN(sizeof(IceTShmSlotHeader))
+                   + ICET_SHM_ALIGN(slot_data_size) );
+    mapped_size = (  ICET_SHM_ALIGN(sizeof(IceTShmRingHeader))
+                   + (size_t)num_slots*slot_stride );
+
+    /* Never remove an existing object.  It may be the ring of a sink that is
+       still running. */
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        if (errno == EEXIST) {
+            icetRaiseError(ICET_INVALID_OPERATION,
+                           "Shared memory object %s already exists.", name);
+        } else {
+            icetRaiseError(ICET_INVALID_OPERATION,
+                           "Could not create shared memory object %s.", name);
+        }
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)mapped_size) != 0) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not size shared memory object %s.", name);
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        icetRaiseError(ICET_OUT_OF_MEMORY,
+                       "Could not map shared memory object %s.", name);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    sink = malloc(sizeof(struct IceTShmSinkStruct));
+    sink->name = malloc(strlen(name) + 1);
+    strcpy(sink->name, name);
+    sink->ring = (IceTShmRingHeader *)memory;
+    sink->mapped_size = mapped_size;
+    sink->color_pixel_size = color_pixel_size;
+    sink->slot_data_size = slot_data_size;
+    sink->begun_slot = NULL;
+
+    sink->ring->num_slots = num_slots;
+    sink->ring->color_format = color_format;
+    sink->ring->max_width = max_width;
+    sink->ring->max_height = max_height;
+    sink->ring->slot_stride = slot_stride;
+    sink->ring->last_sequence = 0;
+    sem_init(&sink->ring->frame_posted, 1, 0);
+    for (slot = 0; slot < num_slots; slot++) {
+        ICET_SHM_SLOT(sink->ring, slot)->sequence = 0;
+    }
+
+    /* Readers check the magic number last, so set it after everything else
+       is in place. */
+    sink->ring->version = ICET_SHM_VERSION;
+    ICET_SHM_MEMORY_BARRIER();
+    sink->ring->magic = ICET_SHM_MAGIC;
+
+    return sink;
+}
+
+void icetShmSinkDestroy(IceTShmSink sink)
+{
+    if (sink == NULL) { return; }
+
+    if (sink->begun_slot != NULL) {
+        icetStateSetPointer(ICET_DISPLAY_IMAGE_BUFFER, NULL);
+        icetStateSetInteger(ICET_DISPLAY_IMAGE_BUFFER_SIZE, 0);
+    }
+
+    sink->ring->magic = 0;
+    sem_destroy(&sink->ring->frame_posted);
+    munmap(sink->ring, sink->mapped_size);
+    shm_unlink(sink->name);
+
+    free(sink->name);
+    free(sink);
+}
+
+/* Returns the slot that the next frame goes in after marking it as in flux,
+   so that a reader still holding the frame that used to be there can tell
+   it was overwritten. */
+static IceTShmSlotHeader *shmSinkNextSlot(IceTShmSink sink)
+{
+    IceTShmRingHeader *ring = sink->ring;
+    IceTShmSlotHeader *slot;
+
+    slot = ICET_SHM_SLOT(ring, ICET_SHM_SLOT_INDEX(ring,
+                                                   ring->last_sequence + 1));
+    slot->sequence = 0;
+    ICET_SHM_MEMORY_BARRIER();
+
+    return slot;
+}
+
+void icetShmSinkBeginFrame(IceTShmSink sink)
+{
+    sink->begun_slot = shmSinkNextSlot(sink);
+    icetStateSetPointer(ICET_DISPLAY_IMAGE_BUFFER,
+                        ICET_SHM_SLOT_DATA(sink->begun_slot));
+    icetStateSetInteger(ICET_DISPLAY_IMAGE_BUFFER_SIZE, sink->slot_data_size);
+}
+
+IceTUnsignedInt64 icetShmSinkWriteImage(IceTShmSink sink,
+                                        const IceTImage image)
+{
+    IceTShmRingHeader *ring = sink->ring;
+    IceTUnsignedInt64 sequence;
+    IceTShmSlotHeader *slot;
+    IceTSizeType width;
+    IceTSizeType height;
+    const IceTByte *colors;
+    const IceTByte *slot_data;
+    int pending;
+
+    /* The slot is only lent to IceT for one frame. */
+    slot = sink->begun_slot;
+    if (slot != NULL) {
+        icetStateSetPointer(ICET_DISPLAY_IMAGE_BUFFER, NULL);
+        icetStateSetInteger(ICET_DISPLAY_IMAGE_BUFFER_SIZE, 0);
+        sink->begun_slot = NULL;
+    }
+
+    if (icetImageIsNull(image)) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Cannot write a null image to the frame sink.");
+        return 0;
+    }
+    if (icetImageGetColorFormat(image) != ring->color_format) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Image color format 0x%X does not match frame sink"
+                       " format 0x%X.",
+                       icetImageGetColorFormat(image), ring->color_format);
+        return 0;
+    }
+    width = icetImageGetWidth(image);
+    height = icetImageGetHeight(image);
+    if ((width > ring->max_width) || (height > ring->max_height)) {
+        icetRaiseError(ICET_INVALID_VALUE,
+                       "Image of size %dx%d does not fit in frame sink.",
+                       (int)width, (int)height);
+        return 0;
+    }
+
+    sequence = ring->last_sequence + 1;
+    if (slot == NULL) {
+        slot = shmSinkNextSlot(sink);
+    }
+
+    slot->width = width;
+    slot->height = height;
+    slot->color_format = ring->color_format;
+
+    /* If icetShmSinkBeginFrame was called before drawing, IceT composited
+       the frame straight into the slot and there is nothing to copy.
+       Otherwise (or if the frame ended up in another buffer, as when frames
+       are accumulated) copy the colors in. */
+    colors = icetImageGetColorConstVoid(image, NULL);
+    slot_data = ICET_SHM_SLOT_DATA(slot);
+    if (   (colors >= slot_data)
+        && (colors < slot_data + sink->slot_data_size) ) {
+        slot->pixel_offset = (IceTSizeType)(colors - (const IceTByte *)slot);
+    } else {
+        slot->pixel_offset = (IceTSizeType)(slot_data - (const IceTByte *)slot);
+        memcpy(ICET_SHM_SLOT_PIXELS(slot),
+               colors,
+               sink->color_pixel_size*width*height);
+    }
+
+    ICET_SHM_MEMORY_BARRIER();
+    slot->sequence = sequence;
+    ICET_SHM_MEMORY_BARRIER();
+    ring->last_sequence = sequence;
+
+    /* A wakeup only tells the reader to look at last_sequence again, so one
+       pending post is enough.  Posting for every frame would let the count
+       grow without bound when the reader polls without blocking. */
+    if ((sem_getvalue(&ring->frame_posted, &pending) != 0) || (pending < 1)) {
+        sem_post(&ring->frame_posted);
+    }
+
+    return sequence;
+}
@@ -547,16 +547,22 @@ static void icetDoSendRecvLarge(const IceTInt *sendIds,
             if (finished) break;
         }
 
-        /* Wait for some some message to come in before continuing. */ {
-            int request_finished_idx = icetCommWaitany(2, requests);
-            if (request_finished_idx == RECV_IDX) {
-                IceTInt src_rank;
-                if (messagesInOrder) {
-                    src_rank = composite_order[recv_order_idx];
-                } else {
-                    src_rank = recv_iter_state;
+        /* Wait for some message to come in before continuing.  If both the
+           send and the receive finished, catch them both so that the next
+           send and receive are posted together. */ {
+            int finished_indices[2];
+            int num_finished = icetCommWaitsome(2, requests, finished_indices);
+            int i;
+            for (i = 0; i < num_finished; i++) {
+                if (finished_indices[i] == RECV_IDX) {
+                    IceTInt src_rank;
+                    if (messagesInOrder) {
+                        src_rank = composite_order[recv_order_idx];
+                    } else {
+                        src_rank = recv_order_idx;
+                    }
+                    (*handleDataFunc)(incomingBuffer, src_rank);
                 }
-                (*handleDataFunc)(incomingBuffer, src_rank);
             }
         }
     }
@@ -609,6 +615,60 @@ void icetSingleImageCompose(const IceTInt *compose_group,
                                   piece_offset);
 }
 
+IceTBoolean icetSingleImageComposeCollect(const IceTInt *compose_group,
+                                          IceTInt group_size,
+                                          IceTInt image_dest,
+                                          IceTSparseImage input_image,
+                                          IceTImage result_image)
+{
+    IceTEnum strategy;
+    IceTBoolean collected;
+
+    if (!icetIsEnabled(ICET_FUSE_COLLECT)) {
+        return ICET_FALSE;
+    }
+
+    icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &strategy);
+
+    collected = icetInvokeSingleImageStrategyCollect(strategy,
+                                                     compose_group,
+                                                     group_size,
+                                                     image_dest,
+                                                     input_image,
+                                                     result_image);
+
+    return collected;
+}
+
+IceTInt icetSingleImageMagicK(void)
+{
+    IceTInt magic_k;
+    IceTInt memory_budget;
+    IceTInt tile_width;
+    IceTInt tile_height;
+    IceTUnsignedInt64 round_bytes;
+    IceTUnsignedInt64 budget_k;
+
+    icetGetIntegerv(ICET_MAGIC_K, &magic_k);
+    icetGetIntegerv(ICET_MEMORY_BUDGET, &memory_budget);
+    if (memory_budget <= 0) { return magic_k; }
+
+    icetGetIntegerv(ICET_TILE_MAX_WIDTH, &tile_width);
+    icetGetIntegerv(ICET_TILE_MAX_HEIGHT, &tile_height);
+    /* One send and one receive buffer per partner. */
+    round_bytes = 2*(IceTUnsignedInt64)icetSparseImageBufferSize(tile_width,
+                                                                 tile_height);
+    budget_k = (IceTUnsignedInt64)memory_budget*1024*1024/round_bytes;
+
+    if (budget_k < 2) { budget_k = 2; }
+    if (budget_k < (IceTUnsignedInt64)magic_k) {
+        icetRaiseDebug("Lowering k to %d to fit memory budget.", (int)budget_k);
+        return (IceTInt)budget_k;
+    } else {
+        return magic_k;
+    }
+}
+
 #define ICET_IMAGE_COLLECT_OFFSET_BUF ICET_STRATEGY_COMMON_BUF_0
 #define ICET_IMAGE_COLLECT_SIZE_BUF ICET_STRATEGY_COMMON_BUF_1
 
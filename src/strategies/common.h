@@ -167,6 +167,32 @@ void icetSingleImageCompose(const IceTInt *compose_group,
                             IceTSparseImage *result_image,
                             IceTSizeType *piece_offset);
 
+/* icetSingleImageComposeCollect
+
+   Like icetSingleImageCompose followed by icetSingleImageCollect to
+   compose_group[image_dest], but with the last round of compositing and the
+   collection done in one step.  Only happens when ICET_FUSE_COLLECT is
+   enabled and the single image strategy supports it, in which case this
+   returns ICET_TRUE and the image is in result_image on the destination
+   process.  Otherwise this returns ICET_FALSE without doing anything and the
+   caller should compose and collect as usual.  Unlike icetSingleImageCollect,
+   only the processes in compose_group take part. */
+IceTBoolean icetSingleImageComposeCollect(const IceTInt *compose_group,
+                                          IceTInt group_size,
+                                          IceTInt image_dest,
+                                          IceTSparseImage input_image,
+                                          IceTImage result_image);
+
+/* icetSingleImageMagicK
+
+   Returns the ICET_MAGIC_K that single image strategies should aim for.  When
+   ICET_MEMORY_BUDGET is set, the value is lowered so that a round sending and
+   receiving k sparse images as big as the largest tile fits in the budget.
+   Smaller k means more rounds but less buffer memory for rounds that no
+   longer split the image.  Never returns less than 2.  All processes get the
+   same value as long as they have the same budget. */
+IceTInt icetSingleImageMagicK(void);
+
 /* icetSingleImageCollect
 
    Collects image partitions distributed amongst processes.  The intension is to
@@ -42,8 +42,8 @@ IceTImage icetDirectCompose(void)
 
     sparseImageSize = icetSparseImageBufferSize(max_width, max_height);
 
-    image               = icetGetStateBufferImage(DIRECT_IMAGE_BUFFER,
-                                                  max_width, max_height);
+    image               = icetGetDisplayImage(DIRECT_IMAGE_BUFFER,
+                                              max_width, max_height);
     inSparseImageBuffer = icetGetStateBuffer(DIRECT_IN_SPARSE_IMAGE_BUFFER,
                                              sparseImageSize);
     outSparseImage      = icetGetStateBufferSparseImage(
@@ -0,0 +1,461 @@
+/* -*- c -*- *******************************************************/
+/*
+ * Copyright (C) 2014 Sandia Corporation
+ * Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+ * the U.S. Government retains certain rights in this software.
+ *
+ * This source code is released under the New BSD License.
+ */
+
+/* The in transit strategy splits the processes into renderers and
+ * compositors.  The compositors are given with icetCompositorGroup and never
+ * render.  Every renderer ships its images to one compositor and is then
+ * free to go on to the next frame (or whatever else the application wants to
+ * do).  Each compositor first blends the images of its block of renderers
+ * and then the compositors run the single image strategy amongst
+ * themselves on a communicator that holds just the compositors and the
+ * display nodes. */
+
+#include <IceT.h>
+
+#include <IceTDevCommunication.h>
+#include <IceTDevContext.h>
+#include <IceTDevDiagnostics.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+#include <IceTDevStrategySelect.h>
+#include "common.h"
+
+#define INTRANSIT_RENDERED_IMAGE_BUFFER         ICET_STRATEGY_BUFFER_0
+#define INTRANSIT_IN_IMAGE_BUFFER               ICET_STRATEGY_BUFFER_1
+#define INTRANSIT_ACCUMULATE_IMAGE_BUFFER_0     ICET_STRATEGY_BUFFER_2
+#define INTRANSIT_ACCUMULATE_IMAGE_BUFFER_1     ICET_STRATEGY_BUFFER_3
+#define INTRANSIT_FINAL_IMAGE_BUFFER            ICET_STRATEGY_BUFFER_4
+#define INTRANSIT_INTERMEDIATE_IMAGE_BUFFER     ICET_STRATEGY_BUFFER_5
+#define INTRANSIT_RENDERERS_BUFFER              ICET_STRATEGY_BUFFER_6
+#define INTRANSIT_COMPOSITOR_INDEX_BUFFER       ICET_STRATEGY_BUFFER_7
+#define INTRANSIT_SUBSET_BUFFER                 ICET_STRATEGY_BUFFER_8
+#define INTRANSIT_COMPOSE_GROUP_BUFFER          ICET_STRATEGY_BUFFER_9
+#define INTRANSIT_SEND_REQUEST_BUFFER           ICET_STRATEGY_BUFFER_10
+
+#define INTRANSIT_IMAGE_TAG     2400
+
+extern IceTImage icetSequentialCompose(void);
+
+/* Lists the processes of the in transit communicator: the compositors (in
+ * the order of the compositor group) followed by the display nodes that are
+ * not also compositors.  Returns the number of processes listed. */
+static IceTInt intransitBuildSubset(const IceTInt *compositor_index,
+                                    IceTInt *subset)
+{
+    IceTInt num_compositors;
+    const IceTInt *compositors;
+    IceTInt num_tiles;
+    const IceTInt *display_nodes;
+    IceTInt subset_size;
+    IceTInt tile;
+
+    icetGetIntegerv(ICET_COMPOSITOR_GROUP_SIZE, &num_compositors);
+    compositors = icetUnsafeStateGetInteger(ICET_COMPOSITOR_GROUP);
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    display_nodes = icetUnsafeStateGetInteger(ICET_DISPLAY_NODES);
+
+    for (subset_size = 0; subset_size < num_compositors; subset_size++) {
+        subset[subset_size] = compositors[subset_size];
+    }
+    for (tile = 0; tile < num_tiles; tile++) {
+        IceTInt d_node = display_nodes[tile];
+        IceTInt i;
+        if (compositor_index[d_node] >= 0) continue;
+        for (i = num_compositors; i < subset_size; i++) {
+            if (subset[i] == d_node) break;
+        }
+        if (i == subset_size) {
+            subset[subset_size] = d_node;
+            subset_size++;
+        }
+    }
+
+    return subset_size;
+}
+
+/* Returns the communicator for the processes in subset, which is NULL on
+ * processes outside of it.  It is built with a collective call, so every
+ * process must decide to rebuild it the same way.  That is why the decision
+ * only looks at state times and not at the pointer. */
+static IceTCommunicator intransitGetCommunicator(const IceTInt *subset,
+                                                 IceTInt subset_size)
+{
+    IceTVoid *value;
+    IceTCommunicator in_transit_comm;
+    IceTTimeStamp comm_time;
+
+    icetGetPointerv(ICET_IN_TRANSIT_COMMUNICATOR, &value);
+    in_transit_comm = (IceTCommunicator)value;
+    comm_time = icetStateGetTime(ICET_IN_TRANSIT_COMMUNICATOR);
+    if (   (comm_time > icetStateGetTime(ICET_COMPOSITOR_GROUP))
+        && (comm_time > icetStateGetTime(ICET_DISPLAY_NODES)) ) {
+        return in_transit_comm;
+    }
+
+    if (in_transit_comm != NULL) {
+        in_transit_comm->Destroy(in_transit_comm);
+    }
+
+    icetRaiseDebug("Building in transit communicator of %d processes.",
+                   subset_size);
+    in_transit_comm = icetCommSubset(subset_size, subset);
+    icetStateSetPointer(ICET_IN_TRANSIT_COMMUNICATOR, in_transit_comm);
+    return in_transit_comm;
+}
+
+/* Returns the rank of process in the in transit communicator.  Only valid for
+ * compositors and display nodes. */
+static IceTInt intransitSubsetRank(const IceTInt *subset, IceTInt process)
+{
+    IceTInt i;
+    for (i = 0; subset[i] != process; i++);
+    return i;
+}
+
+/* Starts sending the image of every contained tile to compositor and returns
+ * the number of send requests placed in *requests_p.  The sends must not
+ * block: a renderer that is also a display node has to take part in the
+ * collection of one tile while its image of a later tile is still waiting
+ * for the compositor to get to it.  The caller waits on the requests once it
+ * is done with all the tiles. */
+static IceTInt intransitSendImages(IceTInt compositor,
+                                   IceTCommRequest **requests_p)
+{
+    IceTInt num_tiles;
+    IceTInt num_contained_tiles;
+    IceTInt max_width, max_height;
+    const IceTBoolean *contained_tiles;
+    IceTSizeType image_buffer_size;
+    IceTByte *image_buffers;
+    IceTCommRequest *requests;
+    IceTInt num_requests;
+    IceTInt tile;
+
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    icetGetIntegerv(ICET_NUM_CONTAINED_TILES, &num_contained_tiles);
+    icetGetIntegerv(ICET_TILE_MAX_WIDTH, &max_width);
+    icetGetIntegerv(ICET_TILE_MAX_HEIGHT, &max_height);
+    contained_tiles = icetUnsafeStateGetBoolean(ICET_CONTAINED_TILES_MASK);
+
+    /* Each image stays in its own buffer until its send finishes. */
+    image_buffer_size = icetSparseImageBufferSize(max_width, max_height);
+    image_buffers = icetGetStateBuffer(INTRANSIT_RENDERED_IMAGE_BUFFER,
+                                       image_buffer_size*num_contained_tiles);
+    requests = icetGetStateBuffer(INTRANSIT_SEND_REQUEST_BUFFER,
+                                  sizeof(IceTCommRequest)*num_contained_tiles);
+
+    /* The compositor receives the tiles in order, which matches the order of
+     * the sends. */
+    num_requests = 0;
+    for (tile = 0; tile < num_tiles; tile++) {
+        IceTSparseImage rendered_image;
+        IceTVoid *package_buffer;
+        IceTSizeType package_size;
+
+        if (!contained_tiles[tile]) continue;
+
+        rendered_image = icetSparseImageAssignBuffer(
+                                   image_buffers
+                                   + num_requests*image_buffer_size,
+                                   max_width,
+                                   max_height);
+        icetGetCompressedTileImage(tile, rendered_image);
+        icetSparseImagePackageForSend(rendered_image,
+                                      &package_buffer, &package_size);
+        icetRaiseDebug("Sending tile %d to compositor %d.",
+                       tile, compositor);
+        requests[num_requests]
+            = icetCommIsend(package_buffer, package_size, ICET_BYTE,
+                            compositor, INTRANSIT_IMAGE_TAG);
+        num_requests++;
+    }
+
+    *requests_p = requests;
+    return num_requests;
+}
+
+/* Blends the images of tile from the renderers in block (which are listed
+ * front to back) and returns the result. */
+static IceTSparseImage intransitReceiveImages(IceTInt tile,
+                                              const IceTInt *block,
+                                              IceTInt block_size)
+{
+    const IceTInt *tile_viewports;
+    const IceTBoolean *all_contained_tiles_masks;
+    IceTInt num_tiles;
+    IceTSizeType tile_width, tile_height;
+    IceTVoid *in_buffer;
+    IceTSizeType in_buffer_size;
+    IceTSparseImage accumulate_images[2];
+    IceTSparseImage result_image;
+    IceTInt accumulate_index;
+    IceTInt i;
+
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    tile_viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
+    all_contained_tiles_masks
+        = icetUnsafeStateGetBoolean(ICET_ALL_CONTAINED_TILES_MASKS);
+    tile_width = tile_viewports[4*tile + 2];
+    tile_height = tile_viewports[4*tile + 3];
+
+    in_buffer_size = icetSparseImageBufferSize(tile_width, tile_height);
+    in_buffer = icetGetStateBuffer(INTRANSIT_IN_IMAGE_BUFFER, in_buffer_size);
+    accumulate_images[0]
+        = icetGetStateBufferSparseImage(INTRANSIT_ACCUMULATE_IMAGE_BUFFER_0,
+                                        tile_width, tile_height);
+    accumulate_images[1]
+        = icetGetStateBufferSparseImage(INTRANSIT_ACCUMULATE_IMAGE_BUFFER_1,
+                                        tile_width, tile_height);
+
+    result_image = icetSparseImageNull();
+    accumulate_index = 0;
+    for (i = 0; i < block_size; i++) {
+        IceTInt renderer = block[i];
+        IceTSparseImage in_image;
+
+        if (!all_contained_tiles_masks[renderer*num_tiles + tile]) continue;
+
+        icetRaiseDebug("Receiving tile %d from renderer %d.", tile, renderer);
+        icetCommRecv(in_buffer, in_buffer_size, ICET_BYTE,
+                     renderer, INTRANSIT_IMAGE_TAG);
+        in_image = icetSparseImageUnpackageFromReceive(in_buffer);
+
+        if (icetSparseImageIsNull(result_image)) {
+            /* The receive buffer is reused for the next image, so copy the
+               first one out of it. */
+            icetSparseImageCopyPixels(in_image,
+                                      0,
+                                      icetSparseImageGetNumPixels(in_image),
+                                      accumulate_images[accumulate_index]);
+        } else {
+            icetCompressedCompressedComposite(
+                                         result_image,
+                                         in_image,
+                                         accumulate_images[accumulate_index]);
+        }
+        result_image = accumulate_images[accumulate_index];
+        accumulate_index = 1 - accumulate_index;
+    }
+
+    if (icetSparseImageIsNull(result_image)) {
+        /* Nothing in this block touched the tile. */
+        result_image = accumulate_images[0];
+        icetClearSparseImage(result_image);
+    }
+
+    return result_image;
+}
+
+IceTImage icetInTransitCompose(void)
+{
+    IceTInt num_tiles;
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt num_compositors;
+    const IceTInt *compositors;
+    const IceTInt *display_nodes;
+    const IceTInt *tile_viewports;
+    IceTBoolean ordered_composite;
+    IceTBoolean image_collect;
+    IceTInt *compositor_index;
+    IceTInt *renderers;
+    IceTInt num_renderers;
+    IceTInt *compose_group;
+    IceTInt *subset;
+    IceTInt subset_size;
+    IceTCommunicator in_transit_comm;
+    IceTCommunicator saved_comm;
+    IceTImage my_image;
+    IceTInt my_compositor_index;
+    IceTInt block_start, block_end;
+    IceTCommRequest *send_requests;
+    IceTInt num_send_requests;
+    IceTInt i;
+
+    icetGetIntegerv(ICET_COMPOSITOR_GROUP_SIZE, &num_compositors);
+    if (num_compositors < 1) {
+        icetRaiseWarning(ICET_INVALID_OPERATION,
+                         "In transit strategy needs a compositor group."
+                         "  Using sequential strategy instead.");
+        return icetSequentialCompose();
+    }
+
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    compositors = icetUnsafeStateGetInteger(ICET_COMPOSITOR_GROUP);
+    display_nodes = icetUnsafeStateGetInteger(ICET_DISPLAY_NODES);
+    tile_viewports = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
+    ordered_composite = icetIsEnabled(ICET_ORDERED_COMPOSITE);
+    image_collect = icetIsEnabled(ICET_COLLECT_IMAGES);
+
+    if (!image_collect && (num_tiles > 1)) {
+        icetRaiseWarning(ICET_INVALID_OPERATION,
+                         "In transit strategy must collect images with more"
+                         " than one tile.");
+        image_collect = ICET_TRUE;
+    }
+
+    compositor_index = icetGetStateBuffer(INTRANSIT_COMPOSITOR_INDEX_BUFFER,
+                                          sizeof(IceTInt)*num_proc);
+    for (i = 0; i < num_proc; i++) {
+        compositor_index[i] = -1;
+    }
+    for (i = 0; i < num_compositors; i++) {
+        compositor_index[compositors[i]] = i;
+    }
+    my_compositor_index = compositor_index[rank];
+
+    /* The renderers, in the order their images must be blended. */
+    renderers = icetGetStateBuffer(INTRANSIT_RENDERERS_BUFFER,
+                                   sizeof(IceTInt)*num_proc);
+    num_renderers = 0;
+    for (i = 0; i < num_proc; i++) {
+        IceTInt process;
+        if (ordered_composite) {
+            process = icetUnsafeStateGetInteger(ICET_COMPOSITE_ORDER)[i];
+        } else {
+            process = i;
+        }
+        if (compositor_index[process] < 0) {
+            renderers[num_renderers] = process;
+            num_renderers++;
+        }
+    }
+
+    subset = icetGetStateBuffer(INTRANSIT_SUBSET_BUFFER,
+                                sizeof(IceTInt)*(num_compositors+num_tiles));
+    subset_size = intransitBuildSubset(compositor_index, subset);
+    in_transit_comm = intransitGetCommunicator(subset, subset_size);
+
+    if (my_compositor_index < 0) {
+        /* Renderer k sends to compositor k*C/R, which gives every compositor
+           a contiguous block of renderers in blending order. */
+        for (i = 0; renderers[i] != rank; i++);
+        num_send_requests = intransitSendImages(
+                               compositors[(i*num_compositors)/num_renderers],
+                               &send_requests);
+        block_start = block_end = 0;
+    } else {
+        send_requests = NULL;
+        num_send_requests = 0;
+        /* Invert k*C/R to find the block of renderers sending here. */
+        block_start = (  (my_compositor_index*num_renderers + num_compositors-1)
+                       / num_compositors );
+        block_end = (  ((my_compositor_index+1)*num_renderers
+                        + num_compositors-1)
+                     / num_compositors );
+    }
+
+    if (!image_collect) {
+        icetStateSetInteger(ICET_VALID_PIXELS_TILE, -1);
+        icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, 0);
+        icetStateSetInteger(ICET_VALID_PIXELS_NUM, 0);
+    }
+    my_image = icetImageNull();
+
+    if (in_transit_comm == NULL) {
+        /* A renderer with no tile to display is done once its images are
+           out. */
+        icetCommWaitall(num_send_requests, send_requests);
+        return my_image;
+    }
+
+    compose_group = icetGetStateBuffer(INTRANSIT_COMPOSE_GROUP_BUFFER,
+                                       sizeof(IceTInt)*num_compositors);
+    for (i = 0; i < num_compositors; i++) {
+        compose_group[i] = i;
+    }
+
+    for (i = 0; i < num_tiles; i++) {
+        IceTInt d_node = display_nodes[i];
+        IceTSizeType tile_width = tile_viewports[4*i + 2];
+        IceTSizeType tile_height = tile_viewports[4*i + 3];
+        IceTSparseImage composited_image;
+        IceTSizeType piece_offset;
+        IceTSparseImage block_image;
+
+        /* The renderers are addressed by their rank in the full
+           communicator, so receive before switching communicators. */
+        if (my_compositor_index >= 0) {
+            block_image = intransitReceiveImages(i,
+                                                 renderers + block_start,
+                                                 block_end - block_start);
+        } else {
+            block_image = icetSparseImageNull();
+        }
+
+        saved_comm = icetSetCommunicator(in_transit_comm);
+
+        if (my_compositor_index >= 0) {
+            IceTInt image_dest;
+            IceTEnum strategy;
+
+            /* The compose group is already in the order of the in transit
+               communicator, so call the strategy directly rather than
+               through icetSingleImageCompose, which would translate it
+               again. */
+            image_dest = compositor_index[d_node];
+            if (image_dest < 0) image_dest = 0;
+            icetGetEnumv(ICET_SINGLE_IMAGE_STRATEGY, &strategy);
+            icetInvokeSingleImageStrategy(strategy,
+                                          compose_group,
+                                          num_compositors,
+                                          image_dest,
+                                          block_image,
+                                          &composited_image,
+                                          &piece_offset);
+        } else {
+            composited_image = icetSparseImageNull();
+            piece_offset = 0;
+        }
+
+        if (image_collect) {
+            IceTImage tile_image;
+
+            if (d_node == rank) {
+                tile_image = icetGetDisplayImage(INTRANSIT_FINAL_IMAGE_BUFFER,
+                                                 tile_width, tile_height);
+            } else {
+                tile_image = icetGetStateBufferImage(
+                                            INTRANSIT_INTERMEDIATE_IMAGE_BUFFER,
+                                            tile_width, tile_height);
+            }
+
+            icetSingleImageCollect(composited_image,
+                                   intransitSubsetRank(subset, d_node),
+                                   piece_offset,
+                                   tile_image);
+
+            if (d_node == rank) {
+                my_image = tile_image;
+            }
+        } else { /* !image_collect */
+            IceTSizeType piece_size
+                = icetSparseImageGetNumPixels(composited_image);
+            if (piece_size > 0) {
+                my_image = icetGetStateBufferImage(
+                                                  INTRANSIT_FINAL_IMAGE_BUFFER,
+                                                  tile_width, tile_height);
+                icetDecompressSubImageCorrectBackground(composited_image,
+                                                        piece_offset,
+                                                        my_image);
+                icetStateSetInteger(ICET_VALID_PIXELS_TILE, i);
+                icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, piece_offset);
+                icetStateSetInteger(ICET_VALID_PIXELS_NUM, piece_size);
+            }
+        }
+
+        icetSetCommunicator(saved_comm);
+    }
+
+    icetCommWaitall(num_send_requests, send_requests);
+
+    return my_image;
+}
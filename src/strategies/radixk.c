@@ -30,10 +30,13 @@
 #include <IceTDevDiagnostics.h>
 #include <IceTDevImage.h>
 
+#include "common.h"
+
 /* #define RADIXK_USE_TELESCOPE */
 
 #define RADIXK_SWAP_IMAGE_TAG_START     2200
 #define RADIXK_TELESCOPE_IMAGE_TAG      2300
+#define RADIXK_COLLECT_IMAGE_TAG        2350
 
 #define RADIXK_RECEIVE_BUFFER                   ICET_SI_STRATEGY_BUFFER_0
 #define RADIXK_SEND_BUFFER                      ICET_SI_STRATEGY_BUFFER_1
@@ -46,6 +49,8 @@
 #define RADIXK_SPLIT_OFFSET_ARRAY_BUFFER        ICET_SI_STRATEGY_BUFFER_8
 #define RADIXK_SPLIT_IMAGE_ARRAY_BUFFER         ICET_SI_STRATEGY_BUFFER_9
 #define RADIXK_RANK_LIST_BUFFER                 ICET_SI_STRATEGY_BUFFER_10
+#define RADIXK_RECEIVE_INDEX_BUFFER             ICET_SI_STRATEGY_BUFFER_11
+#define RADIXK_COLLECT_PIECE_BUFFER             ICET_SI_STRATEGY_BUFFER_12
 
 typedef struct radixkRoundInfoStruct {
     IceTInt k; /* k value for this round. */
@@ -60,6 +65,21 @@ typedef struct radixkInfoStruct {
     IceTInt num_rounds;
 } radixkInfo;
 
+/* The rounds computed by radixkGetK are remembered in ICET_RADIXK_SCHEDULE so
+   that they are not factored again every frame.  The schedule is an integer
+   array of up to RADIXK_SCHEDULE_MAX_ENTRIES entries, most recent first.  Each
+   entry has a header holding the inputs it was built from followed by the
+   fields of each round.  Several entries are kept because one frame asks for
+   more than one group size when telescoping or when compositing several
+   tiles. */
+#define RADIXK_SCHEDULE_GROUP_SIZE      0
+#define RADIXK_SCHEDULE_GROUP_RANK      1
+#define RADIXK_SCHEDULE_MAGIC_K         2
+#define RADIXK_SCHEDULE_NUM_ROUNDS      3
+#define RADIXK_SCHEDULE_HEADER_SIZE     4
+#define RADIXK_SCHEDULE_ROUND_SIZE      5
+#define RADIXK_SCHEDULE_MAX_ENTRIES     4
+
 typedef struct radixkPartnerInfoStruct {
     IceTInt rank; /* Rank of partner. */
     IceTSizeType offset; /* Offset of partner's partition in image. */
@@ -176,6 +196,134 @@ static void radixkGetPartitionIndices(radixkInfo info,
 
 }
 
+/* radixkLoadSchedule
+
+   Copies the rounds remembered by radixkStoreSchedule into the factors array
+   buffer if an entry was built for the same inputs.  ICET_MAX_IMAGE_SPLIT is
+   checked with its time stamp.  The magic k is compared by value because
+   icetSingleImageMagicK derives it from several state variables.
+
+   returns:
+     ICET_TRUE if info was filled from the schedule.
+*/
+static IceTBoolean radixkLoadSchedule(IceTInt compose_group_size,
+                                      IceTInt group_rank,
+                                      IceTInt magic_k,
+                                      radixkInfo *info)
+{
+    const IceTInt *schedule;
+    const IceTInt *schedule_end;
+    IceTInt current_round;
+
+    if (  icetStateGetTime(ICET_MAX_IMAGE_SPLIT)
+        > icetStateGetTime(ICET_RADIXK_SCHEDULE) ) {
+        return ICET_FALSE;
+    }
+
+    schedule = icetUnsafeStateGetInteger(ICET_RADIXK_SCHEDULE);
+    schedule_end = schedule + icetStateGetNumEntries(ICET_RADIXK_SCHEDULE);
+    while (   (schedule < schedule_end)
+           && (   (schedule[RADIXK_SCHEDULE_GROUP_SIZE] != compose_group_size)
+               || (schedule[RADIXK_SCHEDULE_GROUP_RANK] != group_rank)
+               || (schedule[RADIXK_SCHEDULE_MAGIC_K] != magic_k) ) ) {
+        schedule += RADIXK_SCHEDULE_HEADER_SIZE
+            + RADIXK_SCHEDULE_ROUND_SIZE*schedule[RADIXK_SCHEDULE_NUM_ROUNDS];
+    }
+    if (schedule >= schedule_end) {
+        return ICET_FALSE;
+    }
+
+    /* Allocate the same size as radixkGetK so that the buffer does not change
+       whether or not the schedule is reused. */
+    info->num_rounds = schedule[RADIXK_SCHEDULE_NUM_ROUNDS];
+    info->rounds = icetGetStateBuffer(
+                       RADIXK_FACTORS_ARRAY_BUFFER,
+                       sizeof(radixkRoundInfo)
+                       * radixkFindFloorPow2(compose_group_size));
+    schedule += RADIXK_SCHEDULE_HEADER_SIZE;
+    for (current_round = 0;
+         current_round < info->num_rounds;
+         current_round++) {
+        radixkRoundInfo *round_info = &info->rounds[current_round];
+        round_info->k = schedule[0];
+        round_info->step = schedule[1];
+        round_info->split = (IceTBoolean)schedule[2];
+        round_info->has_image = (IceTBoolean)schedule[3];
+        round_info->partition_index = schedule[4];
+        schedule += RADIXK_SCHEDULE_ROUND_SIZE;
+    }
+
+    return ICET_TRUE;
+}
+
+/* radixkStoreSchedule
+
+   Puts the rounds in info at the front of ICET_RADIXK_SCHEDULE, keeping the
+   most recent of the other entries.  Entries built before
+   ICET_MAX_IMAGE_SPLIT last changed are dropped, since the new entry makes
+   the schedule look newer than that change.
+*/
+static void radixkStoreSchedule(IceTInt compose_group_size,
+                                IceTInt group_rank,
+                                IceTInt magic_k,
+                                const radixkInfo *info)
+{
+    const IceTInt *old_schedule = NULL;
+    IceTInt old_size = 0;
+    IceTInt new_size;
+    IceTInt *new_schedule;
+    IceTInt *schedule;
+    IceTInt current_round;
+
+    if (  icetStateGetTime(ICET_MAX_IMAGE_SPLIT)
+        <= icetStateGetTime(ICET_RADIXK_SCHEDULE) ) {
+        IceTInt num_old = icetStateGetNumEntries(ICET_RADIXK_SCHEDULE);
+        IceTInt num_kept;
+        old_schedule = icetUnsafeStateGetInteger(ICET_RADIXK_SCHEDULE);
+        for (num_kept = 1;
+             (num_kept < RADIXK_SCHEDULE_MAX_ENTRIES) && (old_size < num_old);
+             num_kept++) {
+            old_size += RADIXK_SCHEDULE_HEADER_SIZE
+                + (RADIXK_SCHEDULE_ROUND_SIZE
+                   * old_schedule[old_size + RADIXK_SCHEDULE_NUM_ROUNDS]);
+        }
+    }
+
+    new_size = RADIXK_SCHEDULE_HEADER_SIZE
+        + RADIXK_SCHEDULE_ROUND_SIZE*info->num_rounds;
+    new_schedule = malloc((new_size + old_size)*sizeof(IceTInt));
+    if (new_schedule == NULL) {
+        /* The schedule is only a shortcut, so just do not remember it. */
+        return;
+    }
+
+    schedule = new_schedule;
+    schedule[RADIXK_SCHEDULE_GROUP_SIZE] = compose_group_size;
+    schedule[RADIXK_SCHEDULE_GROUP_RANK] = group_rank;
+    schedule[RADIXK_SCHEDULE_MAGIC_K] = magic_k;
+    schedule[RADIXK_SCHEDULE_NUM_ROUNDS] = info->num_rounds;
+    schedule += RADIXK_SCHEDULE_HEADER_SIZE;
+    for (current_round = 0;
+         current_round < info->num_rounds;
+         current_round++) {
+        const radixkRoundInfo *round_info = &info->rounds[current_round];
+        schedule[0] = round_info->k;
+        schedule[1] = round_info->step;
+        schedule[2] = round_info->split;
+        schedule[3] = round_info->has_image;
+        schedule[4] = round_info->partition_index;
+        schedule += RADIXK_SCHEDULE_ROUND_SIZE;
+    }
+    if (old_size > 0) {
+        memcpy(schedule, old_schedule, old_size*sizeof(IceTInt));
+    }
+
+    icetStateSetIntegerv(ICET_RADIXK_SCHEDULE,
+                         new_size + old_size,
+                         new_schedule);
+    free(new_schedule);
+}
+
 static radixkInfo radixkGetK(IceTInt compose_group_size,
                              IceTInt group_rank)
 {
@@ -198,9 +346,13 @@ static radixkInfo radixkGetK(IceTInt compose_group_size,
         return info;
     }
 
-    info.num_rounds = 0;
+    magic_k = icetSingleImageMagicK();
 
-    icetGetIntegerv(ICET_MAGIC_K, &magic_k);
+    if (radixkLoadSchedule(compose_group_size, group_rank, magic_k, &info)) {
+        return info;
+    }
+
+    info.num_rounds = 0;
 
     /* The maximum number of factors possible is the floor of log base 2. */
     max_num_k = radixkFindFloorPow2(compose_group_size);
@@ -286,6 +438,8 @@ static radixkInfo radixkGetK(IceTInt compose_group_size,
 
     radixkGetPartitionIndices(info, group_rank);
 
+    radixkStoreSchedule(compose_group_size, group_rank, magic_k, &info);
+
     return info;
 }
 
@@ -591,6 +745,9 @@ static IceTCommRequest *radixkPostSends(radixkPartnerInfo *partners,
                 IceTVoid *package_buffer;
                 IceTSizeType package_size;
 
+                icetSparseImageEncodeDepth(image_pieces[i]);
+                icetSparseImageEncodeBitmap(image_pieces[i]);
+                icetSparseImageEncodeVarint(image_pieces[i]);
                 icetSparseImagePackageForSend(image_pieces[i],
                                               &package_buffer, &package_size);
 
@@ -714,6 +871,7 @@ static void radixkCompositeIncomingImages(radixkPartnerInfo *partners,
 
     IceTSparseImage spare_image;
     IceTInt total_composites;
+    int *receive_indices;
 
     IceTSizeType width;
     IceTSizeType height;
@@ -763,32 +921,49 @@ static void radixkCompositeIncomingImages(radixkPartnerInfo *partners,
                                                  &spare_image,
                                                  image);
 
+    receive_indices = icetGetStateBuffer(RADIXK_RECEIVE_INDEX_BUFFER,
+                                         sizeof(int)*round_info->k);
+
     while (!composites_done) {
-        IceTInt receive_idx;
-        radixkPartnerInfo *receiver;
-
-        /* Wait for an image to come in. */
-        receive_idx = icetCommWaitany(round_info->k, receive_requests);
-        receiver = &partners[receive_idx];
-        receiver->compositeLevel = 0;
-        receiver->receiveImage
-            = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
-        if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
-            || (icetSparseImageGetHeight(receiver->receiveImage) != height) ) {
+        int num_received;
+        int i;
+
+        /* Wait for images to come in.  Take every image that has arrived so
+           that they can all be paired up in the composite tree. */
+        num_received = icetCommWaitsome(round_info->k,
+                                        receive_requests,
+                                        receive_indices);
+        if (num_received < 1) {
             icetRaiseError(ICET_SANITY_CHECK_FAIL,
-                           "Radix-k received image with wrong size "
-                           "(%dx%d) != (%dx%d)",
-                           icetSparseImageGetWidth(receiver->receiveImage),
-                           icetSparseImageGetHeight(receiver->receiveImage),
-                           width, height);
+                           "Radix-k waiting on images that will never come.");
+            break;
         }
 
-        /* Try to composite that image. */
-        composites_done = radixkTryCompositeIncoming(partners,
-                                                     round_info,
-                                                     receive_idx,
-                                                     &spare_image,
-                                                     image);
+        for (i = 0; i < num_received; i++) {
+            radixkPartnerInfo *receiver = &partners[receive_indices[i]];
+            receiver->compositeLevel = 0;
+            receiver->receiveImage
+                = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
+            if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
+                || (icetSparseImageGetHeight(receiver->receiveImage) != height)
+                   ) {
+                icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                               "Radix-k received image with wrong size "
+                               "(%dx%d) != (%dx%d)",
+                               icetSparseImageGetWidth(receiver->receiveImage),
+                               icetSparseImageGetHeight(receiver->receiveImage),
+                               width, height);
+            }
+        }
+
+        /* Try to composite those images. */
+        for (i = 0; i < num_received; i++) {
+            composites_done = radixkTryCompositeIncoming(partners,
+                                                         round_info,
+                                                         receive_indices[i],
+                                                         &spare_image,
+                                                         image);
+        }
     }
 }
 
@@ -855,6 +1030,10 @@ static void icetRadixkBasicCompose(const radixkInfo *info,
                                         my_offset,
                                         working_image);
 
+        /* Let the sends progress while blending incoming images. */
+        icetCommProgressRequests(round_info->split ? round_info->k : 1,
+                                 send_requests);
+
         radixkCompositeIncomingImages(partners,
                                       receive_requests,
                                       round_info,
@@ -865,6 +1044,7 @@ static void icetRadixkBasicCompose(const radixkInfo *info,
         } else {
             icetCommWait(&send_requests[0]);
         }
+        icetCommProgressRequests(0, NULL);
 
         my_offset = partners[round_info->partition_index].offset;
         if (round_info->split) {
@@ -1238,7 +1418,7 @@ static void icetRadixkTelescopeCompose(const IceTInt *compose_group,
         IceTInt magic_k;
         use_interlace = icetIsEnabled(ICET_INTERLACE_IMAGES);
 
-        icetGetIntegerv(ICET_MAGIC_K, &magic_k);
+        magic_k = icetSingleImageMagicK();
         use_interlace &= (total_num_partitions > magic_k);
     }
 
@@ -1321,8 +1501,106 @@ void icetRadixkCompose(const IceTInt *compose_group,
                                piece_offset);
 }
 
+IceTBoolean icetRadixkComposeCollect(const IceTInt *compose_group,
+                                     IceTInt group_size,
+                                     IceTInt image_dest,
+                                     IceTSparseImage input_image,
+                                     IceTImage result_image)
+{
+    /* The telescoping rounds do not have a single last round to fuse. */
+    (void)compose_group;
+    (void)group_size;
+    (void)image_dest;
+    (void)input_image;
+    (void)result_image;
+    return ICET_FALSE;
+}
+
 #else
 
+/* radixkFuseSmallRounds
+
+   Late rounds of radix-k trade small pieces of the image and are dominated by
+   message latency rather than bandwidth.  Once the partition held by a process
+   drops below ICET_DIRECT_SEND_THRESHOLD bytes, this folds all the remaining
+   rounds that split the image into a single round that sends every piece
+   straight to its final owner (that is, direct-send within the group of
+   processes still trading).  The final partitions keep the same number and
+   sizes, but the fused round numbers the pieces in a different order, so a
+   process may end up with a different partition index than it would without
+   fusing.  Collection and interlacing compute the index from the fused
+   rounds with radixkGetFinalPartitionIndex, so pieces are still placed
+   correctly.
+
+   The size is measured with the buffer bound for an uncompressed partition
+   rather than the actual data so that every process makes the same decision.
+
+   inputs:
+     info: rounds as returned from radixkGetK
+     group_rank: my rank in composite order
+     image_num_pixels: size of the image before the first round
+
+   outputs:
+     info is modified in place.
+*/
+static void radixkFuseSmallRounds(radixkInfo *info,
+                                  IceTInt group_rank,
+                                  IceTSizeType image_num_pixels)
+{
+    IceTInt threshold;
+    IceTInt last_split_round;
+    IceTInt first_fused_round;
+    IceTSizeType partition_num_pixels;
+    IceTInt fused_rounds;
+    IceTInt current_round;
+
+    icetGetIntegerv(ICET_DIRECT_SEND_THRESHOLD, &threshold);
+    if (threshold <= 0) { return; }
+
+    last_split_round = -1;
+    while (   (last_split_round+1 < info->num_rounds)
+           && info->rounds[last_split_round+1].split) {
+        last_split_round++;
+    }
+
+    partition_num_pixels = image_num_pixels;
+    for (first_fused_round = 0;
+         first_fused_round < last_split_round;
+         first_fused_round++) {
+        if (icetSparseImageBufferSize(partition_num_pixels, 1) < threshold) {
+            break;
+        }
+        partition_num_pixels /= info->rounds[first_fused_round].k;
+    }
+    if (first_fused_round >= last_split_round) { return; }
+
+    {
+        radixkRoundInfo *fused = &info->rounds[first_fused_round];
+        for (current_round = first_fused_round + 1;
+             current_round <= last_split_round;
+             current_round++) {
+            fused->k *= info->rounds[current_round].k;
+        }
+        fused->partition_index = (group_rank/fused->step) % fused->k;
+    }
+
+    fused_rounds = last_split_round - first_fused_round;
+    for (current_round = last_split_round + 1;
+         current_round < info->num_rounds;
+         current_round++) {
+        info->rounds[current_round - fused_rounds]
+            = info->rounds[current_round];
+    }
+    info->num_rounds -= fused_rounds;
+
+    {
+        IceTInt direct_send_rounds;
+        icetGetIntegerv(ICET_DIRECT_SEND_ROUNDS, &direct_send_rounds);
+        icetStateSetInteger(ICET_DIRECT_SEND_ROUNDS,
+                            direct_send_rounds + fused_rounds);
+    }
+}
+
 void icetRadixkCompose(const IceTInt *compose_group,
                        IceTInt group_size,
                        IceTInt image_dest,
@@ -1355,6 +1633,8 @@ void icetRadixkCompose(const IceTInt *compose_group,
         working_image = interlaced_image;
     }
 
+    radixkFuseSmallRounds(&info, group_rank, original_image_size);
+
     icetRadixkBasicCompose(&info,
                            compose_group,
                            group_size,
@@ -1372,6 +1652,261 @@ void icetRadixkCompose(const IceTInt *compose_group,
     }
 }
 
+/* Offset of the final partition in the image being composited (which is the
+   interlaced image when interlacing).  Radix-k splits images so that the
+   first size%num_partitions partitions get an extra pixel. */
+static IceTSizeType radixkFinalPartitionOffset(IceTInt partition,
+                                               IceTInt total_num_partitions,
+                                               IceTSizeType image_size)
+{
+    IceTSizeType lower_size = image_size/total_num_partitions;
+    IceTSizeType remainder = image_size%total_num_partitions;
+    return (  partition*lower_size
+            + ((partition < remainder) ? partition : remainder) );
+}
+
+/* Places the blended region of the final image that holds the final
+   partitions starting at first_partition into result_image.  When
+   interlacing, interlace_offsets holds where each final partition starts in
+   the original image (see icetGetInterlaceOffsets). */
+static void radixkCollectRegion(const IceTSparseImage region_image,
+                                IceTInt first_partition,
+                                IceTInt num_region_partitions,
+                                IceTInt total_num_partitions,
+                                IceTSizeType image_size,
+                                const IceTSizeType *interlace_offsets,
+                                IceTImage result_image)
+{
+    IceTSizeType region_offset
+        = radixkFinalPartitionOffset(first_partition,
+                                     total_num_partitions,
+                                     image_size);
+    IceTSparseImage piece_image;
+    IceTInt i;
+
+    if (interlace_offsets == NULL) {
+        /* The region is contiguous in the original image. */
+        icetDecompressSubImageCorrectBackground(region_image,
+                                                region_offset,
+                                                result_image);
+        return;
+    }
+
+    /* Each final partition of an interlaced image lands somewhere else, so
+       pull them out one at a time. */
+    piece_image = icetGetStateBufferSparseImage(
+                      RADIXK_COLLECT_PIECE_BUFFER,
+                      icetSparseImageSplitPartitionNumPixels(
+                                  image_size,
+                                  total_num_partitions,
+                                  total_num_partitions),
+                      1);
+    for (i = 0; i < num_region_partitions; i++) {
+        IceTInt partition = first_partition + i;
+        IceTSizeType piece_start
+            = radixkFinalPartitionOffset(partition,
+                                         total_num_partitions,
+                                         image_size);
+        IceTSizeType piece_end
+            = radixkFinalPartitionOffset(partition + 1,
+                                         total_num_partitions,
+                                         image_size);
+        icetSparseImageCopyPixels(region_image,
+                                  piece_start - region_offset,
+                                  piece_end - piece_start,
+                                  piece_image);
+        icetDecompressSubImageCorrectBackground(
+                                   piece_image,
+                                   interlace_offsets[partition],
+                                   result_image);
+    }
+}
+
+/* Runs every radix-k round but the last one that splits the image.  Instead of
+   trading pieces in that round and then collecting the pieces in a separate
+   step, every process sends its partition straight to the display process,
+   which blends the partitions of each region as they come in and writes them
+   into result_image.  This saves a round of communication at the cost of the
+   display process doing the blending of the last round. */
+IceTBoolean icetRadixkComposeCollect(const IceTInt *compose_group,
+                                     IceTInt group_size,
+                                     IceTInt image_dest,
+                                     IceTSparseImage input_image,
+                                     IceTImage result_image)
+{
+    IceTInt group_rank = icetFindMyRankInGroup(compose_group, group_size);
+    radixkInfo info = radixkGetK(group_size, group_rank);
+    IceTInt total_num_partitions = radixkGetTotalNumPartitions(&info);
+    IceTBoolean use_interlace = icetIsEnabled(ICET_INTERLACE_IMAGES);
+    IceTSparseImage working_image = input_image;
+    IceTSizeType original_image_size = icetSparseImageGetNumPixels(input_image);
+    IceTInt last_split_round;
+    IceTInt region_step;
+    IceTSizeType piece_offset;
+
+    /* Every process makes this decision from the same values, so they all
+       agree on whether to take the fused path. */
+    if ((group_size < 2) || (total_num_partitions < 2)) {
+        return ICET_FALSE;
+    }
+
+    if (use_interlace) {
+        use_interlace = (info.num_rounds > 1);
+    }
+
+    if (use_interlace) {
+        IceTSparseImage interlaced_image = icetGetStateBufferSparseImage(
+                                       RADIXK_INTERLACED_IMAGE_BUFFER,
+                                       icetSparseImageGetWidth(working_image),
+                                       icetSparseImageGetHeight(working_image));
+        icetSparseImageInterlace(working_image,
+                                 total_num_partitions,
+                                 RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
+                                 interlaced_image);
+        working_image = interlaced_image;
+    }
+
+    radixkFuseSmallRounds(&info, group_rank, original_image_size);
+
+    /* The rounds that split always come first. */
+    for (last_split_round = 0;
+         (   (last_split_round+1 < info.num_rounds)
+          && info.rounds[last_split_round+1].split);
+         last_split_round++);
+
+    if (last_split_round > 0) {
+        radixkInfo first_rounds = info;
+        first_rounds.num_rounds = last_split_round;
+        icetRadixkBasicCompose(&first_rounds,
+                               compose_group,
+                               group_size,
+                               total_num_partitions,
+                               working_image,
+                               &piece_offset);
+    }
+
+    /* Processes whose group ranks are equal modulo region_step now hold the
+       same region of the image.  Listed by group rank, each holds the blend
+       of the next region_step processes of the compose group. */
+    region_step = info.rounds[last_split_round].step;
+
+    if (group_rank != image_dest) {
+        IceTVoid *package_buffer;
+        IceTSizeType package_size;
+
+        icetSparseImagePackageForSend(working_image,
+                                      &package_buffer, &package_size);
+        icetCommSend(package_buffer, package_size, ICET_BYTE,
+                     compose_group[image_dest], RADIXK_COLLECT_IMAGE_TAG);
+    } else {
+        IceTSizeType region_num_pixels;
+        IceTSizeType sparse_image_size;
+        IceTByte *receive_buffers;
+        IceTCommRequest *receive_requests;
+        IceTSparseImage composite_images[2];
+        IceTSizeType *interlace_offsets = NULL;
+        IceTInt num_region_partitions;
+        IceTInt region;
+        IceTInt i;
+
+        if (region_step > 1) {
+            region_num_pixels
+                = icetSparseImageSplitPartitionNumPixels(original_image_size,
+                                                         region_step,
+                                                         total_num_partitions);
+        } else {
+            region_num_pixels = original_image_size;
+        }
+        sparse_image_size = icetSparseImageBufferSize(region_num_pixels, 1);
+
+        receive_buffers = icetGetStateBuffer(RADIXK_RECEIVE_BUFFER,
+                                             sparse_image_size*group_size);
+        receive_requests = icetGetStateBuffer(
+                                        RADIXK_RECEIVE_REQUEST_BUFFER,
+                                        sizeof(IceTCommRequest)*group_size);
+        for (i = 0; i < group_size; i++) {
+            if (i != group_rank) {
+                receive_requests[i]
+                    = icetCommIrecv(receive_buffers + i*sparse_image_size,
+                                    sparse_image_size,
+                                    ICET_BYTE,
+                                    compose_group[i],
+                                    RADIXK_COLLECT_IMAGE_TAG);
+            } else {
+                receive_requests[i] = ICET_COMM_REQUEST_NULL;
+            }
+        }
+
+        composite_images[0] = icetGetStateBufferSparseImage(
+                                        RADIXK_SPARE_BUFFER,
+                                        region_num_pixels, 1);
+        composite_images[1] = icetGetStateBufferSparseImage(
+                                        RADIXK_SEND_BUFFER,
+                                        region_num_pixels, 1);
+
+        num_region_partitions = info.rounds[last_split_round].k;
+
+        /* The split offsets are no longer needed once the rounds are done. */
+        if (use_interlace) {
+            interlace_offsets = icetGetStateBuffer(
+                                     RADIXK_SPLIT_OFFSET_ARRAY_BUFFER,
+                                     sizeof(IceTSizeType)*total_num_partitions);
+            icetGetInterlaceOffsets(total_num_partitions,
+                                    original_image_size,
+                                    interlace_offsets);
+        }
+
+        for (region = 0; region < region_step; region++) {
+            IceTSparseImage region_image = icetSparseImageNull();
+            IceTInt composite_index = 0;
+            IceTInt first_partition;
+            IceTInt round;
+
+            for (i = region; i < group_size; i += region_step) {
+                IceTSparseImage in_image;
+                if (i == group_rank) {
+                    in_image = working_image;
+                } else {
+                    icetCommWait(&receive_requests[i]);
+                    in_image = icetSparseImageUnpackageFromReceive(
+                                          receive_buffers + i*sparse_image_size);
+                }
+                if (icetSparseImageIsNull(region_image)) {
+                    region_image = in_image;
+                } else {
+                    icetCompressedCompressedComposite(
+                                             region_image,
+                                             in_image,
+                                             composite_images[composite_index]);
+                    region_image = composite_images[composite_index];
+                    composite_index = 1 - composite_index;
+                }
+            }
+
+            /* Same numbering as radixkGetFinalPartitionIndex. */
+            first_partition = 0;
+            for (round = 0; round < last_split_round; round++) {
+                const radixkRoundInfo *r = &info.rounds[round];
+                first_partition *= r->k;
+                first_partition += (region/r->step)%r->k;
+            }
+            first_partition *= num_region_partitions;
+
+            radixkCollectRegion(region_image,
+                                first_partition,
+                                num_region_partitions,
+                                total_num_partitions,
+                                original_image_size,
+                                interlace_offsets,
+                                result_image);
+        }
+
+        icetImageAdjustForOutput(result_image);
+    }
+
+    return ICET_TRUE;
+}
+
 #endif
 
 static IceTBoolean radixkTryPartitionLookup(IceTInt group_size)
@@ -1488,6 +2023,146 @@ ICET_EXPORT IceTBoolean icetRadixkPartitionLookupUnitTest(void)
     return ICET_TRUE;
 }
 
+static IceTBoolean radixkSameRounds(const radixkInfo *info1,
+                                    const radixkInfo *info2)
+{
+    IceTInt current_round;
+
+    if (info1->num_rounds != info2->num_rounds) { return ICET_FALSE; }
+    for (current_round = 0;
+         current_round < info1->num_rounds;
+         current_round++) {
+        const radixkRoundInfo *r1 = &info1->rounds[current_round];
+        const radixkRoundInfo *r2 = &info2->rounds[current_round];
+        if (   (r1->k != r2->k)
+            || (r1->step != r2->step)
+            || (r1->split != r2->split)
+            || (r1->has_image != r2->has_image)
+            || (r1->partition_index != r2->partition_index) ) {
+            return ICET_FALSE;
+        }
+    }
+
+    return ICET_TRUE;
+}
+
+/* Checks that radixkGetK returns the remembered schedule when called again
+   with the same inputs, even after a call for another group size as in
+   telescoping, and builds a new one when an input changes. */
+static IceTBoolean radixkTrySchedule(IceTInt group_size, IceTInt group_rank)
+{
+    radixkInfo info;
+    radixkInfo expected;
+    IceTTimeStamp schedule_time;
+    IceTBoolean same;
+
+    /* Build the schedule from scratch for reference. */
+    icetStateSetIntegerv(ICET_RADIXK_SCHEDULE, 0, NULL);
+    info = radixkGetK(group_size, group_rank);
+    expected.num_rounds = info.num_rounds;
+    expected.rounds = malloc(sizeof(radixkRoundInfo)*info.num_rounds);
+    memcpy(expected.rounds,
+           info.rounds,
+           sizeof(radixkRoundInfo)*info.num_rounds);
+
+    /* Scribble over the factors so that a stale copy would be noticed. */
+    memset(info.rounds, 0xFF, sizeof(radixkRoundInfo)*info.num_rounds);
+    radixkGetK(group_size + 1, 0);
+
+    schedule_time = icetStateGetTime(ICET_RADIXK_SCHEDULE);
+    info = radixkGetK(group_size, group_rank);
+    same = radixkSameRounds(&info, &expected);
+    free(expected.rounds);
+    radixkGetK(group_size + 1, 0);
+    if (!same) {
+        printf("Remembered schedule for rank %d of %d differs.\n",
+               group_rank, group_size);
+        return ICET_FALSE;
+    }
+    if (icetStateGetTime(ICET_RADIXK_SCHEDULE) != schedule_time) {
+        printf("Schedule for rank %d of %d was built again.\n",
+               group_rank, group_size);
+        return ICET_FALSE;
+    }
+
+    {
+        IceTInt max_image_split;
+        icetGetIntegerv(ICET_MAX_IMAGE_SPLIT, &max_image_split);
+        icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, max_image_split);
+    }
+    info = radixkGetK(group_size, group_rank);
+    if (icetStateGetTime(ICET_RADIXK_SCHEDULE) == schedule_time) {
+        printf("Schedule not rebuilt after ICET_MAX_IMAGE_SPLIT changed.\n");
+        return ICET_FALSE;
+    }
+
+    return ICET_TRUE;
+}
+
+ICET_EXPORT IceTBoolean icetRadixkScheduleUnitTest(void)
+{
+    const IceTInt group_sizes_to_try[] = {
+        ICET_MAGIC_K_DEFAULT*2,         /* Changing group sizes. */
+        576,                            /* Factors into 2 and 3. */
+        509                             /* Prime. */
+    };
+    const IceTInt num_group_sizes_to_try
+        = sizeof(group_sizes_to_try)/sizeof(IceTInt);
+    IceTInt group_size_index;
+    IceTInt magic_k;
+    IceTInt max_image_split;
+    IceTBoolean result = ICET_TRUE;
+
+    printf("\nTesting remembered schedules.\n");
+
+    icetGetIntegerv(ICET_MAGIC_K, &magic_k);
+    icetGetIntegerv(ICET_MAX_IMAGE_SPLIT, &max_image_split);
+
+    for (group_size_index = 0;
+         group_size_index < num_group_sizes_to_try;
+         group_size_index++) {
+        IceTInt group_size = group_sizes_to_try[group_size_index];
+
+        printf("Trying size %d\n", group_size);
+
+        if (   !radixkTrySchedule(group_size, 0)
+            || !radixkTrySchedule(group_size, group_size/2)
+            || !radixkTrySchedule(group_size, group_size-1) ) {
+            result = ICET_FALSE;
+            break;
+        }
+
+        /* A different magic k must not reuse the schedule. */
+        {
+            radixkInfo info;
+            IceTInt first_k;
+
+            info = radixkGetK(group_size, 0);
+            first_k = info.rounds[0].k;
+            icetStateSetInteger(ICET_MAGIC_K, 2);
+            info = radixkGetK(group_size, 0);
+            icetStateSetInteger(ICET_MAGIC_K, magic_k);
+            if ((group_size%2 == 0) && (info.rounds[0].k != 2)) {
+                printf("Schedule kept k = %d after magic k changed to 2.\n",
+                       (int)info.rounds[0].k);
+                result = ICET_FALSE;
+                break;
+            }
+            info = radixkGetK(group_size, 0);
+            if (info.rounds[0].k != first_k) {
+                printf("Schedule not rebuilt after magic k restored.\n");
+                result = ICET_FALSE;
+                break;
+            }
+        }
+    }
+
+    icetStateSetInteger(ICET_MAGIC_K, magic_k);
+    icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, max_image_split);
+
+    return result;
+}
+
 #ifdef RADIXK_USE_TELESCOPE
 
 #define MAIN_GROUP_RANK(idx)    (10000 + idx)
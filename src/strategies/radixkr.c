@@ -33,6 +33,8 @@
 #include <IceTDevDiagnostics.h>
 #include <IceTDevImage.h>
 
+#include "common.h"
+
 #define RADIXKR_SWAP_IMAGE_TAG_START     2200
 
 #define RADIXKR_RECEIVE_BUFFER                   ICET_SI_STRATEGY_BUFFER_0
@@ -45,6 +47,7 @@
 #define RADIXKR_FACTORS_ARRAY_BUFFER             ICET_SI_STRATEGY_BUFFER_7
 #define RADIXKR_SPLIT_OFFSET_ARRAY_BUFFER        ICET_SI_STRATEGY_BUFFER_8
 #define RADIXKR_SPLIT_IMAGE_ARRAY_BUFFER         ICET_SI_STRATEGY_BUFFER_9
+#define RADIXKR_RECEIVE_INDEX_BUFFER             ICET_SI_STRATEGY_BUFFER_10
 
 typedef struct radixkrRoundInfoStruct {
     IceTInt k; /* k value for this round. */
@@ -62,6 +65,20 @@ typedef struct radixkrInfoStruct {
     IceTInt num_rounds;
 } radixkrInfo;
 
+/* The rounds computed by radixkrGetK are remembered in ICET_RADIXKR_SCHEDULE so
+   that they are not factored again every frame.  The schedule is an integer
+   array of up to RADIXKR_SCHEDULE_MAX_ENTRIES entries, most recent first.  Each
+   entry has a header holding the inputs it was built from followed by the
+   fields of each round.  Several entries are kept because one frame can
+   composite several tiles with groups of different sizes. */
+#define RADIXKR_SCHEDULE_GROUP_SIZE     0
+#define RADIXKR_SCHEDULE_GROUP_RANK     1
+#define RADIXKR_SCHEDULE_MAGIC_K        2
+#define RADIXKR_SCHEDULE_NUM_ROUNDS     3
+#define RADIXKR_SCHEDULE_HEADER_SIZE    4
+#define RADIXKR_SCHEDULE_ROUND_SIZE     8
+#define RADIXKR_SCHEDULE_MAX_ENTRIES    4
+
 typedef struct radixkrPartnerInfoStruct {
     IceTInt rank; /* Rank of partner. */
     IceTSizeType offset; /* Offset of partner's partition in image. */
@@ -186,6 +203,140 @@ static void radixkrGetPartitionIndices(radixkrInfo info,
 
 }
 
+/* radixkrLoadSchedule
+
+   Copies the rounds remembered by radixkrStoreSchedule into the factors array
+   buffer if an entry was built for the same inputs.  ICET_MAX_IMAGE_SPLIT is
+   checked with its time stamp.  The magic k is compared by value because
+   icetSingleImageMagicK derives it from several state variables.
+
+   returns:
+     ICET_TRUE if info was filled from the schedule.
+*/
+static IceTBoolean radixkrLoadSchedule(IceTInt compose_group_size,
+                                       IceTInt group_rank,
+                                       IceTInt magic_k,
+                                       radixkrInfo *info)
+{
+    const IceTInt *schedule;
+    const IceTInt *schedule_end;
+    IceTInt current_round;
+
+    if (  icetStateGetTime(ICET_MAX_IMAGE_SPLIT)
+        > icetStateGetTime(ICET_RADIXKR_SCHEDULE) ) {
+        return ICET_FALSE;
+    }
+
+    schedule = icetUnsafeStateGetInteger(ICET_RADIXKR_SCHEDULE);
+    schedule_end = schedule + icetStateGetNumEntries(ICET_RADIXKR_SCHEDULE);
+    while (   (schedule < schedule_end)
+           && (   (schedule[RADIXKR_SCHEDULE_GROUP_SIZE] != compose_group_size)
+               || (schedule[RADIXKR_SCHEDULE_GROUP_RANK] != group_rank)
+               || (schedule[RADIXKR_SCHEDULE_MAGIC_K] != magic_k) ) ) {
+        schedule += RADIXKR_SCHEDULE_HEADER_SIZE
+            + RADIXKR_SCHEDULE_ROUND_SIZE*schedule[RADIXKR_SCHEDULE_NUM_ROUNDS];
+    }
+    if (schedule >= schedule_end) {
+        return ICET_FALSE;
+    }
+
+    /* Allocate the same size as radixkrGetK so that the buffer does not change
+       whether or not the schedule is reused. */
+    info->num_rounds = schedule[RADIXKR_SCHEDULE_NUM_ROUNDS];
+    info->rounds = icetGetStateBuffer(
+                       RADIXKR_FACTORS_ARRAY_BUFFER,
+                       sizeof(radixkrRoundInfo)
+                       * radixkrFindFloorLog2(compose_group_size));
+    schedule += RADIXKR_SCHEDULE_HEADER_SIZE;
+    for (current_round = 0;
+         current_round < info->num_rounds;
+         current_round++) {
+        radixkrRoundInfo *round_info = &info->rounds[current_round];
+        round_info->k = schedule[0];
+        round_info->r = schedule[1];
+        round_info->step = schedule[2];
+        round_info->split_factor = schedule[3];
+        round_info->has_image = (IceTBoolean)schedule[4];
+        round_info->last_partition = (IceTBoolean)schedule[5];
+        round_info->first_rank = schedule[6];
+        round_info->partition_index = schedule[7];
+        schedule += RADIXKR_SCHEDULE_ROUND_SIZE;
+    }
+
+    return ICET_TRUE;
+}
+
+/* radixkrStoreSchedule
+
+   Puts the rounds in info at the front of ICET_RADIXKR_SCHEDULE, keeping the
+   most recent of the other entries.  Entries built before
+   ICET_MAX_IMAGE_SPLIT last changed are dropped, since the new entry makes
+   the schedule look newer than that change.
+*/
+static void radixkrStoreSchedule(IceTInt compose_group_size,
+                                 IceTInt group_rank,
+                                 IceTInt magic_k,
+                                 const radixkrInfo *info)
+{
+    const IceTInt *old_schedule = NULL;
+    IceTInt old_size = 0;
+    IceTInt new_size;
+    IceTInt *new_schedule;
+    IceTInt *schedule;
+    IceTInt current_round;
+
+    if (  icetStateGetTime(ICET_MAX_IMAGE_SPLIT)
+        <= icetStateGetTime(ICET_RADIXKR_SCHEDULE) ) {
+        IceTInt num_old = icetStateGetNumEntries(ICET_RADIXKR_SCHEDULE);
+        IceTInt num_kept;
+        old_schedule = icetUnsafeStateGetInteger(ICET_RADIXKR_SCHEDULE);
+        for (num_kept = 1;
+             (num_kept < RADIXKR_SCHEDULE_MAX_ENTRIES) && (old_size < num_old);
+             num_kept++) {
+            old_size += RADIXKR_SCHEDULE_HEADER_SIZE
+                + (RADIXKR_SCHEDULE_ROUND_SIZE
+                   * old_schedule[old_size + RADIXKR_SCHEDULE_NUM_ROUNDS]);
+        }
+    }
+
+    new_size = RADIXKR_SCHEDULE_HEADER_SIZE
+        + RADIXKR_SCHEDULE_ROUND_SIZE*info->num_rounds;
+    new_schedule = malloc((new_size + old_size)*sizeof(IceTInt));
+    if (new_schedule == NULL) {
+        /* The schedule is only a shortcut, so just do not remember it. */
+        return;
+    }
+
+    schedule = new_schedule;
+    schedule[RADIXKR_SCHEDULE_GROUP_SIZE] = compose_group_size;
+    schedule[RADIXKR_SCHEDULE_GROUP_RANK] = group_rank;
+    schedule[RADIXKR_SCHEDULE_MAGIC_K] = magic_k;
+    schedule[RADIXKR_SCHEDULE_NUM_ROUNDS] = info->num_rounds;
+    schedule += RADIXKR_SCHEDULE_HEADER_SIZE;
+    for (current_round = 0;
+         current_round < info->num_rounds;
+         current_round++) {
+        const radixkrRoundInfo *round_info = &info->rounds[current_round];
+        schedule[0] = round_info->k;
+        schedule[1] = round_info->r;
+        schedule[2] = round_info->step;
+        schedule[3] = round_info->split_factor;
+        schedule[4] = round_info->has_image;
+        schedule[5] = round_info->last_partition;
+        schedule[6] = round_info->first_rank;
+        schedule[7] = round_info->partition_index;
+        schedule += RADIXKR_SCHEDULE_ROUND_SIZE;
+    }
+    if (old_size > 0) {
+        memcpy(schedule, old_schedule, old_size*sizeof(IceTInt));
+    }
+
+    icetStateSetIntegerv(ICET_RADIXKR_SCHEDULE,
+                         new_size + old_size,
+                         new_schedule);
+    free(new_schedule);
+}
+
 static radixkrInfo radixkrGetK(IceTInt compose_group_size,
                                IceTInt group_rank)
 {
@@ -210,9 +361,13 @@ static radixkrInfo radixkrGetK(IceTInt compose_group_size,
         return info;
     }
 
-    info.num_rounds = 0;
+    magic_k = icetSingleImageMagicK();
 
-    icetGetIntegerv(ICET_MAGIC_K, &magic_k);
+    if (radixkrLoadSchedule(compose_group_size, group_rank, magic_k, &info)) {
+        return info;
+    }
+
+    info.num_rounds = 0;
 
     /* The maximum number of factors possible is the floor of log base 2. */
     max_num_k = radixkrFindFloorLog2(compose_group_size);
@@ -279,6 +434,8 @@ static radixkrInfo radixkrGetK(IceTInt compose_group_size,
 
     radixkrGetPartitionIndices(info, compose_group_size, group_rank);
 
+    radixkrStoreSchedule(compose_group_size, group_rank, magic_k, &info);
+
     return info;
 }
 
@@ -588,6 +745,9 @@ static IceTCommRequest *radixkrPostSends(radixkrPartnerGroupInfo p_group,
                 IceTVoid *package_buffer;
                 IceTSizeType package_size;
 
+                icetSparseImageEncodeDepth(image_pieces[i]);
+                icetSparseImageEncodeBitmap(image_pieces[i]);
+                icetSparseImageEncodeVarint(image_pieces[i]);
                 icetSparseImagePackageForSend(image_pieces[i],
                                               &package_buffer, &package_size);
 
@@ -714,6 +874,7 @@ static void radixkrCompositeIncomingImages(radixkrPartnerGroupInfo p_group,
 
     IceTSparseImage spare_image;
     IceTInt total_composites;
+    int *receive_indices;
 
     IceTSizeType width;
     IceTSizeType height;
@@ -763,27 +924,44 @@ static void radixkrCompositeIncomingImages(radixkrPartnerGroupInfo p_group,
                                                   &spare_image,
                                                   image);
 
+    receive_indices = icetGetStateBuffer(RADIXKR_RECEIVE_INDEX_BUFFER,
+                                         sizeof(int)*num_partners);
+
     while (!composites_done) {
-        IceTInt receive_idx;
-        radixkrPartnerInfo *receiver;
-
-        /* Wait for an image to come in. */
-        receive_idx = icetCommWaitany(num_partners, receive_requests);
-        receiver = &partners[receive_idx];
-        receiver->compositeLevel = 0;
-        receiver->receiveImage
-            = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
-        if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
-            || (icetSparseImageGetHeight(receiver->receiveImage) != height) ) {
+        int num_received;
+        int i;
+
+        /* Wait for images to come in.  Take every image that has arrived so
+           that they can all be paired up in the composite tree. */
+        num_received = icetCommWaitsome(num_partners,
+                                        receive_requests,
+                                        receive_indices);
+        if (num_received < 1) {
             icetRaiseError(ICET_SANITY_CHECK_FAIL,
-                           "Radix-kr received image with wrong size.");
+                           "Radix-kr waiting on images that will never come.");
+            break;
+        }
+
+        for (i = 0; i < num_received; i++) {
+            radixkrPartnerInfo *receiver = &partners[receive_indices[i]];
+            receiver->compositeLevel = 0;
+            receiver->receiveImage
+                = icetSparseImageUnpackageFromReceive(receiver->receiveBuffer);
+            if (   (icetSparseImageGetWidth(receiver->receiveImage) != width)
+                || (icetSparseImageGetHeight(receiver->receiveImage) != height)
+                   ) {
+                icetRaiseError(ICET_SANITY_CHECK_FAIL,
+                               "Radix-kr received image with wrong size.");
+            }
         }
 
-        /* Try to composite that image. */
-        composites_done = radixkrTryCompositeIncoming(p_group,
-                                                      receive_idx,
-                                                      &spare_image,
-                                                      image);
+        /* Try to composite those images. */
+        for (i = 0; i < num_received; i++) {
+            composites_done = radixkrTryCompositeIncoming(p_group,
+                                                          receive_indices[i],
+                                                          &spare_image,
+                                                          image);
+        }
     }
 }
 
@@ -889,12 +1067,16 @@ void icetRadixkrCompose(const IceTInt *compose_group,
                                          my_offset,
                                          working_image);
 
+        /* Let the sends progress while blending incoming images. */
+        icetCommProgressRequests(round_info->split_factor, send_requests);
+
         radixkrCompositeIncomingImages(p_group,
                                        receive_requests,
                                        round_info,
                                        working_image);
 
         icetCommWaitall(round_info->split_factor, send_requests);
+        icetCommProgressRequests(0, NULL);
 
         my_offset = p_group.partners[round_info->partition_index].offset;
         if (round_info->has_image) {
@@ -1037,3 +1219,101 @@ ICET_EXPORT IceTBoolean icetRadixkrPartitionLookupUnitTest(void)
 
     return ICET_TRUE;
 }
+
+/* Checks that radixkrGetK returns the remembered schedule when called again
+   with the same inputs, even after a call for another group size, and builds
+   a new one when an input changes. */
+static IceTBoolean radixkrTrySchedule(IceTInt group_size, IceTInt group_rank)
+{
+    radixkrInfo info;
+    radixkrRoundInfo *expected;
+    IceTInt num_rounds;
+    IceTTimeStamp schedule_time;
+    IceTInt current_round;
+    IceTBoolean same;
+
+    /* Build the schedule from scratch for reference. */
+    icetStateSetIntegerv(ICET_RADIXKR_SCHEDULE, 0, NULL);
+    info = radixkrGetK(group_size, group_rank);
+    num_rounds = info.num_rounds;
+    expected = malloc(sizeof(radixkrRoundInfo)*num_rounds);
+    memcpy(expected, info.rounds, sizeof(radixkrRoundInfo)*num_rounds);
+
+    /* Scribble over the factors so that a stale copy would be noticed. */
+    memset(info.rounds, 0xFF, sizeof(radixkrRoundInfo)*num_rounds);
+    radixkrGetK(group_size + 1, 0);
+
+    schedule_time = icetStateGetTime(ICET_RADIXKR_SCHEDULE);
+    info = radixkrGetK(group_size, group_rank);
+    same = (info.num_rounds == num_rounds);
+    for (current_round = 0;
+         same && (current_round < num_rounds);
+         current_round++) {
+        const radixkrRoundInfo *r1 = &info.rounds[current_round];
+        const radixkrRoundInfo *r2 = &expected[current_round];
+        same = (   (r1->k == r2->k)
+                && (r1->r == r2->r)
+                && (r1->step == r2->step)
+                && (r1->split_factor == r2->split_factor)
+                && (r1->has_image == r2->has_image)
+                && (r1->last_partition == r2->last_partition)
+                && (r1->first_rank == r2->first_rank)
+                && (r1->partition_index == r2->partition_index) );
+    }
+    free(expected);
+    radixkrGetK(group_size + 1, 0);
+    if (!same) {
+        printf("Remembered schedule for rank %d of %d differs.\n",
+               group_rank, group_size);
+        return ICET_FALSE;
+    }
+    if (icetStateGetTime(ICET_RADIXKR_SCHEDULE) != schedule_time) {
+        printf("Schedule for rank %d of %d was built again.\n",
+               group_rank, group_size);
+        return ICET_FALSE;
+    }
+
+    {
+        IceTInt max_image_split;
+        icetGetIntegerv(ICET_MAX_IMAGE_SPLIT, &max_image_split);
+        icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, max_image_split);
+    }
+    radixkrGetK(group_size, group_rank);
+    if (icetStateGetTime(ICET_RADIXKR_SCHEDULE) == schedule_time) {
+        printf("Schedule not rebuilt after ICET_MAX_IMAGE_SPLIT changed.\n");
+        return ICET_FALSE;
+    }
+
+    return ICET_TRUE;
+}
+
+ICET_EXPORT IceTBoolean icetRadixkrScheduleUnitTest(void)
+{
+    const IceTInt group_sizes_to_try[] = {
+        ICET_MAGIC_K_DEFAULT*ICET_MAGIC_K_DEFAULT*37,
+                                        /* Odd factor past some rounds. */
+        576,                            /* Factors into 2 and 3. */
+        509                             /* Prime. */
+    };
+    const IceTInt num_group_sizes_to_try
+        = sizeof(group_sizes_to_try)/sizeof(IceTInt);
+    IceTInt group_size_index;
+
+    printf("\nTesting remembered schedules.\n");
+
+    for (group_size_index = 0;
+         group_size_index < num_group_sizes_to_try;
+         group_size_index++) {
+        IceTInt group_size = group_sizes_to_try[group_size_index];
+
+        printf("Trying size %d\n", group_size);
+
+        if (   !radixkrTrySchedule(group_size, 0)
+            || !radixkrTrySchedule(group_size, group_size/2)
+            || !radixkrTrySchedule(group_size, group_size-1) ) {
+            return ICET_FALSE;
+        }
+    }
+
+    return ICET_TRUE;
+}
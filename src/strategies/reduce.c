@@ -9,6 +9,7 @@
 
 #include <IceT.h>
 
+#include <IceTDevContext.h>
 #include <IceTDevImage.h>
 #include <IceTDevState.h>
 #include <IceTDevDiagnostics.h>
@@ -41,6 +42,10 @@ static IceTImage reduceCollect(const IceTSparseImage composited_image,
                                IceTInt compose_tile,
                                IceTInt piece_offset);
 
+static IceTInt reduceChooseCompositeRoot(const IceTInt *proc_group,
+                                         IceTInt group_size,
+                                         IceTInt display_node);
+
 
 IceTImage icetReduceCompose(void)
 {
@@ -94,6 +99,10 @@ IceTImage icetReduceCompose(void)
                                        &rendered_image);
     }
 
+    /* All processes meet here and again before the collect, so these are
+       the points to drop a cancelled frame. */
+    if (icetFrameCancelled()) { return icetImageNull(); }
+
     if (compose_tile >= 0) {
         icetSingleImageCompose(compose_group,
                                group_size,
@@ -108,6 +117,8 @@ IceTImage icetReduceCompose(void)
         piece_offset = 0;
     }
 
+    if (icetFrameCancelled()) { return icetImageNull(); }
+
     if (icetIsEnabled(ICET_COLLECT_IMAGES)) {
         result_image = reduceCollect(composited_image,
                                      compose_tile,
@@ -116,14 +127,14 @@ IceTImage icetReduceCompose(void)
         IceTSizeType piece_size = icetSparseImageGetNumPixels(composited_image);
         const IceTInt *tile_viewports
             = icetUnsafeStateGetInteger(ICET_TILE_VIEWPORTS);
-        IceTSizeType tile_width = tile_viewports[compose_tile + 2];
-        IceTSizeType tile_height = tile_viewports[compose_tile + 3];
+        IceTSizeType tile_width = tile_viewports[4*compose_tile + 2];
+        IceTSizeType tile_height = tile_viewports[4*compose_tile + 3];
         if (piece_size > 0) {
             result_image = icetGetStateBufferImage(REDUCE_OUT_IMAGE_BUFFER,
                                                    tile_width, tile_height);
-            icetDecompressSubImage(composited_image,
-                                   piece_offset,
-                                   result_image);
+            icetDecompressSubImageCorrectBackground(composited_image,
+                                                    piece_offset,
+                                                    result_image);
             icetStateSetInteger(ICET_VALID_PIXELS_TILE, compose_tile);
             icetStateSetInteger(ICET_VALID_PIXELS_OFFSET, piece_offset);
             icetStateSetInteger(ICET_VALID_PIXELS_NUM, piece_size);
@@ -167,6 +178,7 @@ static IceTInt reduceDelegate(IceTInt **tile_image_destp,
     IceTInt snode, rnode, dest;
     IceTInt piece;
     IceTInt first_loop;
+    IceTBoolean auto_placement;
 
     all_contained_tiles_masks
         = icetUnsafeStateGetBoolean(ICET_ALL_CONTAINED_TILES_MASKS);
@@ -178,6 +190,7 @@ static IceTInt reduceDelegate(IceTInt **tile_image_destp,
     icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
     icetGetIntegerv(ICET_NUM_PROCESSES, &num_processes);
     icetGetIntegerv(ICET_RANK, &rank);
+    auto_placement = icetIsEnabled(ICET_AUTO_DISPLAY_PLACEMENT);
 
     if (total_image_count < 1) {
         icetRaiseDebug("No nodes are drawing.");
@@ -273,10 +286,14 @@ tile_proc_groups[(tile)*num_processes + group_sizes[(tile)]] = (node);  \
 group_sizes[(tile)]++;
 
   /* Assign each display node to the group processing that tile if there
-     are any images in that tile. */
-    for (tile = 0; tile < num_tiles; tile++) {
-        if (contrib_counts[tile] > 0) {
-            ASSIGN_NODE2TILE(tile_display_nodes[tile], tile);
+     are any images in that tile.  With automatic display placement, the
+     groups are instead built only from where the images are, and the
+     collect at the end forwards each tile to its display node. */
+    if (!auto_placement) {
+        for (tile = 0; tile < num_tiles; tile++) {
+            if (contrib_counts[tile] > 0) {
+                ASSIGN_NODE2TILE(tile_display_nodes[tile], tile);
+            }
         }
     }
 
@@ -325,6 +342,15 @@ group_sizes[(tile)]++;
                 tile_image_dest[tile] = rank;
             }
 
+          /* The display node is always first in the group unless we are
+             placing it automatically. */
+            if (auto_placement && (node_assignment[rank] == tile)) {
+                group_image_dest
+                    = reduceChooseCompositeRoot(proc_group,
+                                                group_sizes[tile],
+                                                tile_display_nodes[tile]);
+            }
+
             snode = -1;
             rnode = -1;
             first_loop = 1;
@@ -418,14 +444,14 @@ group_sizes[(tile)]++;
           /* We have just shuffled proc_group, so the tile display node is
            * no longer necessarily at 0.  Find out where it should be. */
             if (node_assignment[rank] == tile) {
-                for (i = 0; i < group_sizes[tile]; i++) {
-                    if (proc_group[i] == tile_display_nodes[tile]) {
-                        group_image_dest = i;
-                        break;
-                    }
-                }
+                group_image_dest
+                    = reduceChooseCompositeRoot(proc_group,
+                                                group_sizes[tile],
+                                                tile_display_nodes[tile]);
 #ifdef DEBUG
-                if (i == group_sizes[tile]) {
+                if (   !auto_placement
+                    && (   proc_group[group_image_dest]
+                        != tile_display_nodes[tile]) ) {
                     icetRaiseError(
                         ICET_SANITY_CHECK_FAIL,
                         "Display process not participating in tile?");
@@ -460,6 +486,31 @@ group_sizes[(tile)]++;
     return node_assignment[rank];
 }
 
+static IceTInt reduceChooseCompositeRoot(const IceTInt *proc_group,
+                                         IceTInt group_size,
+                                         IceTInt display_node)
+{
+    IceTInt best_index = 0;
+    IceTInt best_distance = -1;
+    IceTInt i;
+
+  /* Pick the process in the group closest to the display node.  If the
+     display node is in the group, it is chosen.  Otherwise we have no real
+     information about the network, but processes with nearby ranks are
+     usually allocated on the same or neighboring nodes, so the difference
+     in rank is a reasonable guess at how far the final image has to go. */
+    for (i = 0; i < group_size; i++) {
+        IceTInt distance = proc_group[i] - display_node;
+        if (distance < 0) distance = -distance;
+        if ((best_distance < 0) || (distance < best_distance)) {
+            best_index = i;
+            best_distance = distance;
+        }
+    }
+
+    return best_index;
+}
+
 IceTImage reduceCollect(const IceTSparseImage composited_image,
                         IceTInt compose_tile,
                         IceTInt piece_offset)
@@ -497,9 +548,9 @@ IceTImage reduceCollect(const IceTSparseImage composited_image,
         }
 
         if (tile_idx == tile_displayed) {
-            result_image = icetGetStateBufferImage(REDUCE_OUT_IMAGE_BUFFER,
-                                                   collect_tile_width,
-                                                   collect_tile_height);
+            result_image = icetGetDisplayImage(REDUCE_OUT_IMAGE_BUFFER,
+                                               collect_tile_width,
+                                               collect_tile_height);
             in_image = result_image;
         } else if (tile_idx == compose_tile) {
             in_image = icetGetStateBufferImage(REDUCE_IN_IMAGE_BUFFER,
@@ -516,7 +567,9 @@ IceTImage reduceCollect(const IceTSparseImage composited_image,
     }
 
     icetGetIntegerv(ICET_TILE_DISPLAYED, &tile_displayed);
-    if ((tile_displayed >= 0) && (tile_displayed != compose_tile)) {
+    if (   (tile_displayed >= 0)
+        && (icetUnsafeStateGetInteger(ICET_TILE_CONTRIB_COUNTS)[tile_displayed]
+            < 1) ) {
         /* Return empty image if nothing in this tile. */
         icetRaiseDebug("Clearing pixels");
         icetClearImageTrueBackground(result_image);
@@ -20,6 +20,7 @@ extern IceTImage icetSequentialCompose(void);
 extern IceTImage icetSplitCompose(void);
 extern IceTImage icetReduceCompose(void);
 extern IceTImage icetVtreeCompose(void);
+extern IceTImage icetInTransitCompose(void);
 
 /* Declaration of single image strategy compose functions. */
 extern void icetAutomaticCompose(const IceTInt *compose_group,
@@ -58,6 +59,11 @@ extern void icetRadixkrCompose(const IceTInt *compose_group,
                                IceTSparseImage input_image,
                                IceTSparseImage *result_image,
                                IceTSizeType *piece_offset);
+extern IceTBoolean icetRadixkComposeCollect(const IceTInt *compose_group,
+                                            IceTInt group_size,
+                                            IceTInt image_dest,
+                                            IceTSparseImage input_image,
+                                            IceTImage result_image);
 
 /*==================================================================*/
 
@@ -69,6 +75,7 @@ IceTBoolean icetStrategyValid(IceTEnum strategy)
       case ICET_STRATEGY_SPLIT:
       case ICET_STRATEGY_REDUCE:
       case ICET_STRATEGY_VTREE:
+      case ICET_STRATEGY_IN_TRANSIT:
           return ICET_TRUE;
       default:
           return ICET_FALSE;
@@ -83,6 +90,7 @@ const char *icetStrategyNameFromEnum(IceTEnum strategy)
       case ICET_STRATEGY_SPLIT:         return "Split";
       case ICET_STRATEGY_REDUCE:        return "Reduce";
       case ICET_STRATEGY_VTREE:         return "Virtual Tree";
+      case ICET_STRATEGY_IN_TRANSIT:    return "In Transit";
       case ICET_STRATEGY_UNDEFINED:
           icetRaiseError(ICET_INVALID_ENUM,
                          "Strategy not defined. "
@@ -103,6 +111,7 @@ IceTBoolean icetStrategySupportsOrdering(IceTEnum strategy)
       case ICET_STRATEGY_SPLIT:         return ICET_FALSE;
       case ICET_STRATEGY_REDUCE:        return ICET_TRUE;
       case ICET_STRATEGY_VTREE:         return ICET_FALSE;
+      case ICET_STRATEGY_IN_TRANSIT:    return ICET_TRUE;
       case ICET_STRATEGY_UNDEFINED:
           icetRaiseError(ICET_INVALID_ENUM,
                          "Strategy not defined. "
@@ -125,6 +134,7 @@ IceTImage icetInvokeStrategy(IceTEnum strategy)
       case ICET_STRATEGY_SPLIT:         return icetSplitCompose();
       case ICET_STRATEGY_REDUCE:        return icetReduceCompose();
       case ICET_STRATEGY_VTREE:         return icetVtreeCompose();
+      case ICET_STRATEGY_IN_TRANSIT:    return icetInTransitCompose();
       case ICET_STRATEGY_UNDEFINED:
           icetRaiseError(ICET_INVALID_ENUM,
                          "Strategy not defined. "
@@ -237,3 +247,33 @@ void icetInvokeSingleImageStrategy(IceTEnum strategy,
 
     icetStateCheckMemory();
 }
+
+IceTBoolean icetInvokeSingleImageStrategyCollect(IceTEnum strategy,
+                                                 const IceTInt *compose_group,
+                                                 IceTInt group_size,
+                                                 IceTInt image_dest,
+                                                 IceTSparseImage input_image,
+                                                 IceTImage result_image)
+{
+    IceTBoolean collected;
+
+    switch(strategy) {
+      case ICET_SINGLE_IMAGE_STRATEGY_RADIXK:
+          icetRaiseDebug("Invoking single image strategy %s with collect",
+                         icetSingleImageStrategyNameFromEnum(strategy));
+          collected = icetRadixkComposeCollect(compose_group,
+                                               group_size,
+                                               image_dest,
+                                               input_image,
+                                               result_image);
+          break;
+      default:
+          /* No fused path.  Caller composites and collects separately. */
+          collected = ICET_FALSE;
+          break;
+    }
+
+    icetStateCheckMemory();
+
+    return collected;
+}
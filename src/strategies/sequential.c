@@ -9,6 +9,7 @@
 
 #include <IceT.h>
 
+#include <IceTDevContext.h>
 #include <IceTDevImage.h>
 #include <IceTDevState.h>
 #include <IceTDevDiagnostics.h>
@@ -28,6 +29,7 @@ IceTImage icetSequentialCompose(void)
     const IceTInt *tile_viewports;
     IceTBoolean ordered_composite;
     IceTBoolean image_collect;
+    IceTInt block_size;
     IceTImage my_image;
     IceTInt *compose_group;
     int i;
@@ -47,6 +49,13 @@ IceTImage icetSequentialCompose(void)
         image_collect = ICET_TRUE;
     }
 
+    /* Pixels can only be put back in scanline order once the whole tile is
+       collected. */
+    icetGetIntegerv(ICET_PIXEL_BLOCK_SIZE, &block_size);
+    if (!image_collect) {
+        block_size = 0;
+    }
+
     compose_group = icetGetStateBuffer(SEQUENTIAL_COMPOSE_GROUP_BUFFER,
                                        sizeof(IceTInt)*num_proc);
 
@@ -87,7 +96,37 @@ IceTImage icetSequentialCompose(void)
         rendered_image = icetGetStateBufferSparseImage(SEQUENTIAL_IMAGE_BUFFER,
                                                        tile_width, tile_height);
 
-        icetGetCompressedTileImage(i, rendered_image);
+        icetGetBlockedCompressedTileImage(i, block_size, rendered_image);
+
+        /* Every process renders every tile, so each tile gives two points
+           (before compose and before collect) where all processes can
+           agree to drop a cancelled frame. */
+        if (icetFrameCancelled()) { break; }
+
+        if (image_collect) {
+            IceTImage tile_image;
+
+            /* Everyone is in the compose group, so the fused path reaches
+               every process that the separate collect would. */
+            if (d_node == rank) {
+                tile_image = icetGetDisplayImage(SEQUENTIAL_FINAL_IMAGE_BUFFER,
+                                                 tile_width, tile_height);
+            } else {
+                tile_image = icetImageNull();
+            }
+            if (icetSingleImageComposeCollect(compose_group,
+                                              num_proc,
+                                              image_dest,
+                                              rendered_image,
+                                              tile_image)) {
+                if (d_node == rank) {
+                    icetImageUnblockPixels(tile_image, block_size);
+                    my_image = tile_image;
+                }
+                continue;
+            }
+        }
+
 	icetSingleImageCompose(compose_group,
                                num_proc,
                                image_dest,
@@ -98,12 +137,13 @@ IceTImage icetSequentialCompose(void)
         if (image_collect) {
             IceTImage tile_image;
 
+            if (icetFrameCancelled()) { break; }
+
             /* If this processor is display node, make sure image goes to
                myColorBuffer. */
             if (d_node == rank) {
-                tile_image = icetGetStateBufferImage(
-                                                  SEQUENTIAL_FINAL_IMAGE_BUFFER,
-                                                  tile_width, tile_height);
+                tile_image = icetGetDisplayImage(SEQUENTIAL_FINAL_IMAGE_BUFFER,
+                                                 tile_width, tile_height);
             } else {
                 tile_image = icetGetStateBufferImage(
                                            SEQUENTIAL_INTERMEDIATE_IMAGE_BUFFER,
@@ -116,6 +156,7 @@ IceTImage icetSequentialCompose(void)
                                    tile_image);
 
             if (d_node == rank) {
+                icetImageUnblockPixels(tile_image, block_size);
                 my_image = tile_image;
             }
         } else { /* !image_collect */
@@ -86,8 +86,8 @@ IceTImage icetVtreeCompose(void)
   /* Allocate buffers. */
     sparseImageSize = icetSparseImageBufferSize(max_width, max_height);
 
-    image                = icetGetStateBufferImage(VTREE_IMAGE_BUFFER,
-                                                   max_width, max_height);
+    image                = icetGetDisplayImage(VTREE_IMAGE_BUFFER,
+                                               max_width, max_height);
     inSparseImageBuffer  = icetGetStateBuffer(VTREE_IN_SPARSE_IMAGE_BUFFER,
                                               sparseImageSize);
     outSparseImage       = icetGetStateBufferSparseImage(
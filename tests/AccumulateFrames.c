@@ -0,0 +1,253 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks accumulating frames with ICET_ACCUMULATE_FRAMES.  Each
+** process must hold the average of all frames so far in its piece of the
+** image, and the averaged image must be collected every
+** ICET_ACCUMULATE_INTERVAL frames and on the frame after icetAccumulateCollect.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+
+#include <math.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+/* Red value drawn by every process in the next frame. */
+static IceTFloat g_red;
+
+static void AccumulateFramesDraw(const IceTDouble *projection_matrix,
+                                 const IceTDouble *modelview_matrix,
+                                 const IceTFloat *background_color,
+                                 const IceTInt *readback_viewport,
+                                 IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTFloat *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorf(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A band of columns for each process.  Together they cover the image. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if ((x*num_proc)/width == rank) {
+                colors[4*pixel + 0] = g_red;
+                colors[4*pixel + 1] = 0.0f;
+                colors[4*pixel + 2] = 0.0f;
+                colors[4*pixel + 3] = 1.0f;
+                depths[pixel] = 0.5f;
+            } else {
+                colors[4*pixel + 0] = 0.0f;
+                colors[4*pixel + 1] = 0.0f;
+                colors[4*pixel + 2] = 0.0f;
+                colors[4*pixel + 3] = 0.0f;
+                depths[pixel] = 1.0f;
+            }
+        }
+    }
+}
+
+/* Draws a frame with the given red value and checks that the pixels held by
+   the local process have the expected average.  If collected is true, the
+   display process must get the whole image. */
+static int AccumulateFramesCheckFrame(IceTFloat red,
+                                      IceTInt expected_frames,
+                                      IceTFloat expected_red,
+                                      IceTBoolean collected)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+    IceTInt frames;
+    IceTInt valid_tile;
+    IceTInt valid_offset;
+    IceTInt valid_num;
+    IceTInt tile_displayed;
+    int result = TEST_PASSED;
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    g_red = red;
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    icetGetIntegerv(ICET_ACCUMULATED_FRAMES, &frames);
+    if (frames != expected_frames) {
+        printrank("Accumulated %d frames, expected %d.\n",
+                  (int)frames, (int)expected_frames);
+        result = TEST_FAILED;
+    }
+
+    if (!icetIsEnabled(ICET_COLLECT_IMAGES)) {
+        printrank("ICET_COLLECT_IMAGES not restored after the frame.\n");
+        result = TEST_FAILED;
+    }
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+    icetGetIntegerv(ICET_VALID_PIXELS_OFFSET, &valid_offset);
+    icetGetIntegerv(ICET_VALID_PIXELS_NUM, &valid_num);
+    icetGetIntegerv(ICET_TILE_DISPLAYED, &tile_displayed);
+
+    if (collected && (tile_displayed >= 0)) {
+        if (   (valid_tile != tile_displayed)
+            || (valid_offset != 0)
+            || (valid_num != SCREEN_WIDTH*SCREEN_HEIGHT) ) {
+            printrank("Accumulated image not collected.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    if (valid_tile >= 0) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTInt pixel;
+        for (pixel = valid_offset; pixel < valid_offset+valid_num; pixel++) {
+            if (   (fabs(colors[4*pixel + 0] - expected_red) > 0.0001)
+                || (colors[4*pixel + 3] != 1.0f) ) {
+                printrank("Pixel %d has color %f %f, expected %f %f.\n",
+                          (int)pixel,
+                          colors[4*pixel + 0], colors[4*pixel + 3],
+                          expected_red, 1.0f);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int AccumulateFramesTryStrategy(void)
+{
+    int result = TEST_PASSED;
+
+    icetEnable(ICET_ACCUMULATE_FRAMES);
+    icetAccumulateInterval(4);
+    icetAccumulateReset();
+
+    printstat("  Checking running averages.\n");
+    if (AccumulateFramesCheckFrame(0.25f, 1, 0.25f, ICET_FALSE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (AccumulateFramesCheckFrame(0.75f, 2, 0.5f, ICET_FALSE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (AccumulateFramesCheckFrame(0.25f, 3, 1.25f/3.0f, ICET_FALSE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    printstat("  Checking collection every interval.\n");
+    if (AccumulateFramesCheckFrame(0.75f, 4, 0.5f, ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    printstat("  Checking collection on request.\n");
+    icetAccumulateCollect();
+    if (AccumulateFramesCheckFrame(0.25f, 5, 0.45f, ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (AccumulateFramesCheckFrame(0.75f, 6, 0.5f, ICET_FALSE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    printstat("  Checking reset.\n");
+    icetAccumulateReset();
+    icetAccumulateCollect();
+    if (AccumulateFramesCheckFrame(0.75f, 1, 0.75f, ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    printstat("  Checking that frames are collected when turned off.\n");
+    icetDisable(ICET_ACCUMULATE_FRAMES);
+    if (AccumulateFramesCheckFrame(0.25f, 1, 0.25f, ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int AccumulateFramesRun(void)
+{
+    IceTInt strategy_index;
+    IceTInt diagnostic_level;
+    int result = TEST_PASSED;
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(AccumulateFramesDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    /* The error is expected, so do not report it. */
+    icetGetIntegerv(ICET_DIAGNOSTIC_LEVEL, &diagnostic_level);
+    icetDiagnostics(ICET_DIAG_OFF);
+    icetAccumulateInterval(-1);
+    icetDiagnostics(diagnostic_level);
+    if (icetGetError() != ICET_INVALID_VALUE) {
+        printrank("Negative interval not rejected.\n");
+        result = TEST_FAILED;
+    }
+
+    /* Keep running every strategy even after a failure so that all processes
+       make the same sequence of collective calls. */
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+        printstat("Checking strategy %s.\n", icetGetStrategyName());
+        if (AccumulateFramesTryStrategy() != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    return result;
+}
+
+int AccumulateFrames(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(AccumulateFramesRun);
+}
@@ -0,0 +1,231 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_BITMAP_SPARSE_IMAGES option.  Sparse images of
+** scattered points must get smaller with a bitmap and come back exactly the
+** same after a round trip through a receive buffer, images with long runs
+** must be left alone, and compositing with the option on must give the same
+** image as with it off.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_WIDTH     300
+#define IMAGE_HEIGHT    200
+
+/* Makes roughly one pixel in point_spacing active, or solid blocks of rows
+   when point_spacing is 0. */
+static void BitmapSparseImagesFill(IceTImage image,
+                                   IceTInt point_spacing,
+                                   IceTInt seed)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType pixel;
+
+    srand(seed);
+    for (pixel = 0; pixel < num_pixels; pixel++) {
+        IceTBoolean active;
+        IceTFloat color[4];
+
+        if (point_spacing > 0) {
+            active = (rand()%point_spacing == 0);
+        } else {
+            active = ((pixel/width)%16 < 8);
+        }
+
+        if (active) {
+            color[0] = (IceTFloat)(rand()%256)/255.0f;
+            color[1] = (IceTFloat)(rand()%256)/255.0f;
+            color[2] = (IceTFloat)(rand()%256)/255.0f;
+            color[3] = 1.0f;
+        } else {
+            color[0] = color[1] = color[2] = color[3] = 0.0f;
+        }
+
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            IceTUByte *out = icetImageGetColorub(image) + 4*pixel;
+            out[0] = (IceTUByte)(255*color[0]);
+            out[1] = (IceTUByte)(255*color[1]);
+            out[2] = (IceTUByte)(255*color[2]);
+            out[3] = (IceTUByte)(255*color[3]);
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 4*pixel, color, sizeof(color));
+        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 3*pixel, color,
+                   3*sizeof(IceTFloat));
+        }
+
+        if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+            icetImageGetDepthf(image)[pixel]
+                = active ? (IceTFloat)rand()/((IceTFloat)RAND_MAX + 1) : 1.0f;
+        }
+    }
+}
+
+static int BitmapSparseImagesRoundTrip(IceTEnum composite_mode,
+                                       IceTEnum color_format,
+                                       IceTEnum depth_format)
+{
+    IceTImage image;
+    IceTSparseImage sparse;
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffer;
+    IceTSizeType original_size;
+    IceTSizeType encoded_size;
+    IceTInt point_spacing;
+    int result = TEST_PASSED;
+
+    printstat("Round trip with composite mode 0x%X, color 0x%X, depth 0x%X.\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    image_buffer = malloc(icetImageBufferSize(IMAGE_WIDTH, IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer, IMAGE_WIDTH, IMAGE_HEIGHT);
+    sparse_buffer = malloc(icetSparseImageBufferSize(IMAGE_WIDTH,
+                                                     IMAGE_HEIGHT));
+
+    for (point_spacing = 0; point_spacing < 20; point_spacing += 4) {
+        /* An encoded image can only be sent, so start from a new one. */
+        sparse = icetSparseImageAssignBuffer(sparse_buffer,
+                                             IMAGE_WIDTH, IMAGE_HEIGHT);
+        BitmapSparseImagesFill(image, point_spacing, point_spacing + 1);
+        icetCompressImage(image, sparse);
+
+        if (check_transport_encoding(sparse,
+                                     ICET_BITMAP_SPARSE_IMAGES,
+                                     icetSparseImageEncodeBitmap,
+                                     &original_size,
+                                     &encoded_size) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        printstat("Point spacing %d: encoded %d bytes to %d.\n",
+                  (int)point_spacing, (int)original_size, (int)encoded_size);
+        if (point_spacing == 0) {
+            if (encoded_size != original_size) {
+                printrank("Image with long runs was encoded.\n");
+                result = TEST_FAILED;
+            }
+        } else if (encoded_size >= original_size) {
+            printrank("Scattered points did not get smaller.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    free(sparse_buffer);
+    free(image_buffer);
+
+    return result;
+}
+
+static void BitmapSparseImagesDraw(const IceTDouble *projection_matrix,
+                                   const IceTDouble *modelview_matrix,
+                                   const IceTFloat *background_color,
+                                   const IceTInt *readback_viewport,
+                                   IceTImage result)
+{
+    IceTInt rank;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A different scatter of points on each process. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if ((x*7 + y*13 + rank*5)%17 == 0) {
+                depths[pixel] = 0.1f + 0.001f*(IceTFloat)((x + rank)%500);
+                colors[4*pixel + 0] = (IceTUByte)(40*rank%256);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+static int BitmapSparseImagesRun(void)
+{
+    int result = TEST_PASSED;
+
+    /* Bitmaps are only used when smaller than the run lengths would be sent,
+       so compare against fixed size run lengths. */
+    icetDisable(ICET_VARINT_RUN_LENGTHS);
+
+    if (BitmapSparseImagesRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                    ICET_IMAGE_COLOR_RGBA_UBYTE,
+                                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (BitmapSparseImagesRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                    ICET_IMAGE_COLOR_RGB_FLOAT,
+                                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (BitmapSparseImagesRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                    ICET_IMAGE_COLOR_NONE,
+                                    ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (BitmapSparseImagesRoundTrip(ICET_COMPOSITE_MODE_BLEND,
+                                    ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                    ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    if (check_transport_encoding_composite(ICET_BITMAP_SPARSE_IMAGES,
+                                           BitmapSparseImagesDraw)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetEnable(ICET_VARINT_RUN_LENGTHS);
+
+    return result;
+}
+
+int BitmapSparseImages(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(BitmapSparseImagesRun);
+}
@@ -0,0 +1,256 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks giving multiple bounding boxes with icetBoundingBoxesd.
+** Each box should be projected separately so that the region of each tile
+** that IceT reads back only covers the boxes that actually touch the tile
+** rather than everything in the bounds of all the boxes.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static const IceTFloat g_background_color[4] = { 0.5, 0.5, 0.5, 1.0 };
+static const IceTFloat g_foreground_color[4] = { 0.0, 0.25, 0.5, 1.0 };
+
+static IceTBoolean ColorsEqual(const IceTFloat *color1, const IceTFloat *color2)
+{
+    IceTBoolean result;
+
+    result  = (color1[0] == color2[0]);
+    result &= (color1[1] == color2[1]);
+    result &= (color1[2] == color2[2]);
+    result &= (color1[3] == color2[3]);
+
+    return result;
+}
+
+static void BoundingBoxesDraw(const IceTDouble *projection_matrix,
+                              const IceTDouble *modelview_matrix,
+                              const IceTFloat *background_color,
+                              const IceTInt *readback_viewport,
+                              IceTImage result)
+{
+    IceTSizeType width;
+    IceTFloat *colors;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorf(result);
+
+    /* Fill everything in the readback viewport.  If IceT asks for more than
+     * the boxes cover, the extra pixels will show up in the final image. */
+    {
+        IceTSizeType line_start = width*readback_viewport[1];
+        IceTSizeType line;
+        for (line = 0; line < readback_viewport[3]; line++) {
+            IceTSizeType pixel = line_start + readback_viewport[0];
+            IceTSizeType column;
+            for (column = 0; column < readback_viewport[2]; column++) {
+                colors[4*pixel + 0] = g_foreground_color[0];
+                colors[4*pixel + 1] = g_foreground_color[1];
+                colors[4*pixel + 2] = g_foreground_color[2];
+                colors[4*pixel + 3] = g_foreground_color[3];
+                pixel++;
+            }
+            line_start += width;
+        }
+    }
+}
+
+/* Checks the pixels in the region given as fractions of the image width and
+ * height.  Regions are kept well inside the boxes to avoid problems with
+ * rounding. */
+static IceTBoolean CheckRegion(const IceTImage image,
+                               IceTFloat left, IceTFloat right,
+                               IceTFloat bottom, IceTFloat top,
+                               const IceTFloat *expected_color)
+{
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    const IceTFloat *colors = icetImageGetColorcf(image);
+    IceTSizeType x, y;
+
+    for (y = (IceTSizeType)(bottom*height); y < (IceTSizeType)(top*height); y++){
+        for (x = (IceTSizeType)(left*width); x < (IceTSizeType)(right*width); x++){
+            const IceTFloat *pixel = colors + 4*(y*width + x);
+            if (!ColorsEqual(pixel, expected_color)) {
+                IceTUByte *buffer;
+                IceTInt rank;
+                char filename[255];
+                printrank("BAD PIXEL %d %d\n", (int)x, (int)y);
+                printrank("    Expected %f %f %f %f\n",
+                          expected_color[0],
+                          expected_color[1],
+                          expected_color[2],
+                          expected_color[3]);
+                printrank("    Got %f %f %f %f\n",
+                          pixel[0], pixel[1], pixel[2], pixel[3]);
+                buffer = malloc(4*width*height);
+                icetImageCopyColorub(image, buffer,ICET_IMAGE_COLOR_RGBA_UBYTE);
+                icetGetIntegerv(ICET_RANK, &rank);
+                icetSnprintf(filename, 255, "BoundingBoxes_%d.ppm", rank);
+                write_ppm(filename, buffer, width, height);
+                free(buffer);
+                return ICET_FALSE;
+            }
+        }
+    }
+
+    return ICET_TRUE;
+}
+
+static void BoundingBoxesSetupRender(void)
+{
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+    icetEnable(ICET_CORRECT_COLORED_BACKGROUND);
+
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+
+    icetDrawCallback(BoundingBoxesDraw);
+}
+
+static IceTImage BoundingBoxesRender(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    /* Identity matrices make it easy to predict where geometry is projected. */
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+static int BoundingBoxesCulled(void)
+{
+    IceTImage image;
+    IceTInt rank;
+    /* The second box is behind the far plane. */
+    const IceTDouble boxes[12] = {
+        -0.75, -0.25, -0.75, -0.25, -0.5, 0.5,
+         0.25,  0.75,  0.25,  0.75,  2.0, 3.0
+    };
+
+    printstat("Checking that a box outside the view is dropped.\n");
+
+    BoundingBoxesSetupRender();
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetBoundingBoxesd(2, boxes);
+
+    image = BoundingBoxesRender();
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank != 0) { return TEST_PASSED; }
+
+    if (!CheckRegion(image, 0.15f, 0.35f, 0.15f, 0.35f, g_foreground_color)) {
+        return TEST_FAILED;
+    }
+    if (!CheckRegion(image, 0.45f, 0.55f, 0.45f, 0.55f, g_background_color)) {
+        return TEST_FAILED;
+    }
+    if (!CheckRegion(image, 0.65f, 0.85f, 0.65f, 0.85f, g_background_color)) {
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+static int BoundingBoxesTwoTiles(void)
+{
+    IceTImage image;
+    IceTInt rank;
+    IceTInt num_proc;
+    /* One box in the bottom of the left tile and one box in the top of the
+       right tile.  The bounds of both boxes cover parts of both tiles. */
+    const IceTDouble boxes[12] = {
+        -0.4, -0.1, -0.75, -0.25, -0.5, 0.5,
+         0.1,  0.4,  0.25,  0.75, -0.5, 0.5
+    };
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    if (num_proc < 2) {
+        printstat("Need at least two processes to check multiple tiles.\n");
+        return TEST_PASSED;
+    }
+
+    BoundingBoxesSetupRender();
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetAddTile(SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
+    icetBoundingBoxesd(2, boxes);
+
+    image = BoundingBoxesRender();
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    if (rank == 0) {
+        if (!CheckRegion(image, 0.65f, 0.85f, 0.15f, 0.35f,
+                         g_foreground_color)) {
+            return TEST_FAILED;
+        }
+        if (!CheckRegion(image, 0.65f, 0.85f, 0.65f, 0.85f,
+                         g_background_color)) {
+            return TEST_FAILED;
+        }
+    } else if (rank == 1) {
+        if (!CheckRegion(image, 0.15f, 0.35f, 0.65f, 0.85f,
+                         g_foreground_color)) {
+            return TEST_FAILED;
+        }
+        if (!CheckRegion(image, 0.15f, 0.35f, 0.15f, 0.35f,
+                         g_background_color)) {
+            return TEST_FAILED;
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int BoundingBoxesRun(void)
+{
+    int result = TEST_PASSED;
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (BoundingBoxesCulled() != TEST_PASSED) { result = TEST_FAILED; }
+
+    printstat("Checking two tiles with floating viewport.\n");
+    icetEnable(ICET_FLOATING_VIEWPORT);
+    if (BoundingBoxesTwoTiles() != TEST_PASSED) { result = TEST_FAILED; }
+
+    printstat("Checking two tiles without floating viewport.\n");
+    icetDisable(ICET_FLOATING_VIEWPORT);
+    if (BoundingBoxesTwoTiles() != TEST_PASSED) { result = TEST_FAILED; }
+
+    return result;
+}
+
+int BoundingBoxes(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(BoundingBoxesRun);
+}
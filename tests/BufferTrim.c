@@ -0,0 +1,263 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that the internal buffers of a context give back the
+** memory of a big frame: explicitly with icetTrimBuffers, after
+** ICET_BUFFER_RELEASE_FRAMES smaller frames, and after a single smaller frame
+** when over ICET_MEMORY_BUDGET.  Images must not change in any case.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static void BufferTrimDraw(const IceTDouble *projection_matrix,
+                           const IceTDouble *modelview_matrix,
+                           const IceTFloat *background_color,
+                           const IceTInt *readback_viewport,
+                           IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A band of rows for each process at a different depth. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        IceTBoolean inside = ((y*num_proc)/height == rank);
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if (inside || (x%(rank + 2) == 0)) {
+                depths[pixel] = inside ? 0.25f : 0.75f;
+                colors[4*pixel + 0] = (IceTUByte)(40*rank%256);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+static IceTImage BufferTrimRender(IceTSizeType width, IceTSizeType height)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetResetTiles();
+    icetAddTile(0, 0, width, height, 0);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Renders a big frame and checks that it matches the one held in
+   expected_color, or fills expected_color if it is the first. */
+static int BufferTrimRenderBig(IceTUByte *expected_color,
+                               IceTBoolean fill_expected)
+{
+    IceTInt rank;
+    IceTSizeType num_pixels = SCREEN_WIDTH*SCREEN_HEIGHT;
+    IceTImage image;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    image = BufferTrimRender(SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (rank != 0) { return TEST_PASSED; }
+
+    if (fill_expected) {
+        memcpy(expected_color, icetImageGetColorcub(image), 4*num_pixels);
+    } else if (memcmp(expected_color, icetImageGetColorcub(image),
+                      4*num_pixels) != 0) {
+        printrank("Image changed.\n");
+        return TEST_FAILED;
+    }
+    return TEST_PASSED;
+}
+
+static int BufferTrimExplicit(IceTUByte *expected_color)
+{
+    IceTUnsignedInt64 big_bytes;
+    int result = TEST_PASSED;
+
+    printstat("Checking icetTrimBuffers.\n");
+
+    /* Start from scratch so that no buffer is left big from earlier tests. */
+    icetTrimBuffers();
+    BufferTrimRenderBig(expected_color, ICET_TRUE);
+    big_bytes = icetStateBufferBytes();
+    if (big_bytes == 0) {
+        printrank("No buffers allocated for a frame.\n");
+        result = TEST_FAILED;
+    }
+
+    icetTrimBuffers();
+    if (icetStateBufferBytes() != 0) {
+        printrank("Buffers still allocated after trim.\n");
+        result = TEST_FAILED;
+    }
+
+    if (BufferTrimRenderBig(expected_color, ICET_FALSE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (icetStateBufferBytes() != big_bytes) {
+        printrank("Frame after trim allocated %d bytes instead of %d.\n",
+                  (int)icetStateBufferBytes(), (int)big_bytes);
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int BufferTrimReleaseFrames(IceTUByte *expected_color)
+{
+    IceTUnsignedInt64 big_bytes;
+    int result = TEST_PASSED;
+
+    printstat("Checking ICET_BUFFER_RELEASE_FRAMES.\n");
+    icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES, 2);
+
+    BufferTrimRenderBig(expected_color, ICET_FALSE);
+    big_bytes = icetStateBufferBytes();
+
+    /* The big buffers are not needed in the next two frames, so they are
+       released at the start of the third. */
+    BufferTrimRender(SCREEN_WIDTH/4, SCREEN_HEIGHT/4);
+    BufferTrimRender(SCREEN_WIDTH/4, SCREEN_HEIGHT/4);
+    if (icetStateBufferBytes() < big_bytes) {
+        printrank("Buffers released too early.\n");
+        result = TEST_FAILED;
+    }
+    BufferTrimRender(SCREEN_WIDTH/4, SCREEN_HEIGHT/4);
+    if (2*icetStateBufferBytes() > big_bytes) {
+        printrank("Buffers hold %d bytes after small frames, %d for big.\n",
+                  (int)icetStateBufferBytes(), (int)big_bytes);
+        result = TEST_FAILED;
+    }
+
+    if (BufferTrimRenderBig(expected_color, ICET_FALSE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES, 0);
+    return result;
+}
+
+static int BufferTrimMemoryBudget(IceTUByte *expected_color)
+{
+    IceTUnsignedInt64 big_bytes;
+    int result = TEST_PASSED;
+
+    printstat("Checking ICET_MEMORY_BUDGET.\n");
+    icetStateSetInteger(ICET_MEMORY_BUDGET, 1);
+
+    /* Smaller k values are picked under the budget.  That must not change
+       the image. */
+    if (BufferTrimRenderBig(expected_color, ICET_FALSE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    big_bytes = icetStateBufferBytes();
+
+    BufferTrimRender(SCREEN_WIDTH/4, SCREEN_HEIGHT/4);
+    BufferTrimRender(SCREEN_WIDTH/4, SCREEN_HEIGHT/4);
+    if (2*icetStateBufferBytes() > big_bytes) {
+        printrank("Buffers hold %d bytes over budget, %d for big.\n",
+                  (int)icetStateBufferBytes(), (int)big_bytes);
+        result = TEST_FAILED;
+    }
+
+    icetStateSetInteger(ICET_MEMORY_BUDGET, 0);
+    return result;
+}
+
+static int BufferTrimRun(void)
+{
+    IceTInt save_release_frames;
+    IceTInt save_memory_budget;
+    IceTUByte *expected_color;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_BUFFER_RELEASE_FRAMES, &save_release_frames);
+    icetGetIntegerv(ICET_MEMORY_BUDGET, &save_memory_budget);
+    icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES, 0);
+    icetStateSetInteger(ICET_MEMORY_BUDGET, 0);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(BufferTrimDraw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+
+    expected_color = malloc(4*SCREEN_WIDTH*SCREEN_HEIGHT);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (BufferTrimExplicit(expected_color) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (BufferTrimReleaseFrames(expected_color) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (BufferTrimMemoryBudget(expected_color) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    free(expected_color);
+
+    icetStateSetInteger(ICET_BUFFER_RELEASE_FRAMES, save_release_frames);
+    icetStateSetInteger(ICET_MEMORY_BUDGET, save_memory_budget);
+
+    return result;
+}
+
+int BufferTrim(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(BufferTrimRun);
+}
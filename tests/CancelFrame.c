@@ -0,0 +1,261 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks icetCancelFrame.  A frame cancelled by one process from
+** its drawing callback must be dropped by all processes together, a request
+** made between frames or with ICET_FRAME_CANCELLATION disabled must be
+** ignored, and the frame after a cancelled one must be complete.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevCommunication.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTBoolean g_cancel_in_draw;
+
+static void CancelFrameDraw(const IceTDouble *projection_matrix,
+                            const IceTDouble *modelview_matrix,
+                            const IceTFloat *background_color,
+                            const IceTInt *readback_viewport,
+                            IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    /* Only the last process notices that the frame is stale. */
+    if (g_cancel_in_draw && (rank == num_proc-1)) {
+        icetCancelFrame();
+    }
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A band of columns for each process. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if ((x*num_proc)/width == rank) {
+                depths[pixel] = 0.5f;
+                colors[4*pixel + 0] = (IceTUByte)(40*rank%256);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+static IceTImage CancelFrameRender(IceTBoolean cancel_in_draw)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    g_cancel_in_draw = cancel_in_draw;
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Checks that every process has the same ICET_FRAME_CANCELLED. */
+static int CancelFrameCheckAgreement(IceTBoolean *cancelled_p)
+{
+    IceTInt num_proc;
+    IceTBoolean cancelled;
+    IceTBoolean *all_cancelled;
+    IceTInt proc;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    icetGetBooleanv(ICET_FRAME_CANCELLED, &cancelled);
+
+    all_cancelled = malloc(num_proc*sizeof(IceTBoolean));
+    icetCommAllgather(&cancelled, 1, ICET_BYTE, all_cancelled);
+    for (proc = 0; proc < num_proc; proc++) {
+        if (all_cancelled[proc] != cancelled) {
+            printrank("Process %d does not agree the frame is cancelled.\n",
+                      (int)proc);
+            result = TEST_FAILED;
+        }
+    }
+    free(all_cancelled);
+
+    *cancelled_p = cancelled;
+    return result;
+}
+
+/* Renders a frame that must not be cancelled and compares it to
+   expected_color. */
+static int CancelFrameCheckComplete(const IceTUByte *expected_color)
+{
+    IceTImage image;
+    IceTBoolean cancelled;
+    IceTInt valid_tile;
+    int result = TEST_PASSED;
+
+    image = CancelFrameRender(ICET_FALSE);
+    if (CancelFrameCheckAgreement(&cancelled) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (cancelled) {
+        printrank("Frame cancelled without a request.\n");
+        return TEST_FAILED;
+    }
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+    if (   (valid_tile >= 0)
+        && (memcmp(expected_color, icetImageGetColorcub(image),
+                   4*SCREEN_WIDTH*SCREEN_HEIGHT) != 0) ) {
+        printrank("Image differs from reference.\n");
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int CancelFrameTryStrategy(const IceTUByte *expected_color)
+{
+    IceTEnum strategy;
+    IceTImage image;
+    IceTBoolean cancelled;
+    int result = TEST_PASSED;
+
+    icetGetEnumv(ICET_STRATEGY, &strategy);
+
+    /* A request made between frames is for a frame that is already done. */
+    icetCancelFrame();
+    if (CancelFrameCheckComplete(expected_color) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    image = CancelFrameRender(ICET_TRUE);
+    if (CancelFrameCheckAgreement(&cancelled) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (cancelled) {
+        IceTInt valid_tile;
+        icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+        if (!icetImageIsNull(image) || (valid_tile != -1)) {
+            printrank("Cancelled frame returned an image.\n");
+            result = TEST_FAILED;
+        }
+    } else if (   (strategy == ICET_STRATEGY_SEQUENTIAL)
+               || (strategy == ICET_STRATEGY_REDUCE) ) {
+        /* These strategies meet on all processes between rendering and
+           compositing, so the request must have been seen there. */
+        printrank("Frame not cancelled by strategy %s.\n",
+                  icetGetStrategyName());
+        result = TEST_FAILED;
+    }
+
+    /* The next frame starts over. */
+    if (CancelFrameCheckComplete(expected_color) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int CancelFrameRun(void)
+{
+    IceTUByte *expected_color;
+    IceTImage image;
+    IceTBoolean cancelled;
+    IceTInt rank;
+    IceTInt strategy_index;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(CancelFrameDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+    icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_AUTOMATIC);
+
+    expected_color = malloc(4*SCREEN_WIDTH*SCREEN_HEIGHT);
+
+    printstat("Checking that cancellation is off by default.\n");
+    icetDisable(ICET_FRAME_CANCELLATION);
+    image = CancelFrameRender(ICET_TRUE);
+    if (CancelFrameCheckAgreement(&cancelled) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (cancelled) {
+        printrank("Frame cancelled with ICET_FRAME_CANCELLATION disabled.\n");
+        result = TEST_FAILED;
+    }
+    if (rank == 0) {
+        memcpy(expected_color, icetImageGetColorcub(image),
+               4*SCREEN_WIDTH*SCREEN_HEIGHT);
+    }
+
+    icetEnable(ICET_FRAME_CANCELLATION);
+
+    /* Keep running every strategy even after a failure so that all processes
+       make the same sequence of collective calls. */
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        printstat("Checking strategy %s.\n", icetGetStrategyName());
+        if (CancelFrameTryStrategy(expected_color) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    icetDisable(ICET_FRAME_CANCELLATION);
+    free(expected_color);
+
+    return result;
+}
+
+int CancelFrame(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(CancelFrameRun);
+}
@@ -0,0 +1,216 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_COMM_PROGRESS_INTERVAL option.  Testing the
+** outstanding sends of radix-k and radix-kr while blending, even after every
+** few pixels, must give exactly the same image as never testing them.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static void CommProgressDraw(const IceTDouble *projection_matrix,
+                             const IceTDouble *modelview_matrix,
+                             const IceTFloat *background_color,
+                             const IceTInt *readback_viewport,
+                             IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTFloat color[4];
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTFloat *colors;
+    IceTSizeType band_start;
+    IceTSizeType band_end;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    /* Translucent colors that blend exactly in floating point. */
+    color[0] = 0.5f*(IceTFloat)( rank     %3)/2.0f;
+    color[1] = 0.5f*(IceTFloat)((rank/3)  %3)/2.0f;
+    color[2] = 0.5f*(IceTFloat)((rank/9)  %3)/2.0f;
+    color[3] = 0.5f;
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    colors = icetImageGetColorf(result);
+
+    /* Overlapping bands with holes so that the blends see many short runs. */
+    band_start = (rank*height)/(num_proc+1);
+    band_end = ((rank+2)*height)/(num_proc+1);
+
+    for (line = readback_viewport[1];
+         line < readback_viewport[1] + readback_viewport[3];
+         line++) {
+        IceTSizeType pixel = line*width + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            if (   (line >= band_start) && (line < band_end)
+                && ((column + rank)%3 != 0) ) {
+                colors[4*pixel + 0] = color[0];
+                colors[4*pixel + 1] = color[1];
+                colors[4*pixel + 2] = color[2];
+                colors[4*pixel + 3] = color[3];
+            } else {
+                colors[4*pixel + 0] = 0.0f;
+                colors[4*pixel + 1] = 0.0f;
+                colors[4*pixel + 2] = 0.0f;
+                colors[4*pixel + 3] = 0.0f;
+            }
+            pixel++;
+        }
+    }
+}
+
+static IceTImage CommProgressRender(IceTInt interval)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetStateSetInteger(ICET_COMM_PROGRESS_INTERVAL, interval);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Checks the image rendered with the given interval against one rendered
+   with polling off. */
+static int CommProgressCompare(IceTEnum single_image_strategy,
+                               IceTInt interval)
+{
+    IceTInt rank;
+    IceTSizeType num_values;
+    IceTFloat *expected;
+    IceTImage image;
+    IceTInt num_requests;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetSingleImageStrategy(single_image_strategy);
+    printstat("Checking %s with an interval of %d pixels.\n",
+              icetGetSingleImageStrategyName(), (int)interval);
+
+    image = CommProgressRender(0);
+    num_values = 4*SCREEN_WIDTH*SCREEN_HEIGHT;
+    expected = malloc(num_values*sizeof(IceTFloat));
+    if (rank == 0) {
+        memcpy(expected, icetImageGetColorcf(image),
+               num_values*sizeof(IceTFloat));
+    }
+
+    image = CommProgressRender(interval);
+    icetGetIntegerv(ICET_NUM_COMM_PROGRESS_REQUESTS, &num_requests);
+    if (num_requests != 0) {
+        printrank("Send requests are still registered after the frame.\n");
+        result = TEST_FAILED;
+    }
+    if (rank == 0) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTSizeType i;
+        for (i = 0; i < num_values; i++) {
+            if (colors[i] != expected[i]) {
+                printrank("Value %d differs with polling.\n", (int)i);
+                printrank("    Expected %f, got %f\n",
+                          expected[i], colors[i]);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    free(expected);
+    return result;
+}
+
+static int CommProgressRun(void)
+{
+    static const IceTEnum single_image_strategies[2] = {
+        ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+        ICET_SINGLE_IMAGE_STRATEGY_RADIXKR
+    };
+    static const IceTInt intervals[3] = { 1, 7, 256 };
+    IceTInt num_proc;
+    IceTInt save_magic_k;
+    IceTInt save_interval;
+    IceTInt *composite_order;
+    IceTInt strategy_index;
+    IceTInt interval_index;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    icetGetIntegerv(ICET_MAGIC_K, &save_magic_k);
+    icetGetIntegerv(ICET_COMM_PROGRESS_INTERVAL, &save_interval);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetDisable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(CommProgressDraw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+    /* Small k values give several rounds with sends outstanding. */
+    icetStateSetInteger(ICET_MAGIC_K, 2);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    composite_order = malloc(num_proc*sizeof(IceTInt));
+    for (i = 0; i < num_proc; i++) {
+        composite_order[i] = num_proc - i - 1;
+    }
+    icetEnable(ICET_ORDERED_COMPOSITE);
+    icetCompositeOrder(composite_order);
+    free(composite_order);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    for (strategy_index = 0; strategy_index < 2; strategy_index++) {
+        for (interval_index = 0; interval_index < 3; interval_index++) {
+            if (CommProgressCompare(single_image_strategies[strategy_index],
+                                    intervals[interval_index])
+                != TEST_PASSED) {
+                result = TEST_FAILED;
+            }
+        }
+    }
+
+    icetStateSetInteger(ICET_COMM_PROGRESS_INTERVAL, save_interval);
+    icetStateSetInteger(ICET_MAGIC_K, save_magic_k);
+
+    return result;
+}
+
+int CommProgress(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(CommProgressRun);
+}
@@ -0,0 +1,271 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** Tests the icetCompositeImageSpans method to composite an image given as a
+** list of spans of active pixels.  The result must match compositing the
+** same pixels in dense buffers with icetCompositeImage.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTInt g_num_spans;
+static IceTInt *g_spans;
+static IceTUInt *g_span_colors;
+static IceTFloat *g_span_depths;
+static IceTUInt *g_dense_colors;
+static IceTFloat *g_dense_depths;
+
+static void SetUpTiles(IceTInt tile_dimension)
+{
+    IceTInt tile_index = 0;
+    IceTInt tile_x;
+    IceTInt tile_y;
+
+    icetResetTiles();
+    for (tile_y = 0; tile_y < tile_dimension; tile_y++) {
+        for (tile_x = 0; tile_x < tile_dimension; tile_x++) {
+            icetAddTile(tile_x*SCREEN_WIDTH,
+                        tile_y*SCREEN_HEIGHT,
+                        SCREEN_WIDTH,
+                        SCREEN_HEIGHT,
+                        tile_index);
+            tile_index++;
+        }
+    }
+}
+
+/* Builds spans of various lengths, some of them across several rows, along
+   with the dense buffers holding the same pixels. */
+static void MakeSpans(void)
+{
+    IceTInt global_viewport[4];
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType num_pixels;
+    IceTSizeType max_spans;
+    IceTSizeType next_pixel;
+    IceTSizeType num_active;
+    IceTSizeType pixel;
+    IceTInt span;
+
+    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    num_pixels = global_viewport[2]*global_viewport[3];
+
+    max_spans = num_pixels/5 + 1;
+    g_spans = malloc(2*max_spans*sizeof(IceTInt));
+    g_span_colors = malloc(num_pixels*sizeof(IceTUInt));
+    g_span_depths = malloc(num_pixels*sizeof(IceTFloat));
+    g_dense_colors = malloc(num_pixels*sizeof(IceTUInt));
+    g_dense_depths = malloc(num_pixels*sizeof(IceTFloat));
+
+    for (pixel = 0; pixel < num_pixels; pixel++) {
+        g_dense_colors[pixel] = 0;
+        g_dense_depths[pixel] = 1.0f;
+    }
+
+    g_num_spans = 0;
+    num_active = 0;
+    next_pixel = 11*rank;
+    for (span = 0; span < max_spans; span++) {
+        IceTSizeType start = next_pixel + 5 + (span*(rank+1))%23;
+        IceTSizeType length;
+
+        if (span%7 == 3) {
+            length = global_viewport[2] + 17;
+        } else {
+            length = (span*31 + rank)%40;
+        }
+        if (start >= num_pixels) { break; }
+        if (start + length > num_pixels) { length = num_pixels - start; }
+
+        g_spans[2*g_num_spans + 0] = start;
+        g_spans[2*g_num_spans + 1] = length;
+        g_num_spans++;
+
+        for (pixel = start; pixel < start + length; pixel++) {
+            /* Depths never tie between processes. */
+            IceTUInt color =
+                0xFF000000 | ((IceTUInt)rank << 16) | (IceTUInt)(pixel%0xFFFF);
+            IceTFloat depth =
+                ((IceTFloat)((pixel + rank)%num_proc) + 0.5f)/num_proc;
+            g_span_colors[num_active] = color;
+            g_span_depths[num_active] = depth;
+            g_dense_colors[pixel] = color;
+            g_dense_depths[pixel] = depth;
+            num_active++;
+        }
+
+        next_pixel = start + length;
+    }
+}
+
+static void FreeSpans(void)
+{
+    free(g_spans);
+    free(g_span_colors);
+    free(g_span_depths);
+    free(g_dense_colors);
+    free(g_dense_depths);
+}
+
+static IceTBoolean CompositeImageSpansTryComposite(void)
+{
+    IceTImage image;
+    IceTInt tile_displayed;
+    IceTSizeType num_pixels;
+    IceTUInt *expected_colors;
+    IceTBoolean success = ICET_TRUE;
+
+    image = icetCompositeImage(g_dense_colors,
+                               g_dense_depths,
+                               NULL,
+                               NULL,
+                               NULL,
+                               g_background_color);
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &tile_displayed);
+    if (tile_displayed < 0) {
+        /* No local tile.  Just take part in the collective calls. */
+        icetCompositeImageSpans(g_num_spans,
+                                g_spans,
+                                g_span_colors,
+                                g_span_depths,
+                                NULL,
+                                NULL,
+                                g_background_color);
+        return ICET_TRUE;
+    }
+
+    num_pixels = icetImageGetNumPixels(image);
+    expected_colors = malloc(num_pixels*sizeof(IceTUInt));
+    memcpy(expected_colors,
+           icetImageGetColorcui(image),
+           num_pixels*sizeof(IceTUInt));
+
+    image = icetCompositeImageSpans(g_num_spans,
+                                    g_spans,
+                                    g_span_colors,
+                                    g_span_depths,
+                                    NULL,
+                                    NULL,
+                                    g_background_color);
+    if (icetImageGetNumPixels(image) != num_pixels) {
+        printrank("***** Image sizes differ: %d and %d *****\n",
+                  (int)icetImageGetNumPixels(image), (int)num_pixels);
+        success = ICET_FALSE;
+    } else if (memcmp(expected_colors,
+                      icetImageGetColorcui(image),
+                      num_pixels*sizeof(IceTUInt)) != 0) {
+        printrank("***** Span image differs from dense image *****\n");
+        success = ICET_FALSE;
+    }
+
+    free(expected_colors);
+    return success;
+}
+
+static IceTBoolean CompositeImageSpansTryStrategies(void)
+{
+    IceTBoolean success = ICET_TRUE;
+    IceTInt strategy_index;
+    IceTInt si_strategy_index;
+
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        for (si_strategy_index = 0;
+             si_strategy_index < SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+             si_strategy_index++) {
+            icetSingleImageStrategy(
+                              single_image_strategy_list[si_strategy_index]);
+            printstat("  Using %s strategy, %s single image strategy.\n",
+                      icetGetStrategyName(),
+                      icetGetSingleImageStrategyName());
+
+            success &= CompositeImageSpansTryComposite();
+        }
+    }
+
+    return success;
+}
+
+static IceTBoolean CompositeImageSpansTryErrors(void)
+{
+    IceTInt bad_spans[4] = { 20, 10, 25, 10 };
+    IceTInt diagnostic_level;
+    IceTImage image;
+
+    printstat("\nChecking overlapping spans.\n");
+
+    /* The error is expected, so do not report it. */
+    icetGetIntegerv(ICET_DIAGNOSTIC_LEVEL, &diagnostic_level);
+    icetDiagnostics(ICET_DIAG_OFF);
+    image = icetCompositeImageSpans(2,
+                                    bad_spans,
+                                    g_span_colors,
+                                    g_span_depths,
+                                    NULL,
+                                    NULL,
+                                    g_background_color);
+    icetDiagnostics(diagnostic_level);
+    if (!icetImageIsNull(image) || (icetGetError() != ICET_INVALID_VALUE)) {
+        printrank("***** Overlapping spans not rejected *****\n");
+        return ICET_FALSE;
+    }
+
+    return ICET_TRUE;
+}
+
+static int CompositeImageSpansRun(void)
+{
+    IceTBoolean success = ICET_TRUE;
+    IceTInt num_proc;
+    IceTInt tile_dimension;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+
+    for (tile_dimension = 1;
+         (tile_dimension <= 2) && (tile_dimension*tile_dimension <= num_proc);
+         tile_dimension++) {
+        printstat("\nUsing %dx%d tiles\n", tile_dimension, tile_dimension);
+
+        SetUpTiles(tile_dimension);
+        MakeSpans();
+
+        success &= CompositeImageSpansTryStrategies();
+        if (tile_dimension == 1) {
+            success &= CompositeImageSpansTryErrors();
+        }
+
+        FreeSpans();
+    }
+
+    return (success ? TEST_PASSED : TEST_FAILED);
+}
+
+int CompositeImageSpans(int argc, char *argv[])
+{
+    /* Suppress warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(CompositeImageSpansRun);
+}
@@ -0,0 +1,293 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks ICET_DENSE_IMAGE_PERCENT.  Images with a few holes must
+** be compressed as a single run of active pixels, and decompressing or
+** compositing them must give exactly what the run-length encoded images give.
+** Images with many holes must still be run-length encoded.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_WIDTH     200
+#define IMAGE_HEIGHT    150
+
+/* Fills image with active pixels except for holes every hole_spacing pixels.
+   The holes are given colors and depths other than the background to check
+   that they come back as background. */
+static void DenseImagesFill(IceTImage image,
+                            IceTInt hole_spacing,
+                            IceTInt seed)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType pixel;
+
+    srand(seed);
+    for (pixel = 0; pixel < num_pixels; pixel++) {
+        IceTBoolean hole = ((pixel + seed)%hole_spacing == 0);
+        IceTFloat color[4];
+
+        color[0] = (IceTFloat)(rand()%256)/255.0f;
+        color[1] = (IceTFloat)(rand()%256)/255.0f;
+        color[2] = (IceTFloat)(rand()%256)/255.0f;
+        color[3] = hole ? 0.0f : (IceTFloat)(rand()%255 + 1)/255.0f;
+        /* Premultiplied colors for blending. */
+        if (!hole) {
+            color[0] *= color[3];
+            color[1] *= color[3];
+            color[2] *= color[3];
+        }
+
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            IceTUByte *out = icetImageGetColorub(image) + 4*pixel;
+            out[0] = (IceTUByte)(255*color[0]);
+            out[1] = (IceTUByte)(255*color[1]);
+            out[2] = (IceTUByte)(255*color[2]);
+            out[3] = (IceTUByte)(255*color[3]);
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 4*pixel, color, sizeof(color));
+        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 3*pixel, color,
+                   3*sizeof(IceTFloat));
+        }
+
+        if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+            icetImageGetDepthf(image)[pixel]
+                = hole ? 1.0f : (IceTFloat)rand()/((IceTFloat)RAND_MAX + 1);
+        }
+    }
+}
+
+static IceTBoolean DenseImagesEqual(const IceTImage image0,
+                                   const IceTImage image1)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image0);
+    IceTSizeType pixel_size;
+
+    if (icetImageGetColorFormat(image0) != ICET_IMAGE_COLOR_NONE) {
+        const IceTVoid *color0 = icetImageGetColorConstVoid(image0,
+                                                            &pixel_size);
+        const IceTVoid *color1 = icetImageGetColorConstVoid(image1, NULL);
+        if (memcmp(color0, color1, num_pixels*pixel_size) != 0) {
+            return ICET_FALSE;
+        }
+    }
+    if (icetImageGetDepthFormat(image0) != ICET_IMAGE_DEPTH_NONE) {
+        const IceTVoid *depth0 = icetImageGetDepthConstVoid(image0,
+                                                            &pixel_size);
+        const IceTVoid *depth1 = icetImageGetDepthConstVoid(image1, NULL);
+        if (memcmp(depth0, depth1, num_pixels*pixel_size) != 0) {
+            return ICET_FALSE;
+        }
+    }
+    return ICET_TRUE;
+}
+
+static IceTBoolean DenseImagesSparseEqual(const IceTSparseImage image0,
+                                         const IceTSparseImage image1)
+{
+    IceTVoid *buffer0;
+    IceTVoid *buffer1;
+    IceTSizeType size0;
+    IceTSizeType size1;
+
+    icetSparseImagePackageForSend(image0, &buffer0, &size0);
+    icetSparseImagePackageForSend(image1, &buffer1, &size1);
+    return ((size0 == size1) && (memcmp(buffer0, buffer1, size0) == 0));
+}
+
+static int DenseImagesTryFormat(IceTEnum composite_mode,
+                                IceTEnum color_format,
+                                IceTEnum depth_format)
+{
+    IceTVoid *buffers[8];
+    IceTImage input[2];
+    IceTSparseImage rle[2];
+    IceTSparseImage raw[2];
+    IceTImage output[2];
+    IceTSparseImage composited[2];
+    IceTSizeType image_size;
+    IceTSizeType sparse_size;
+    int i;
+    int result = TEST_PASSED;
+
+    printstat("Trying composite mode 0x%X, color 0x%X, depth 0x%X.\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+
+    image_size = icetImageBufferSize(IMAGE_WIDTH, IMAGE_HEIGHT);
+    sparse_size = icetSparseImageBufferSize(IMAGE_WIDTH, IMAGE_HEIGHT);
+    for (i = 0; i < 2; i++) {
+        buffers[4*i+0] = malloc(image_size);
+        buffers[4*i+1] = malloc(sparse_size);
+        buffers[4*i+2] = malloc(sparse_size);
+        buffers[4*i+3] = malloc(image_size);
+        input[i] = icetImageAssignBuffer(buffers[4*i+0],
+                                         IMAGE_WIDTH, IMAGE_HEIGHT);
+        rle[i] = icetSparseImageAssignBuffer(buffers[4*i+1],
+                                             IMAGE_WIDTH, IMAGE_HEIGHT);
+        raw[i] = icetSparseImageAssignBuffer(buffers[4*i+2],
+                                             IMAGE_WIDTH, IMAGE_HEIGHT);
+        output[i] = icetImageAssignBuffer(buffers[4*i+3],
+                                          IMAGE_WIDTH, IMAGE_HEIGHT);
+    }
+    composited[0] = icetSparseImageAssignBuffer(malloc(sparse_size),
+                                                IMAGE_WIDTH, IMAGE_HEIGHT);
+    composited[1] = icetSparseImageAssignBuffer(malloc(sparse_size),
+                                                IMAGE_WIDTH, IMAGE_HEIGHT);
+
+    /* A few holes. */
+    for (i = 0; i < 2; i++) {
+        DenseImagesFill(input[i], 23 + 6*i, 5 + i);
+        icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, 0);
+        icetCompressImage(input[i], rle[i]);
+        icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, 90);
+        icetCompressImage(input[i], raw[i]);
+    }
+    if (DenseImagesSparseEqual(rle[0], raw[0])) {
+        printrank("Image with few holes was not stored as one run.\n");
+        result = TEST_FAILED;
+    }
+
+    icetDecompressImage(rle[0], output[0]);
+    icetDecompressImage(raw[0], output[1]);
+    if (!DenseImagesEqual(output[0], output[1])) {
+        printrank("Decompressed images differ.\n");
+        result = TEST_FAILED;
+    }
+
+    icetDecompressImage(rle[1], output[0]);
+    icetDecompressImage(rle[1], output[1]);
+    icetCompressedComposite(output[0], rle[0], 1);
+    icetCompressedComposite(output[1], raw[0], 1);
+    if (!DenseImagesEqual(output[0], output[1])) {
+        printrank("Composited images differ.\n");
+        result = TEST_FAILED;
+    }
+
+    icetCompressedCompressedComposite(rle[0], rle[1], composited[0]);
+    icetCompressedCompressedComposite(raw[0], raw[1], composited[1]);
+    icetDecompressImage(composited[0], output[0]);
+    icetDecompressImage(composited[1], output[1]);
+    if (!DenseImagesEqual(output[0], output[1])) {
+        printrank("Compressed composited images differ.\n");
+        result = TEST_FAILED;
+    }
+
+    /* Many holes. */
+    DenseImagesFill(input[0], 7, 3);
+    icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, 0);
+    icetCompressImage(input[0], rle[0]);
+    icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, 90);
+    icetCompressImage(input[0], raw[0]);
+    if (!DenseImagesSparseEqual(rle[0], raw[0])) {
+        printrank("Image with many holes was not run-length encoded.\n");
+        result = TEST_FAILED;
+    }
+
+    for (i = 0; i < 8; i++) {
+        free(buffers[i]);
+    }
+    free(composited[0].opaque_internals);
+    free(composited[1].opaque_internals);
+
+    return result;
+}
+
+static int DenseImagesRun(void)
+{
+    IceTInt save_percent;
+    IceTFloat save_background[4];
+    IceTInt save_background_word;
+    IceTFloat background[4];
+    IceTUByte *background_bytes;
+    IceTInt background_word;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_DENSE_IMAGE_PERCENT, &save_percent);
+    icetGetFloatv(ICET_BACKGROUND_COLOR, save_background);
+    icetGetIntegerv(ICET_BACKGROUND_COLOR_WORD, &save_background_word);
+
+    /* A colored background for depth compositing, where holes are stored as
+       the background. */
+    background[0] = 0.25f;
+    background[1] = 0.5f;
+    background[2] = 0.75f;
+    background[3] = 1.0f;
+    background_bytes = (IceTUByte *)&background_word;
+    background_bytes[0] = 64;
+    background_bytes[1] = 128;
+    background_bytes[2] = 191;
+    background_bytes[3] = 255;
+    icetStateSetFloatv(ICET_BACKGROUND_COLOR, 4, background);
+    icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, background_word);
+
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_Z_BUFFER,
+                             ICET_IMAGE_COLOR_RGBA_UBYTE,
+                             ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_Z_BUFFER,
+                             ICET_IMAGE_COLOR_RGBA_FLOAT,
+                             ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_Z_BUFFER,
+                             ICET_IMAGE_COLOR_RGB_FLOAT,
+                             ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_Z_BUFFER,
+                             ICET_IMAGE_COLOR_NONE,
+                             ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    /* Blending needs a transparent background to store holes. */
+    background[0] = background[1] = background[2] = background[3] = 0.0f;
+    icetStateSetFloatv(ICET_BACKGROUND_COLOR, 4, background);
+    icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, 0);
+
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_BLEND,
+                             ICET_IMAGE_COLOR_RGBA_UBYTE,
+                             ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DenseImagesTryFormat(ICET_COMPOSITE_MODE_BLEND,
+                             ICET_IMAGE_COLOR_RGBA_FLOAT,
+                             ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetStateSetInteger(ICET_DENSE_IMAGE_PERCENT, save_percent);
+    icetStateSetFloatv(ICET_BACKGROUND_COLOR, 4, save_background);
+    icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, save_background_word);
+
+    return result;
+}
+
+int DenseImages(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(DenseImagesRun);
+}
@@ -0,0 +1,263 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_DIRECT_SEND_THRESHOLD option.  Folding the small
+** rounds of radix-k into one direct-send exchange must give exactly the same
+** image as running every round, and the number of folded rounds must be
+** reported in ICET_DIRECT_SEND_ROUNDS.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static void DirectSendThresholdDraw(const IceTDouble *projection_matrix,
+                                    const IceTDouble *modelview_matrix,
+                                    const IceTFloat *background_color,
+                                    const IceTInt *readback_viewport,
+                                    IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTFloat color[4];
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTFloat *colors;
+    IceTSizeType band_start;
+    IceTSizeType band_end;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    /* Translucent colors that blend exactly in floating point. */
+    color[0] = 0.5f*(IceTFloat)( rank     %3)/2.0f;
+    color[1] = 0.5f*(IceTFloat)((rank/3)  %3)/2.0f;
+    color[2] = 0.5f*(IceTFloat)((rank/9)  %3)/2.0f;
+    color[3] = 0.5f;
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    colors = icetImageGetColorf(result);
+
+    /* Overlapping bands so that every partition has some active pixels. */
+    band_start = (rank*height)/(num_proc+1);
+    band_end = ((rank+2)*height)/(num_proc+1);
+
+    for (line = readback_viewport[1];
+         line < readback_viewport[1] + readback_viewport[3];
+         line++) {
+        IceTSizeType pixel = line*width + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            if (   (line >= band_start) && (line < band_end)
+                && ((column + rank)%3 != 0) ) {
+                colors[4*pixel + 0] = color[0];
+                colors[4*pixel + 1] = color[1];
+                colors[4*pixel + 2] = color[2];
+                colors[4*pixel + 3] = color[3];
+            } else {
+                colors[4*pixel + 0] = 0.0f;
+                colors[4*pixel + 1] = 0.0f;
+                colors[4*pixel + 2] = 0.0f;
+                colors[4*pixel + 3] = 0.0f;
+            }
+            pixel++;
+        }
+    }
+}
+
+static IceTImage DirectSendThresholdRender(IceTInt threshold)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetStateSetInteger(ICET_DIRECT_SEND_THRESHOLD, threshold);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Checks the image against one rendered with all rounds.  min_fused_rounds
+   is the fewest rounds that must have been folded on this process. */
+static int DirectSendThresholdCompare(IceTInt threshold,
+                                      IceTInt max_image_split,
+                                      IceTBoolean interlace,
+                                      IceTBoolean fuse_collect,
+                                      IceTInt min_fused_rounds)
+{
+    IceTInt rank;
+    IceTSizeType num_values;
+    IceTFloat *expected;
+    IceTImage image;
+    IceTInt fused_rounds;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    printstat("Threshold %d, max split %d, interlace %s, fuse collect %s.\n",
+              (int)threshold, (int)max_image_split,
+              interlace ? "on" : "off", fuse_collect ? "on" : "off");
+
+    icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, max_image_split);
+    if (interlace) {
+        icetEnable(ICET_INTERLACE_IMAGES);
+    } else {
+        icetDisable(ICET_INTERLACE_IMAGES);
+    }
+    if (fuse_collect) {
+        icetEnable(ICET_FUSE_COLLECT);
+    } else {
+        icetDisable(ICET_FUSE_COLLECT);
+    }
+
+    image = DirectSendThresholdRender(0);
+    icetGetIntegerv(ICET_DIRECT_SEND_ROUNDS, &fused_rounds);
+    if (fused_rounds != 0) {
+        printrank("Rounds were folded with the threshold off.\n");
+        result = TEST_FAILED;
+    }
+    num_values = 4*SCREEN_WIDTH*SCREEN_HEIGHT;
+    expected = malloc(num_values*sizeof(IceTFloat));
+    if (rank == 0) {
+        memcpy(expected, icetImageGetColorcf(image),
+               num_values*sizeof(IceTFloat));
+    }
+
+    image = DirectSendThresholdRender(threshold);
+    icetGetIntegerv(ICET_DIRECT_SEND_ROUNDS, &fused_rounds);
+    if (fused_rounds < min_fused_rounds) {
+        printrank("Expected at least %d folded rounds, got %d.\n",
+                  (int)min_fused_rounds, (int)fused_rounds);
+        result = TEST_FAILED;
+    }
+    if (rank == 0) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTSizeType i;
+        for (i = 0; i < num_values; i++) {
+            if (colors[i] != expected[i]) {
+                printrank("Value %d differs with direct send.\n", (int)i);
+                printrank("    Expected %f, got %f\n",
+                          expected[i], colors[i]);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    free(expected);
+    return result;
+}
+
+static int DirectSendThresholdRun(void)
+{
+    IceTInt num_proc;
+    IceTInt save_magic_k;
+    IceTInt save_max_image_split;
+    IceTInt save_threshold;
+    IceTInt *composite_order;
+    IceTInt full_image_size;
+    IceTInt many_rounds;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    icetGetIntegerv(ICET_MAGIC_K, &save_magic_k);
+    icetGetIntegerv(ICET_MAX_IMAGE_SPLIT, &save_max_image_split);
+    icetGetIntegerv(ICET_DIRECT_SEND_THRESHOLD, &save_threshold);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetDisable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(DirectSendThresholdDraw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+    icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+    icetStateSetInteger(ICET_MAGIC_K, 2);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    composite_order = malloc(num_proc*sizeof(IceTInt));
+    for (i = 0; i < num_proc; i++) {
+        composite_order[i] = num_proc - i - 1;
+    }
+    icetEnable(ICET_ORDERED_COMPOSITE);
+    icetCompositeOrder(composite_order);
+    free(composite_order);
+
+    /* With a magic k of 2, a multiple of 4 processes splits in at least two
+       rounds, and a multiple of 8 in at least three. */
+    many_rounds = ((num_proc%4) == 0) ? 1 : 0;
+    full_image_size
+        = (IceTInt)icetSparseImageBufferSize(SCREEN_WIDTH*SCREEN_HEIGHT, 1);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (DirectSendThresholdCompare(0x7FFFFFFF, num_proc,
+                                   ICET_TRUE, ICET_FALSE, many_rounds)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DirectSendThresholdCompare(0x7FFFFFFF, num_proc,
+                                   ICET_FALSE, ICET_FALSE, many_rounds)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DirectSendThresholdCompare(full_image_size, num_proc,
+                                   ICET_TRUE, ICET_FALSE,
+                                   ((num_proc%8) == 0) ? 1 : 0)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (DirectSendThresholdCompare(0x7FFFFFFF, num_proc,
+                                   ICET_TRUE, ICET_TRUE, many_rounds)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    /* Only one round splits, so there is nothing to fold. */
+    if (DirectSendThresholdCompare(0x7FFFFFFF, 2,
+                                   ICET_TRUE, ICET_FALSE, 0)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetDisable(ICET_FUSE_COLLECT);
+    icetEnable(ICET_INTERLACE_IMAGES);
+    icetStateSetInteger(ICET_DIRECT_SEND_THRESHOLD, save_threshold);
+    icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, save_max_image_split);
+    icetStateSetInteger(ICET_MAGIC_K, save_magic_k);
+
+    return result;
+}
+
+int DirectSendThreshold(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(DirectSendThresholdRun);
+}
@@ -0,0 +1,184 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_AUTO_DISPLAY_PLACEMENT option.  Each process
+** only renders geometry in a tile that some other process displays, so the
+** display nodes never contribute to their own tiles.  The composited image
+** must still be forwarded to the correct display node.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static const IceTFloat g_background_color[4] = { 0.5, 0.5, 0.5, 1.0 };
+static const IceTFloat g_foreground_color[4] = { 0.25, 0.0, 0.5, 1.0 };
+
+static void DisplayPlacementDraw(const IceTDouble *projection_matrix,
+                                 const IceTDouble *modelview_matrix,
+                                 const IceTFloat *background_color,
+                                 const IceTInt *readback_viewport,
+                                 IceTImage result)
+{
+    IceTSizeType width;
+    IceTFloat *colors;
+    IceTSizeType line_start;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorf(result);
+
+    line_start = width*readback_viewport[1];
+    for (line = 0; line < readback_viewport[3]; line++) {
+        IceTSizeType pixel = line_start + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            colors[4*pixel + 0] = g_foreground_color[0];
+            colors[4*pixel + 1] = g_foreground_color[1];
+            colors[4*pixel + 2] = g_foreground_color[2];
+            colors[4*pixel + 3] = g_foreground_color[3];
+            pixel++;
+        }
+        line_start += width;
+    }
+}
+
+static int DisplayPlacementCheckImage(const IceTImage image)
+{
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    const IceTFloat *colors = icetImageGetColorcf(image);
+    IceTSizeType x, y;
+
+    /* Stay away from the edges of the geometry to avoid rounding issues. */
+    for (y = height/4; y < 3*height/4; y++) {
+        for (x = width/4; x < 3*width/4; x++) {
+            const IceTFloat *pixel = colors + 4*(y*width + x);
+            if (   (pixel[0] != g_foreground_color[0])
+                || (pixel[1] != g_foreground_color[1])
+                || (pixel[2] != g_foreground_color[2])
+                || (pixel[3] != g_foreground_color[3]) ) {
+                printrank("BAD PIXEL %d %d\n", (int)x, (int)y);
+                printrank("    Expected %f %f %f %f\n",
+                          g_foreground_color[0],
+                          g_foreground_color[1],
+                          g_foreground_color[2],
+                          g_foreground_color[3]);
+                printrank("    Got %f %f %f %f\n",
+                          pixel[0], pixel[1], pixel[2], pixel[3]);
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
+
+static int DisplayPlacementTryFrame(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt render_tile;
+    IceTDouble tile_left, tile_right;
+    IceTImage image;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    /* Render the tile displayed by the next process over.  The tiles sit
+       side by side, so find the range of that tile in normalized x. */
+    render_tile = (rank + 1)%num_proc;
+    tile_left = -1.0 + (2.0*render_tile)/num_proc;
+    tile_right = -1.0 + (2.0*(render_tile+1))/num_proc;
+    icetBoundingBoxd(tile_left + 0.1/num_proc, tile_right - 0.1/num_proc,
+                     -0.9, 0.9, -0.5, 0.5);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    return DisplayPlacementCheckImage(image);
+}
+
+static int DisplayPlacementRun(void)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt tile;
+    IceTInt *composite_order;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    if (num_proc < 2) {
+        printstat("Need at least two processes to move display nodes.\n");
+        return TEST_PASSED;
+    }
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetEnable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(DisplayPlacementDraw);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+
+    icetResetTiles();
+    for (tile = 0; tile < num_proc; tile++) {
+        icetAddTile(tile*SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT, tile);
+    }
+
+    composite_order = malloc(num_proc*sizeof(IceTInt));
+    for (tile = 0; tile < num_proc; tile++) {
+        composite_order[tile] = num_proc - tile - 1;
+    }
+    icetCompositeOrder(composite_order);
+    free(composite_order);
+
+    icetEnable(ICET_AUTO_DISPLAY_PLACEMENT);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    printstat("Checking automatic display placement, unordered.\n");
+    icetDisable(ICET_ORDERED_COMPOSITE);
+    if (DisplayPlacementTryFrame() != TEST_PASSED) { result = TEST_FAILED; }
+
+    printstat("Checking automatic display placement, ordered.\n");
+    icetEnable(ICET_ORDERED_COMPOSITE);
+    if (DisplayPlacementTryFrame() != TEST_PASSED) { result = TEST_FAILED; }
+
+    printstat("Checking fixed display placement.\n");
+    icetDisable(ICET_AUTO_DISPLAY_PLACEMENT);
+    if (DisplayPlacementTryFrame() != TEST_PASSED) { result = TEST_FAILED; }
+
+    return result;
+}
+
+int DisplayPlacement(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(DisplayPlacementRun);
+}
@@ -0,0 +1,216 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_FUSE_COLLECT option.  Fusing the last round of
+** compositing with the image collection must give exactly the same image as
+** compositing and collecting separately.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static void FuseCollectDraw(const IceTDouble *projection_matrix,
+                            const IceTDouble *modelview_matrix,
+                            const IceTFloat *background_color,
+                            const IceTInt *readback_viewport,
+                            IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTFloat color[4];
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTFloat *colors;
+    IceTSizeType band_start;
+    IceTSizeType band_end;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    /* Translucent colors that blend exactly in floating point. */
+    color[0] = 0.5f*(IceTFloat)( rank     %3)/2.0f;
+    color[1] = 0.5f*(IceTFloat)((rank/3)  %3)/2.0f;
+    color[2] = 0.5f*(IceTFloat)((rank/9)  %3)/2.0f;
+    color[3] = 0.5f;
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    colors = icetImageGetColorf(result);
+
+    /* Draw overlapping bands so that the image has runs of active and
+       inactive pixels that differ from process to process. */
+    band_start = (rank*height)/(num_proc+1);
+    band_end = ((rank+2)*height)/(num_proc+1);
+
+    for (line = readback_viewport[1];
+         line < readback_viewport[1] + readback_viewport[3];
+         line++) {
+        IceTSizeType pixel = line*width + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            if (   (line >= band_start) && (line < band_end)
+                && ((column + rank)%5 != 0) ) {
+                colors[4*pixel + 0] = color[0];
+                colors[4*pixel + 1] = color[1];
+                colors[4*pixel + 2] = color[2];
+                colors[4*pixel + 3] = color[3];
+            } else {
+                colors[4*pixel + 0] = 0.0f;
+                colors[4*pixel + 1] = 0.0f;
+                colors[4*pixel + 2] = 0.0f;
+                colors[4*pixel + 3] = 0.0f;
+            }
+            pixel++;
+        }
+    }
+}
+
+static IceTImage FuseCollectRender(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+static int FuseCollectCompare(IceTInt display_node,
+                              IceTInt magic_k,
+                              IceTInt max_image_split,
+                              IceTBoolean interlace)
+{
+    IceTInt rank;
+    IceTSizeType num_values;
+    IceTFloat *expected;
+    IceTImage image;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    printstat("Display %d, magic k %d, max split %d, interlace %s.\n",
+              (int)display_node, (int)magic_k, (int)max_image_split,
+              interlace ? "on" : "off");
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, display_node);
+    icetStateSetInteger(ICET_MAGIC_K, magic_k);
+    icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, max_image_split);
+    if (interlace) {
+        icetEnable(ICET_INTERLACE_IMAGES);
+    } else {
+        icetDisable(ICET_INTERLACE_IMAGES);
+    }
+
+    icetDisable(ICET_FUSE_COLLECT);
+    image = FuseCollectRender();
+    num_values = 4*SCREEN_WIDTH*SCREEN_HEIGHT;
+    expected = malloc(num_values*sizeof(IceTFloat));
+    if (rank == display_node) {
+        memcpy(expected, icetImageGetColorcf(image),
+               num_values*sizeof(IceTFloat));
+    }
+
+    icetEnable(ICET_FUSE_COLLECT);
+    image = FuseCollectRender();
+    if (rank == display_node) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTSizeType i;
+        for (i = 0; i < num_values; i++) {
+            if (colors[i] != expected[i]) {
+                printrank("Value %d differs with fused collect.\n", (int)i);
+                printrank("    Expected %f, got %f\n",
+                          expected[i], colors[i]);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+    icetDisable(ICET_FUSE_COLLECT);
+
+    free(expected);
+    return result;
+}
+
+static int FuseCollectRun(void)
+{
+    IceTInt num_proc;
+    IceTInt save_magic_k;
+    IceTInt save_max_image_split;
+    IceTInt *composite_order;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    icetGetIntegerv(ICET_MAGIC_K, &save_magic_k);
+    icetGetIntegerv(ICET_MAX_IMAGE_SPLIT, &save_max_image_split);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetDisable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(FuseCollectDraw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+    icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+
+    composite_order = malloc(num_proc*sizeof(IceTInt));
+    for (i = 0; i < num_proc; i++) {
+        composite_order[i] = num_proc - i - 1;
+    }
+    icetEnable(ICET_ORDERED_COMPOSITE);
+    icetCompositeOrder(composite_order);
+    free(composite_order);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (FuseCollectCompare(0, 2, num_proc, ICET_TRUE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (FuseCollectCompare(0, 2, num_proc, ICET_FALSE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (FuseCollectCompare(num_proc-1, 8, num_proc, ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (FuseCollectCompare(num_proc/2, 2, 2, ICET_TRUE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetStateSetInteger(ICET_MAX_IMAGE_SPLIT, save_max_image_split);
+    icetStateSetInteger(ICET_MAGIC_K, save_magic_k);
+    icetEnable(ICET_INTERLACE_IMAGES);
+
+    return result;
+}
+
+int FuseCollect(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(FuseCollectRun);
+}
@@ -0,0 +1,458 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the operations on full images that are spread over the
+** worker threads given by ICET_NUM_THREADS, as well as the interlacing of
+** sparse images.  Each operation must give exactly the same result with
+** several threads as with one.  It also checks that copying the state between
+** contexts leaves each of them with its own worker threads.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevContext.h>
+#include <IceTDevImage.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_WIDTH     613
+#define IMAGE_HEIGHT    509
+#define NUM_THREADS     4
+
+typedef void (*ImageThreadsOperation)(IceTImage image);
+
+/* The second operand of the operation, if any. */
+static IceTImage g_source_image;
+
+static IceTImage ImageThreadsCreate(IceTEnum color_format,
+                                    IceTEnum depth_format,
+                                    unsigned int seed)
+{
+    IceTImage image;
+    IceTSizeType num_pixels = IMAGE_WIDTH*IMAGE_HEIGHT;
+    IceTSizeType i;
+
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    image = icetImageAssignBuffer(
+                           malloc(icetImageBufferSize(IMAGE_WIDTH,
+                                                      IMAGE_HEIGHT)),
+                           IMAGE_WIDTH, IMAGE_HEIGHT);
+
+    srand(seed);
+    if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+        IceTUByte *color = icetImageGetColorub(image);
+        for (i = 0; i < 4*num_pixels; i++) {
+            color[i] = (IceTUByte)(rand()%256);
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        IceTFloat *color = icetImageGetColorf(image);
+        for (i = 0; i < 4*num_pixels; i++) {
+            color[i] = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+        }
+    } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+        IceTFloat *color = icetImageGetColorf(image);
+        for (i = 0; i < 3*num_pixels; i++) {
+            color[i] = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+        }
+    }
+    if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+        IceTFloat *depth = icetImageGetDepthf(image);
+        for (i = 0; i < num_pixels; i++) {
+            depth[i] = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+        }
+    }
+
+    return image;
+}
+
+static void ImageThreadsDestroy(IceTImage image)
+{
+    IceTVoid *buffer;
+    IceTSizeType size;
+    icetImagePackageForSend(image, &buffer, &size);
+    free(buffer);
+}
+
+/* Runs operation on two copies of the same image, once on a single thread
+   and once on NUM_THREADS threads, and compares the results. */
+static int ImageThreadsCheck(const char *name,
+                             IceTEnum color_format,
+                             IceTEnum depth_format,
+                             IceTEnum source_color_format,
+                             IceTEnum source_depth_format,
+                             ImageThreadsOperation operation)
+{
+    IceTImage serial_image;
+    IceTImage threaded_image;
+    IceTVoid *serial_buffer;
+    IceTVoid *threaded_buffer;
+    IceTSizeType serial_size;
+    IceTSizeType threaded_size;
+    int result = TEST_PASSED;
+
+    printstat("Checking %s.\n", name);
+
+    g_source_image = ImageThreadsCreate(source_color_format,
+                                        source_depth_format,
+                                        2);
+    serial_image = ImageThreadsCreate(color_format, depth_format, 1);
+    threaded_image = ImageThreadsCreate(color_format, depth_format, 1);
+
+    icetStateSetInteger(ICET_NUM_THREADS, 1);
+    operation(serial_image);
+    icetStateSetInteger(ICET_NUM_THREADS, NUM_THREADS);
+    operation(threaded_image);
+
+    icetImagePackageForSend(serial_image, &serial_buffer, &serial_size);
+    icetImagePackageForSend(threaded_image, &threaded_buffer, &threaded_size);
+    if (   (serial_size != threaded_size)
+        || (memcmp(serial_buffer, threaded_buffer, serial_size) != 0) ) {
+        printrank("Threaded %s differs from serial.\n", name);
+        result = TEST_FAILED;
+    }
+
+    ImageThreadsDestroy(threaded_image);
+    ImageThreadsDestroy(serial_image);
+    ImageThreadsDestroy(g_source_image);
+
+    return result;
+}
+
+static void ImageThreadsCompositeOver(IceTImage image)
+{
+    icetComposite(image, g_source_image, 1);
+}
+
+static void ImageThreadsCompositeUnder(IceTImage image)
+{
+    icetComposite(image, g_source_image, 0);
+}
+
+static void ImageThreadsCorrectBackground(IceTImage image)
+{
+    icetImageCorrectBackground(image);
+}
+
+static void ImageThreadsCopyColorub(IceTImage image)
+{
+    icetImageCopyColorub(g_source_image,
+                         icetImageGetColorub(image),
+                         ICET_IMAGE_COLOR_RGBA_UBYTE);
+}
+
+static void ImageThreadsCopyColorf(IceTImage image)
+{
+    icetImageCopyColorf(g_source_image,
+                        icetImageGetColorf(image),
+                        icetImageGetColorFormat(image));
+}
+
+static void ImageThreadsCopyRegion(IceTImage image)
+{
+    IceTInt in_viewport[4] = { 17, 5, 500, 480 };
+    IceTInt out_viewport[4] = { 101, 23, 500, 480 };
+    icetImageCopyRegion(g_source_image, in_viewport, image, out_viewport);
+}
+
+static void ImageThreadsClearAroundRegion(IceTImage image)
+{
+    IceTInt region[4] = { 31, 47, 400, 300 };
+    icetImageClearAroundRegion(image, region);
+}
+
+/* Interlaces a sparse image with runs of background pixels of all lengths,
+   some longer than a partition, into several numbers of partitions. */
+static int ImageThreadsCheckInterlace(void)
+{
+    static const IceTInt partition_counts[5] = { 2, 7, 16, 64, 100 };
+    IceTImage image;
+    IceTFloat *depth;
+    IceTSizeType num_pixels = IMAGE_WIDTH*IMAGE_HEIGHT;
+    IceTSizeType sparse_size = icetSparseImageBufferSize(IMAGE_WIDTH,
+                                                          IMAGE_HEIGHT);
+    IceTVoid *sparse_buffers[3];
+    IceTSparseImage sparse_images[3];
+    IceTSizeType *offsets;
+    IceTSizeType pixel;
+    IceTInt count_index;
+    int result = TEST_PASSED;
+
+    printstat("Checking sparse interlace.\n");
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    image = ImageThreadsCreate(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                               ICET_IMAGE_DEPTH_FLOAT,
+                               3);
+    depth = icetImageGetDepthf(image);
+    pixel = 0;
+    while (pixel < num_pixels) {
+        IceTSizeType run_length = rand()%(1 << (rand()%16));
+        while ((run_length > 0) && (pixel < num_pixels)) {
+            depth[pixel] = 1.0f;
+            pixel++;
+            run_length--;
+        }
+        pixel += rand()%(1 << (rand()%12));
+    }
+
+    for (count_index = 0; count_index < 3; count_index++) {
+        sparse_buffers[count_index] = malloc(sparse_size);
+        sparse_images[count_index]
+            = icetSparseImageAssignBuffer(sparse_buffers[count_index],
+                                          IMAGE_WIDTH, IMAGE_HEIGHT);
+    }
+    icetCompressImage(image, sparse_images[0]);
+
+    offsets = malloc(100*sizeof(IceTSizeType));
+
+    for (count_index = 0; count_index < 5; count_index++) {
+        IceTInt num_partitions = partition_counts[count_index];
+        IceTVoid *serial_buffer;
+        IceTVoid *threaded_buffer;
+        IceTSizeType serial_size;
+        IceTSizeType threaded_size;
+        IceTInt partition;
+
+        icetStateSetInteger(ICET_NUM_THREADS, 1);
+        icetSparseImageInterlace(sparse_images[0],
+                                 num_partitions,
+                                 ICET_SI_STRATEGY_BUFFER_0,
+                                 sparse_images[1]);
+        icetStateSetInteger(ICET_NUM_THREADS, NUM_THREADS);
+        icetSparseImageInterlace(sparse_images[0],
+                                 num_partitions,
+                                 ICET_SI_STRATEGY_BUFFER_0,
+                                 sparse_images[2]);
+
+        icetSparseImagePackageForSend(sparse_images[1],
+                                      &serial_buffer, &serial_size);
+        icetSparseImagePackageForSend(sparse_images[2],
+                                      &threaded_buffer, &threaded_size);
+        if (   (serial_size != threaded_size)
+            || (memcmp(serial_buffer, threaded_buffer, serial_size) != 0) ) {
+            printrank("Threaded interlace for %d partitions differs from"
+                      " serial.\n", (int)num_partitions);
+            result = TEST_FAILED;
+        }
+
+        icetGetInterlaceOffsets(num_partitions, num_pixels, offsets);
+        for (partition = 0; partition < num_partitions; partition++) {
+            if (offsets[partition]
+                != icetGetInterlaceOffset(partition,
+                                          num_partitions,
+                                          num_pixels)) {
+                printrank("Wrong interlace offset for partition %d of %d.\n",
+                          (int)partition, (int)num_partitions);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    }
+
+    free(offsets);
+    for (count_index = 0; count_index < 3; count_index++) {
+        free(sparse_buffers[count_index]);
+    }
+    ImageThreadsDestroy(image);
+
+    return result;
+}
+
+static void ImageThreadsStartPool(IceTInt num_threads)
+{
+    IceTImage image;
+
+    icetStateSetInteger(ICET_NUM_THREADS, num_threads);
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    g_source_image = ImageThreadsCreate(ICET_IMAGE_COLOR_RGBA_UBYTE,
+                                        ICET_IMAGE_DEPTH_FLOAT,
+                                        2);
+    image = ImageThreadsCreate(ICET_IMAGE_COLOR_RGBA_UBYTE,
+                               ICET_IMAGE_DEPTH_FLOAT,
+                               1);
+    ImageThreadsCompositeOver(image);
+    ImageThreadsDestroy(image);
+    ImageThreadsDestroy(g_source_image);
+}
+
+/* Copies the state between two contexts that both started worker threads,
+   with different thread counts, then uses and destroys both.  Each context
+   must keep its own pool. */
+static int ImageThreadsCheckCopyState(void)
+{
+    IceTContext original_context = icetGetContext();
+    IceTContext contexts[2];
+    IceTVoid *pools[2];
+    IceTVoid *pool;
+    int i;
+    int result = TEST_PASSED;
+
+    printstat("Checking state copy between threaded contexts.\n");
+
+    for (i = 0; i < 2; i++) {
+        contexts[i] = icetCreateContext(icetGetCommunicator());
+        ImageThreadsStartPool(NUM_THREADS - i);
+        icetGetPointerv(ICET_THREAD_POOL, &pools[i]);
+    }
+
+    icetCopyState(contexts[1], contexts[0]);
+
+    icetSetContext(contexts[1]);
+    icetGetPointerv(ICET_THREAD_POOL, &pool);
+    if ((pool != pools[1]) || ((pool != NULL) && (pool == pools[0]))) {
+        printrank("Copying the state shared the thread pool.\n");
+        result = TEST_FAILED;
+    }
+    ImageThreadsStartPool(NUM_THREADS);
+
+    icetSetContext(contexts[0]);
+    icetGetPointerv(ICET_THREAD_POOL, &pool);
+    if (pool != pools[0]) {
+        printrank("Copying the state changed the source thread pool.\n");
+        result = TEST_FAILED;
+    }
+    ImageThreadsStartPool(NUM_THREADS);
+
+    icetDestroyContext(contexts[1]);
+    icetDestroyContext(contexts[0]);
+    icetSetContext(original_context);
+
+    return result;
+}
+
+static int ImageThreadsRun(void)
+{
+    static const IceTEnum color_formats[3] = {
+        ICET_IMAGE_COLOR_RGBA_UBYTE,
+        ICET_IMAGE_COLOR_RGBA_FLOAT,
+        ICET_IMAGE_COLOR_RGB_FLOAT
+    };
+    static const IceTFloat background_color[4] = { 0.25f, 0.5f, 0.75f, 1.0f };
+    IceTInt save_num_threads;
+    IceTInt color_index;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_THREADS, &save_num_threads);
+
+    icetStateSetFloatv(ICET_BACKGROUND_COLOR, 4, background_color);
+    icetStateSetInteger(ICET_BACKGROUND_COLOR_WORD, 0x40C08020);
+    icetStateSetFloatv(ICET_TRUE_BACKGROUND_COLOR, 4, background_color);
+    icetStateSetInteger(ICET_TRUE_BACKGROUND_COLOR_WORD, 0x40C08020);
+    icetStateSetBoolean(ICET_NEED_BACKGROUND_CORRECTION, ICET_TRUE);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    for (color_index = 0; color_index < 3; color_index++) {
+        IceTEnum color_format = color_formats[color_index];
+        if (ImageThreadsCheck("z buffer composite",
+                              color_format, ICET_IMAGE_DEPTH_FLOAT,
+                              color_format, ICET_IMAGE_DEPTH_FLOAT,
+                              ImageThreadsCompositeOver) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    for (color_index = 0; color_index < 2; color_index++) {
+        IceTEnum color_format = color_formats[color_index];
+        if (ImageThreadsCheck("blend over",
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCompositeOver) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (ImageThreadsCheck("blend under",
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCompositeUnder) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (ImageThreadsCheck("background correction",
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCorrectBackground) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    for (color_index = 0; color_index < 3; color_index++) {
+        IceTEnum source_format = color_formats[color_index];
+        if (ImageThreadsCheck("ubyte color copy",
+                              ICET_IMAGE_COLOR_RGBA_UBYTE,
+                              ICET_IMAGE_DEPTH_NONE,
+                              source_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCopyColorub) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (ImageThreadsCheck("RGBA float color copy",
+                              ICET_IMAGE_COLOR_RGBA_FLOAT,
+                              ICET_IMAGE_DEPTH_NONE,
+                              source_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCopyColorf) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (ImageThreadsCheck("RGB float color copy",
+                              ICET_IMAGE_COLOR_RGB_FLOAT,
+                              ICET_IMAGE_DEPTH_NONE,
+                              source_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsCopyColorf) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    for (color_index = 0; color_index < 3; color_index++) {
+        IceTEnum color_format = color_formats[color_index];
+        if (ImageThreadsCheck("region copy",
+                              color_format, ICET_IMAGE_DEPTH_FLOAT,
+                              color_format, ICET_IMAGE_DEPTH_FLOAT,
+                              ImageThreadsCopyRegion) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (ImageThreadsCheck("clear around region",
+                              color_format, ICET_IMAGE_DEPTH_FLOAT,
+                              color_format, ICET_IMAGE_DEPTH_NONE,
+                              ImageThreadsClearAroundRegion) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    if (ImageThreadsCheckInterlace() != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    if (ImageThreadsCheckCopyState() != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+#ifdef ICET_USE_PTHREADS
+    {
+        IceTVoid *thread_pool;
+        icetGetPointerv(ICET_THREAD_POOL, &thread_pool);
+        if (thread_pool == NULL) {
+            printrank("No worker threads were started.\n");
+            result = TEST_FAILED;
+        }
+    }
+#endif
+
+    icetStateSetInteger(ICET_NUM_THREADS, save_num_threads);
+
+    return result;
+}
+
+int ImageThreads(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ImageThreadsRun);
+}
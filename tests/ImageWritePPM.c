@@ -0,0 +1,392 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks icetImageWritePPM.  A file written by the display node
+** after collecting the image must match the file written in parallel by
+** all processes straight from their partitions without collection.  It also
+** checks that float colors outside [0,1] are clamped and that an image
+** without colors, a tile out of range, and a failed write raise errors.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.25, 0.5, 0.75, 1.0 };
+
+static void ImageWritePPMDraw(const IceTDouble *projection_matrix,
+                              const IceTDouble *modelview_matrix,
+                              const IceTFloat *background_color,
+                              const IceTInt *readback_viewport,
+                              IceTImage result)
+{
+    IceTInt rank;
+    IceTUByte color[4];
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTSizeType line_start;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    color[0] = (IceTUByte)(32*(rank%4));
+    color[1] = (IceTUByte)(32*((rank/4)%4));
+    color[2] = 64;
+    color[3] = 128;
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+
+    line_start = width*readback_viewport[1];
+    for (line = 0; line < readback_viewport[3]; line++) {
+        IceTSizeType pixel = line_start + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            colors[4*pixel + 0] = color[0];
+            colors[4*pixel + 1] = color[1];
+            colors[4*pixel + 2] = color[2];
+            colors[4*pixel + 3] = color[3];
+            pixel++;
+        }
+        line_start += width;
+    }
+}
+
+static FILE *ImageWritePPMOpen(const char *filename)
+{
+    FILE *fd;
+#ifndef _WIN32
+    fd = fopen(filename, "rb");
+#else /*_WIN32*/
+    fopen_s(&fd, filename, "rb");
+#endif /*_WIN32*/
+    return fd;
+}
+
+static int ImageWritePPMCompareFiles(const char *filename1,
+                                     const char *filename2)
+{
+    FILE *fd1;
+    FILE *fd2;
+    long position;
+    int result = TEST_PASSED;
+
+    fd1 = ImageWritePPMOpen(filename1);
+    fd2 = ImageWritePPMOpen(filename2);
+    if ((fd1 == NULL) || (fd2 == NULL)) {
+        printrank("Could not open %s or %s.\n", filename1, filename2);
+        if (fd1 != NULL) { fclose(fd1); }
+        if (fd2 != NULL) { fclose(fd2); }
+        return TEST_FAILED;
+    }
+
+    for (position = 0; ; position++) {
+        int c1 = fgetc(fd1);
+        int c2 = fgetc(fd2);
+        if (c1 != c2) {
+            printrank("%s and %s differ at byte %ld.\n",
+                      filename1, filename2, position);
+            result = TEST_FAILED;
+            break;
+        }
+        if (c1 == EOF) { break; }
+    }
+
+    fclose(fd1);
+    fclose(fd2);
+    return result;
+}
+
+static void ImageWritePPMFrame(const char *prefix, IceTInt num_tiles)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+    IceTInt tile;
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    for (tile = 0; tile < num_tiles; tile++) {
+        char filename[64];
+        icetSnprintf(filename, 64, "%s_%d.ppm", prefix, (int)tile);
+        icetImageWritePPM(image, tile, filename);
+    }
+}
+
+/* Writes tile 0 from an image in the given color format that the display
+   node fills with the colors in pixel_colors, one RGBA float value per
+   pixel in turn.  Returns the error raised on the display node. */
+static IceTEnum ImageWritePPMWriteFormat(IceTEnum color_format,
+                                         const IceTFloat *pixel_colors,
+                                         IceTInt num_pixel_colors,
+                                         const char *filename)
+{
+    IceTInt rank;
+    IceTVoid *buffer = NULL;
+    IceTImage image = icetImageNull();
+    IceTInt diagnostic_level;
+    IceTEnum error;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetSetColorFormat(color_format);
+    if (rank == 0) {
+        buffer = malloc(icetImageBufferSize(SCREEN_WIDTH, SCREEN_HEIGHT));
+        image = icetImageAssignBuffer(buffer, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            IceTFloat *colors = icetImageGetColorf(image);
+            IceTSizeType pixel;
+            for (pixel = 0; pixel < SCREEN_WIDTH*SCREEN_HEIGHT; pixel++) {
+                IceTInt index = pixel%num_pixel_colors;
+                colors[4*pixel + 0] = pixel_colors[4*index + 0];
+                colors[4*pixel + 1] = pixel_colors[4*index + 1];
+                colors[4*pixel + 2] = pixel_colors[4*index + 2];
+                colors[4*pixel + 3] = pixel_colors[4*index + 3];
+            }
+        }
+    }
+
+    /* The error for an image without colors is expected, so do not report
+       it. */
+    icetGetIntegerv(ICET_DIAGNOSTIC_LEVEL, &diagnostic_level);
+    icetDiagnostics(ICET_DIAG_OFF);
+    icetGetError();
+    icetImageWritePPM(image, 0, filename);
+    error = icetGetError();
+    icetDiagnostics(diagnostic_level);
+
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    free(buffer);
+    return error;
+}
+
+static int ImageWritePPMCheckFormats(void)
+{
+    static const IceTFloat pixel_colors[] = {
+        -0.5f, 1.5f, 0.5f, 1.0f,
+         2.0f, 0.0f, -1.0f, 1.0f
+    };
+    static const IceTUByte expected_bytes[] = {
+        0, 255, 127,
+        255, 0, 0
+    };
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTInt rank;
+    IceTEnum error;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    /* Draw a collected frame so that the display node of tile 0 holds all of
+       its pixels. */
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+    icetDrawFrame(projection_matrix, modelview_matrix, g_background_color);
+
+    printstat("Checking that float colors are clamped.\n");
+    error = ImageWritePPMWriteFormat(ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                     pixel_colors, 2,
+                                     "ImageWritePPM_clamped.ppm");
+    if (rank == 0) {
+        char header[64];
+        IceTUByte bytes[6];
+        FILE *fd;
+
+        if (error != ICET_NO_ERROR) {
+            printrank("Got error 0x%X writing float colors.\n", error);
+            result = TEST_FAILED;
+        }
+
+        /* The first row of the file is the top row of the image, which
+           starts with the pixels at index SCREEN_WIDTH*(SCREEN_HEIGHT-1). */
+        icetSnprintf(header, 64, "P6\n%d %d\n255\n",
+                     SCREEN_WIDTH, SCREEN_HEIGHT);
+        fd = ImageWritePPMOpen("ImageWritePPM_clamped.ppm");
+        if (   (fd == NULL)
+            || (fseek(fd, (long)strlen(header), SEEK_SET) != 0)
+            || (fread(bytes, 1, 6, fd) != 6) ) {
+            printrank("Could not read ImageWritePPM_clamped.ppm.\n");
+            result = TEST_FAILED;
+        } else {
+            IceTInt first = (SCREEN_WIDTH*(SCREEN_HEIGHT-1))%2;
+            int i;
+            for (i = 0; i < 6; i++) {
+                if (bytes[i] != expected_bytes[(3*first + i)%6]) {
+                    printrank("Byte %d of the file is %d, expected %d.\n",
+                              i, (int)bytes[i],
+                              (int)expected_bytes[(3*first + i)%6]);
+                    result = TEST_FAILED;
+                }
+            }
+        }
+        if (fd != NULL) { fclose(fd); }
+    }
+
+    printstat("Checking that an image without colors is rejected.\n");
+    error = ImageWritePPMWriteFormat(ICET_IMAGE_COLOR_NONE, NULL, 0,
+                                     "ImageWritePPM_none.ppm");
+    if ((rank == 0) && (error != ICET_INVALID_VALUE)) {
+        printrank("Got error 0x%X for an image without colors.\n", error);
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+/* Writes image with the error it raises hidden and returns the error. */
+static IceTEnum ImageWritePPMExpectError(const IceTImage image,
+                                         IceTInt tile,
+                                         const char *filename)
+{
+    IceTInt diagnostic_level;
+    IceTEnum error;
+
+    icetGetIntegerv(ICET_DIAGNOSTIC_LEVEL, &diagnostic_level);
+    icetDiagnostics(ICET_DIAG_OFF);
+    icetGetError();
+    icetImageWritePPM(image, tile, filename);
+    error = icetGetError();
+    icetDiagnostics(diagnostic_level);
+
+    return error;
+}
+
+static int ImageWritePPMCheckErrors(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+    IceTInt rank;
+    IceTInt num_tiles;
+    IceTEnum error;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_TILES, &num_tiles);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    printstat("Checking that tiles out of range are rejected.\n");
+    error = ImageWritePPMExpectError(image, -1, "ImageWritePPM_invalid.ppm");
+    if (error != ICET_INVALID_VALUE) {
+        printrank("Got error 0x%X for tile -1.\n", error);
+        result = TEST_FAILED;
+    }
+    error = ImageWritePPMExpectError(image,
+                                     num_tiles,
+                                     "ImageWritePPM_invalid.ppm");
+    if (error != ICET_INVALID_VALUE) {
+        printrank("Got error 0x%X for tile %d.\n", error, (int)num_tiles);
+        result = TEST_FAILED;
+    }
+
+#ifdef __linux__
+    /* Every write to /dev/full fails as if the disk were full. */
+    printstat("Checking that a failed write is reported.\n");
+    error = ImageWritePPMExpectError(image, 0, "/dev/full");
+    if ((rank == 0) && (error != ICET_INVALID_OPERATION)) {
+        printrank("Got error 0x%X writing to a full device.\n", error);
+        result = TEST_FAILED;
+    }
+#endif /*__linux__*/
+
+    return result;
+}
+
+static int ImageWritePPMRun(void)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt num_tiles;
+    IceTInt tile;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetEnable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(ImageWritePPMDraw);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+
+    /* Use a second tile when possible so that a tile other than the first
+       one is written. */
+    num_tiles = (num_proc > 1) ? 2 : 1;
+    icetResetTiles();
+    for (tile = 0; tile < num_tiles; tile++) {
+        icetAddTile(tile*SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT, tile);
+    }
+    icetBoundingBoxd(-0.9, 0.9, -0.8, 0.7, -0.5, 0.5);
+
+    printstat("Writing collected images.\n");
+    icetEnable(ICET_COLLECT_IMAGES);
+    ImageWritePPMFrame("ImageWritePPM_collected", num_tiles);
+
+    printstat("Writing partitions in parallel.\n");
+    icetDisable(ICET_COLLECT_IMAGES);
+    ImageWritePPMFrame("ImageWritePPM_parallel", num_tiles);
+    icetEnable(ICET_COLLECT_IMAGES);
+
+    if (rank == 0) {
+        for (tile = 0; tile < num_tiles; tile++) {
+            char collected_name[64];
+            char parallel_name[64];
+            icetSnprintf(collected_name, 64,
+                         "ImageWritePPM_collected_%d.ppm", (int)tile);
+            icetSnprintf(parallel_name, 64,
+                         "ImageWritePPM_parallel_%d.ppm", (int)tile);
+            printstat("Comparing files for tile %d.\n", (int)tile);
+            if (   ImageWritePPMCompareFiles(collected_name, parallel_name)
+                != TEST_PASSED ) {
+                result = TEST_FAILED;
+            }
+        }
+    }
+
+    if (ImageWritePPMCheckFormats() != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    if (ImageWritePPMCheckErrors() != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+int ImageWritePPM(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ImageWritePPMRun);
+}
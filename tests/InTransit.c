@@ -0,0 +1,306 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the in transit strategy.  The upper half of the processes
+** are compositors and must never render.  The image must match the one the
+** sequential strategy makes when the compositors have nothing to draw.  A
+** copy of the state in a second context must build its own communicator.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevContext.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTBoolean g_drew_frame;
+
+static void InTransitDraw(const IceTDouble *projection_matrix,
+                          const IceTDouble *modelview_matrix,
+                          const IceTFloat *background_color,
+                          const IceTInt *readback_viewport,
+                          IceTImage result)
+{
+    IceTInt rank;
+    IceTFloat color[4];
+    IceTSizeType width;
+    IceTFloat *colors;
+    IceTSizeType line_start;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    g_drew_frame = ICET_TRUE;
+
+    /* Translucent colors that blend exactly in floating point, so that any
+       difference in blending order shows up as a difference in value. */
+    icetGetIntegerv(ICET_RANK, &rank);
+    color[0] = 0.5f*(IceTFloat)( rank     %3)/2.0f;
+    color[1] = 0.5f*(IceTFloat)((rank/3)  %3)/2.0f;
+    color[2] = 0.5f*(IceTFloat)((rank/9)  %3)/2.0f;
+    color[3] = 0.5f;
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorf(result);
+
+    line_start = width*readback_viewport[1];
+    for (line = 0; line < readback_viewport[3]; line++) {
+        IceTSizeType pixel = line_start + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            colors[4*pixel + 0] = color[0];
+            colors[4*pixel + 1] = color[1];
+            colors[4*pixel + 2] = color[2];
+            colors[4*pixel + 3] = color[3];
+            pixel++;
+        }
+        line_start += width;
+    }
+}
+
+static IceTImage InTransitRender(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Splits the screen into num_tiles columns of tiles displayed on
+   display_nodes.  Returns the index of the tile displayed by the local
+   process or -1. */
+static IceTInt InTransitSetTiles(IceTInt num_tiles,
+                                 const IceTInt *display_nodes)
+{
+    IceTInt rank;
+    IceTInt tile_displayed = -1;
+    IceTInt tile;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetResetTiles();
+    for (tile = 0; tile < num_tiles; tile++) {
+        IceTInt x_start = (tile*SCREEN_WIDTH)/num_tiles;
+        IceTInt x_end = ((tile+1)*SCREEN_WIDTH)/num_tiles;
+        icetAddTile(x_start, 0, x_end - x_start, SCREEN_HEIGHT,
+                    display_nodes[tile]);
+        if (display_nodes[tile] == rank) {
+            tile_displayed = tile;
+        }
+    }
+
+    return tile_displayed;
+}
+
+static int InTransitCompareTiles(IceTEnum single_image_strategy,
+                                 IceTInt num_tiles,
+                                 const IceTInt *display_nodes,
+                                 IceTBoolean is_compositor)
+{
+    IceTInt tile_displayed;
+    IceTSizeType num_values;
+    IceTFloat *expected;
+    IceTImage image;
+    int result = TEST_PASSED;
+
+    icetSingleImageStrategy(single_image_strategy);
+    tile_displayed = InTransitSetTiles(num_tiles, display_nodes);
+    printstat("Checking single image strategy %s with %d tiles displaying"
+              " first on %d.\n",
+              icetGetSingleImageStrategyName(),
+              (int)num_tiles, (int)display_nodes[0]);
+
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    image = InTransitRender();
+    num_values = 4*SCREEN_WIDTH*SCREEN_HEIGHT;
+    expected = malloc(num_values*sizeof(IceTFloat));
+    if (tile_displayed >= 0) {
+        num_values = 4*icetImageGetNumPixels(image);
+        memcpy(expected, icetImageGetColorcf(image),
+               num_values*sizeof(IceTFloat));
+    }
+
+    icetStrategy(ICET_STRATEGY_IN_TRANSIT);
+    g_drew_frame = ICET_FALSE;
+    image = InTransitRender();
+    if (is_compositor && g_drew_frame) {
+        printrank("Compositor rendered a frame.\n");
+        result = TEST_FAILED;
+    }
+    if (!is_compositor && !g_drew_frame) {
+        printrank("Renderer did not render a frame.\n");
+        result = TEST_FAILED;
+    }
+    if (tile_displayed >= 0) {
+        const IceTFloat *colors = icetImageGetColorcf(image);
+        IceTSizeType i;
+        for (i = 0; i < num_values; i++) {
+            if (colors[i] != expected[i]) {
+                printrank("Value %d differs with in transit strategy.\n",
+                          (int)i);
+                printrank("    Expected %f, got %f\n",
+                          expected[i], colors[i]);
+                result = TEST_FAILED;
+                break;
+            }
+        }
+    } else if (!icetImageIsNull(image) && !is_compositor) {
+        printrank("Renderer that does not display got an image.\n");
+        result = TEST_FAILED;
+    }
+
+    free(expected);
+    return result;
+}
+
+static int InTransitCompare(IceTEnum single_image_strategy,
+                            IceTInt display_node,
+                            IceTBoolean is_compositor)
+{
+    return InTransitCompareTiles(single_image_strategy,
+                                 1,
+                                 &display_node,
+                                 is_compositor);
+}
+
+static int InTransitRun(void)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt num_compositors;
+    IceTInt *compositors;
+    IceTInt *composite_order;
+    IceTBoolean is_compositor;
+    IceTInt i;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+    if (num_proc < 2) {
+        printstat("Need at least two processes for compositors.\n");
+        return TEST_PASSED;
+    }
+
+    num_compositors = num_proc/2;
+    compositors = malloc(num_compositors*sizeof(IceTInt));
+    for (i = 0; i < num_compositors; i++) {
+        compositors[i] = num_proc - num_compositors + i;
+    }
+    is_compositor = (rank >= num_proc - num_compositors);
+    icetCompositorGroup(num_compositors, compositors);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+    icetDisable(ICET_CORRECT_COLORED_BACKGROUND);
+    icetDrawCallback(InTransitDraw);
+
+    /* Put the compositors' geometry out of view so that the sequential
+       strategy makes the image the renderers alone would make. */
+    if (is_compositor) {
+        icetBoundingBoxd(5.0, 6.0, 5.0, 6.0, -0.5, 0.5);
+    } else {
+        icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+    }
+
+    composite_order = malloc(num_proc*sizeof(IceTInt));
+    for (i = 0; i < num_proc; i++) {
+        composite_order[i] = num_proc - i - 1;
+    }
+    icetEnable(ICET_ORDERED_COMPOSITE);
+    icetCompositeOrder(composite_order);
+    free(composite_order);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_BSWAP, 0, is_compositor)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_RADIXK, 0, is_compositor)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_TREE, 0, is_compositor)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_BSWAP, num_proc - 1,
+                         is_compositor)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    /* Renderer 0 displays the first tile and also renders into the second.
+       It must be able to take part in collecting the first tile while its
+       image of the second is still waiting for the compositor. */
+    {
+        IceTInt display_nodes[2];
+        display_nodes[0] = 0;
+        display_nodes[1] = num_proc - 1;
+        if (InTransitCompareTiles(ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+                                  2, display_nodes, is_compositor)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (InTransitCompareTiles(ICET_SINGLE_IMAGE_STRATEGY_BSWAP,
+                                  2, display_nodes, is_compositor)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    /* Copy the state into a second context and draw with it.  Destroying it
+       must leave the communicator of the original context alone. */
+    {
+        IceTContext original_context = icetGetContext();
+        IceTContext copy_context = icetCreateContext(icetGetCommunicator());
+
+        icetCopyState(copy_context, original_context);
+        icetCompositorGroup(num_compositors, compositors);
+        if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_RADIXK, 0,
+                             is_compositor)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        icetDestroyContext(copy_context);
+        icetSetContext(original_context);
+
+        if (InTransitCompare(ICET_SINGLE_IMAGE_STRATEGY_RADIXK, 0,
+                             is_compositor)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    icetCompositorGroup(0, NULL);
+    free(compositors);
+
+    return result;
+}
+
+int InTransit(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(InTransitRun);
+}
@@ -0,0 +1,182 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that communicators written before Test, Testany, and
+** Waitsome were added to IceTCommunicatorStruct still work.  It composites
+** on a communicator that never sets version or the new members and compares
+** the result with the full communicator.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevContext.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTCommunicator (*g_full_duplicate)(IceTCommunicator self);
+
+/* Makes a copy of the communicator with garbage from version to the end of
+   the struct, as a communicator written against the older struct leaves it
+   when it allocates the struct with malloc.  IceT must not call any of the
+   garbage members. */
+static IceTCommunicator LegacyCommunicatorDuplicate(IceTCommunicator self)
+{
+    IceTCommunicator comm = g_full_duplicate(self);
+    char *new_members = (char *)&comm->version;
+    memset(new_members,
+           0xA5,
+           sizeof(struct IceTCommunicatorStruct)
+           - (size_t)(new_members - (char *)comm));
+    return comm;
+}
+
+static void LegacyCommunicatorDraw(const IceTDouble *projection_matrix,
+                                   const IceTDouble *modelview_matrix,
+                                   const IceTFloat *background_color,
+                                   const IceTInt *readback_viewport,
+                                   IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* Overlapping diagonal bands so that every process contributes to most of
+       the image. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if ((x + y + 16*rank)%(4*num_proc) < 8) {
+                colors[4*pixel + 0] = (IceTUByte)(255*(rank+1)/num_proc);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+                depths[pixel] = (IceTFloat)((rank + x)%7)/8.0f;
+            } else {
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+                depths[pixel] = 1.0f;
+            }
+        }
+    }
+}
+
+static void LegacyCommunicatorSetup(IceTEnum single_image_strategy)
+{
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(LegacyCommunicatorDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+    icetSingleImageStrategy(single_image_strategy);
+}
+
+static IceTImage LegacyCommunicatorRender(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+static int LegacyCommunicatorRun(void)
+{
+    static const IceTEnum single_image_strategies[] = {
+        ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+        ICET_SINGLE_IMAGE_STRATEGY_RADIXKR,
+        ICET_SINGLE_IMAGE_STRATEGY_BSWAP
+    };
+    IceTContext original_context = icetGetContext();
+    struct IceTCommunicatorStruct legacy_comm;
+    IceTSizeType image_size = 4*SCREEN_WIDTH*SCREEN_HEIGHT;
+    IceTUByte *expected_color;
+    IceTInt rank;
+    int strategy_index;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    expected_color = malloc(image_size);
+
+    /* The context duplicates the communicator it is given, so hand it a copy
+       whose Duplicate fills the new members with garbage. */
+    legacy_comm = *icetGetCommunicator();
+    g_full_duplicate = legacy_comm.Duplicate;
+    legacy_comm.Duplicate = LegacyCommunicatorDuplicate;
+
+    for (strategy_index = 0; strategy_index < 3; strategy_index++) {
+        IceTEnum strategy = single_image_strategies[strategy_index];
+        IceTImage image;
+
+        icetSetContext(original_context);
+        LegacyCommunicatorSetup(strategy);
+        printstat("Checking single image strategy %s.\n",
+                  icetGetSingleImageStrategyName());
+        image = LegacyCommunicatorRender();
+        if (rank == 0) {
+            memcpy(expected_color, icetImageGetColorcub(image), image_size);
+        }
+
+        icetCreateContext(&legacy_comm);
+        LegacyCommunicatorSetup(strategy);
+        image = LegacyCommunicatorRender();
+        if (   (rank == 0)
+            && (memcmp(expected_color, icetImageGetColorcub(image), image_size)
+                != 0) ) {
+            printrank("Image differs with the legacy communicator.\n");
+            result = TEST_FAILED;
+        }
+        icetDestroyContext(icetGetContext());
+    }
+
+    icetSetContext(original_context);
+    free(expected_color);
+
+    return result;
+}
+
+int LegacyCommunicator(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(LegacyCommunicatorRun);
+}
@@ -0,0 +1,217 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_PIXEL_BLOCK_SIZE option.  Compositing tiles in
+** block order must give exactly the same image as in scanline order, also when
+** the tile is not a multiple of the block size.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevState.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTSizeType g_tile_width;
+static IceTSizeType g_tile_height;
+
+static void PixelBlockSizeDraw(const IceTDouble *projection_matrix,
+                               const IceTDouble *modelview_matrix,
+                               const IceTFloat *background_color,
+                               const IceTInt *readback_viewport,
+                               IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A disk for each process at a different place and depth. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTSizeType center_x = ((rank + 1)*width)/(num_proc + 2);
+            IceTSizeType center_y = ((rank%3 + 1)*g_tile_height)/4;
+            IceTSizeType radius = g_tile_height/3;
+            IceTSizeType dx = x - center_x;
+            IceTSizeType dy = y - center_y;
+            if (dx*dx + dy*dy < radius*radius) {
+                depths[pixel] = 0.1f + 0.8f*(IceTFloat)((rank*7)%num_proc)
+                    /(IceTFloat)num_proc + 0.0001f*(IceTFloat)dx;
+                colors[4*pixel + 0] = (IceTUByte)(50*rank%256);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+static IceTImage PixelBlockSizeRender(IceTInt block_size)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetStateSetInteger(ICET_PIXEL_BLOCK_SIZE, block_size);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+static int PixelBlockSizeCompare(IceTInt block_size,
+                                 IceTEnum single_image_strategy,
+                                 IceTBoolean fuse_collect)
+{
+    IceTInt rank;
+    IceTSizeType num_pixels = g_tile_width*g_tile_height;
+    IceTUByte *expected_color;
+    IceTFloat *expected_depth;
+    IceTBoolean has_depth;
+    IceTImage image;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetSingleImageStrategy(single_image_strategy);
+    if (fuse_collect) {
+        icetEnable(ICET_FUSE_COLLECT);
+    } else {
+        icetDisable(ICET_FUSE_COLLECT);
+    }
+    has_depth = !icetIsEnabled(ICET_COMPOSITE_ONE_BUFFER);
+    printstat("Block size %d, %s, fuse collect %s, depth %s.\n",
+              (int)block_size, icetGetSingleImageStrategyName(),
+              fuse_collect ? "on" : "off", has_depth ? "on" : "off");
+
+    expected_color = malloc(4*num_pixels);
+    expected_depth = malloc(num_pixels*sizeof(IceTFloat));
+
+    image = PixelBlockSizeRender(0);
+    if (rank == 0) {
+        memcpy(expected_color, icetImageGetColorcub(image), 4*num_pixels);
+        if (has_depth) {
+            memcpy(expected_depth, icetImageGetDepthcf(image),
+                   num_pixels*sizeof(IceTFloat));
+        }
+    }
+
+    image = PixelBlockSizeRender(block_size);
+    if (rank == 0) {
+        if (memcmp(expected_color, icetImageGetColorcub(image), 4*num_pixels)
+            != 0) {
+            printrank("Color differs in block order.\n");
+            result = TEST_FAILED;
+        }
+        if (   has_depth
+            && (memcmp(expected_depth, icetImageGetDepthcf(image),
+                       num_pixels*sizeof(IceTFloat)) != 0) ) {
+            printrank("Depth differs in block order.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    free(expected_depth);
+    free(expected_color);
+
+    return result;
+}
+
+static int PixelBlockSizeRun(void)
+{
+    static const IceTEnum strategies[3] = {
+        ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+        ICET_SINGLE_IMAGE_STRATEGY_BSWAP,
+        ICET_SINGLE_IMAGE_STRATEGY_TREE
+    };
+    IceTInt save_block_size;
+    IceTInt strategy_index;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_PIXEL_BLOCK_SIZE, &save_block_size);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(PixelBlockSizeDraw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+
+    /* A tile that does not divide into whole blocks. */
+    g_tile_width = SCREEN_WIDTH - 3;
+    g_tile_height = SCREEN_HEIGHT - 5;
+    icetResetTiles();
+    icetAddTile(0, 0, g_tile_width, g_tile_height, 0);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    icetDisable(ICET_COMPOSITE_ONE_BUFFER);
+    for (strategy_index = 0; strategy_index < 3; strategy_index++) {
+        if (PixelBlockSizeCompare(8, strategies[strategy_index], ICET_FALSE)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+    if (PixelBlockSizeCompare(5, ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+                              ICET_TRUE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    icetEnable(ICET_COMPOSITE_ONE_BUFFER);
+    if (PixelBlockSizeCompare(16, ICET_SINGLE_IMAGE_STRATEGY_RADIXK,
+                              ICET_FALSE)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetDisable(ICET_FUSE_COLLECT);
+    icetStateSetInteger(ICET_PIXEL_BLOCK_SIZE, save_block_size);
+
+    return result;
+}
+
+int PixelBlockSize(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(PixelBlockSizeRun);
+}
@@ -0,0 +1,197 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_PREDICT_DEPTH option.  Sparse images with
+** predicted depth must come back exactly the same after a round trip through
+** a receive buffer and must be smaller when the depth is planar.  Compositing
+** with the option on must give the same image as with it off.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+
+#include <stdlib.h>
+
+#define IMAGE_WIDTH     300
+#define IMAGE_HEIGHT    200
+
+/* Fills rows with, in turn, planar depth, planar depth with a little noise,
+   random depth and background. */
+static void PredictDepthFill(IceTImage image, IceTInt seed)
+{
+    IceTSizeType width = icetImageGetWidth(image);
+    IceTSizeType height = icetImageGetHeight(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTFloat *depth = icetImageGetDepthf(image);
+    IceTSizeType x, y;
+
+    srand(seed);
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTFloat value;
+
+            switch ((y/8)%4) {
+              case 0:
+                  value = 0.5f + 0.0011f*(IceTFloat)x + 0.0003f*(IceTFloat)y;
+                  break;
+              case 1:
+                  value = 0.6f + 0.0007f*(IceTFloat)x
+                      + 0.00001f*(IceTFloat)(rand()%16);
+                  break;
+              case 2:
+                  value = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+                  break;
+              default:
+                  value = 1.0f;
+                  break;
+            }
+            /* Some holes in the surfaces. */
+            if ((x + 3*y)%37 == 0) { value = 1.0f; }
+            if (value > 1.0f) { value = 1.0f; }
+            depth[pixel] = value;
+
+            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                IceTUByte *color = icetImageGetColorub(image) + 4*pixel;
+                color[0] = (IceTUByte)(x%256);
+                color[1] = (IceTUByte)(y%256);
+                color[2] = (IceTUByte)(rand()%256);
+                color[3] = 255;
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                IceTFloat *color = icetImageGetColorf(image) + 4*pixel;
+                color[0] = (IceTFloat)x/(IceTFloat)width;
+                color[1] = (IceTFloat)y/(IceTFloat)height;
+                color[2] = (IceTFloat)rand()/(IceTFloat)RAND_MAX;
+                color[3] = 1.0f;
+            }
+        }
+    }
+}
+
+static int PredictDepthRoundTrip(IceTEnum color_format)
+{
+    IceTImage image;
+    IceTSparseImage sparse;
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffer;
+    IceTSizeType original_size;
+    IceTSizeType encoded_size;
+    int result;
+
+    printstat("Round trip with color format 0x%X.\n", color_format);
+
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    image_buffer = malloc(icetImageBufferSize(IMAGE_WIDTH, IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer, IMAGE_WIDTH, IMAGE_HEIGHT);
+    PredictDepthFill(image, 1);
+
+    sparse_buffer = malloc(icetSparseImageBufferSize(IMAGE_WIDTH,
+                                                     IMAGE_HEIGHT));
+    sparse = icetSparseImageAssignBuffer(sparse_buffer,
+                                         IMAGE_WIDTH, IMAGE_HEIGHT);
+    icetCompressImage(image, sparse);
+
+    result = check_transport_encoding(sparse,
+                                      ICET_PREDICT_DEPTH,
+                                      icetSparseImageEncodeDepth,
+                                      &original_size,
+                                      &encoded_size);
+    printstat("Encoded %d bytes to %d.\n",
+              (int)original_size, (int)encoded_size);
+    if (encoded_size >= original_size - 2*IMAGE_WIDTH*IMAGE_HEIGHT/4) {
+        printrank("Planar depth did not get smaller.\n");
+        result = TEST_FAILED;
+    }
+
+    free(sparse_buffer);
+    free(image_buffer);
+
+    return result;
+}
+
+static void PredictDepthDraw(const IceTDouble *projection_matrix,
+                             const IceTDouble *modelview_matrix,
+                             const IceTFloat *background_color,
+                             const IceTInt *readback_viewport,
+                             IceTImage result)
+{
+    IceTInt rank;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* Tilted planes that cross each other, so the depth test matters. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTFloat depth = 0.3f + 0.05f*(IceTFloat)(rank%5)
+                + 0.0004f*(IceTFloat)((rank%2) ? x : y);
+            if ((depth >= 1.0f) || ((x + y + rank)%11 == 0)) {
+                depth = 1.0f;
+            }
+            depths[pixel] = depth;
+            colors[4*pixel + 0] = (IceTUByte)(40*rank%256);
+            colors[4*pixel + 1] = (IceTUByte)(x%256);
+            colors[4*pixel + 2] = (IceTUByte)(y%256);
+            colors[4*pixel + 3] = (depth < 1.0f) ? 255 : 0;
+        }
+    }
+}
+
+static int PredictDepthRun(void)
+{
+    int result = TEST_PASSED;
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+
+    if (PredictDepthRoundTrip(ICET_IMAGE_COLOR_RGBA_UBYTE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (PredictDepthRoundTrip(ICET_IMAGE_COLOR_RGBA_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (PredictDepthRoundTrip(ICET_IMAGE_COLOR_NONE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    if (check_transport_encoding_composite(ICET_PREDICT_DEPTH,
+                                           PredictDepthDraw)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+int PredictDepth(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(PredictDepthRun);
+}
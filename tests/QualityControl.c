@@ -0,0 +1,355 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the adaptive quality controller set up with
+** icetTargetFrameTime.  All processes must pick the same render scale,
+** precision, and single image strategy, an unreachable target must lower the
+** quality while still returning full size images, and a generous target must
+** leave the image unchanged.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevCommunication.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static void QualityControlDraw(const IceTDouble *projection_matrix,
+                               const IceTDouble *modelview_matrix,
+                               const IceTFloat *background_color,
+                               const IceTInt *readback_viewport,
+                               IceTImage result)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTEnum color_format;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    color_format = icetImageGetColorFormat(result);
+    depths = icetImageGetDepthf(result);
+
+    /* A band of columns for each process.  The drawing callback is given
+       smaller images when the resolution is lowered. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTBoolean inside = ((x*num_proc)/width == rank);
+            IceTFloat color[4];
+            if (inside) {
+                color[0] = (IceTFloat)(rank + 1)/(IceTFloat)num_proc;
+                color[1] = (IceTFloat)x/(IceTFloat)width;
+                color[2] = (IceTFloat)y/(IceTFloat)height;
+                color[3] = 1.0f;
+                depths[pixel] = 0.5f;
+            } else {
+                color[0] = color[1] = color[2] = color[3] = 0.0f;
+                depths[pixel] = 1.0f;
+            }
+            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                IceTUByte *colors = icetImageGetColorub(result);
+                int i;
+                for (i = 0; i < 4; i++) {
+                    colors[4*pixel + i] = (IceTUByte)(255*color[i]);
+                }
+            } else {
+                memcpy(icetImageGetColorf(result) + 4*pixel,
+                       color,
+                       4*sizeof(IceTFloat));
+            }
+        }
+    }
+}
+
+static IceTImage QualityControlRender(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         g_background_color);
+}
+
+/* Checks that every process picked the same settings for the next frame. */
+static int QualityControlCheckAgreement(void)
+{
+    IceTInt num_proc;
+    IceTDouble settings[3];
+    IceTDouble *all_settings;
+    IceTInt proc;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    {
+        IceTBoolean reduced_precision;
+        IceTInt strategy;
+        icetGetDoublev(ICET_RENDER_SCALE, &settings[0]);
+        icetGetBooleanv(ICET_REDUCED_PRECISION, &reduced_precision);
+        icetGetIntegerv(ICET_SINGLE_IMAGE_STRATEGY, &strategy);
+        settings[1] = (IceTDouble)reduced_precision;
+        settings[2] = (IceTDouble)strategy;
+    }
+
+    all_settings = malloc(3*num_proc*sizeof(IceTDouble));
+    icetCommAllgather(settings, 3, ICET_DOUBLE, all_settings);
+    for (proc = 0; proc < num_proc; proc++) {
+        if (memcmp(settings, all_settings + 3*proc, sizeof(settings)) != 0) {
+            printrank("Process %d picked different quality settings.\n",
+                      (int)proc);
+            result = TEST_FAILED;
+        }
+    }
+    free(all_settings);
+
+    return result;
+}
+
+/* Renders a frame and checks that the image has the size and format that the
+   application asked for. */
+static int QualityControlCheckFrame(IceTEnum color_format,
+                                    IceTImage *image_p)
+{
+    IceTImage image;
+    IceTInt valid_tile;
+    int result = TEST_PASSED;
+
+    image = QualityControlRender();
+    *image_p = image;
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+    if (valid_tile >= 0) {
+        IceTInt valid_num;
+        if (   (icetImageGetWidth(image) != SCREEN_WIDTH)
+            || (icetImageGetHeight(image) != SCREEN_HEIGHT) ) {
+            printrank("Got a %dx%d image instead of %dx%d.\n",
+                      (int)icetImageGetWidth(image),
+                      (int)icetImageGetHeight(image),
+                      SCREEN_WIDTH, SCREEN_HEIGHT);
+            result = TEST_FAILED;
+        }
+        if (icetImageGetColorFormat(image) != color_format) {
+            printrank("Image has the wrong color format.\n");
+            result = TEST_FAILED;
+        }
+        icetGetIntegerv(ICET_VALID_PIXELS_NUM, &valid_num);
+        if (valid_num != SCREEN_WIDTH*SCREEN_HEIGHT) {
+            printrank("Only %d pixels valid.\n", (int)valid_num);
+            result = TEST_FAILED;
+        }
+    }
+
+    {
+        IceTInt tile_viewport[4];
+        icetGetIntegerv(ICET_TILE_VIEWPORTS, tile_viewport);
+        if (   (tile_viewport[2] != SCREEN_WIDTH)
+            || (tile_viewport[3] != SCREEN_HEIGHT) ) {
+            printrank("Tile not restored after the frame.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    if (QualityControlCheckAgreement() != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int QualityControlGenerous(const IceTUByte *expected_color)
+{
+    IceTInt rank;
+    IceTInt frame;
+    int result = TEST_PASSED;
+
+    printstat("Checking that a generous target keeps full quality.\n");
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetTargetFrameTime(1000.0);
+    for (frame = 0; frame < 5; frame++) {
+        IceTImage image;
+        IceTDouble scale;
+        IceTInt valid_tile;
+
+        if (QualityControlCheckFrame(ICET_IMAGE_COLOR_RGBA_UBYTE, &image)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        icetGetIntegerv(ICET_VALID_PIXELS_TILE, &valid_tile);
+        if (   (valid_tile >= 0)
+            && (memcmp(expected_color, icetImageGetColorcub(image),
+                       4*SCREEN_WIDTH*SCREEN_HEIGHT) != 0) ) {
+            printrank("Image differs from reference.\n");
+            result = TEST_FAILED;
+        }
+        icetGetDoublev(ICET_RENDER_SCALE, &scale);
+        if (scale != 1.0) {
+            printrank("Scale lowered to %g with a generous target.\n", scale);
+            result = TEST_FAILED;
+        }
+    }
+
+    return result;
+}
+
+static int QualityControlUnreachable(void)
+{
+    IceTInt frame;
+    IceTDouble scale;
+    int result = TEST_PASSED;
+
+    printstat("Checking that an unreachable target lowers the resolution.\n");
+
+    icetTargetFrameTime(1.0e-9);
+    for (frame = 0; frame < 5; frame++) {
+        IceTImage image;
+        if (QualityControlCheckFrame(ICET_IMAGE_COLOR_RGBA_UBYTE, &image)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        icetGetDoublev(ICET_RENDER_SCALE, &scale);
+        if (scale >= 1.0) {
+            printrank("Scale not lowered on frame %d.\n", (int)frame);
+            result = TEST_FAILED;
+        }
+    }
+
+    /* Turning the controller off returns to full quality. */
+    icetTargetFrameTime(0.0);
+    icetGetDoublev(ICET_RENDER_SCALE, &scale);
+    if (scale != 1.0) {
+        printrank("Scale not reset when the controller is turned off.\n");
+        result = TEST_FAILED;
+    }
+
+    return result;
+}
+
+static int QualityControlPrecision(void)
+{
+    IceTInt frame;
+    IceTBoolean reduced_precision;
+    IceTImage image;
+    int result = TEST_PASSED;
+
+    printstat("Checking that precision is lowered for float colors.\n");
+
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+    icetEnable(ICET_ADAPT_PRECISION);
+    icetTargetFrameTime(1.0e-9);
+
+    if (QualityControlCheckFrame(ICET_IMAGE_COLOR_RGBA_FLOAT, &image)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    icetGetBooleanv(ICET_REDUCED_PRECISION, &reduced_precision);
+    if (!reduced_precision) {
+        printrank("Precision not lowered.\n");
+        result = TEST_FAILED;
+    }
+
+    for (frame = 0; frame < 3; frame++) {
+        if (QualityControlCheckFrame(ICET_IMAGE_COLOR_RGBA_FLOAT, &image)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    icetTargetFrameTime(0.0);
+    icetDisable(ICET_ADAPT_PRECISION);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+
+    return result;
+}
+
+static int QualityControlRun(void)
+{
+    IceTUByte *expected_color;
+    IceTImage image;
+    IceTInt rank;
+    IceTInt strategy_index;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(QualityControlDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+    icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+
+    expected_color = malloc(4*SCREEN_WIDTH*SCREEN_HEIGHT);
+
+    icetTargetFrameTime(0.0);
+    image = QualityControlRender();
+    if (rank == 0) {
+        memcpy(expected_color, icetImageGetColorcub(image),
+               4*SCREEN_WIDTH*SCREEN_HEIGHT);
+    }
+
+    /* Keep running every strategy even after a failure so that all processes
+       make the same sequence of collective calls. */
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        icetStrategy(strategy_list[strategy_index]);
+        icetSingleImageStrategy(ICET_SINGLE_IMAGE_STRATEGY_RADIXK);
+        printstat("Checking strategy %s.\n", icetGetStrategyName());
+        if (QualityControlGenerous(expected_color) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (QualityControlUnreachable() != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (QualityControlPrecision() != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+    }
+
+    free(expected_color);
+
+    return result;
+}
+
+int QualityControl(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(QualityControlRun);
+}
@@ -16,6 +16,8 @@
 
 extern ICET_EXPORT IceTBoolean icetRadixkPartitionLookupUnitTest(void);
 
+extern ICET_EXPORT IceTBoolean icetRadixkScheduleUnitTest(void);
+
 extern ICET_EXPORT IceTBoolean icetRadixkTelescopeSendReceiveTest(void);
 
 static int RadixkUnitTestsRun(void)
@@ -31,6 +33,10 @@ static int RadixkUnitTestsRun(void)
         return TEST_FAILED;
     }
 
+    if (!icetRadixkScheduleUnitTest()) {
+        return TEST_FAILED;
+    }
+
     if (!icetRadixkTelescopeSendReceiveTest()) {
         return TEST_FAILED;
     }
@@ -16,6 +16,8 @@
 
 extern ICET_EXPORT IceTBoolean icetRadixkrPartitionLookupUnitTest(void);
 
+extern ICET_EXPORT IceTBoolean icetRadixkrScheduleUnitTest(void);
+
 static int RadixkUnitTestsRun(void)
 {
     IceTInt rank;
@@ -29,6 +31,10 @@ static int RadixkUnitTestsRun(void)
         return TEST_FAILED;
     }
 
+    if (!icetRadixkrScheduleUnitTest()) {
+        return TEST_FAILED;
+    }
+
     return TEST_PASSED;
 }
 
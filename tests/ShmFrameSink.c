@@ -0,0 +1,250 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the shared memory frame sink.  The display process writes
+** several frames into a ring with fewer slots than frames and reads them back
+** through the reader library.  All frames but the last are composited
+** straight into the ring; the last one is copied in.  It also checks that a
+** second sink cannot take over the name of a running one.
+*****************************************************************************/
+
+#include <IceT.h>
+#include <IceTShm.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+#include <IceTDevPorting.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_FRAMES      3
+#define NUM_SLOTS       2
+
+static void ShmFrameSinkDraw(const IceTDouble *projection_matrix,
+                             const IceTDouble *modelview_matrix,
+                             const IceTFloat *background_color,
+                             const IceTInt *readback_viewport,
+                             IceTImage result)
+{
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTSizeType line_start;
+    IceTSizeType line;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+
+    line_start = width*readback_viewport[1];
+    for (line = 0; line < readback_viewport[3]; line++) {
+        IceTSizeType pixel = line_start + readback_viewport[0];
+        IceTSizeType column;
+        for (column = 0; column < readback_viewport[2]; column++) {
+            colors[4*pixel + 0] = 255;
+            colors[4*pixel + 1] = 0;
+            colors[4*pixel + 2] = (IceTUByte)(column%256);
+            colors[4*pixel + 3] = 255;
+            pixel++;
+        }
+        line_start += width;
+    }
+}
+
+static IceTImage ShmFrameSinkRender(IceTInt frame)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTFloat background_color[4];
+
+    /* Change the background every frame so that the frames differ. */
+    background_color[0] = 0.0f;
+    background_color[1] = 0.25f*(IceTFloat)frame;
+    background_color[2] = 0.0f;
+    background_color[3] = 1.0f;
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         background_color);
+}
+
+static int ShmFrameSinkCheckFrame(const IceTShmFrame *frame,
+                                  IceTUnsignedInt64 expected_sequence,
+                                  const IceTImage image,
+                                  IceTBoolean in_place)
+{
+    IceTUByte *colors;
+    IceTBoolean shared;
+
+    if (frame->sequence != expected_sequence) {
+        printrank("Got frame %d, expected %d.\n",
+                  (int)frame->sequence, (int)expected_sequence);
+        return TEST_FAILED;
+    }
+    if (   (frame->width != icetImageGetWidth(image))
+        || (frame->height != icetImageGetHeight(image))
+        || (frame->color_format != icetImageGetColorFormat(image)) ) {
+        printrank("Frame %d has the wrong size or format.\n",
+                  (int)frame->sequence);
+        return TEST_FAILED;
+    }
+    if (memcmp(frame->pixels,
+               icetImageGetColorcub(image),
+               4*icetImageGetNumPixels(image)) != 0) {
+        printrank("Frame %d has the wrong pixels.\n", (int)frame->sequence);
+        return TEST_FAILED;
+    }
+
+    /* The reader maps the ring at a different address, so check whether the
+       image and the frame share memory by changing a pixel. */
+    colors = icetImageGetColorub(image);
+    colors[0] = (IceTUByte)(colors[0] + 1);
+    shared = (((const IceTUByte *)frame->pixels)[0] == colors[0]);
+    colors[0] = (IceTUByte)(colors[0] - 1);
+    if (shared != in_place) {
+        printrank("Frame %d was %s composited into the ring.\n",
+                  (int)frame->sequence, in_place ? "not" : "unexpectedly");
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
+
+static int ShmFrameSinkRun(void)
+{
+    IceTInt rank;
+    char name[64];
+    IceTShmSink sink = NULL;
+    IceTShmReader reader = NULL;
+    IceTShmFrame first_frame;
+    IceTShmFrame frame;
+    IceTInt frame_index;
+    IceTInt diagnostic_level;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDrawCallback(ShmFrameSinkDraw);
+    icetStrategy(ICET_STRATEGY_REDUCE);
+    icetBoundingBoxd(-0.5, 0.5, -0.5, 0.5, -0.5, 0.5);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    if (rank == 0) {
+        icetSnprintf(name, 64, "/IceTTestShm_%d", (int)getpid());
+        sink = icetShmSinkCreate(name, NUM_SLOTS,
+                                 SCREEN_WIDTH, SCREEN_HEIGHT,
+                                 ICET_IMAGE_COLOR_RGBA_UBYTE);
+        reader = icetShmReaderOpen(name);
+        if ((sink == NULL) || (reader == NULL)) {
+            printrank("Could not set up shared memory ring %s.\n", name);
+            result = TEST_FAILED;
+        } else if (icetShmReaderNextFrame(reader, ICET_FALSE, &frame)) {
+            printrank("Got a frame from an empty ring.\n");
+            result = TEST_FAILED;
+        }
+
+        if (result == TEST_PASSED) {
+            IceTShmSink second_sink;
+
+            printstat("Checking that an existing ring is kept.\n");
+            /* The error is expected, so do not report it. */
+            icetGetIntegerv(ICET_DIAGNOSTIC_LEVEL, &diagnostic_level);
+            icetDiagnostics(ICET_DIAG_OFF);
+            second_sink = icetShmSinkCreate(name, NUM_SLOTS,
+                                            SCREEN_WIDTH, SCREEN_HEIGHT,
+                                            ICET_IMAGE_COLOR_RGBA_UBYTE);
+            icetDiagnostics(diagnostic_level);
+            if (second_sink != NULL) {
+                printrank("Created a second sink with the same name.\n");
+                icetShmSinkDestroy(second_sink);
+                result = TEST_FAILED;
+            } else if (icetGetError() != ICET_INVALID_OPERATION) {
+                printrank("Wrong error for an existing ring.\n");
+                result = TEST_FAILED;
+            }
+        }
+    }
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    for (frame_index = 0; frame_index < NUM_FRAMES; frame_index++) {
+        IceTImage image;
+        IceTBoolean in_place = (frame_index < NUM_FRAMES - 1);
+
+        printstat("Writing frame %d.\n", (int)frame_index);
+        if ((rank == 0) && (result == TEST_PASSED) && in_place) {
+            icetShmSinkBeginFrame(sink);
+        }
+        image = ShmFrameSinkRender(frame_index);
+        if ((rank != 0) || (result != TEST_PASSED)) { continue; }
+
+        if (icetShmSinkWriteImage(sink, image)
+            != (IceTUnsignedInt64)(frame_index + 1)) {
+            printrank("Wrong sequence number from sink.\n");
+            result = TEST_FAILED;
+            continue;
+        }
+        if (!icetShmReaderNextFrame(reader, ICET_TRUE, &frame)) {
+            printrank("Could not read frame %d.\n", (int)frame_index);
+            result = TEST_FAILED;
+            continue;
+        }
+        if (ShmFrameSinkCheckFrame(&frame, frame_index + 1, image, in_place)
+            != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        if (frame_index == 0) {
+            first_frame = frame;
+        }
+    }
+
+    if ((rank == 0) && (result == TEST_PASSED)) {
+        printstat("Checking ring wrap around.\n");
+        if (icetShmReaderNextFrame(reader, ICET_FALSE, &frame)) {
+            printrank("Got a frame that was already read.\n");
+            result = TEST_FAILED;
+        }
+        if (icetShmReaderFrameValid(reader, &first_frame)) {
+            printrank("Overwritten frame still reported as valid.\n");
+            result = TEST_FAILED;
+        }
+        if (!icetShmReaderFrameValid(reader, &frame)) {
+            printrank("Last frame reported as overwritten.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    if (rank == 0) {
+        icetShmReaderClose(reader);
+        icetShmSinkDestroy(sink);
+    }
+
+    return result;
+}
+
+int ShmFrameSink(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(ShmFrameSinkRun);
+}
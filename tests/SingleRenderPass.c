@@ -0,0 +1,205 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that with ICET_SINGLE_RENDER_PASS the drawing callback
+** is called once per frame even when the geometry covers several tiles that
+** do not fit in the physical render size, and that the composited images are
+** the same as when each tile is rendered on its own.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+static IceTInt g_num_render_callbacks;
+
+/* Fills the image with a pattern fixed to the pixels of the global display,
+   found by undoing the viewport part of the projection like a real renderer
+   would. */
+static void SingleRenderPassDraw(const IceTDouble *projection_matrix,
+                                 const IceTDouble *modelview_matrix,
+                                 const IceTFloat *background_color,
+                                 const IceTInt *readback_viewport,
+                                 IceTImage result)
+{
+    IceTInt global_viewport[4];
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTSizeType width;
+    IceTSizeType height;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)modelview_matrix;
+    (void)background_color;
+
+    g_num_render_callbacks++;
+
+    icetGetIntegerv(ICET_GLOBAL_VIEWPORT, global_viewport);
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    width = icetImageGetWidth(result);
+    height = icetImageGetHeight(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        IceTDouble ndc_y = (2.0*y + 1.0)/height - 1.0;
+        IceTDouble global_ndc_y
+            = (ndc_y - projection_matrix[13])/projection_matrix[5];
+        IceTInt gy = (IceTInt)(  (global_ndc_y + 1.0)*0.5*global_viewport[3]
+                               - 0.5 + 0.5);
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTDouble ndc_x = (2.0*x + 1.0)/width - 1.0;
+            IceTDouble global_ndc_x
+                = (ndc_x - projection_matrix[12])/projection_matrix[0];
+            IceTInt gx = (IceTInt)(  (global_ndc_x + 1.0)*0.5*global_viewport[2]
+                                   - 0.5 + 0.5);
+            IceTSizeType pixel = y*width + x;
+            if ((gx/7 + gy/5 + rank)%3 != 0) {
+                depths[pixel]
+                    = ((IceTFloat)((gx + gy + rank)%num_proc) + 0.5f)/num_proc;
+                colors[4*pixel + 0] = (IceTUByte)(40*rank);
+                colors[4*pixel + 1] = (IceTUByte)gx;
+                colors[4*pixel + 2] = (IceTUByte)gy;
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+/* Draws a frame with each tile rendered on its own and another in a single
+   render pass and compares them. */
+static IceTBoolean SingleRenderPassTryFrame(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+    IceTInt tile_displayed;
+    IceTSizeType color_bytes;
+    IceTUByte *expected_color = NULL;
+    IceTBoolean success = ICET_TRUE;
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    icetDisable(ICET_SINGLE_RENDER_PASS);
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &tile_displayed);
+    color_bytes = 4*icetImageGetNumPixels(image);
+    if (tile_displayed >= 0) {
+        expected_color = malloc(color_bytes);
+        memcpy(expected_color, icetImageGetColorcub(image), color_bytes);
+    }
+
+    icetEnable(ICET_SINGLE_RENDER_PASS);
+    g_num_render_callbacks = 0;
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+    if (g_num_render_callbacks > 1) {
+        printrank("***** Drawing callback called %d times *****\n",
+                  (int)g_num_render_callbacks);
+        success = ICET_FALSE;
+    }
+    if (tile_displayed >= 0) {
+        if (memcmp(expected_color, icetImageGetColorcub(image), color_bytes)
+            != 0) {
+            printrank("***** Single pass image differs *****\n");
+            success = ICET_FALSE;
+        }
+        free(expected_color);
+    }
+
+    return success;
+}
+
+static int SingleRenderPassRun(void)
+{
+    IceTBoolean success = ICET_TRUE;
+    IceTInt num_proc;
+    IceTInt tile_dimension;
+    IceTInt strategy_index;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    icetDrawCallback(SingleRenderPassDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDisable(ICET_ORDERED_COMPOSITE);
+
+    for (tile_dimension = 1;
+         (tile_dimension <= 2) && (tile_dimension*tile_dimension <= num_proc);
+         tile_dimension++) {
+        IceTInt tile_x, tile_y;
+
+        printstat("\nUsing %dx%d tiles\n", tile_dimension, tile_dimension);
+        icetResetTiles();
+        for (tile_y = 0; tile_y < tile_dimension; tile_y++) {
+            for (tile_x = 0; tile_x < tile_dimension; tile_x++) {
+                icetAddTile(tile_x*SCREEN_WIDTH,
+                            tile_y*SCREEN_HEIGHT,
+                            SCREEN_WIDTH,
+                            SCREEN_HEIGHT,
+                            tile_y*tile_dimension + tile_x);
+            }
+        }
+
+        for (strategy_index = 0;
+             strategy_index < STRATEGY_LIST_SIZE;
+             strategy_index++) {
+            icetStrategy(strategy_list[strategy_index]);
+            printstat("  Using %s strategy.\n", icetGetStrategyName());
+
+            printstat("    With floating viewport.\n");
+            icetEnable(ICET_FLOATING_VIEWPORT);
+            success &= SingleRenderPassTryFrame();
+
+            printstat("    Without floating viewport.\n");
+            icetDisable(ICET_FLOATING_VIEWPORT);
+            success &= SingleRenderPassTryFrame();
+        }
+    }
+
+    icetDisable(ICET_SINGLE_RENDER_PASS);
+    icetEnable(ICET_FLOATING_VIEWPORT);
+
+    return (success ? TEST_PASSED : TEST_FAILED);
+}
+
+int SingleRenderPass(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(SingleRenderPassRun);
+}
@@ -0,0 +1,296 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks that images are the same whether or not the drawing
+** callback hands finished blocks to IceT with icetDrawBlockFinished and
+** ICET_STREAM_DRAW_BLOCKS is on.  Blocks are finished out of order (and on
+** several threads when available), and some are never handed over.
+*****************************************************************************/
+
+/* Needed for pthreads when compiling with -ansi. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+#include <IceTDevMatrix.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ICET_USE_PTHREADS
+#include <pthread.h>
+#define NUM_DRAW_THREADS 3
+#else
+#define NUM_DRAW_THREADS 1
+#endif
+
+#define BLOCK_SIZE 16
+
+#ifndef MIN
+#define MIN(x, y)       ((x) < (y) ? (x) : (y))
+#endif
+
+static const IceTFloat g_background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+typedef struct {
+    IceTImage result;
+    const IceTInt *readback_viewport;
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt thread;
+} StreamDrawBlocksJob;
+
+static void StreamDrawBlocksFill(const StreamDrawBlocksJob *job,
+                                 const IceTInt *block)
+{
+    IceTSizeType width = icetImageGetWidth(job->result);
+    IceTEnum color_format = icetImageGetColorFormat(job->result);
+    IceTEnum depth_format = icetImageGetDepthFormat(job->result);
+    IceTSizeType x, y;
+
+    for (y = block[1]; y < block[1] + block[3]; y++) {
+        for (x = block[0]; x < block[0] + block[2]; x++) {
+            IceTSizeType pixel = y*width + x;
+            IceTBoolean active = ((x/7 + y/5 + job->rank)%3 != 0);
+            IceTFloat value = (IceTFloat)(((x + y + job->rank)%job->num_proc)
+                                          + 0.5f)/job->num_proc;
+
+            if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+                IceTUByte *color = icetImageGetColorub(job->result) + 4*pixel;
+                color[0] = (IceTUByte)(40*job->rank);
+                color[1] = (IceTUByte)x;
+                color[2] = (IceTUByte)y;
+                color[3] = active ? (IceTUByte)(255*value) : 0;
+            } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+                IceTFloat *color = icetImageGetColorf(job->result) + 4*pixel;
+                color[0] = 0.1f*job->rank;
+                color[1] = (IceTFloat)(x%256)/256;
+                color[2] = (IceTFloat)(y%256)/256;
+                color[3] = active ? value : 0.0f;
+            }
+            if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+                icetImageGetDepthf(job->result)[pixel] = active ? value : 1.0f;
+            }
+        }
+    }
+}
+
+/* Draws every NUM_DRAW_THREADS-th block from the top of the image down.
+   Every other block of the top row is not handed to IceT. */
+static void *StreamDrawBlocksThread(void *arg)
+{
+    const StreamDrawBlocksJob *job = (const StreamDrawBlocksJob *)arg;
+    const IceTInt *viewport = job->readback_viewport;
+    IceTInt blocks_x = (viewport[2] + BLOCK_SIZE - 1)/BLOCK_SIZE;
+    IceTInt blocks_y = (viewport[3] + BLOCK_SIZE - 1)/BLOCK_SIZE;
+    IceTInt block_index;
+
+    for (block_index = blocks_x*blocks_y - 1 - job->thread;
+         block_index >= 0;
+         block_index -= NUM_DRAW_THREADS) {
+        IceTInt block[4];
+        block[0] = viewport[0] + (block_index%blocks_x)*BLOCK_SIZE;
+        block[1] = viewport[1] + (block_index/blocks_x)*BLOCK_SIZE;
+        block[2] = MIN(BLOCK_SIZE, viewport[0] + viewport[2] - block[0]);
+        block[3] = MIN(BLOCK_SIZE, viewport[1] + viewport[3] - block[1]);
+
+        StreamDrawBlocksFill(job, block);
+        if ((block_index < blocks_x*(blocks_y-1)) || (block_index%2 == 0)) {
+            icetDrawBlockFinished(block);
+        }
+    }
+
+    return NULL;
+}
+
+static void StreamDrawBlocksDraw(const IceTDouble *projection_matrix,
+                                 const IceTDouble *modelview_matrix,
+                                 const IceTFloat *background_color,
+                                 const IceTInt *readback_viewport,
+                                 IceTImage result)
+{
+    StreamDrawBlocksJob jobs[NUM_DRAW_THREADS];
+    IceTInt thread;
+#ifdef ICET_USE_PTHREADS
+    pthread_t threads[NUM_DRAW_THREADS];
+#endif
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    for (thread = 0; thread < NUM_DRAW_THREADS; thread++) {
+        jobs[thread].result = result;
+        jobs[thread].readback_viewport = readback_viewport;
+        icetGetIntegerv(ICET_RANK, &jobs[thread].rank);
+        icetGetIntegerv(ICET_NUM_PROCESSES, &jobs[thread].num_proc);
+        jobs[thread].thread = thread;
+    }
+
+#ifdef ICET_USE_PTHREADS
+    for (thread = 1; thread < NUM_DRAW_THREADS; thread++) {
+        pthread_create(&threads[thread], NULL,
+                       StreamDrawBlocksThread, &jobs[thread]);
+    }
+    StreamDrawBlocksThread(&jobs[0]);
+    for (thread = 1; thread < NUM_DRAW_THREADS; thread++) {
+        pthread_join(threads[thread], NULL);
+    }
+#else
+    StreamDrawBlocksThread(&jobs[0]);
+#endif
+}
+
+static void SetUpTiles(IceTInt tile_dimension)
+{
+    IceTInt tile_index = 0;
+    IceTInt tile_x;
+    IceTInt tile_y;
+
+    icetResetTiles();
+    for (tile_y = 0; tile_y < tile_dimension; tile_y++) {
+        for (tile_x = 0; tile_x < tile_dimension; tile_x++) {
+            icetAddTile(tile_x*SCREEN_WIDTH,
+                        tile_y*SCREEN_HEIGHT,
+                        SCREEN_WIDTH,
+                        SCREEN_HEIGHT,
+                        tile_index);
+            tile_index++;
+        }
+    }
+}
+
+/* Draws a frame with and without streaming and compares the color. */
+static IceTBoolean StreamDrawBlocksTryFrame(void)
+{
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+    IceTImage image;
+    IceTInt tile_displayed;
+    IceTSizeType color_bytes;
+    IceTByte *expected_color;
+    IceTBoolean success = ICET_TRUE;
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    icetDisable(ICET_STREAM_DRAW_BLOCKS);
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+
+    icetGetIntegerv(ICET_VALID_PIXELS_TILE, &tile_displayed);
+    if (tile_displayed < 0) {
+        /* No local tile.  Just take part in the collective calls. */
+        icetEnable(ICET_STREAM_DRAW_BLOCKS);
+        icetDrawFrame(projection_matrix, modelview_matrix, g_background_color);
+        return ICET_TRUE;
+    }
+
+    color_bytes = icetImageGetNumPixels(image)*4;
+    if (icetImageGetColorFormat(image) == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+        color_bytes *= sizeof(IceTFloat);
+    }
+    expected_color = malloc(color_bytes);
+    memcpy(expected_color, icetImageGetColorConstVoid(image, NULL), color_bytes);
+
+    icetEnable(ICET_STREAM_DRAW_BLOCKS);
+    image = icetDrawFrame(projection_matrix,
+                          modelview_matrix,
+                          g_background_color);
+    if (memcmp(expected_color,
+               icetImageGetColorConstVoid(image, NULL),
+               color_bytes) != 0) {
+        printrank("***** Streamed image differs *****\n");
+        success = ICET_FALSE;
+    }
+
+    free(expected_color);
+    return success;
+}
+
+static IceTBoolean StreamDrawBlocksTryStrategies(void)
+{
+    IceTBoolean success = ICET_TRUE;
+    IceTInt strategy_index;
+    IceTInt si_strategy_index;
+
+    for (strategy_index = 0;
+         strategy_index < STRATEGY_LIST_SIZE;
+         strategy_index++) {
+        IceTBoolean supports_ordering;
+        icetStrategy(strategy_list[strategy_index]);
+        icetGetBooleanv(ICET_STRATEGY_SUPPORTS_ORDERING, &supports_ordering);
+        if (icetIsEnabled(ICET_ORDERED_COMPOSITE) && !supports_ordering) {
+            continue;
+        }
+        for (si_strategy_index = 0;
+             si_strategy_index < SINGLE_IMAGE_STRATEGY_LIST_SIZE;
+             si_strategy_index += 2) {
+            icetSingleImageStrategy(
+                              single_image_strategy_list[si_strategy_index]);
+            printstat("    Using %s strategy, %s single image strategy.\n",
+                      icetGetStrategyName(),
+                      icetGetSingleImageStrategyName());
+
+            success &= StreamDrawBlocksTryFrame();
+        }
+    }
+
+    return success;
+}
+
+static int StreamDrawBlocksRun(void)
+{
+    IceTBoolean success = ICET_TRUE;
+    IceTInt num_proc;
+    IceTInt tile_dimension;
+
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    icetDrawCallback(StreamDrawBlocksDraw);
+    icetBoundingBoxd(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5);
+
+    for (tile_dimension = 1;
+         (tile_dimension <= 2) && (tile_dimension*tile_dimension <= num_proc);
+         tile_dimension++) {
+        printstat("\nUsing %dx%d tiles\n", tile_dimension, tile_dimension);
+        SetUpTiles(tile_dimension);
+
+        printstat("  Z buffer compositing.\n");
+        icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+        icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+        icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+        success &= StreamDrawBlocksTryStrategies();
+
+        /* Blending is only repeatable in a fixed order. */
+        printstat("  Blended compositing.\n");
+        icetEnable(ICET_ORDERED_COMPOSITE);
+        icetCompositeMode(ICET_COMPOSITE_MODE_BLEND);
+        icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_FLOAT);
+        icetSetDepthFormat(ICET_IMAGE_DEPTH_NONE);
+        success &= StreamDrawBlocksTryStrategies();
+        icetDisable(ICET_ORDERED_COMPOSITE);
+    }
+
+    icetDisable(ICET_STREAM_DRAW_BLOCKS);
+
+    return (success ? TEST_PASSED : TEST_FAILED);
+}
+
+int StreamDrawBlocks(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(StreamDrawBlocksRun);
+}
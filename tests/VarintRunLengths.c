@@ -0,0 +1,226 @@
+/* -*- c -*- *****************************************************************
+** Copyright (C) 2014 Sandia Corporation
+** Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+** the U.S. Government retains certain rights in this software.
+**
+** This source code is released under the New BSD License.
+**
+** This test checks the ICET_VARINT_RUN_LENGTHS option.  Sparse images with
+** short runs must get smaller with variable-length run lengths and come back
+** exactly the same after a round trip through a receive buffer, and
+** compositing with the option on must give the same image as with it off.
+*****************************************************************************/
+
+#include <IceT.h>
+#include "test_codes.h"
+#include "test_util.h"
+
+#include <IceTDevImage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_WIDTH     300
+#define IMAGE_HEIGHT    200
+
+/* Alternates active and inactive runs with random lengths up to
+   max_run_length. */
+static void VarintRunLengthsFill(IceTImage image,
+                                 IceTInt max_run_length,
+                                 IceTInt seed)
+{
+    IceTSizeType num_pixels = icetImageGetNumPixels(image);
+    IceTEnum color_format = icetImageGetColorFormat(image);
+    IceTEnum depth_format = icetImageGetDepthFormat(image);
+    IceTSizeType run_left = 0;
+    IceTBoolean active = ICET_TRUE;
+    IceTSizeType pixel;
+
+    srand(seed);
+    for (pixel = 0; pixel < num_pixels; pixel++) {
+        IceTFloat color[4];
+
+        if (run_left == 0) {
+            active = !active;
+            run_left = rand()%max_run_length + 1;
+        }
+        run_left--;
+
+        if (active) {
+            color[0] = (IceTFloat)(rand()%256)/255.0f;
+            color[1] = (IceTFloat)(rand()%256)/255.0f;
+            color[2] = (IceTFloat)(rand()%256)/255.0f;
+            color[3] = 1.0f;
+        } else {
+            color[0] = color[1] = color[2] = color[3] = 0.0f;
+        }
+
+        if (color_format == ICET_IMAGE_COLOR_RGBA_UBYTE) {
+            IceTUByte *out = icetImageGetColorub(image) + 4*pixel;
+            out[0] = (IceTUByte)(255*color[0]);
+            out[1] = (IceTUByte)(255*color[1]);
+            out[2] = (IceTUByte)(255*color[2]);
+            out[3] = (IceTUByte)(255*color[3]);
+        } else if (color_format == ICET_IMAGE_COLOR_RGBA_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 4*pixel, color, sizeof(color));
+        } else if (color_format == ICET_IMAGE_COLOR_RGB_FLOAT) {
+            memcpy(icetImageGetColorf(image) + 3*pixel, color,
+                   3*sizeof(IceTFloat));
+        }
+
+        if (depth_format == ICET_IMAGE_DEPTH_FLOAT) {
+            icetImageGetDepthf(image)[pixel]
+                = active ? (IceTFloat)rand()/((IceTFloat)RAND_MAX + 1) : 1.0f;
+        }
+    }
+}
+
+static int VarintRunLengthsRoundTrip(IceTEnum composite_mode,
+                                     IceTEnum color_format,
+                                     IceTEnum depth_format)
+{
+    IceTImage image;
+    IceTSparseImage sparse;
+    IceTVoid *image_buffer;
+    IceTVoid *sparse_buffer;
+    IceTSizeType original_size;
+    IceTSizeType encoded_size;
+    IceTInt max_run_length;
+    int result = TEST_PASSED;
+
+    printstat("Round trip with composite mode 0x%X, color 0x%X, depth 0x%X.\n",
+              composite_mode, color_format, depth_format);
+
+    icetCompositeMode(composite_mode);
+    icetSetColorFormat(color_format);
+    icetSetDepthFormat(depth_format);
+    image_buffer = malloc(icetImageBufferSize(IMAGE_WIDTH, IMAGE_HEIGHT));
+    image = icetImageAssignBuffer(image_buffer, IMAGE_WIDTH, IMAGE_HEIGHT);
+    sparse_buffer = malloc(icetSparseImageBufferSize(IMAGE_WIDTH,
+                                                     IMAGE_HEIGHT));
+
+    /* Runs up to 1000 pixels long need two byte lengths. */
+    for (max_run_length = 10; max_run_length <= 1000; max_run_length *= 10) {
+        /* An encoded image can only be sent, so start from a new one. */
+        sparse = icetSparseImageAssignBuffer(sparse_buffer,
+                                             IMAGE_WIDTH, IMAGE_HEIGHT);
+        VarintRunLengthsFill(image, max_run_length, max_run_length);
+        icetCompressImage(image, sparse);
+
+        if (check_transport_encoding(sparse,
+                                     ICET_VARINT_RUN_LENGTHS,
+                                     icetSparseImageEncodeVarint,
+                                     &original_size,
+                                     &encoded_size) != TEST_PASSED) {
+            result = TEST_FAILED;
+        }
+        printstat("Runs up to %d: encoded %d bytes to %d.\n",
+                  (int)max_run_length, (int)original_size, (int)encoded_size);
+        if (encoded_size >= original_size) {
+            printrank("Short runs did not get smaller.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    free(sparse_buffer);
+    free(image_buffer);
+
+    return result;
+}
+
+static void VarintRunLengthsDraw(const IceTDouble *projection_matrix,
+                                 const IceTDouble *modelview_matrix,
+                                 const IceTFloat *background_color,
+                                 const IceTInt *readback_viewport,
+                                 IceTImage result)
+{
+    IceTInt rank;
+    IceTSizeType width;
+    IceTUByte *colors;
+    IceTFloat *depths;
+    IceTSizeType x, y;
+
+    /* To remove warning. */
+    (void)projection_matrix;
+    (void)modelview_matrix;
+    (void)background_color;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+
+    width = icetImageGetWidth(result);
+    colors = icetImageGetColorub(result);
+    depths = icetImageGetDepthf(result);
+
+    /* Thin stripes at a different angle on each process, which have many
+       short runs like the edges of a detailed scene. */
+    for (y = readback_viewport[1];
+         y < readback_viewport[1] + readback_viewport[3];
+         y++) {
+        for (x = readback_viewport[0];
+             x < readback_viewport[0] + readback_viewport[2];
+             x++) {
+            IceTSizeType pixel = y*width + x;
+            if (((x + (rank + 1)*y)/3)%4 == 0) {
+                depths[pixel] = 0.1f + 0.001f*(IceTFloat)((x + rank)%500);
+                colors[4*pixel + 0] = (IceTUByte)(40*rank%256);
+                colors[4*pixel + 1] = (IceTUByte)(x%256);
+                colors[4*pixel + 2] = (IceTUByte)(y%256);
+                colors[4*pixel + 3] = 255;
+            } else {
+                depths[pixel] = 1.0f;
+                colors[4*pixel + 0] = 0;
+                colors[4*pixel + 1] = 0;
+                colors[4*pixel + 2] = 0;
+                colors[4*pixel + 3] = 0;
+            }
+        }
+    }
+}
+
+static int VarintRunLengthsRun(void)
+{
+    int result = TEST_PASSED;
+
+    /* Keep bitmaps out of the way so that only the run lengths change. */
+    icetDisable(ICET_BITMAP_SPARSE_IMAGES);
+
+    if (VarintRunLengthsRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                  ICET_IMAGE_COLOR_RGBA_UBYTE,
+                                  ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (VarintRunLengthsRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                  ICET_IMAGE_COLOR_RGB_FLOAT,
+                                  ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (VarintRunLengthsRoundTrip(ICET_COMPOSITE_MODE_Z_BUFFER,
+                                  ICET_IMAGE_COLOR_NONE,
+                                  ICET_IMAGE_DEPTH_FLOAT) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (VarintRunLengthsRoundTrip(ICET_COMPOSITE_MODE_BLEND,
+                                  ICET_IMAGE_COLOR_RGBA_FLOAT,
+                                  ICET_IMAGE_DEPTH_NONE) != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    if (check_transport_encoding_composite(ICET_VARINT_RUN_LENGTHS,
+                                           VarintRunLengthsDraw)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetEnable(ICET_BITMAP_SPARSE_IMAGES);
+
+    return result;
+}
+
+int VarintRunLengths(int argc, char *argv[])
+{
+    /* To remove warning. */
+    (void)argc;
+    (void)argv;
+
+    return run_test(VarintRunLengthsRun);
+}
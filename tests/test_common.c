@@ -11,6 +11,7 @@
 #include "test_codes.h"
 
 #include <IceTDevCommunication.h>
+#include <IceTDevMatrix.h>
 #include <IceTDevPorting.h>
 
 #ifndef __USE_POSIX
@@ -270,6 +271,172 @@ IceTBoolean strategy_uses_single_image_strategy(IceTEnum strategy)
     }
 }
 
+static void set_enabled(IceTEnum option, IceTBoolean enabled)
+{
+    if (enabled) {
+        icetEnable(option);
+    } else {
+        icetDisable(option);
+    }
+}
+
+int check_transport_encoding(IceTSparseImage sparse,
+                             IceTEnum option,
+                             void (*encode)(IceTSparseImage),
+                             IceTSizeType *original_size,
+                             IceTSizeType *encoded_size)
+{
+    IceTBoolean was_enabled = icetIsEnabled(option);
+    IceTSparseImage received;
+    IceTVoid *package_buffer;
+    IceTVoid *expected_buffer;
+    IceTVoid *receive_buffer;
+    IceTSizeType package_size;
+    int result = TEST_PASSED;
+
+    /* An encoded image can only be packaged, so get its size first. */
+    receive_buffer = malloc(
+        icetSparseImageBufferSize(icetSparseImageGetWidth(sparse),
+                                  icetSparseImageGetHeight(sparse)));
+
+    icetSparseImagePackageForSend(sparse, &package_buffer, original_size);
+    expected_buffer = malloc(*original_size);
+    memcpy(expected_buffer, package_buffer, *original_size);
+
+    icetDisable(option);
+    encode(sparse);
+    icetSparseImagePackageForSend(sparse, &package_buffer, &package_size);
+    if (package_size != *original_size) {
+        printrank("Image was encoded with the option off.\n");
+        result = TEST_FAILED;
+    }
+
+    icetEnable(option);
+    encode(sparse);
+    icetSparseImagePackageForSend(sparse, &package_buffer, encoded_size);
+
+    memcpy(receive_buffer, package_buffer, *encoded_size);
+    received = icetSparseImageUnpackageFromReceive(receive_buffer);
+    icetSparseImagePackageForSend(received, &package_buffer, &package_size);
+    if (   (package_size != *original_size)
+        || (memcmp(package_buffer, expected_buffer, package_size) != 0) ) {
+        printrank("Decoded image differs from the original.\n");
+        result = TEST_FAILED;
+    }
+
+    set_enabled(option, was_enabled);
+    free(receive_buffer);
+    free(expected_buffer);
+
+    return result;
+}
+
+static IceTImage transport_encoding_render(IceTEnum option,
+                                           IceTBoolean enabled)
+{
+    static const IceTFloat background_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+    IceTDouble projection_matrix[16];
+    IceTDouble modelview_matrix[16];
+
+    set_enabled(option, enabled);
+
+    icetMatrixIdentity(projection_matrix);
+    icetMatrixIdentity(modelview_matrix);
+
+    return icetDrawFrame(projection_matrix,
+                         modelview_matrix,
+                         background_color);
+}
+
+static int transport_encoding_composite(IceTEnum option,
+                                        IceTEnum single_image_strategy)
+{
+    IceTInt rank;
+    IceTInt num_proc;
+    IceTInt expected_bytes_sent;
+    IceTInt bytes_sent;
+    IceTSizeType num_pixels = SCREEN_WIDTH*SCREEN_HEIGHT;
+    IceTUByte *expected_color;
+    IceTFloat *expected_depth;
+    IceTImage image;
+    int result = TEST_PASSED;
+
+    icetGetIntegerv(ICET_RANK, &rank);
+    icetGetIntegerv(ICET_NUM_PROCESSES, &num_proc);
+
+    icetSingleImageStrategy(single_image_strategy);
+    printstat("Compositing with %s.\n", icetGetSingleImageStrategyName());
+
+    expected_color = malloc(4*num_pixels);
+    expected_depth = malloc(num_pixels*sizeof(IceTFloat));
+
+    image = transport_encoding_render(option, ICET_FALSE);
+    icetGetIntegerv(ICET_BYTES_SENT, &expected_bytes_sent);
+    if (rank == 0) {
+        memcpy(expected_color, icetImageGetColorcub(image), 4*num_pixels);
+        memcpy(expected_depth, icetImageGetDepthcf(image),
+               num_pixels*sizeof(IceTFloat));
+    }
+
+    image = transport_encoding_render(option, ICET_TRUE);
+    icetGetIntegerv(ICET_BYTES_SENT, &bytes_sent);
+    if ((num_proc > 1) && (bytes_sent >= expected_bytes_sent)) {
+        printrank("Encoding did not send fewer bytes (%d vs %d).\n",
+                  (int)bytes_sent, (int)expected_bytes_sent);
+        result = TEST_FAILED;
+    }
+    if (rank == 0) {
+        if (   (memcmp(expected_color, icetImageGetColorcub(image),
+                       4*num_pixels) != 0)
+            || (memcmp(expected_depth, icetImageGetDepthcf(image),
+                       num_pixels*sizeof(IceTFloat)) != 0) ) {
+            printrank("Image differs with encoding.\n");
+            result = TEST_FAILED;
+        }
+    }
+
+    free(expected_depth);
+    free(expected_color);
+
+    return result;
+}
+
+int check_transport_encoding_composite(IceTEnum option,
+                                       IceTDrawCallbackType draw)
+{
+    IceTBoolean was_enabled = icetIsEnabled(option);
+    int result = TEST_PASSED;
+
+    icetCompositeMode(ICET_COMPOSITE_MODE_Z_BUFFER);
+    icetSetColorFormat(ICET_IMAGE_COLOR_RGBA_UBYTE);
+    icetSetDepthFormat(ICET_IMAGE_DEPTH_FLOAT);
+    icetDisable(ICET_COMPOSITE_ONE_BUFFER);
+    icetDrawCallback(draw);
+    icetStrategy(ICET_STRATEGY_SEQUENTIAL);
+    icetBoundingBoxd(-0.9, 0.9, -0.9, 0.9, -0.5, 0.5);
+
+    icetResetTiles();
+    icetAddTile(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+
+    /* Keep running every frame even after a failure so that all processes
+       make the same sequence of collective calls. */
+    if (transport_encoding_composite(option,
+                                     ICET_SINGLE_IMAGE_STRATEGY_RADIXK)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+    if (transport_encoding_composite(option,
+                                     ICET_SINGLE_IMAGE_STRATEGY_RADIXKR)
+        != TEST_PASSED) {
+        result = TEST_FAILED;
+    }
+
+    icetEnable(ICET_COMPOSITE_ONE_BUFFER);
+    set_enabled(option, was_enabled);
+
+    return result;
+}
+
 int run_test_base(int (*test_function)())
 {
     int result;
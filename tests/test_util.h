@@ -20,6 +20,7 @@ extern "C" {
 #endif
 
 #include <IceT.h>
+#include <IceTDevImage.h>
 
 extern IceTEnum strategy_list[];
 extern int STRATEGY_LIST_SIZE;
@@ -51,6 +52,25 @@ void write_ppm(const char *filename,
 
 IceTBoolean strategy_uses_single_image_strategy(IceTEnum strategy);
 
+/* Checks one of the encodings that sparse images get when packaged for
+   send.  option is the state enable that turns the encoding on and encode
+   is the function that applies it.  With option disabled, encode must leave
+   the image alone.  With it enabled, the encoded image must come back
+   exactly the same after a round trip through a receive buffer.  The sizes
+   of the package before and after encoding are returned so that the caller
+   can check how well the encoding did.  sparse must not be encoded yet. */
+int check_transport_encoding(IceTSparseImage sparse,
+                             IceTEnum option,
+                             void (*encode)(IceTSparseImage),
+                             IceTSizeType *original_size,
+                             IceTSizeType *encoded_size);
+
+/* Draws full screen frames of depth composited ubyte images with draw and
+   checks that turning option on gives exactly the same image while sending
+   fewer bytes, once with radix-k and once with radix-kr. */
+int check_transport_encoding_composite(IceTEnum option,
+                                       IceTDrawCallbackType draw);
+
 #ifdef __cplusplus
 }
 #endif